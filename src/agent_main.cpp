@@ -0,0 +1,172 @@
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "agent_protocol.h"
+
+// Serves the agent protocol on standard input and output, or to one Unix
+// socket client at a time. Every complete frame in a read is handled
+// before any reply is written, and all of their replies go out in one
+// write, so a client that pipelines frames pays for a read and a write
+// per batch rather than per frame.
+
+const std::size_t AGENT_READ_SIZE = 256 * 1024;
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--width N] [--height N] [--socket PATH]\n"
+               "Runs games for another process over the binary protocol in\n"
+               "src/agent_protocol.h, on standard input and output or, with\n"
+               "--socket, for each client of a Unix socket in turn.\n",
+               program);
+}
+
+bool write_all(int fd, const std::uint8_t *data, std::size_t size) {
+  while (size > 0) {
+    ssize_t written = write(fd, data, size);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    data += written;
+    size -= written;
+  }
+  return true;
+}
+
+// Returns false on a read or write error or a malformed frame, and true
+// once the input ends.
+bool serve(int in_fd, int out_fd, AgentGames &games) {
+  std::vector<std::uint8_t> input(AGENT_READ_SIZE);
+  std::vector<std::uint8_t> reply;
+  std::size_t start = 0;
+  std::size_t end = 0;
+  while (true) {
+    while (end - start >= AGENT_LENGTH_SIZE) {
+      std::uint32_t length = get_agent_u32(&input[start]);
+      if (length > AGENT_MAX_FRAME) {
+        std::fprintf(stderr, "Frame of %u bytes is too long\n", length);
+        return false;
+      }
+      if (end - start < AGENT_LENGTH_SIZE + length) {
+        break;
+      }
+      if (!handle_agent_frame(games, &input[start + AGENT_LENGTH_SIZE], length, reply)) {
+        std::fprintf(stderr, "Malformed frame\n");
+        return false;
+      }
+      start += AGENT_LENGTH_SIZE + length;
+    }
+    if (!reply.empty()) {
+      if (!write_all(out_fd, reply.data(), reply.size())) {
+        std::fprintf(stderr, "Write failed: %s\n", std::strerror(errno));
+        return false;
+      }
+      reply.clear(); // keeps the capacity
+    }
+
+    // Move a partial frame to the front, growing the buffer if it is
+    // larger than the buffer.
+    std::memmove(input.data(), input.data() + start, end - start);
+    end -= start;
+    start = 0;
+    if (end >= AGENT_LENGTH_SIZE) {
+      std::size_t needed = AGENT_LENGTH_SIZE + get_agent_u32(input.data());
+      if (needed > input.size()) {
+        input.resize(needed);
+      }
+    }
+    if (end == input.size()) {
+      input.resize(input.size() * 2);
+    }
+
+    ssize_t count = read(in_fd, input.data() + end, input.size() - end);
+    if (count == 0) {
+      return end == 0;
+    }
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::fprintf(stderr, "Read failed: %s\n", std::strerror(errno));
+      return false;
+    }
+    end += count;
+  }
+}
+
+int listen_unix(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  unlink(path);
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int main(int argc, char *argv[]) {
+  int width = DEFAULT_WIDTH;
+  int height = DEFAULT_HEIGHT;
+  std::string socket_path;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--width" && i + 1 < argc) {
+      width = std::atoi(argv[++i]);
+    } else if (arg == "--height" && i + 1 < argc) {
+      height = std::atoi(argv[++i]);
+    } else if (arg == "--socket" && i + 1 < argc) {
+      socket_path = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (width < MAX_TETROMINO_WIDTH || height < MAX_TETROMINO_HEIGHT) {
+    usage(argv[0]);
+    return 1;
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  if (socket_path.empty()) {
+    AgentGames games = new_agent_games(width, height);
+    return serve(STDIN_FILENO, STDOUT_FILENO, games) ? 0 : 1;
+  }
+
+  int listener = listen_unix(socket_path.c_str());
+  if (listener < 0) {
+    std::fprintf(stderr, "Unable to listen on %s: %s\n", socket_path.c_str(), std::strerror(errno));
+    return 1;
+  }
+  while (true) {
+    int client = accept(listener, nullptr, nullptr);
+    if (client < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      std::fprintf(stderr, "accept failed: %s\n", std::strerror(errno));
+      return 1;
+    }
+    AgentGames games = new_agent_games(width, height);
+    serve(client, client, games);
+    close(client);
+  }
+}
@@ -0,0 +1,218 @@
+#include <cstring>
+#include <utility>
+
+#include "agent_protocol.h"
+#include "packed_state.h"
+#include "session_protocol.h"
+
+static void put_u32(std::uint8_t *out, std::uint32_t value) {
+  out[0] = value & 0xFF;
+  out[1] = (value >> 8) & 0xFF;
+  out[2] = (value >> 16) & 0xFF;
+  out[3] = (value >> 24) & 0xFF;
+}
+
+std::uint32_t get_agent_u32(const std::uint8_t *in) {
+  return static_cast<std::uint32_t>(in[0])
+       | static_cast<std::uint32_t>(in[1]) << 8
+       | static_cast<std::uint32_t>(in[2]) << 16
+       | static_cast<std::uint32_t>(in[3]) << 24;
+}
+
+std::size_t agent_block_size(AgentBlock block) {
+  switch (block) {
+  case AgentBlock::STATUS:
+    return STATUS_REPORT_SIZE;
+  case AgentBlock::PACKED:
+    return PACKED_STATE_SIZE;
+  default:
+    return 0;
+  }
+}
+
+AgentGames new_agent_games(int width, int height) {
+  return {width, height, {}};
+}
+
+static bool is_step_action(std::uint8_t byte) {
+  return is_valid_action_byte(byte) &&
+         byte != static_cast<std::uint8_t>(Action::QUIT) &&
+         byte != static_cast<std::uint8_t>(Action::NEW_GAME);
+}
+
+// Checks that the entries fill the body exactly, before any is applied.
+static bool entries_fit(AgentRequestKind kind,
+                        const std::uint8_t *entries,
+                        std::size_t size,
+                        std::uint32_t count) {
+  std::size_t offset = 0;
+  for (std::uint32_t i = 0; i < count; i++) {
+    switch (kind) {
+    case AgentRequestKind::NEW_GAME:
+      offset += 8;
+      break;
+    case AgentRequestKind::STEP:
+      if (size - offset < 8) {
+        return false;
+      }
+      offset += 8 + static_cast<std::size_t>(get_agent_u32(entries + offset + 4));
+      break;
+    case AgentRequestKind::END_GAME:
+      offset += 4;
+      break;
+    }
+    if (offset > size) {
+      return false;
+    }
+  }
+  return offset == size;
+}
+
+// Appends the reply entry for game, whose state is null if it does not
+// exist.
+static void add_reply_entry(std::uint8_t *&out,
+                            std::uint32_t game,
+                            AgentStatus status,
+                            AgentBlock block,
+                            const GameState *state,
+                            std::uint32_t actions_applied) {
+  std::size_t block_size = agent_block_size(block);
+  std::memset(out, 0, AGENT_REPLY_ENTRY_SIZE + block_size);
+  put_u32(out, game);
+  std::uint8_t *block_bytes = out + AGENT_REPLY_ENTRY_SIZE;
+  if (state != nullptr && block == AgentBlock::STATUS) {
+    encode_status_report(make_status_report(*state, actions_applied), block_bytes);
+  } else if (state != nullptr && block == AgentBlock::PACKED) {
+    PackedState packed;
+    if (pack_state(packed_format(*state), *state, packed)) {
+      std::memcpy(block_bytes, packed.bytes, PACKED_STATE_SIZE);
+    } else if (status == AgentStatus::OK) {
+      status = AgentStatus::TOO_LARGE;
+    }
+  }
+  out[4] = static_cast<std::uint8_t>(status);
+  out += AGENT_REPLY_ENTRY_SIZE + block_size;
+}
+
+bool handle_agent_frame(AgentGames &games,
+                        const std::uint8_t *body,
+                        std::size_t size,
+                        std::vector<std::uint8_t> &reply) {
+  if (size < AGENT_HEADER_SIZE) {
+    return false;
+  }
+  AgentRequestKind kind = static_cast<AgentRequestKind>(body[0]);
+  AgentBlock block = static_cast<AgentBlock>(body[1]);
+  std::uint32_t count = get_agent_u32(body + 4);
+  const std::uint8_t *entries = body + AGENT_HEADER_SIZE;
+  std::size_t entries_size = size - AGENT_HEADER_SIZE;
+  if (kind < AgentRequestKind::NEW_GAME || kind > AgentRequestKind::END_GAME ||
+      block > AgentBlock::PACKED ||
+      !entries_fit(kind, entries, entries_size, count)) {
+    return false;
+  }
+
+  // Entries are at least four bytes, so count is bounded by the body.
+  std::size_t reply_size = AGENT_HEADER_SIZE +
+                           count * (AGENT_REPLY_ENTRY_SIZE + agent_block_size(block));
+  std::size_t frame_start = reply.size();
+  reply.resize(frame_start + AGENT_LENGTH_SIZE + reply_size);
+  std::uint8_t *out = &reply[frame_start];
+  put_u32(out, static_cast<std::uint32_t>(reply_size));
+  std::memcpy(out + AGENT_LENGTH_SIZE, body, AGENT_HEADER_SIZE);
+  out += AGENT_LENGTH_SIZE + AGENT_HEADER_SIZE;
+
+  const std::uint8_t *in = entries;
+  for (std::uint32_t i = 0; i < count; i++) {
+    std::uint32_t id = get_agent_u32(in);
+    auto game = games.games.find(id);
+    switch (kind) {
+    case AgentRequestKind::NEW_GAME: {
+      std::uint32_t seed = get_agent_u32(in + 4);
+      in += 8;
+      if (game == games.games.end()) {
+        if (games.games.size() >= AGENT_MAX_GAMES) {
+          add_reply_entry(out, id, AgentStatus::TOO_MANY_GAMES, block, nullptr, 0);
+          break;
+        }
+        game = games.games.emplace(id, GameState()).first;
+      }
+      game->second = new_game(games.width, games.height, seed);
+      add_reply_entry(out, id, AgentStatus::OK, block, &game->second, 0);
+      break;
+    }
+    case AgentRequestKind::STEP: {
+      std::uint32_t actions = get_agent_u32(in + 4);
+      const std::uint8_t *action = in + 8;
+      in += 8 + actions;
+      if (game == games.games.end()) {
+        add_reply_entry(out, id, AgentStatus::UNKNOWN_GAME, block, nullptr, 0);
+        break;
+      }
+      GameState &state = game->second;
+      std::uint32_t applied = 0;
+      while (applied < actions && is_step_action(action[applied])) {
+        state = reduce(std::move(state), static_cast<Action>(action[applied]));
+        applied++;
+      }
+      add_reply_entry(out, id,
+                      applied == actions ? AgentStatus::OK : AgentStatus::INVALID_ACTION,
+                      block, &state, applied);
+      break;
+    }
+    case AgentRequestKind::END_GAME:
+      in += 4;
+      if (game == games.games.end()) {
+        add_reply_entry(out, id, AgentStatus::UNKNOWN_GAME, block, nullptr, 0);
+        break;
+      }
+      add_reply_entry(out, id, AgentStatus::OK, block, &game->second, 0);
+      games.games.erase(game);
+      break;
+    }
+  }
+  return true;
+}
+
+std::size_t begin_agent_frame(std::vector<std::uint8_t> &out,
+                              AgentRequestKind kind,
+                              AgentBlock block,
+                              std::uint32_t count) {
+  std::size_t frame_start = out.size();
+  out.resize(frame_start + AGENT_LENGTH_SIZE + AGENT_HEADER_SIZE, 0);
+  std::uint8_t *header = &out[frame_start + AGENT_LENGTH_SIZE];
+  header[0] = static_cast<std::uint8_t>(kind);
+  header[1] = static_cast<std::uint8_t>(block);
+  put_u32(header + 4, count);
+  return frame_start;
+}
+
+static void append_u32(std::vector<std::uint8_t> &out, std::uint32_t value) {
+  out.resize(out.size() + 4);
+  put_u32(&out[out.size() - 4], value);
+}
+
+void add_new_game_entry(std::vector<std::uint8_t> &out, std::uint32_t game, std::uint32_t seed) {
+  append_u32(out, game);
+  append_u32(out, seed);
+}
+
+void add_step_entry(std::vector<std::uint8_t> &out,
+                    std::uint32_t game,
+                    const Action *actions,
+                    std::uint32_t count) {
+  append_u32(out, game);
+  append_u32(out, count);
+  for (std::uint32_t i = 0; i < count; i++) {
+    out.push_back(static_cast<std::uint8_t>(actions[i]));
+  }
+}
+
+void add_end_game_entry(std::vector<std::uint8_t> &out, std::uint32_t game) {
+  append_u32(out, game);
+}
+
+void finish_agent_frame(std::vector<std::uint8_t> &out, std::size_t frame_start) {
+  put_u32(&out[frame_start],
+          static_cast<std::uint32_t>(out.size() - frame_start - AGENT_LENGTH_SIZE));
+}
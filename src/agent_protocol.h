@@ -0,0 +1,97 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "state.h"
+
+// Binary protocol for driving many games from another process, used by
+// TetrisAgent over a pipe or a Unix socket.
+//
+// Both directions are a stream of frames: a little-endian u32 length,
+// counting the bytes after it, then an 8-byte header and a list of
+// entries. The header is
+//   u8 kind, u8 block, u16 zero, u32 entry count
+// and request entries are, by kind:
+//   NEW_GAME  u32 game, u32 seed: starts the game over from seed
+//   STEP      u32 game, u32 n, n action bytes: applies the actions
+//   END_GAME  u32 game: forgets the game
+// Games are named by any u32 id, up to AGENT_MAX_GAMES at once, and one
+// frame may carry any mix of them. The reply has the request's kind and
+// block, and one entry per request entry, in order:
+//   u32 game, u8 AgentStatus, 3 zero bytes, then the block
+// where the block describes the game after the request:
+//   NONE    nothing
+//   STATUS  a session_protocol StatusReport, 16 bytes, its
+//           actions_applied counting this entry's actions
+//   PACKED  a PackedState, 48 bytes
+// A game that does not exist, or will not pack, gets a zeroed block, so
+// every reply entry of a frame is the same size.
+//
+// Requests are decoded in place and replies encoded into a buffer the
+// caller keeps, so once the buffers have grown to size, stepping games
+// allocates nothing.
+
+const std::size_t AGENT_LENGTH_SIZE = 4;
+const std::size_t AGENT_HEADER_SIZE = 8;
+const std::size_t AGENT_REPLY_ENTRY_SIZE = 8;
+const std::uint32_t AGENT_MAX_FRAME = 64 * 1024 * 1024;
+const std::size_t AGENT_MAX_GAMES = 1 << 16;
+
+enum class AgentRequestKind : std::uint8_t {
+  NEW_GAME = 1,
+  STEP = 2,
+  END_GAME = 3
+};
+
+enum class AgentBlock : std::uint8_t {
+  NONE = 0,
+  STATUS = 1,
+  PACKED = 2
+};
+
+enum class AgentStatus : std::uint8_t {
+  OK = 0,
+  UNKNOWN_GAME = 1,
+  INVALID_ACTION = 2, // NEW_GAME, QUIT or unknown; the actions before it were applied
+  TOO_LARGE = 3,      // the field does not fit a packed block
+  TOO_MANY_GAMES = 4
+};
+
+std::size_t agent_block_size(AgentBlock block);
+
+struct AgentGames {
+  int width;
+  int height;
+  std::unordered_map<std::uint32_t, GameState> games;
+};
+
+AgentGames new_agent_games(int width, int height);
+
+// Handles the request frame body (the bytes after the length) and
+// appends the reply frame, length included, to reply. Returns false,
+// appending nothing, if the body is malformed.
+bool handle_agent_frame(AgentGames &games,
+                        const std::uint8_t *body,
+                        std::size_t size,
+                        std::vector<std::uint8_t> &reply);
+
+// For clients: begin_agent_frame appends a request's length and header
+// to out and returns where the frame starts; the entries follow, and
+// finish_agent_frame fills in the length.
+std::size_t begin_agent_frame(std::vector<std::uint8_t> &out,
+                              AgentRequestKind kind,
+                              AgentBlock block,
+                              std::uint32_t count);
+void add_new_game_entry(std::vector<std::uint8_t> &out, std::uint32_t game, std::uint32_t seed);
+void add_step_entry(std::vector<std::uint8_t> &out,
+                    std::uint32_t game,
+                    const Action *actions,
+                    std::uint32_t count);
+void add_end_game_entry(std::vector<std::uint8_t> &out, std::uint32_t game);
+void finish_agent_frame(std::vector<std::uint8_t> &out, std::size_t frame_start);
+
+// Reads a little-endian u32, such as a frame's length.
+std::uint32_t get_agent_u32(const std::uint8_t *in);
@@ -0,0 +1,67 @@
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.h"
+
+static thread_local AllocationCount thread_count = {0, 0};
+
+static void *counted_allocation(std::size_t size) {
+  thread_count.allocations++;
+  thread_count.bytes += size;
+  return std::malloc(size == 0 ? 1 : size);
+}
+
+AllocationCount thread_allocation_count() {
+  return thread_count;
+}
+
+AllocationCount allocations_since(AllocationCount earlier) {
+  return {
+    thread_count.allocations - earlier.allocations,
+    thread_count.bytes - earlier.bytes
+  };
+}
+
+void *operator new(std::size_t size) {
+  void *memory = counted_allocation(size);
+  if (memory == nullptr) {
+    throw std::bad_alloc();
+  }
+  return memory;
+}
+
+void *operator new[](std::size_t size) {
+  return operator new(size);
+}
+
+void *operator new(std::size_t size, const std::nothrow_t &) noexcept {
+  return counted_allocation(size);
+}
+
+void *operator new[](std::size_t size, const std::nothrow_t &) noexcept {
+  return counted_allocation(size);
+}
+
+void operator delete(void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, std::size_t) noexcept {
+  std::free(memory);
+}
+
+void operator delete(void *memory, const std::nothrow_t &) noexcept {
+  std::free(memory);
+}
+
+void operator delete[](void *memory, const std::nothrow_t &) noexcept {
+  std::free(memory);
+}
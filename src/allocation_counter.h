@@ -0,0 +1,17 @@
+#pragma once
+
+// Counts heap allocations made by the calling thread. Linking
+// allocation_counter.cpp replaces the global operator new and delete in
+// the whole executable. It is linked into Test and into TetrisServer,
+// whose metrics count the allocations of each reduce, and into nothing
+// else.
+
+struct AllocationCount {
+  unsigned long long allocations;
+  unsigned long long bytes;
+};
+
+AllocationCount thread_allocation_count();
+
+// Allocations made by this thread since an earlier reading.
+AllocationCount allocations_since(AllocationCount earlier);
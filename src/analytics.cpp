@@ -0,0 +1,335 @@
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <limits>
+#include <string>
+#include <utility>
+
+#include "analytics.h"
+#include "parallel.h"
+
+const int HISTOGRAM_BAR_WIDTH = 40;
+const double ANALYTICS_QUANTILES[] = {0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99};
+// The chi-square value with TETROMINO_COUNT - 1 degrees of freedom that a
+// fair deal exceeds one time in a thousand.
+const double PIECE_CHI_SQUARE_LIMIT = 22.458;
+const char TETROMINO_LETTERS[] = "IJLOSTZ";
+
+static int bucket_index(std::uint64_t value) {
+  if (value < HISTOGRAM_SUB_BUCKETS) {
+    return static_cast<int>(value);
+  }
+  int power = 63 - __builtin_clzll(value); // at least 4
+  int sub = static_cast<int>(value >> (power - 4)) & (HISTOGRAM_SUB_BUCKETS - 1);
+  return HISTOGRAM_SUB_BUCKETS * (power - 3) + sub;
+}
+
+static std::uint64_t bucket_low(int index) {
+  if (index < HISTOGRAM_SUB_BUCKETS) {
+    return index;
+  }
+  int power = index / HISTOGRAM_SUB_BUCKETS + 3;
+  std::uint64_t sub = index % HISTOGRAM_SUB_BUCKETS;
+  return (HISTOGRAM_SUB_BUCKETS + sub) << (power - 4);
+}
+
+static std::uint64_t bucket_width(int index) {
+  return index < HISTOGRAM_SUB_BUCKETS ? 1 : 1ull << (index / HISTOGRAM_SUB_BUCKETS - 1);
+}
+
+Histogram new_histogram() {
+  Histogram histogram = {0, 0, std::numeric_limits<std::uint64_t>::max(), 0, {}};
+  return histogram;
+}
+
+void record_value(Histogram &histogram, std::uint64_t value) {
+  histogram.count++;
+  histogram.sum += value;
+  histogram.min = std::min(histogram.min, value);
+  histogram.max = std::max(histogram.max, value);
+  histogram.buckets[bucket_index(value)]++;
+}
+
+void merge_histogram(Histogram &into, const Histogram &from) {
+  into.count += from.count;
+  into.sum += from.sum;
+  into.min = std::min(into.min, from.min);
+  into.max = std::max(into.max, from.max);
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    into.buckets[i] += from.buckets[i];
+  }
+}
+
+double histogram_mean(const Histogram &histogram) {
+  return histogram.count == 0 ? 0 : static_cast<double>(histogram.sum) / histogram.count;
+}
+
+std::uint64_t histogram_quantile(const Histogram &histogram, double quantile) {
+  if (histogram.count == 0) {
+    return 0;
+  }
+  std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(quantile * histogram.count));
+  rank = std::min(std::max<std::uint64_t>(rank, 1), histogram.count);
+  if (rank == 1) {
+    return histogram.min;
+  }
+  if (rank == histogram.count) {
+    return histogram.max;
+  }
+  std::uint64_t seen = 0;
+  int index = 0;
+  while ((seen += histogram.buckets[index]) < rank) {
+    index++;
+  }
+  std::uint64_t middle = bucket_low(index) + (bucket_width(index) - 1) / 2;
+  return std::min(std::max(middle, histogram.min), histogram.max);
+}
+
+GameAnalytics new_game_analytics(int height_window) {
+  return {
+    std::max(height_window, 1),
+    0,
+    0,
+    new_histogram(),
+    new_histogram(),
+    new_histogram(),
+    {},
+    {},
+    std::vector<Histogram>(ANALYTICS_HEIGHT_WINDOWS, new_histogram())
+  };
+}
+
+void merge_analytics(GameAnalytics &into, const GameAnalytics &from) {
+  into.games += from.games;
+  into.games_over += from.games_over;
+  merge_histogram(into.score, from.score);
+  merge_histogram(into.lines, from.lines);
+  merge_histogram(into.pieces, from.pieces);
+  for (int i = 0; i <= MAX_TETROMINO_HEIGHT; i++) {
+    into.clears[i] += from.clears[i];
+  }
+  for (int i = 0; i < TETROMINO_COUNT; i++) {
+    into.tetrominoes[i] += from.tetrominoes[i];
+  }
+  for (int i = 0; i < ANALYTICS_HEIGHT_WINDOWS; i++) {
+    merge_histogram(into.heights[i], from.heights[i]);
+  }
+}
+
+static int stack_height(const Field &field) {
+  for (int y = field.height - 1; y >= 0; y--) {
+    const Line &line = field.lines[y];
+    if (std::find(line.begin(), line.end(), CellState::FILLED) != line.end()) {
+      return y + 1;
+    }
+  }
+  return 0;
+}
+
+GameTracker start_tracking(GameAnalytics &analytics, const GameState &state) {
+  // A new game deals the active block and the next one.
+  analytics.tetrominoes[static_cast<int>(state.active_block.tetromino)]++;
+  analytics.tetrominoes[static_cast<int>(state.next_block)]++;
+  return {state.rng.seed(), state.rng.position(), state.lines, 0};
+}
+
+void track_state(GameAnalytics &analytics, GameTracker &tracker, const GameState &state) {
+  if (state.rng.position() == tracker.position && state.rng.seed() == tracker.seed) {
+    return;
+  }
+  int cleared = state.lines - tracker.lines;
+  if (cleared >= 0 && cleared <= MAX_TETROMINO_HEIGHT) {
+    analytics.clears[cleared]++;
+  }
+  analytics.tetrominoes[static_cast<int>(state.next_block)]++;
+  int window = std::min(tracker.pieces / analytics.height_window, ANALYTICS_HEIGHT_WINDOWS - 1);
+  record_value(analytics.heights[window], stack_height(state.field));
+  tracker.seed = state.rng.seed();
+  tracker.position = state.rng.position();
+  tracker.lines = state.lines;
+  tracker.pieces++;
+}
+
+void finish_tracking(GameAnalytics &analytics, const GameTracker &tracker, const GameState &state) {
+  analytics.games++;
+  if (state.progress == GameProgress::GAME_OVER) {
+    analytics.games_over++;
+  }
+  record_value(analytics.score, state.score);
+  record_value(analytics.lines, state.lines);
+  record_value(analytics.pieces, tracker.pieces);
+}
+
+// Runs play(game, worker, tally) for every game below count, each worker
+// with a tally of its own, and merges the tallies.
+template <typename Play>
+static GameAnalytics analyze_games(std::uint64_t count, int threads, int height_window, Play play) {
+  threads = std::max(threads, 1);
+  std::vector<GameAnalytics> tallies(threads, new_game_analytics(height_window));
+  std::atomic<std::uint64_t> next_game(0);
+  run_parallel(threads, threads, [&](std::size_t worker) {
+    std::uint64_t game;
+    while ((game = next_game++) < count) {
+      play(game, worker, tallies[worker]);
+    }
+  });
+  GameAnalytics total = new_game_analytics(height_window);
+  for (const GameAnalytics &tally : tallies) {
+    merge_analytics(total, tally);
+  }
+  return total;
+}
+
+GameAnalytics analyze_bot_games(const BotAnalyticsOptions &options) {
+  int threads = std::max(options.threads, 1);
+  std::vector<Bot> bots(threads, new_bot(options.weights, options.width, options.height));
+  return analyze_games(options.games, threads, options.height_window,
+                       [&](std::uint64_t game, std::size_t worker, GameAnalytics &analytics) {
+    GameState state = new_game(options.width, options.height,
+                               static_cast<RNG::result_type>(options.seed + game));
+    GameTracker tracker = start_tracking(analytics, state);
+    while (tracker.pieces < options.max_pieces &&
+           state.progress == GameProgress::IN_PROGRESS &&
+           play_bot_move(bots[worker], state)) {
+      track_state(analytics, tracker, state);
+    }
+    finish_tracking(analytics, tracker, state);
+  });
+}
+
+static void analyze_replay(const Replay &game, GameAnalytics &analytics) {
+  if (game.events.empty() || game.events[0].action != Action::NEW_GAME) {
+    return;
+  }
+  GameState state = apply_replay_event({}, game.events[0], game.width, game.height);
+  GameTracker tracker = start_tracking(analytics, state);
+  for (std::size_t i = 1; i < game.events.size(); i++) {
+    state = apply_replay_event(std::move(state), game.events[i], game.width, game.height);
+    track_state(analytics, tracker, state);
+  }
+  finish_tracking(analytics, tracker, state);
+}
+
+GameAnalytics analyze_replays(const std::vector<Replay> &games, int threads, int height_window) {
+  return analyze_games(games.size(), threads, height_window,
+                       [&](std::uint64_t game, std::size_t, GameAnalytics &analytics) {
+    analyze_replay(games[game], analytics);
+  });
+}
+
+GameAnalytics analyze_archive(const ArchiveReader &reader,
+                              int threads,
+                              int height_window,
+                              std::uint64_t &damaged) {
+  std::atomic<std::uint64_t> damaged_games(0);
+  GameAnalytics total = analyze_games(reader.games.size(), threads, height_window,
+                                          [&](std::uint64_t game, std::size_t, GameAnalytics &analytics) {
+    Replay replay;
+    if (!read_archived_game(reader, game, replay)) {
+      damaged_games++;
+      return;
+    }
+    analyze_replay(replay, analytics);
+  });
+  damaged = damaged_games;
+  return total;
+}
+
+static void write_histogram(std::ostream &out, const char *name, const Histogram &histogram) {
+  char line[256];
+  std::snprintf(line, sizeof(line), "%s: mean %.1f, min %llu, max %llu\n  quantiles",
+                name, histogram_mean(histogram),
+                static_cast<unsigned long long>(histogram.count == 0 ? 0 : histogram.min),
+                static_cast<unsigned long long>(histogram.max));
+  out << line;
+  for (double quantile : ANALYTICS_QUANTILES) {
+    std::snprintf(line, sizeof(line), " p%g=%llu", quantile * 100,
+                  static_cast<unsigned long long>(histogram_quantile(histogram, quantile)));
+    out << line;
+  }
+  out << "\n";
+
+  // One bar per power of two: [0, 1), [1, 2), [2, 4) and so on.
+  std::uint64_t counts[65] = {};
+  for (int i = 0; i < HISTOGRAM_BUCKETS; i++) {
+    std::uint64_t low = bucket_low(i);
+    counts[low == 0 ? 0 : 64 - __builtin_clzll(low)] += histogram.buckets[i];
+  }
+  std::uint64_t most = *std::max_element(counts, counts + 65);
+  for (int range = 0; range < 65; range++) {
+    if (counts[range] == 0) {
+      continue;
+    }
+    std::uint64_t low = range == 0 ? 0 : 1ull << (range - 1);
+    int bar = static_cast<int>(HISTOGRAM_BAR_WIDTH * counts[range] / most);
+    std::snprintf(line, sizeof(line), "  %10llu+ %10llu %s\n",
+                  static_cast<unsigned long long>(low),
+                  static_cast<unsigned long long>(counts[range]),
+                  std::string(std::max(bar, 1), '#').c_str());
+    out << line;
+  }
+}
+
+void write_analytics(std::ostream &out, const GameAnalytics &analytics) {
+  char line[256];
+  std::snprintf(line, sizeof(line), "games: %llu, %llu ended by topping out\n",
+                static_cast<unsigned long long>(analytics.games),
+                static_cast<unsigned long long>(analytics.games_over));
+  out << line;
+  write_histogram(out, "score", analytics.score);
+  write_histogram(out, "lines", analytics.lines);
+  write_histogram(out, "pieces", analytics.pieces);
+
+  std::uint64_t locks = 0;
+  for (std::uint64_t count : analytics.clears) {
+    locks += count;
+  }
+  out << "clears per lock:";
+  for (int lines = 0; lines <= MAX_TETROMINO_HEIGHT; lines++) {
+    std::snprintf(line, sizeof(line), " %d=%llu (%.3f%%, %d points)", lines,
+                  static_cast<unsigned long long>(analytics.clears[lines]),
+                  locks == 0 ? 0 : 100.0 * analytics.clears[lines] / locks,
+                  new_score(0, lines));
+    out << line;
+  }
+  out << "\n";
+
+  std::uint64_t dealt = 0;
+  for (std::uint64_t count : analytics.tetrominoes) {
+    dealt += count;
+  }
+  double expected = static_cast<double>(dealt) / TETROMINO_COUNT;
+  double chi_square = 0;
+  out << "pieces dealt:";
+  for (int i = 0; i < TETROMINO_COUNT; i++) {
+    double difference = analytics.tetrominoes[i] - expected;
+    chi_square += dealt == 0 ? 0 : difference * difference / expected;
+    std::snprintf(line, sizeof(line), " %c=%llu",
+                  TETROMINO_LETTERS[i],
+                  static_cast<unsigned long long>(analytics.tetrominoes[i]));
+    out << line;
+  }
+  std::snprintf(line, sizeof(line), "\n  chi-square %.2f against a uniform deal (%s at p = 0.001)\n",
+                chi_square, chi_square > PIECE_CHI_SQUARE_LIMIT ? "skewed" : "not skewed");
+  out << line;
+
+  out << "stack height after each lock, by pieces locked:\n";
+  for (int window = 0; window < ANALYTICS_HEIGHT_WINDOWS; window++) {
+    const Histogram &heights = analytics.heights[window];
+    if (heights.count == 0) {
+      continue;
+    }
+    int first = window * analytics.height_window;
+    std::snprintf(line, sizeof(line), "  %6d%s %10llu locks, mean %5.2f, p10 %llu, p50 %llu, p90 %llu, max %llu\n",
+                  first,
+                  window + 1 == ANALYTICS_HEIGHT_WINDOWS ? "+" : " ",
+                  static_cast<unsigned long long>(heights.count),
+                  histogram_mean(heights),
+                  static_cast<unsigned long long>(histogram_quantile(heights, 0.1)),
+                  static_cast<unsigned long long>(histogram_quantile(heights, 0.5)),
+                  static_cast<unsigned long long>(histogram_quantile(heights, 0.9)),
+                  static_cast<unsigned long long>(heights.max));
+    out << line;
+  }
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#include "bot.h"
+#include "replay.h"
+#include "replay_archive.h"
+
+// Distributions over many games, for tuning difficulty and checking the
+// generator for skew.
+//
+// Games are either played by the bot or replayed from recordings. Every
+// worker thread tallies into its own GameAnalytics, touched by no other
+// thread, and the tallies are merged once all games are done, so nothing
+// is shared while games run and the result does not depend on the number
+// of threads.
+//
+// A game is followed one state at a time. A lock is seen as the
+// generator moving on, since every lock deals the next block; it counts
+// the block dealt, the lines it cleared and the height of the stack it
+// left. When the game ends, its score, lines and pieces are recorded.
+
+// Histograms count non-negative integers. Values below
+// HISTOGRAM_SUB_BUCKETS have a bucket each; every power of two above
+// that is split into HISTOGRAM_SUB_BUCKETS equal buckets, so a bucket is
+// at most 1/16 of its values wide.
+const int HISTOGRAM_SUB_BUCKETS = 16;
+const int HISTOGRAM_BUCKETS = HISTOGRAM_SUB_BUCKETS * 61;
+
+struct Histogram {
+  std::uint64_t count;
+  std::uint64_t sum;
+  std::uint64_t min;
+  std::uint64_t max;
+  std::uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+Histogram new_histogram();
+void record_value(Histogram &histogram, std::uint64_t value);
+void merge_histogram(Histogram &into, const Histogram &from);
+double histogram_mean(const Histogram &histogram);
+
+// The middle of the bucket holding the quantile, kept within min and
+// max; the first and last values are exact.
+std::uint64_t histogram_quantile(const Histogram &histogram, double quantile);
+
+// Board height is tracked per window of this many pieces, up to
+// ANALYTICS_HEIGHT_WINDOWS; the last window takes all later pieces.
+const int ANALYTICS_DEFAULT_HEIGHT_WINDOW = 50;
+const int ANALYTICS_HEIGHT_WINDOWS = 20;
+
+struct GameAnalytics {
+  int height_window;
+  std::uint64_t games;
+  std::uint64_t games_over; // the rest were cut short or ended mid-game
+  Histogram score;
+  Histogram lines;
+  Histogram pieces;                               // locked, per game
+  std::uint64_t clears[MAX_TETROMINO_HEIGHT + 1]; // locks by lines cleared
+  std::uint64_t tetrominoes[TETROMINO_COUNT];     // blocks dealt
+  std::vector<Histogram> heights;                 // stack height after a lock
+};
+
+GameAnalytics new_game_analytics(int height_window);
+void merge_analytics(GameAnalytics &into, const GameAnalytics &from);
+
+// Follows one game. Start it with the game's first state, pass it every
+// state after that, and finish it with the last.
+struct GameTracker {
+  RNG::result_type seed;
+  unsigned long long position;
+  int lines;
+  int pieces;
+};
+
+GameTracker start_tracking(GameAnalytics &analytics, const GameState &state);
+void track_state(GameAnalytics &analytics, GameTracker &tracker, const GameState &state);
+void finish_tracking(GameAnalytics &analytics, const GameTracker &tracker, const GameState &state);
+
+struct BotAnalyticsOptions {
+  std::uint64_t games;
+  RNG::result_type seed; // game i is dealt from seed + i
+  int max_pieces;
+  int width;
+  int height;
+  FeatureWeights weights;
+  int threads;
+  int height_window;
+};
+
+GameAnalytics analyze_bot_games(const BotAnalyticsOptions &options);
+
+// Each replay is one game, starting with its NEW_GAME.
+GameAnalytics analyze_replays(const std::vector<Replay> &games, int threads, int height_window);
+
+// Games whose blocks are damaged are skipped and counted in damaged.
+GameAnalytics analyze_archive(const ArchiveReader &reader,
+                              int threads,
+                              int height_window,
+                              std::uint64_t &damaged);
+
+// Compact text: quantiles and a histogram by powers of two for each
+// distribution, the clear and piece frequencies with a chi-square test
+// of the pieces against a uniform deal, and the height quantiles of each
+// window.
+void write_analytics(std::ostream &out, const GameAnalytics &analytics);
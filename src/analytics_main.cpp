@@ -0,0 +1,121 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "analytics.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--games N] [--seed N] [--pieces N] [--weights W1,...,W6]\n"
+               "          [--width N] [--height N] [--threads N] [--window N]\n"
+               "       %s [--threads N] [--window N] RECORDING...\n"
+               "Plays games with the bot, or replays every game in the recordings\n"
+               "(archives or text replays), and prints the distributions of score,\n"
+               "lines, pieces, line clears, pieces dealt and stack height over\n"
+               "time, with the height tracked per --window pieces.\n",
+               program, program);
+}
+
+bool parse_weights(const std::string &text, FeatureWeights &weights) {
+  std::istringstream in(text);
+  double values[FEATURE_COUNT];
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    char separator;
+    if (!(in >> values[i]) || (i + 1 < FEATURE_COUNT && !(in >> separator && separator == ','))) {
+      return false;
+    }
+  }
+  weights = {values[0], values[1], values[2], values[3], values[4], values[5]};
+  return in.eof() || (in >> std::ws).eof();
+}
+
+// Adds the games in path, an archive or a text replay, to analytics.
+// Archive games are decoded by the workers as they go, so archives of any
+// size are read without holding them in memory.
+bool analyze_recording(const std::string &path,
+                       int threads,
+                       int height_window,
+                       GameAnalytics &analytics) {
+  ArchiveReader reader;
+  if (open_archive_reader(path, reader)) {
+    std::uint64_t damaged = 0;
+    merge_analytics(analytics, analyze_archive(reader, threads, height_window, damaged));
+    close_archive_reader(reader);
+    return damaged == 0;
+  }
+  std::ifstream in(path);
+  Replay replay;
+  if (!read_replay(in, replay)) {
+    return false;
+  }
+  merge_analytics(analytics, analyze_replays(split_replay_games(replay), threads, height_window));
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  BotAnalyticsOptions options = {
+    10000,
+    0,
+    1000,
+    DEFAULT_WIDTH,
+    DEFAULT_HEIGHT,
+    DEFAULT_BOT_WEIGHTS,
+    static_cast<int>(std::thread::hardware_concurrency()),
+    ANALYTICS_DEFAULT_HEIGHT_WINDOW
+  };
+  std::vector<std::string> recordings;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--games" && i + 1 < argc) {
+      options.games = std::strtoull(argv[++i], nullptr, 10);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--pieces" && i + 1 < argc) {
+      options.max_pieces = std::atoi(argv[++i]);
+    } else if (arg == "--weights" && i + 1 < argc) {
+      if (!parse_weights(argv[++i], options.weights)) {
+        usage(argv[0]);
+        return 1;
+      }
+    } else if (arg == "--width" && i + 1 < argc) {
+      options.width = std::atoi(argv[++i]);
+    } else if (arg == "--height" && i + 1 < argc) {
+      options.height = std::atoi(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--window" && i + 1 < argc) {
+      options.height_window = std::atoi(argv[++i]);
+    } else if (arg.compare(0, 2, "--") != 0) {
+      recordings.push_back(arg);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  options.threads = std::max(1, options.threads);
+  if (options.max_pieces < 1 || options.height_window < 1 ||
+      options.width < MAX_TETROMINO_WIDTH || options.width > EVALUATION_MAX_WIDTH ||
+      options.height < MAX_TETROMINO_HEIGHT || options.height > EVALUATION_MAX_HEIGHT) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  GameAnalytics analytics = new_game_analytics(options.height_window);
+  int status = 0;
+  if (recordings.empty()) {
+    analytics = analyze_bot_games(options);
+  }
+  for (const std::string &path : recordings) {
+    if (!analyze_recording(path, options.threads, options.height_window, analytics)) {
+      std::fprintf(stderr, "Unable to read all of %s\n", path.c_str());
+      status = 1;
+    }
+  }
+  write_analytics(std::cout, analytics);
+  return status;
+}
@@ -0,0 +1,116 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+
+#include "replay_archive.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s add ARCHIVE [--keyframes N] REPLAY...\n"
+               "       %s list ARCHIVE\n"
+               "       %s extract ARCHIVE GAME\n"
+               "       %s state ARCHIVE GAME STEP\n"
+               "add appends every game in the text replays; extract writes one\n"
+               "game back out as a text replay; state prints the game after STEP\n"
+               "actions.\n",
+               program, program, program, program);
+}
+
+int add_replays(const std::string &archive, int argc, char *argv[]) {
+  int keyframe_interval = ARCHIVE_DEFAULT_KEYFRAME_INTERVAL;
+  int first = 0;
+  if (argc >= 2 && std::string(argv[0]) == "--keyframes") {
+    keyframe_interval = std::atoi(argv[1]);
+    first = 2;
+  }
+  ArchiveWriter writer;
+  if (!open_archive_writer(archive, keyframe_interval, writer)) {
+    std::fprintf(stderr, "Unable to open archive %s\n", archive.c_str());
+    return 1;
+  }
+  int status = 0;
+  for (int i = first; i < argc; i++) {
+    std::ifstream in(argv[i]);
+    Replay replay;
+    if (!read_replay(in, replay)) {
+      std::fprintf(stderr, "Unable to read replay %s\n", argv[i]);
+      status = 1;
+      continue;
+    }
+    for (const Replay &game : split_replay_games(replay)) {
+      if (!append_archived_game(writer, game)) {
+        std::fprintf(stderr, "Unable to archive a game from %s\n", argv[i]);
+        status = 1;
+      }
+    }
+  }
+  if (!close_archive_writer(writer)) {
+    std::fprintf(stderr, "Unable to write archive %s\n", archive.c_str());
+    return 1;
+  }
+  return status;
+}
+
+int list_games(const ArchiveReader &reader) {
+  for (std::size_t game = 0; game < reader.games.size(); game++) {
+    std::uint64_t end = game + 1 < reader.games.size() ? reader.games[game + 1].offset
+                                                       : reader.end;
+    std::printf("%zu: %llu steps, %llu bytes\n",
+                game,
+                static_cast<unsigned long long>(reader.games[game].steps),
+                static_cast<unsigned long long>(end - reader.games[game].offset));
+  }
+  return 0;
+}
+
+int main(int argc, char *argv[]) {
+  if (argc < 3) {
+    usage(argv[0]);
+    return 1;
+  }
+  std::string command = argv[1];
+  std::string archive = argv[2];
+  if (command == "add") {
+    return add_replays(archive, argc - 3, argv + 3);
+  }
+
+  ArchiveReader reader;
+  if ((command != "list" || argc != 3) &&
+      (command != "extract" || argc != 4) &&
+      (command != "state" || argc != 5)) {
+    usage(argv[0]);
+    return 1;
+  }
+  if (!open_archive_reader(archive, reader)) {
+    std::fprintf(stderr, "Unable to open archive %s\n", archive.c_str());
+    return 1;
+  }
+  int status = 0;
+  if (command == "list") {
+    status = list_games(reader);
+  } else if (command == "extract") {
+    Replay replay;
+    if (read_archived_game(reader, std::strtoul(argv[3], nullptr, 10), replay)) {
+      write_replay(std::cout, replay);
+    } else {
+      std::fprintf(stderr, "No game %s in %s\n", argv[3], archive.c_str());
+      status = 1;
+    }
+  } else {
+    GameState state;
+    if (archived_game_state(reader,
+                            std::strtoul(argv[3], nullptr, 10),
+                            std::strtoull(argv[4], nullptr, 10),
+                            state)) {
+      std::printf("score %d, lines %d%s\n", state.score, state.lines,
+                  state.progress == GameProgress::GAME_OVER ? ", game over" : "");
+    } else {
+      std::fprintf(stderr, "No step %s of game %s in %s\n", argv[4], argv[3], archive.c_str());
+      status = 1;
+    }
+  }
+  close_archive_reader(reader);
+  return status;
+}
@@ -0,0 +1,179 @@
+#include <algorithm>
+#include <limits>
+#include <utility>
+
+#include "autoplay.h"
+
+const double AUTOPLAY_LOSS = std::numeric_limits<double>::lowest();
+
+// Scores the fields of results into scores, losses as AUTOPLAY_LOSS.
+static void score_results(Bot &bot,
+                          const std::vector<GameState> &results,
+                          std::vector<double> &scores) {
+  clear_field_batch(bot.batch);
+  for (const GameState &result : results) {
+    add_field(bot.batch, result.field);
+  }
+  score_fields(bot.batch, bot.weights, scores);
+  for (std::size_t i = 0; i < results.size(); i++) {
+    if (results[i].progress == GameProgress::GAME_OVER) {
+      scores[i] = AUTOPLAY_LOSS;
+    }
+  }
+}
+
+// The indexes of the best count scores, best first.
+static std::vector<int> best_indexes(const std::vector<double> &scores, std::size_t count) {
+  std::vector<int> indexes(scores.size());
+  for (std::size_t i = 0; i < indexes.size(); i++) {
+    indexes[i] = static_cast<int>(i);
+  }
+  count = std::min(count, indexes.size());
+  std::partial_sort(indexes.begin(), indexes.begin() + count, indexes.end(),
+                    [&](int lhs, int rhs) { return scores[lhs] > scores[rhs]; });
+  indexes.resize(count);
+  return indexes;
+}
+
+// The best score reachable by placing depth more blocks from state, or
+// false if abandoned.
+static bool search_value(Bot &bot,
+                         const GameState &state,
+                         int depth,
+                         const std::function<bool()> &abandoned,
+                         double &value) {
+  if (abandoned()) {
+    return false;
+  }
+  std::vector<GameState> results = find_placement_results(state);
+  std::vector<double> scores;
+  score_results(bot, results, scores);
+  value = AUTOPLAY_LOSS;
+  if (depth == 1) {
+    for (double score : scores) {
+      value = std::max(value, score);
+    }
+    return true;
+  }
+  for (int index : best_indexes(scores, AUTOPLAY_BEAM)) {
+    double child = scores[index];
+    if (child != AUTOPLAY_LOSS &&
+        !search_value(bot, results[index], depth - 1, abandoned, child)) {
+      return false;
+    }
+    value = std::max(value, child);
+  }
+  return true;
+}
+
+bool plan_autoplay_move(Bot &bot,
+                        const GameState &state,
+                        int max_depth,
+                        const std::function<bool()> &abandoned,
+                        const std::function<void(const PlannedMove &)> &on_depth) {
+  std::vector<Placement> placements = find_placements(state);
+  if (placements.empty() || abandoned()) {
+    return false;
+  }
+  std::vector<GameState> results;
+  for (Placement &placement : placements) {
+    results.push_back(std::move(placement.result));
+  }
+  std::vector<double> values;
+  score_results(bot, results, values);
+
+  int best = 0;
+  for (int depth = 1; depth <= max_depth; depth++) {
+    if (depth > 1) {
+      // Every placement is worth a second look, since the next block is
+      // on show; deeper, only the best of the last depth are.
+      std::size_t count = depth == 2 ? values.size() : AUTOPLAY_BEAM;
+      std::vector<double> deeper(values.size(), AUTOPLAY_LOSS);
+      for (int index : best_indexes(values, count)) {
+        deeper[index] = values[index];
+        if (values[index] != AUTOPLAY_LOSS &&
+            !search_value(bot, results[index], depth - 1, abandoned, deeper[index])) {
+          return false;
+        }
+      }
+      values = std::move(deeper);
+    }
+    // Ties go to the first found, which is the one with the fewest
+    // inputs. When every placement loses at this depth, the best of the
+    // last depth stands, since it at least survives longer.
+    int deepest = static_cast<int>(std::max_element(values.begin(), values.end()) - values.begin());
+    if (depth == 1 || values[deepest] != AUTOPLAY_LOSS) {
+      best = deepest;
+    }
+    on_depth({0, placements[best].final_block, depth, depth == max_depth});
+  }
+  return true;
+}
+
+AutoplayPlanner::AutoplayPlanner(const FeatureWeights &weights, int width, int height)
+  : bot(new_bot(weights, width, height)),
+    pending(),
+    pending_id(0),
+    stopping(false),
+    latest_id(0),
+    moves(PlannedMove{0, {0, 0, Tetromino::I, Rotation::UNROTATED}, 0, false}),
+    worker(&AutoplayPlanner::run, this) {
+}
+
+AutoplayPlanner::~AutoplayPlanner() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  latest_id = 0; // abandons the search in progress
+  wakeup.notify_one();
+  worker.join();
+}
+
+void AutoplayPlanner::request(const GameState &state, std::uint32_t id) {
+  latest_id = id;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    pending = state; // reuses the rows of the last request
+    pending_id = id;
+  }
+  wakeup.notify_one();
+}
+
+bool AutoplayPlanner::best_move(std::uint32_t id, PlannedMove &move) {
+  moves.update();
+  if (moves.read_buffer().request != id) {
+    return false;
+  }
+  move = moves.read_buffer();
+  return true;
+}
+
+void AutoplayPlanner::run() {
+  GameState state;
+  while (true) {
+    std::uint32_t id;
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      wakeup.wait(lock, [&]() { return stopping || pending_id != 0; });
+      if (stopping) {
+        return;
+      }
+      state = pending;
+      id = pending_id;
+      pending_id = 0;
+    }
+    plan_autoplay_move(
+      bot,
+      state,
+      AUTOPLAY_MAX_DEPTH,
+      [&]() { return latest_id != id; },
+      [&](const PlannedMove &move) {
+        PlannedMove &slot = moves.write_buffer();
+        slot = move;
+        slot.request = id;
+        moves.publish();
+      }
+    );
+  }
+}
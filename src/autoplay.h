@@ -0,0 +1,78 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "bot.h"
+#include "triple_buffer.h"
+
+// A planner for letting the bot play a live game, as in demo mode.
+//
+// The search is anytime: it deepens one placement at a time, and after
+// each depth it reports where the active block should rest as its best
+// so far. Depth 1 scores each placement's field as the greedy bot does,
+// depth 2 takes the best follow-up for the known next block, and deeper
+// levels follow only the AUTOPLAY_BEAM most promising follow-ups, which
+// keeps each level to a few thousand evaluations. Blocks beyond the next
+// are the ones the game's generator will deal, as the solver reads them.
+// A game can then take whatever the planner has when it can wait no
+// longer.
+//
+// AutoplayPlanner runs the search on its own thread. The game hands it
+// a state with request(), which abandons any older search, and polls
+// best_move(), which never waits; the result comes back through a
+// triple buffer.
+
+const int AUTOPLAY_MAX_DEPTH = 4;
+const int AUTOPLAY_BEAM = 6;
+
+struct PlannedMove {
+  std::uint32_t request;
+  ActiveBlock target; // where the active block should lock
+  int depth;          // placements searched ahead
+  bool complete;      // no deeper search will follow
+};
+
+// Searches up to max_depth placements ahead, calling on_depth with the
+// best target after each depth, and returns false without finishing if
+// abandoned() returns true or the block cannot be placed. The request
+// of the moves reported is 0.
+bool plan_autoplay_move(Bot &bot,
+                        const GameState &state,
+                        int max_depth,
+                        const std::function<bool()> &abandoned,
+                        const std::function<void(const PlannedMove &)> &on_depth);
+
+class AutoplayPlanner {
+public:
+  AutoplayPlanner(const FeatureWeights &weights, int width, int height);
+  ~AutoplayPlanner();
+
+  AutoplayPlanner(const AutoplayPlanner &) = delete;
+  AutoplayPlanner &operator=(const AutoplayPlanner &) = delete;
+
+  // Starts planning for state, abandoning any earlier request. Request
+  // ids must be nonzero and should differ from the previous one.
+  void request(const GameState &state, std::uint32_t id);
+
+  // Sets move to the best found so far for request id, if there is one.
+  // Call from one thread only.
+  bool best_move(std::uint32_t id, PlannedMove &move);
+
+private:
+  void run();
+
+  Bot bot;
+  std::mutex mutex;
+  std::condition_variable wakeup;
+  GameState pending;         // guarded by mutex
+  std::uint32_t pending_id;  // likewise, 0 once taken
+  bool stopping;             // likewise
+  std::atomic<std::uint32_t> latest_id;
+  TripleBuffer<PlannedMove> moves;
+  std::thread worker;
+};
@@ -1,3 +1,4 @@
+#include "profiler.h"
 #include "state.h"
 
 const char* blocks[] = {
@@ -178,7 +179,8 @@ std::vector<Shape> shapes = {
   parse_block(Tetromino::Z, Rotation::COUNTERCLOCKWISE),
 };
 
-Shape get_shape(Tetromino tetromino, Rotation rotation) {
+const Shape& get_shape(Tetromino tetromino, Rotation rotation) {
+  PROFILE_ZONE("get_shape");
   int index = static_cast<int>(tetromino) * 4 + static_cast<int>(rotation);
   return shapes[index];
 }
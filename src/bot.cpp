@@ -0,0 +1,121 @@
+#include <cstring>
+#include <utility>
+
+#include "bot.h"
+
+Bot new_bot(const FeatureWeights &weights, int width, int height) {
+  return {weights, new_field_batch(width, height), {}, nullptr, 0};
+}
+
+void use_cache(Bot &bot, EvaluationCache *cache) {
+  bot.cache = cache;
+  // Only decisions made with the same weights on the same size of field
+  // are interchangeable.
+  double values[FEATURE_COUNT] = {
+    bot.weights.holes,
+    bot.weights.aggregate_height,
+    bot.weights.bumpiness,
+    bot.weights.row_transitions,
+    bot.weights.column_transitions,
+    bot.weights.wells
+  };
+  Field size = {bot.batch.height, bot.batch.width, {}};
+  std::uint64_t context = hash_field(size);
+  for (double value : values) {
+    std::uint64_t bits;
+    std::memcpy(&bits, &value, sizeof(bits));
+    context = context * 0x100000001B3ull ^ bits;
+  }
+  bot.cache_context = context;
+}
+
+// Scores the fields get(0) ... get(count - 1) and returns the best that
+// does not end the game, if any.
+template <typename Get>
+static int choose_best(Bot &bot, std::size_t count, Get get) {
+  clear_field_batch(bot.batch);
+  for (std::size_t i = 0; i < count; i++) {
+    add_field(bot.batch, get(i).field);
+  }
+  score_fields(bot.batch, bot.weights, bot.scores);
+
+  int best = -1;
+  bool best_survives = false;
+  for (std::size_t i = 0; i < count; i++) {
+    bool survives = get(i).progress == GameProgress::IN_PROGRESS;
+    if (best < 0 || (survives && !best_survives) ||
+        (survives == best_survives && bot.scores[i] > bot.scores[best])) {
+      best = static_cast<int>(i);
+      best_survives = survives;
+    }
+  }
+  return best;
+}
+
+int choose_placement(Bot &bot, const std::vector<GameState> &results) {
+  return choose_best(bot, results.size(), [&](std::size_t i) -> const GameState& {
+    return results[i];
+  });
+}
+
+int choose_placement(Bot &bot, const std::vector<Placement> &placements) {
+  return choose_best(bot, placements.size(), [&](std::size_t i) -> const GameState& {
+    return placements[i].result;
+  });
+}
+
+// Whether a cached block can stand in for the placement search: the
+// cache is shared through a file, so an entry may be damaged, from a
+// different game, or another position's under a colliding key.
+static bool locks_in_place(const GameState &state, const ActiveBlock &block) {
+  if (block.tetromino != state.active_block.tetromino ||
+      !is_legal_position(state.field, block)) {
+    return false;
+  }
+  ActiveBlock below = block;
+  below.position_y--;
+  return !is_legal_position(state.field, below);
+}
+
+bool play_bot_move(Bot &bot, GameState &state) {
+  if (bot.cache == nullptr) {
+    std::vector<GameState> results = find_placement_results(state);
+    int best = choose_placement(bot, results);
+    if (best < 0) {
+      return false;
+    }
+    state = std::move(results[best]);
+    return true;
+  }
+
+  CacheKey key = make_cache_key(state.field, state.active_block, bot.cache_context);
+  CachedEvaluation cached;
+  if (cache_lookup(*bot.cache, key, cached) && locks_in_place(state, cached.best_block)) {
+    state.active_block = cached.best_block;
+    state = reduce(std::move(state), Action::MOVE_DOWN);
+    return true;
+  }
+  std::vector<Placement> placements = find_placements(state);
+  int best = choose_placement(bot, placements);
+  if (best < 0) {
+    return false;
+  }
+  cache_insert(*bot.cache, key, {bot.scores[best], placements[best].final_block});
+  state = std::move(placements[best].result);
+  return true;
+}
+
+BotGame play_bot_game(Bot &bot, RNG::result_type seed, int max_pieces) {
+  GameState state = new_game(bot.batch.width, bot.batch.height, seed);
+  BotGame game = {0, 0, 0, true};
+  while (game.pieces < max_pieces && play_bot_move(bot, state)) {
+    game.pieces++;
+    if (state.progress == GameProgress::GAME_OVER) {
+      break;
+    }
+  }
+  game.lines = state.lines;
+  game.score = state.score;
+  game.survived = state.progress == GameProgress::IN_PROGRESS;
+  return game;
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <vector>
+
+#include "evaluation.h"
+#include "evaluation_cache.h"
+#include "placements.h"
+
+// A greedy bot: each piece goes where the resulting field scores best
+// under a set of feature weights. Placements that end the game are only
+// chosen when nothing else is possible.
+
+struct Bot {
+  FeatureWeights weights;
+  FieldBatch batch;           // scratch, reused between moves
+  std::vector<double> scores;
+  EvaluationCache *cache;     // decisions are shared through this if not null
+  std::uint64_t cache_context; // identifies the weights in cache keys
+};
+
+Bot new_bot(const FeatureWeights &weights, int width, int height);
+void use_cache(Bot &bot, EvaluationCache *cache);
+
+// Returns the index of the best result, or -1 if there are none.
+int choose_placement(Bot &bot, const std::vector<GameState> &results);
+int choose_placement(Bot &bot, const std::vector<Placement> &placements);
+
+// Locks the active block where the bot would put it. With a cache, a
+// position seen before, by any process, skips both the placement search
+// and the evaluation; a cached block that would not lock where it is,
+// legally, is ignored. Returns false if the block cannot be placed.
+bool play_bot_move(Bot &bot, GameState &state);
+
+struct BotGame {
+  int pieces;
+  int lines;
+  int score;
+  bool survived; // still in progress after max_pieces
+};
+
+// Plays a new game from seed until it ends or max_pieces have locked.
+BotGame play_bot_game(Bot &bot, RNG::result_type seed, int max_pieces);
+
+// Weights found by the tuner on 10x20 fields.
+const FeatureWeights DEFAULT_BOT_WEIGHTS = {
+  -7.9, -0.5, -0.2, -3.2, -9.3, -3.4
+};
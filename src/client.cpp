@@ -0,0 +1,737 @@
+#include <SDL2/SDL.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "autoplay.h"
+#include "client.h"
+#include "finesse.h"
+#include "profiler.h"
+#include "spsc_queue.h"
+#include "triple_buffer.h"
+
+// Maps a game key to its input. Held keys repeat through the handling
+// controller, on its own clock, rather than through the desktop's key
+// repeat.
+bool get_input_key(SDL_Keycode key, InputKey &input) {
+  switch (key) {
+  case SDLK_a:
+  case SDLK_LEFT:
+    input = InputKey::LEFT;
+    return true;
+  case SDLK_d:
+  case SDLK_RIGHT:
+    input = InputKey::RIGHT;
+    return true;
+  case SDLK_s:
+  case SDLK_DOWN:
+    input = InputKey::SOFT_DROP;
+    return true;
+  case SDLK_q:
+  case SDLK_PAGEUP:
+    input = InputKey::ROTATE_COUNTERCLOCKWISE;
+    return true;
+  case SDLK_e:
+  case SDLK_PAGEDOWN:
+    input = InputKey::ROTATE_CLOCKWISE;
+    return true;
+  case SDLK_n:
+    input = InputKey::NEW_GAME;
+    return true;
+  default:
+    SDL_LogInfo(
+      SDL_LOG_CATEGORY_INPUT,
+      "Unrecognized key: %s\n",
+      SDL_GetKeyName(key)
+    );
+    return false;
+  }
+}
+
+enum class ReplayControl {
+  NONE,
+  QUIT,
+  FASTER,
+  SLOWER,
+  TOGGLE_PAUSE,
+  SEEK_BACK,
+  SEEK_FORWARD,
+  SKIP_BACK,
+  SKIP_FORWARD,
+  RESTART
+};
+
+ReplayControl handle_replay_event(SDL_Event event) {
+  switch (event.type) {
+  case SDL_QUIT:
+    return ReplayControl::QUIT;
+  case SDL_KEYDOWN:
+    switch (event.key.keysym.sym) {
+    case SDLK_ESCAPE:
+      return ReplayControl::QUIT;
+    case SDLK_UP:
+    case SDLK_EQUALS:
+      return ReplayControl::FASTER;
+    case SDLK_DOWN:
+    case SDLK_MINUS:
+      return ReplayControl::SLOWER;
+    case SDLK_SPACE:
+      return ReplayControl::TOGGLE_PAUSE;
+    case SDLK_LEFT:
+      return ReplayControl::SEEK_BACK;
+    case SDLK_RIGHT:
+      return ReplayControl::SEEK_FORWARD;
+    case SDLK_PAGEUP:
+      return ReplayControl::SKIP_BACK;
+    case SDLK_PAGEDOWN:
+      return ReplayControl::SKIP_FORWARD;
+    case SDLK_HOME:
+      return ReplayControl::RESTART;
+    default:
+      return ReplayControl::NONE;
+    }
+  }
+  return ReplayControl::NONE;
+}
+
+int calculate_cell_size(const GameState &state, int view_width, int view_height) {
+  int height_per_cell = view_height / state.field.height;
+  int width_per_cell = view_width / state.field.width;
+  if (height_per_cell > width_per_cell) {
+    return width_per_cell;
+  } else {
+    return height_per_cell;
+  }
+}
+
+void render_row(SDL_Renderer *renderer, const Field &field, int field_y, int cell_size) {
+  SDL_Rect row = {
+    0,
+    cell_size * ((field.height - 1) - field_y),
+    cell_size * field.width,
+    cell_size
+  };
+  SDL_SetRenderDrawColor(renderer, 0x10, 0x10, 0x10, 0xFF);
+  SDL_RenderFillRect(renderer, &row);
+
+  SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
+  for (int field_x = 0; field_x < field.width; field_x++) {
+    if (field.lines[field_y][field_x] == CellState::FILLED) {
+      SDL_Rect rect = {cell_size * field_x, row.y, cell_size, cell_size};
+      SDL_RenderFillRect(renderer, &rect);
+    }
+  }
+}
+
+// The locked cells, drawn into a texture that is kept between frames.
+// Only rows whose versions changed since they were drawn are redrawn, so
+// a frame in which only the active block moved draws no cells at all.
+struct FieldTexture {
+  SDL_Texture *texture; // null until drawn, or if targets are unsupported
+  int cell_size;
+  int width;
+  int height;
+  std::vector<std::uint64_t> rows; // the version each row was drawn at
+};
+
+// Forgets the texture, as when the renderer lost it.
+void reset_field_texture(FieldTexture &cache) {
+  if (cache.texture != nullptr) {
+    SDL_DestroyTexture(cache.texture);
+  }
+  cache.texture = nullptr;
+  cache.rows.clear();
+}
+
+// Brings the texture up to date with field, returning false if it cannot
+// be used, in which case the caller draws the field directly.
+bool update_field_texture(SDL_Renderer *renderer,
+                          FieldTexture &cache,
+                          const Field &field,
+                          const StateVersions &versions,
+                          int cell_size) {
+  PROFILE_ZONE("update_field_texture");
+  if (cell_size <= 0 || versions.rows.size() != field.lines.size()) {
+    return false;
+  }
+  if (cache.texture == nullptr || cache.cell_size != cell_size ||
+      cache.width != field.width || cache.height != field.height) {
+    reset_field_texture(cache);
+    cache.texture = SDL_CreateTexture(renderer,
+                                      SDL_PIXELFORMAT_RGBA8888,
+                                      SDL_TEXTUREACCESS_TARGET,
+                                      cell_size * field.width,
+                                      cell_size * field.height);
+    if (cache.texture == nullptr) {
+      return false;
+    }
+    cache.cell_size = cell_size;
+    cache.width = field.width;
+    cache.height = field.height;
+    cache.rows.assign(field.height, 0);
+  }
+  if (SDL_SetRenderTarget(renderer, cache.texture) != 0) {
+    reset_field_texture(cache);
+    return false;
+  }
+  SDL_RenderSetViewport(renderer, NULL);
+  for (int field_y = 0; field_y < field.height; field_y++) {
+    if (!same_version(cache.rows[field_y], versions.rows[field_y])) {
+      render_row(renderer, field, field_y, cell_size);
+      cache.rows[field_y] = versions.rows[field_y];
+    }
+  }
+  SDL_SetRenderTarget(renderer, NULL);
+  return true;
+}
+
+void render_field(SDL_Renderer *renderer, const Field &field, int cell_size) {
+  PROFILE_ZONE("render_field");
+  for (int field_y = 0; field_y < field.height; field_y++) {
+    render_row(renderer, field, field_y, cell_size);
+  }
+}
+
+void render_active_block(SDL_Renderer *renderer,
+                         ActiveBlock active_block,
+                         int field_height,
+                         int cell_size) {
+  SDL_SetRenderDrawColor(renderer, 0, 0, 0xFF, 0xFF);
+  const Shape &shape = get_shape(active_block.tetromino, active_block.rotation);
+  for (int shape_y = 0; shape_y < MAX_TETROMINO_HEIGHT; shape_y++) {
+    for (int shape_x = 0; shape_x < MAX_TETROMINO_WIDTH; shape_x++) {
+      if (shape[shape_y][shape_x] == CellState::FILLED) {
+        int field_x = active_block.position_x + shape_x;
+        int field_y = active_block.position_y - shape_y;
+        SDL_Rect rect = {
+          cell_size * field_x,
+          cell_size * (field_height - 1 - field_y),
+          cell_size,
+          cell_size
+        };
+        SDL_RenderFillRect(renderer, &rect);
+      }
+    }
+  }
+}
+
+void render_next_block(SDL_Renderer *renderer,
+                       SDL_Rect next_block_view,
+                       int cell_size,
+                       Tetromino next_block) {
+  SDL_RenderSetViewport(renderer, &next_block_view);
+  SDL_SetRenderDrawColor(renderer, 0x10, 0x10, 0x10, 0xFF);
+  SDL_RenderFillRect(renderer, NULL);
+
+  SDL_SetRenderDrawColor(renderer, 0, 0xFF, 0, 0xFF);
+  const Shape &shape = get_shape(next_block, Rotation::UNROTATED);
+  for (int shape_y = 0; shape_y < MAX_TETROMINO_HEIGHT; shape_y++) {
+    for (int shape_x = 0; shape_x < MAX_TETROMINO_WIDTH; shape_x++) {
+      if (shape[shape_y][shape_x] == CellState::FILLED) {
+        SDL_Rect rect = {
+          cell_size * shape_x,
+          cell_size * shape_y,
+          cell_size,
+          cell_size
+        };
+        SDL_RenderFillRect(renderer, &rect);
+      }
+    }
+  }
+}
+
+void render(SDL_Renderer *renderer, FieldTexture &field_texture, const GameState &state) {
+  PROFILE_ZONE("render");
+  int width, height;
+  SDL_GetRendererOutputSize(renderer, &width, &height);
+  int cell_size = calculate_cell_size(state, width, height);
+  bool cached = update_field_texture(renderer, field_texture, state.field,
+                                     state.versions, cell_size);
+
+  SDL_RenderSetViewport(renderer, NULL);
+  SDL_SetRenderDrawColor(renderer, 0x40, 0x40, 0x40, 0xFF);
+  SDL_RenderClear(renderer);
+
+  SDL_Rect field = {
+    (width - (cell_size * state.field.width)) / 2,
+    (height - (cell_size * state.field.height)) / 2,
+    cell_size * state.field.width,
+    cell_size * state.field.height
+  };
+  SDL_RenderSetViewport(renderer, &field);
+  if (cached) {
+    SDL_RenderCopy(renderer, field_texture.texture, NULL, NULL);
+  } else {
+    render_field(renderer, state.field, cell_size);
+  }
+  render_active_block(renderer, state.active_block, state.field.height, cell_size);
+
+  SDL_Rect next_block = {
+    field.x + field.w + 10,
+    10,
+    cell_size * MAX_TETROMINO_WIDTH,
+    cell_size * MAX_TETROMINO_HEIGHT
+  };
+  render_next_block(renderer, next_block, cell_size, state.next_block);
+
+  SDL_RenderPresent(renderer);
+}
+
+// The game runs on its own thread so that a slow present never delays
+// input or gravity, and vice versa. The render thread forwards key
+// presses and releases, stamped on a monotonic microsecond clock, through
+// a lock-free queue to a handling controller, which turns them into
+// moves with its DAS, ARR and lock delay; the simulation publishes each
+// new state through a triple buffer and asks for a repaint with an
+// SDL_USEREVENT carrying SNAPSHOT_PUBLISHED.
+
+std::uint64_t monotonic_microseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+RNG::result_type clock_seed() {
+  return std::chrono::system_clock::now().time_since_epoch().count();
+}
+
+struct Simulation {
+  SpscQueue<InputEvent, 256> inputs;
+  SpscQueue<ReplayControl, 64> controls;
+  TripleBuffer<GameState> snapshots;
+  SDL_sem *wakeup;
+  std::atomic<bool> quit;
+  std::atomic<bool> repaint_requested;
+  HandlingSettings handling;
+  Replay *recording;    // live play is appended here when not null
+  std::uint64_t recording_start; // microseconds
+  ReplayPlayer *player; // plays this back instead of live play when not null
+  double replay_speed;
+  StatePublisher *publisher; // every snapshot is also published here when not null
+  AutoplayPlanner *planner;  // plans for the bot in demo mode
+  std::atomic<bool> demo;    // the bot plays until a key is pressed
+  std::uint64_t dropped_inputs; // by the render thread, the queue being full
+  bool dropping_inputs;
+};
+
+void publish_snapshot(Simulation &simulation, const GameState &game_state) {
+  simulation.snapshots.write_buffer() = game_state; // reuses the slot's rows
+  simulation.snapshots.publish();
+  if (simulation.publisher != nullptr) {
+    publish_game_state(*simulation.publisher, game_state);
+  }
+  if (!simulation.repaint_requested.exchange(true)) {
+    SDL_Event event;
+    SDL_zero(event);
+    event.type = SDL_USEREVENT;
+    event.user.code = SNAPSHOT_PUBLISHED;
+    SDL_PushEvent(&event);
+  }
+}
+
+void record_action(Simulation &simulation, const TimedAction &action) {
+  if (simulation.recording != nullptr) {
+    simulation.recording->events.push_back({
+      static_cast<std::uint32_t>((action.microseconds - simulation.recording_start) / 1000),
+      action.action,
+      action.seed
+    });
+  }
+}
+
+// Sleeps until deadline, in microseconds, or until woken. The semaphore
+// only times out in whole milliseconds, so the last millisecond is spent
+// yielding instead, which wakes within microseconds of the deadline.
+const std::uint64_t SPIN_MICROSECONDS = 1000;
+
+void wait_until(SDL_sem *wakeup, std::uint64_t deadline) {
+  std::uint64_t now = monotonic_microseconds();
+  if (deadline == NO_DEADLINE) {
+    SDL_SemWait(wakeup);
+    return;
+  }
+  if (deadline > now + SPIN_MICROSECONDS) {
+    Uint32 milliseconds = static_cast<Uint32>(
+      std::min<std::uint64_t>((deadline - now - SPIN_MICROSECONDS) / 1000, 1000000));
+    if (SDL_SemWaitTimeout(wakeup, milliseconds) == 0) {
+      return;
+    }
+  }
+  while (monotonic_microseconds() < deadline) {
+    if (SDL_SemTryWait(wakeup) == 0) {
+      return;
+    }
+    std::this_thread::yield();
+  }
+}
+
+// In demo mode the bot plays through the handling controller as a player
+// would, one input at a time. Each new piece is handed to the planner,
+// which deepens its search on its own thread while gravity runs as
+// usual. The piece commits to the best placement found by its first
+// fall, or as soon as the search completes, and the inputs that reach it
+// follow AUTOPLAY_INPUT_MICROSECONDS apart. Nothing here waits on the
+// planner.
+
+const std::uint64_t AUTOPLAY_INPUT_MICROSECONDS = 50000;
+const std::uint64_t AUTOPLAY_POLL_MICROSECONDS = 10000;
+const std::uint64_t AUTOPLAY_RESTART_MICROSECONDS = 3000000;
+
+struct Autoplay {
+  std::uint32_t request;       // the planner's request for this piece
+  RNG::result_type seed;       // every spawn draws from the generator,
+  unsigned long long position; // so these identify the piece
+  std::uint64_t commit_at;     // or, after a game over, when to restart
+  bool committed;
+  ActiveBlock target;
+  std::uint64_t next_input_at;
+  std::vector<Action> inputs;  // scratch
+};
+
+// Applies the bot's next input, if one is due, appending the actions
+// taken.
+void autoplay_step(Simulation &simulation,
+                   Autoplay &autoplay,
+                   HandlingController &controller,
+                   std::uint64_t now,
+                   std::vector<TimedAction> &actions) {
+  const GameState &game = controller.game;
+  if (game.rng.seed() != autoplay.seed || game.rng.position() != autoplay.position) {
+    autoplay.seed = game.rng.seed();
+    autoplay.position = game.rng.position();
+    autoplay.committed = false;
+    autoplay.next_input_at = now;
+    if (game.progress == GameProgress::GAME_OVER) {
+      autoplay.commit_at = now + AUTOPLAY_RESTART_MICROSECONDS;
+    } else {
+      autoplay.request = autoplay.request + 1 == 0 ? 1 : autoplay.request + 1;
+      autoplay.commit_at = controller.next_fall;
+      simulation.planner->request(game, autoplay.request);
+    }
+  }
+
+  if (game.progress == GameProgress::GAME_OVER) {
+    if (now >= autoplay.commit_at) {
+      apply_input_event(controller, {now, InputKey::NEW_GAME, true, clock_seed()}, actions);
+    }
+    return;
+  }
+  if (!autoplay.committed) {
+    PlannedMove move;
+    if (!simulation.planner->best_move(autoplay.request, move) ||
+        !(move.complete || now >= autoplay.commit_at)) {
+      return;
+    }
+    autoplay.committed = true;
+    autoplay.target = move.target;
+  }
+  if (now < autoplay.next_input_at) {
+    return;
+  }
+  // Gravity can leave the target out of reach while the search runs;
+  // the piece is then dropped where it is.
+  Action action = find_placement_inputs(game, autoplay.target, autoplay.inputs)
+                ? autoplay.inputs[0]
+                : Action::MOVE_DOWN;
+  apply_handling_action(controller, action, now, actions);
+  autoplay.next_input_at = now + AUTOPLAY_INPUT_MICROSECONDS;
+}
+
+int simulation_loop(void *data) {
+  Simulation &simulation = *static_cast<Simulation *>(data);
+  std::uint64_t now = monotonic_microseconds();
+  simulation.recording_start = now;
+  RNG::result_type seed = clock_seed();
+  HandlingController controller = new_handling_controller(
+    simulation.handling, new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, seed), now);
+  record_action(simulation, {now, Action::NEW_GAME, seed});
+  publish_snapshot(simulation, controller.game);
+  Autoplay autoplay = {0, 0, 0, 0, false, {}, 0, {}};
+  std::vector<TimedAction> actions;
+
+  while (!simulation.quit) {
+    std::uint64_t deadline = next_handling_deadline(controller);
+    if (simulation.demo) {
+      deadline = std::min(deadline, monotonic_microseconds() + AUTOPLAY_POLL_MICROSECONDS);
+    }
+    wait_until(simulation.wakeup, deadline);
+
+    actions.clear();
+    InputEvent input;
+    while (simulation.inputs.try_pop(input)) {
+      apply_input_event(controller, input, actions);
+    }
+    now = monotonic_microseconds();
+    advance_handling(controller, now, actions);
+    if (simulation.demo) {
+      autoplay_step(simulation, autoplay, controller, now, actions);
+    }
+    for (const TimedAction &action : actions) {
+      record_action(simulation, action);
+    }
+    if (!actions.empty()) {
+      publish_snapshot(simulation, controller.game);
+    }
+  }
+  return 0;
+}
+
+// Replays run on a playback clock that advances by wall time scaled by
+// the speed. Each wake applies every event up to the clock and publishes
+// only the latest state, so at high speeds most states are never drawn
+// and rendering never holds playback back.
+
+const int REPLAY_FRAME_MILLISECONDS = 16;
+const double REPLAY_SEEK_MILLISECONDS = 5000;
+const double REPLAY_SKIP_MILLISECONDS = 60000;
+
+double next_replay_speed(double speed, bool faster) {
+  if (faster) {
+    for (double candidate : REPLAY_SPEEDS) {
+      if (candidate > speed) {
+        return candidate;
+      }
+    }
+    return speed;
+  }
+  double slower = speed;
+  for (double candidate : REPLAY_SPEEDS) {
+    if (candidate < speed) {
+      slower = candidate;
+    }
+  }
+  return slower;
+}
+
+int replay_loop(void *data) {
+  Simulation &simulation = *static_cast<Simulation *>(data);
+  ReplayPlayer &player = *simulation.player;
+  const double duration = replay_duration(player.replay);
+  double speed = simulation.replay_speed;
+  bool paused = false;
+  double position = player.milliseconds;
+  Uint32 last_ticks = SDL_GetTicks();
+  publish_snapshot(simulation, player.state);
+
+  while (!simulation.quit) {
+    if (paused) {
+      SDL_SemWait(simulation.wakeup);
+    } else {
+      SDL_SemWaitTimeout(simulation.wakeup, REPLAY_FRAME_MILLISECONDS);
+    }
+    Uint32 now_ticks = SDL_GetTicks();
+    if (!paused) {
+      position += (now_ticks - last_ticks) * speed;
+    }
+    last_ticks = now_ticks;
+
+    bool seeking = false;
+    ReplayControl control;
+    while (simulation.controls.try_pop(control)) {
+      switch (control) {
+      case ReplayControl::FASTER:
+        speed = next_replay_speed(speed, true);
+        break;
+      case ReplayControl::SLOWER:
+        speed = next_replay_speed(speed, false);
+        break;
+      case ReplayControl::TOGGLE_PAUSE:
+        paused = !paused;
+        break;
+      case ReplayControl::SEEK_BACK:
+        position -= REPLAY_SEEK_MILLISECONDS;
+        seeking = true;
+        break;
+      case ReplayControl::SEEK_FORWARD:
+        position += REPLAY_SEEK_MILLISECONDS;
+        seeking = true;
+        break;
+      case ReplayControl::SKIP_BACK:
+        position -= REPLAY_SKIP_MILLISECONDS;
+        seeking = true;
+        break;
+      case ReplayControl::SKIP_FORWARD:
+        position += REPLAY_SKIP_MILLISECONDS;
+        seeking = true;
+        break;
+      case ReplayControl::RESTART:
+        position = 0;
+        seeking = true;
+        break;
+      default:
+        break;
+      }
+      SDL_LogInfo(
+        SDL_LOG_CATEGORY_APPLICATION,
+        "Replay %s at %gx: %.1f of %.1f s\n",
+        paused ? "paused" : "playing",
+        speed,
+        position / 1000,
+        duration / 1000
+      );
+    }
+    position = std::min(std::max(position, 0.0), duration);
+
+    Uint32 milliseconds = static_cast<Uint32>(position);
+    if (seeking) {
+      seek_replay(player, milliseconds);
+      publish_snapshot(simulation, player.state);
+    } else if (advance_replay(player, milliseconds) > 0) {
+      publish_snapshot(simulation, player.state);
+    }
+  }
+  return 0;
+}
+
+void forward_input(Simulation &simulation, const SDL_Event &event, bool &should_quit) {
+  if (simulation.player != nullptr) {
+    ReplayControl control = handle_replay_event(event);
+    if (control == ReplayControl::QUIT) {
+      should_quit = true;
+    } else if (control != ReplayControl::NONE) {
+      simulation.controls.try_push(control);
+      SDL_SemPost(simulation.wakeup);
+    }
+    return;
+  }
+
+  if (event.type == SDL_QUIT ||
+      (event.type == SDL_KEYDOWN && event.key.keysym.sym == SDLK_ESCAPE)) {
+    should_quit = true;
+    return;
+  }
+  InputKey key;
+  if ((event.type != SDL_KEYDOWN && event.type != SDL_KEYUP) ||
+      event.key.repeat != 0 ||
+      !get_input_key(event.key.keysym.sym, key)) {
+    return;
+  }
+  InputEvent input = {
+    monotonic_microseconds(),
+    key,
+    event.type == SDL_KEYDOWN,
+    clock_seed()
+  };
+  if (simulation.demo) {
+    if (!input.pressed) {
+      return;
+    }
+    // Any game key takes over from the bot with a fresh game.
+    simulation.demo = false;
+    input.key = InputKey::NEW_GAME;
+  }
+  SDL_LogInfo(
+    SDL_LOG_CATEGORY_INPUT,
+    "%s %s\n",
+    SDL_GetKeyName(event.key.keysym.sym),
+    input.pressed ? "pressed" : "released"
+  );
+  if (simulation.inputs.try_push(input)) {
+    simulation.dropping_inputs = false;
+  } else {
+    // Logged once for each run of drops, so that a flood of keys is not
+    // also a flood of logging on the render thread.
+    if (!simulation.dropping_inputs) {
+      SDL_Log("Simulation is behind; dropping keys\n");
+    }
+    simulation.dropping_inputs = true;
+    simulation.dropped_inputs++;
+  }
+  SDL_SemPost(simulation.wakeup);
+}
+
+void game_loop(SDL_Renderer *renderer,
+               Replay *recording,
+               ReplayPlayer *player,
+               double replay_speed,
+               StatePublisher *publisher,
+               const HandlingSettings &handling,
+               bool demo,
+               ClientStats *stats) {
+  Simulation simulation;
+  simulation.wakeup = SDL_CreateSemaphore(0);
+  if (simulation.wakeup == nullptr) {
+    SDL_Log("Unable to start simulation: %s\n", SDL_GetError());
+    return;
+  }
+  simulation.quit = false;
+  simulation.repaint_requested = false;
+  simulation.handling = handling;
+  simulation.recording = recording;
+  simulation.recording_start = 0;
+  simulation.player = player;
+  simulation.replay_speed = replay_speed;
+  simulation.publisher = publisher;
+  std::unique_ptr<AutoplayPlanner> planner;
+  if (demo) {
+    planner.reset(new AutoplayPlanner(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT));
+  }
+  simulation.planner = planner.get();
+  simulation.demo = demo;
+  simulation.dropped_inputs = 0;
+  simulation.dropping_inputs = false;
+  SDL_Thread *thread = SDL_CreateThread(
+    player != nullptr ? replay_loop : simulation_loop,
+    "simulation",
+    &simulation
+  );
+  if (thread == nullptr) {
+    SDL_Log("Unable to start simulation: %s\n", SDL_GetError());
+    SDL_DestroySemaphore(simulation.wakeup);
+    return;
+  }
+
+  // Frames are drawn for new snapshots and for window changes, not for
+  // every key, whose effect arrives as a snapshot of its own.
+  FieldTexture field_texture = {nullptr, 0, 0, 0, {}};
+  bool has_snapshot = false;
+  bool needs_render = false;
+  bool should_quit = false;
+  SDL_Event event;
+  while (should_quit == false) {
+    if (SDL_WaitEvent(&event) == 0) {
+      SDL_Log("Error waiting for event: %s\n", SDL_GetError());
+      should_quit = true;
+    } else if (stats != nullptr) {
+      stats->events++;
+    }
+    if (event.type == SDL_USEREVENT && event.user.code == SNAPSHOT_PUBLISHED) {
+      simulation.repaint_requested = false;
+      if (simulation.snapshots.update()) {
+        has_snapshot = true;
+        needs_render = true;
+      }
+    } else if (event.type == SDL_WINDOWEVENT) {
+      needs_render = true;
+    } else if (event.type == SDL_RENDER_TARGETS_RESET ||
+               event.type == SDL_RENDER_DEVICE_RESET) {
+      reset_field_texture(field_texture);
+      needs_render = true;
+    } else {
+      forward_input(simulation, event, should_quit);
+    }
+
+    if (has_snapshot && needs_render) {
+      std::uint64_t start = stats != nullptr ? monotonic_microseconds() : 0;
+      render(renderer, field_texture, simulation.snapshots.read_buffer());
+      needs_render = false;
+      if (stats != nullptr) {
+        stats->frame_microseconds.push_back(
+          static_cast<std::uint32_t>(monotonic_microseconds() - start));
+      }
+    }
+  }
+  reset_field_texture(field_texture);
+
+  simulation.quit = true;
+  SDL_SemPost(simulation.wakeup);
+  SDL_WaitThread(thread, nullptr);
+  SDL_DestroySemaphore(simulation.wakeup);
+  if (stats != nullptr) {
+    stats->dropped_inputs = simulation.dropped_inputs;
+  }
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <SDL2/SDL.h>
+#include <cstdint>
+#include <vector>
+
+#include "handling.h"
+#include "replay.h"
+#include "shared_state.h"
+
+// The SDL client: the render loop on the calling thread, and live play
+// or replay playback on a thread of its own.
+
+// The code of the SDL_USEREVENT that asks for a repaint once the
+// simulation has published a new state.
+const Sint32 SNAPSHOT_PUBLISHED = 1;
+
+const double REPLAY_SPEEDS[] = {
+  0.25, 0.5, 1, 2, 5, 10, 20, 50, 100, 200, 500, 1000
+};
+
+// What game_loop measures when asked, for load tests.
+struct ClientStats {
+  std::uint64_t events;                          // taken off the SDL queue
+  std::uint64_t dropped_inputs;                  // keys the simulation had no room for
+  std::vector<std::uint32_t> frame_microseconds; // drawing and presenting each frame
+};
+
+std::uint64_t monotonic_microseconds();
+
+// Plays until the window is closed or escape is pressed: live, recording
+// into recording when it is not null, or playing player back at
+// replay_speed when it is not null. Every state is also published to
+// publisher when it is not null, and in demo mode the bot plays until a
+// game key is pressed. Counts into stats when it is not null.
+void game_loop(SDL_Renderer *renderer,
+               Replay *recording,
+               ReplayPlayer *player,
+               double replay_speed,
+               StatePublisher *publisher,
+               const HandlingSettings &handling,
+               bool demo,
+               ClientStats *stats);
@@ -0,0 +1,237 @@
+#include <SDL2/SDL.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "client.h"
+
+// Runs the real client, game_loop and render included, under SDL's dummy
+// video driver while another thread pushes storms of synthetic input
+// through SDL_PushEvent: floods of key repeats, rapid rotations, soft
+// drops and repaint requests. Reports how many events the render thread
+// took per second, how long frames took to draw and present, and the peak
+// resident memory, and fails if any of them is over its budget.
+
+const int REPEAT_FLOOD = 32;
+const int ROTATION_BURST = 8;
+const int REPAINT_BURST = 8;
+const int ROUNDS_PER_NEW_GAME = 64;
+
+struct Budgets {
+  double min_events_per_second;
+  double max_p99_frame_milliseconds;
+  double max_frame_milliseconds;
+  double max_peak_megabytes;
+};
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--seconds S] [--driver NAME]\n"
+               "       %s   [--min-events-per-second N] [--max-p99-frame-ms MS]\n"
+               "       %s   [--max-frame-ms MS] [--max-peak-mb MB]\n"
+               "Plays the client for S seconds (5) on the video driver NAME\n"
+               "(dummy) under a storm of synthetic input, and fails if the\n"
+               "render thread takes fewer than N events a second (20000), the\n"
+               "99th percentile frame takes longer than 16 ms or the slowest\n"
+               "longer than 100 ms, or the peak resident memory is over 128 MB.\n",
+               program, program, program);
+}
+
+// Pushes event, waiting while the queue is full. Returns false once the
+// storm is over.
+bool push_event(SDL_Event &event, const std::atomic<bool> &stop, std::uint64_t &full) {
+  while (SDL_PushEvent(&event) < 0) {
+    if (stop) {
+      return false;
+    }
+    full++;
+    std::this_thread::yield();
+  }
+  return true;
+}
+
+bool push_key(SDL_Keycode key, bool pressed, bool repeat,
+              const std::atomic<bool> &stop, std::uint64_t &full) {
+  SDL_Event event;
+  SDL_zero(event);
+  event.type = pressed ? SDL_KEYDOWN : SDL_KEYUP;
+  event.key.state = pressed ? SDL_PRESSED : SDL_RELEASED;
+  event.key.repeat = repeat ? 1 : 0;
+  event.key.keysym.sym = key;
+  return push_event(event, stop, full);
+}
+
+bool push_tap(SDL_Keycode key, const std::atomic<bool> &stop, std::uint64_t &full) {
+  return push_key(key, true, false, stop, full) && push_key(key, false, false, stop, full);
+}
+
+// Pushes rounds of input until stop, then asks the client to quit.
+void storm(const std::atomic<bool> &stop, std::uint64_t &full) {
+  for (std::uint64_t round = 0; !stop; round++) {
+    // A held shift, with the desktop repeating it, which the client
+    // leaves to the handling controller.
+    SDL_Keycode shift = round % 2 == 0 ? SDLK_LEFT : SDLK_RIGHT;
+    bool pushed = push_key(shift, true, false, stop, full);
+    for (int i = 0; pushed && i < REPEAT_FLOOD; i++) {
+      pushed = push_key(shift, true, true, stop, full);
+    }
+    pushed = pushed && push_key(shift, false, false, stop, full);
+
+    for (int i = 0; pushed && i < ROTATION_BURST; i++) {
+      pushed = push_tap(i % 2 == 0 ? SDLK_e : SDLK_q, stop, full);
+    }
+    pushed = pushed && push_tap(SDLK_DOWN, stop, full);
+
+    // Repaint requests that arrive with no new snapshot, as gravity's do
+    // when the render thread is behind.
+    for (int i = 0; pushed && i < REPAINT_BURST; i++) {
+      SDL_Event event;
+      SDL_zero(event);
+      event.type = SDL_USEREVENT;
+      event.user.code = SNAPSHOT_PUBLISHED;
+      pushed = push_event(event, stop, full);
+    }
+    if (pushed && round % ROUNDS_PER_NEW_GAME == ROUNDS_PER_NEW_GAME - 1) {
+      push_tap(SDLK_n, stop, full);
+    }
+  }
+
+  SDL_Event quit;
+  SDL_zero(quit);
+  quit.type = SDL_QUIT;
+  while (SDL_PushEvent(&quit) < 0) {
+    std::this_thread::yield();
+  }
+}
+
+double frame_quantile(const std::vector<std::uint32_t> &sorted, double quantile) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  std::size_t index = static_cast<std::size_t>(quantile * (sorted.size() - 1) + 0.5);
+  return sorted[index] / 1000.0;
+}
+
+bool check(const char *name, double value, double budget, bool at_least) {
+  bool within = at_least ? value >= budget : value <= budget;
+  if (!within) {
+    std::fprintf(stderr, "Over budget: %s is %.2f, %s %.2f\n",
+                 name, value, at_least ? "below" : "above", budget);
+  }
+  return within;
+}
+
+int main(int argc, char *argv[]) {
+  double seconds = 5;
+  std::string driver = "dummy";
+  Budgets budgets = {20000, 16, 100, 128};
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--seconds" && i + 1 < argc) {
+      seconds = std::atof(argv[++i]);
+    } else if (arg == "--driver" && i + 1 < argc) {
+      driver = argv[++i];
+    } else if (arg == "--min-events-per-second" && i + 1 < argc) {
+      budgets.min_events_per_second = std::atof(argv[++i]);
+    } else if (arg == "--max-p99-frame-ms" && i + 1 < argc) {
+      budgets.max_p99_frame_milliseconds = std::atof(argv[++i]);
+    } else if (arg == "--max-frame-ms" && i + 1 < argc) {
+      budgets.max_frame_milliseconds = std::atof(argv[++i]);
+    } else if (arg == "--max-peak-mb" && i + 1 < argc) {
+      budgets.max_peak_megabytes = std::atof(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (!(seconds > 0) || driver.empty()) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  // Set before SDL_Init, which reads it.
+  setenv("SDL_VIDEODRIVER", driver.c_str(), 1);
+  if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
+    SDL_Log("Unable to initialize SDL: %s\n", SDL_GetError());
+    return 1;
+  }
+  SDL_Window *window = SDL_CreateWindow(
+    "Tetris load test",
+    SDL_WINDOWPOS_UNDEFINED,
+    SDL_WINDOWPOS_UNDEFINED,
+    640,
+    480,
+    0
+  );
+  if (window == nullptr) {
+    SDL_Log("Unable to create window: %s\n", SDL_GetError());
+    return 1;
+  }
+  SDL_Renderer *renderer = SDL_CreateRenderer(window, -1, 0);
+  if (renderer == nullptr) {
+    SDL_Log("Unable to create renderer: %s\n", SDL_GetError());
+    return 1;
+  }
+
+  ClientStats stats = {0, 0, {}};
+  stats.frame_microseconds.reserve(1 << 20);
+  std::atomic<bool> stop(false);
+  std::uint64_t full = 0;
+  std::thread stormer(storm, std::cref(stop), std::ref(full));
+  std::thread timer([&stop, seconds] {
+    std::this_thread::sleep_for(std::chrono::microseconds(
+      static_cast<std::uint64_t>(seconds * 1000000)));
+    stop = true;
+  });
+
+  std::uint64_t start = monotonic_microseconds();
+  game_loop(renderer, nullptr, nullptr, 1, nullptr, DEFAULT_HANDLING, false, &stats);
+  double elapsed = (monotonic_microseconds() - start) / 1000000.0;
+  timer.join();
+  stormer.join();
+
+  SDL_DestroyRenderer(renderer);
+  SDL_DestroyWindow(window);
+  SDL_Quit();
+
+  std::vector<std::uint32_t> &frames = stats.frame_microseconds;
+  std::sort(frames.begin(), frames.end());
+  struct rusage usage_now;
+  getrusage(RUSAGE_SELF, &usage_now);
+  double peak_megabytes = usage_now.ru_maxrss / 1024.0; // kilobytes on Linux
+  double events_per_second = stats.events / elapsed;
+
+  std::printf("driver %s, %.2f s\n", driver.c_str(), elapsed);
+  std::printf("events %llu, %.0f per second, queue full %llu times, %llu keys dropped\n",
+              static_cast<unsigned long long>(stats.events),
+              events_per_second,
+              static_cast<unsigned long long>(full),
+              static_cast<unsigned long long>(stats.dropped_inputs));
+  std::printf("frames %zu, ms p50 %.3f p90 %.3f p99 %.3f max %.3f\n",
+              frames.size(),
+              frame_quantile(frames, 0.5),
+              frame_quantile(frames, 0.9),
+              frame_quantile(frames, 0.99),
+              frame_quantile(frames, 1));
+  std::printf("peak resident %.1f MB\n", peak_megabytes);
+
+  if (frames.empty()) {
+    std::fprintf(stderr, "No frames were drawn\n");
+    return 1;
+  }
+  bool within = check("events per second", events_per_second, budgets.min_events_per_second, true);
+  within = check("p99 frame ms", frame_quantile(frames, 0.99),
+                 budgets.max_p99_frame_milliseconds, false) && within;
+  within = check("slowest frame ms", frame_quantile(frames, 1),
+                 budgets.max_frame_milliseconds, false) && within;
+  within = check("peak resident MB", peak_megabytes, budgets.max_peak_megabytes, false) && within;
+  return within ? 0 : 1;
+}
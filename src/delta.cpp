@@ -0,0 +1,441 @@
+#include <algorithm>
+
+#include "delta.h"
+
+enum DeltaFlag {
+  ACTIVE_BLOCK_CHANGED = 1 << 0,
+  ROWS_REMOVED = 1 << 1,
+  ROWS_SET = 1 << 2,
+  NEXT_BLOCK_CHANGED = 1 << 3,
+  SCORE_CHANGED = 1 << 4,
+  PROGRESS_CHANGED = 1 << 5,
+  RNG_ADVANCED = 1 << 6,
+  SPEED_CHANGED = 1 << 7
+};
+
+// Keeps the encoder from describing absurd fields in a single frame.
+// Each side is bounded on its own so that their product cannot wrap.
+const std::uint64_t MAX_FIELD_SIDE = 0xFFFF;
+const std::uint64_t MAX_FIELD_CELLS = 1 << 24;
+
+static void put_varint(Frame &out, std::uint64_t value) {
+  while (value >= 0x80) {
+    out.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  out.push_back(static_cast<std::uint8_t>(value));
+}
+
+static void put_signed(Frame &out, std::int64_t value) {
+  put_varint(out, (static_cast<std::uint64_t>(value) << 1) ^ (value >> 63));
+}
+
+struct Reader {
+  const std::uint8_t *cursor;
+  const std::uint8_t *end;
+  bool ok;
+};
+
+static std::uint8_t get_byte(Reader &in) {
+  if (in.cursor == in.end) {
+    in.ok = false;
+    return 0;
+  }
+  return *in.cursor++;
+}
+
+static std::uint64_t get_varint(Reader &in) {
+  std::uint64_t value = 0;
+  for (int shift = 0; shift < 64; shift += 7) {
+    std::uint8_t byte = get_byte(in);
+    value |= static_cast<std::uint64_t>(byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) {
+      return value;
+    }
+  }
+  in.ok = false;
+  return 0;
+}
+
+static std::int64_t get_signed(Reader &in) {
+  std::uint64_t value = get_varint(in);
+  return static_cast<std::int64_t>(value >> 1) ^ -static_cast<std::int64_t>(value & 1);
+}
+
+static void put_line(Frame &out, const Line &line) {
+  for (std::size_t x = 0; x < line.size(); x += 8) {
+    std::uint8_t bits = 0;
+    for (std::size_t bit = 0; bit < 8 && x + bit < line.size(); bit++) {
+      if (line[x + bit] == CellState::FILLED) {
+        bits |= 1 << bit;
+      }
+    }
+    out.push_back(bits);
+  }
+}
+
+static void get_line(Reader &in, Line &line) {
+  for (std::size_t x = 0; x < line.size(); x += 8) {
+    std::uint8_t bits = get_byte(in);
+    for (std::size_t bit = 0; bit < 8 && x + bit < line.size(); bit++) {
+      line[x + bit] = (bits & (1 << bit)) ? CellState::FILLED : CellState::EMPTY;
+    }
+  }
+}
+
+static void put_active_block(Frame &out, const ActiveBlock &block) {
+  put_signed(out, block.position_x);
+  put_signed(out, block.position_y);
+  out.push_back(static_cast<std::uint8_t>(block.tetromino) << 2 |
+                static_cast<std::uint8_t>(block.rotation));
+}
+
+static ActiveBlock get_active_block(Reader &in) {
+  int position_x = get_signed(in);
+  int position_y = get_signed(in);
+  std::uint8_t packed = get_byte(in);
+  if ((packed >> 2) >= TETROMINO_COUNT) {
+    in.ok = false;
+  }
+  return {
+    position_x,
+    position_y,
+    static_cast<Tetromino>((packed >> 2) % TETROMINO_COUNT),
+    static_cast<Rotation>(packed & 3)
+  };
+}
+
+static Tetromino get_tetromino(Reader &in) {
+  std::uint8_t value = get_byte(in);
+  if (value >= TETROMINO_COUNT) {
+    in.ok = false;
+    return Tetromino::I;
+  }
+  return static_cast<Tetromino>(value);
+}
+
+static GameProgress get_progress(Reader &in) {
+  return get_byte(in) ? GameProgress::GAME_OVER : GameProgress::IN_PROGRESS;
+}
+
+// True if every filled cell of old_line is also filled in new_line, which
+// is how a surviving row can change when a block locks onto it.
+static bool could_become(const Line &old_line, const Line &new_line) {
+  for (std::size_t x = 0; x < old_line.size(); x++) {
+    if (old_line[x] == CellState::FILLED && new_line[x] == CellState::EMPTY) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static std::vector<int> find_removed_rows(const Field &old_field,
+                                          const Field &new_field) {
+  std::vector<int> removed;
+  int new_y = 0;
+  for (int old_y = 0; old_y < old_field.height; old_y++) {
+    if (new_y < new_field.height &&
+        could_become(old_field.lines[old_y], new_field.lines[new_y])) {
+      new_y++;
+    } else {
+      removed.push_back(old_y);
+    }
+  }
+  return removed;
+}
+
+static void remove_rows(Field &field, const std::vector<int> &rows) {
+  std::vector<Line> kept;
+  kept.reserve(field.height);
+  std::size_t next_removed = 0;
+  for (int y = 0; y < field.height; y++) {
+    if (next_removed < rows.size() && rows[next_removed] == y) {
+      next_removed++;
+    } else {
+      kept.push_back(field.lines[y]);
+    }
+  }
+  kept.resize(field.height, Line(field.width, CellState::EMPTY));
+  field.lines = kept;
+}
+
+Frame encode_keyframe(const GameState &state) {
+  Frame out;
+  out.push_back(static_cast<std::uint8_t>(FrameKind::KEYFRAME));
+  put_varint(out, state.field.width);
+  put_varint(out, state.field.height);
+  for (const Line &line : state.field.lines) {
+    put_line(out, line);
+  }
+  put_active_block(out, state.active_block);
+  out.push_back(static_cast<std::uint8_t>(state.next_block));
+  put_varint(out, state.milliseconds_per_turn);
+  put_signed(out, state.score);
+  put_signed(out, state.lines);
+  out.push_back(static_cast<std::uint8_t>(state.progress));
+  put_varint(out, state.rng.seed());
+  put_varint(out, state.rng.position());
+  return out;
+}
+
+Frame encode_delta(const GameState &previous, const GameState &next) {
+  Frame out;
+  out.push_back(static_cast<std::uint8_t>(FrameKind::DELTA));
+  out.push_back(0); // flags, filled in below
+  std::uint8_t flags = 0;
+
+  if (!(previous.active_block == next.active_block)) {
+    flags |= ACTIVE_BLOCK_CHANGED;
+    put_active_block(out, next.active_block);
+  }
+
+  // Equal stamps spare comparing every cell between locks.
+  if (!same_version(previous.versions.field, next.versions.field) &&
+      !(previous.field == next.field)) {
+    std::vector<int> removed = find_removed_rows(previous.field, next.field);
+    Field shifted = previous.field;
+    if (!removed.empty()) {
+      flags |= ROWS_REMOVED;
+      put_varint(out, removed.size());
+      int last = 0;
+      for (int y : removed) {
+        put_varint(out, y - last); // ascending, so store gaps
+        last = y;
+      }
+      remove_rows(shifted, removed);
+    }
+    std::vector<int> changed;
+    for (int y = 0; y < next.field.height; y++) {
+      if (shifted.lines[y] != next.field.lines[y]) {
+        changed.push_back(y);
+      }
+    }
+    if (!changed.empty()) {
+      flags |= ROWS_SET;
+      put_varint(out, changed.size());
+      int last = 0;
+      for (int y : changed) {
+        put_varint(out, y - last);
+        put_line(out, next.field.lines[y]);
+        last = y;
+      }
+    }
+  }
+
+  if (previous.next_block != next.next_block) {
+    flags |= NEXT_BLOCK_CHANGED;
+    out.push_back(static_cast<std::uint8_t>(next.next_block));
+  }
+  if (previous.score != next.score || previous.lines != next.lines) {
+    flags |= SCORE_CHANGED;
+    put_signed(out, next.score - previous.score);
+    put_signed(out, next.lines - previous.lines);
+  }
+  if (previous.progress != next.progress) {
+    flags |= PROGRESS_CHANGED;
+    out.push_back(static_cast<std::uint8_t>(next.progress));
+  }
+  if (previous.rng.position() != next.rng.position()) {
+    flags |= RNG_ADVANCED;
+    put_varint(out, next.rng.position() - previous.rng.position());
+  }
+  if (previous.milliseconds_per_turn != next.milliseconds_per_turn) {
+    flags |= SPEED_CHANGED;
+    put_varint(out, next.milliseconds_per_turn);
+  }
+
+  out[1] = flags;
+  return out;
+}
+
+DeltaEncoder new_delta_encoder(int keyframe_interval) {
+  return {
+    keyframe_interval,
+    0,
+    false,
+    {}
+  };
+}
+
+static bool needs_keyframe(const DeltaEncoder &encoder, const GameState &state) {
+  return !encoder.has_previous
+      || encoder.frames_since_keyframe + 1 >= encoder.keyframe_interval
+      || encoder.previous.field.width != state.field.width
+      || encoder.previous.field.height != state.field.height
+      || encoder.previous.rng.seed() != state.rng.seed()
+      || encoder.previous.rng.position() > state.rng.position()
+      || state.rng.position() - encoder.previous.rng.position() > MAX_DELTA_DRAWS;
+}
+
+Frame encode_frame(DeltaEncoder &encoder, const GameState &state) {
+  Frame frame;
+  if (needs_keyframe(encoder, state)) {
+    frame = encode_keyframe(state);
+    encoder.frames_since_keyframe = 0;
+  } else {
+    frame = encode_delta(encoder.previous, state);
+    encoder.frames_since_keyframe++;
+  }
+  encoder.previous = state;
+  encoder.has_previous = true;
+  return frame;
+}
+
+DeltaDecoder new_delta_decoder() {
+  return {
+    false,
+    {}
+  };
+}
+
+static bool apply_keyframe(DeltaDecoder &decoder, Reader &in) {
+  GameState state;
+  std::uint64_t width = get_varint(in);
+  std::uint64_t height = get_varint(in);
+  if (!in.ok || width == 0 || height == 0 ||
+      width > MAX_FIELD_SIDE || height > MAX_FIELD_SIDE ||
+      width * height > MAX_FIELD_CELLS) {
+    return false;
+  }
+  // The rows must all be in the frame before any are allocated.
+  if (static_cast<std::uint64_t>(in.end - in.cursor) < height * ((width + 7) / 8)) {
+    return false;
+  }
+  state.field = {
+    static_cast<int>(height),
+    static_cast<int>(width),
+    std::vector<Line>(height, Line(width, CellState::EMPTY))
+  };
+  for (Line &line : state.field.lines) {
+    get_line(in, line);
+  }
+  state.active_block = get_active_block(in);
+  state.next_block = get_tetromino(in);
+  state.milliseconds_per_turn = get_varint(in);
+  state.score = get_signed(in);
+  state.lines = get_signed(in);
+  state.progress = get_progress(in);
+  RNG::result_type seed = get_varint(in);
+  unsigned long long position = get_varint(in);
+  if (!in.ok || in.cursor != in.end || position > MAX_RNG_POSITION) {
+    return false;
+  }
+  state.rng = RNG::at_position(seed, position);
+  refresh_versions(state);
+  decoder.state = state;
+  decoder.synchronized = true;
+  return true;
+}
+
+// Stamps what the delta changed, so the decoded state's consumers can
+// skip the rest like those of the encoder's.
+static bool apply_delta(DeltaDecoder &decoder, Reader &in) {
+  GameState &state = decoder.state;
+  StateVersions &versions = state.versions;
+  std::uint64_t version = new_version();
+  std::uint8_t flags = get_byte(in);
+
+  if (flags & ACTIVE_BLOCK_CHANGED) {
+    state.active_block = get_active_block(in);
+    versions.active_block = version;
+  }
+  if (flags & (ROWS_REMOVED | ROWS_SET)) {
+    versions.field = version;
+  }
+  if (flags & ROWS_REMOVED) {
+    std::uint64_t count = get_varint(in);
+    if (count > static_cast<std::uint64_t>(state.field.height)) {
+      return false;
+    }
+    std::vector<int> removed;
+    std::uint64_t y = 0;
+    for (std::uint64_t i = 0; i < count && in.ok; i++) {
+      y += get_varint(in);
+      if (y >= static_cast<std::uint64_t>(state.field.height) ||
+          (!removed.empty() && static_cast<int>(y) <= removed.back())) {
+        return false;
+      }
+      removed.push_back(y);
+    }
+    remove_rows(state.field, removed);
+    if (!removed.empty()) {
+      std::fill(versions.rows.begin() + removed[0], versions.rows.end(), version);
+    }
+  }
+  if (flags & ROWS_SET) {
+    std::uint64_t count = get_varint(in);
+    std::uint64_t y = 0;
+    for (std::uint64_t i = 0; i < count && in.ok; i++) {
+      y += get_varint(in);
+      if (y >= static_cast<std::uint64_t>(state.field.height)) {
+        return false;
+      }
+      get_line(in, state.field.lines[y]);
+      versions.rows[y] = version;
+    }
+  }
+  if (flags & NEXT_BLOCK_CHANGED) {
+    state.next_block = get_tetromino(in);
+    versions.next_block = version;
+  }
+  if (flags & SCORE_CHANGED) {
+    state.score += get_signed(in);
+    state.lines += get_signed(in);
+    versions.score = version;
+  }
+  if (flags & PROGRESS_CHANGED) {
+    state.progress = get_progress(in);
+    versions.score = version;
+  }
+  if (flags & RNG_ADVANCED) {
+    std::uint64_t advanced = get_varint(in);
+    if (advanced > MAX_DELTA_DRAWS) {
+      in.ok = false;
+    }
+    for (std::uint64_t i = 0; i < advanced && in.ok; i++) {
+      state.rng();
+    }
+  }
+  if (flags & SPEED_CHANGED) {
+    state.milliseconds_per_turn = get_varint(in);
+  }
+  return in.ok && in.cursor == in.end;
+}
+
+bool apply_frame(DeltaDecoder &decoder, const Frame &frame) {
+  Reader in = {frame.data(), frame.data() + frame.size(), true};
+  std::uint8_t kind = get_byte(in);
+  if (kind == static_cast<std::uint8_t>(FrameKind::KEYFRAME)) {
+    if (!apply_keyframe(decoder, in)) {
+      decoder.synchronized = false;
+      return false;
+    }
+    return true;
+  }
+  if (kind == static_cast<std::uint8_t>(FrameKind::DELTA)) {
+    if (!decoder.synchronized) {
+      return true; // joined mid-stream; wait for a keyframe
+    }
+    if (!apply_delta(decoder, in)) {
+      decoder.synchronized = false;
+      return false;
+    }
+    return true;
+  }
+  return false;
+}
+
+void append_framed(std::vector<std::uint8_t> &stream, const Frame &frame) {
+  put_varint(stream, frame.size());
+  stream.insert(stream.end(), frame.begin(), frame.end());
+}
+
+std::size_t take_framed(const std::uint8_t *data, std::size_t size, Frame &frame) {
+  Reader in = {data, data + size, true};
+  std::uint64_t length = get_varint(in);
+  if (!in.ok || length > static_cast<std::uint64_t>(in.end - in.cursor)) {
+    return 0;
+  }
+  frame.assign(in.cursor, in.cursor + length);
+  return (in.cursor - data) + length;
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "state.h"
+
+// Compact state streaming for spectators.
+//
+// A stream is a sequence of frames. A keyframe carries a whole GameState;
+// a delta carries only the components that changed since the previous
+// frame: the active block, rows removed by a line clear, rows whose cells
+// changed, the next block, score and lines, progress and the generator
+// position. A spectator can join at any keyframe and, from then on,
+// reconstructs every GameState exactly. The decoded state is stamped
+// with fresh versions where a frame changed it.
+
+typedef std::vector<std::uint8_t> Frame;
+
+// Bounds on the generator counts in a frame, so that a corrupt frame
+// cannot keep the decoder drawing numbers for hours. A step draws one
+// number per spawn; the encoder sends a keyframe when more than
+// MAX_DELTA_DRAWS were drawn since the previous frame. Keyframes past
+// MAX_RNG_POSITION draws are rejected.
+const std::uint64_t MAX_DELTA_DRAWS = 1024;
+const std::uint64_t MAX_RNG_POSITION = 1ull << 30;
+
+enum class FrameKind {
+  KEYFRAME = 1,
+  DELTA = 2
+};
+
+struct DeltaEncoder {
+  int keyframe_interval; // frames between keyframes
+  int frames_since_keyframe;
+  bool has_previous;
+  GameState previous;
+};
+
+DeltaEncoder new_delta_encoder(int keyframe_interval);
+
+// Encodes state relative to the last state given to this encoder,
+// choosing a keyframe when one is due or a delta cannot describe the
+// change (a new game, a different field size, or more than
+// MAX_DELTA_DRAWS numbers drawn).
+Frame encode_frame(DeltaEncoder &encoder, const GameState &state);
+
+Frame encode_keyframe(const GameState &state);
+Frame encode_delta(const GameState &previous, const GameState &next);
+
+struct DeltaDecoder {
+  bool synchronized; // false until the first keyframe is seen
+  GameState state;
+};
+
+DeltaDecoder new_delta_decoder();
+
+// Applies one frame. Deltas received before the first keyframe are
+// skipped. Returns false if the frame is malformed, in which case the
+// decoder waits for the next keyframe.
+bool apply_frame(DeltaDecoder &decoder, const Frame &frame);
+
+// Length-prefixed framing for byte streams such as pipes and sockets.
+void append_framed(std::vector<std::uint8_t> &stream, const Frame &frame);
+
+// Takes one complete frame from the front of data. Returns the number of
+// bytes consumed, or 0 if more data is needed.
+std::size_t take_framed(const std::uint8_t *data, std::size_t size, Frame &frame);
@@ -0,0 +1,193 @@
+#include <cstdlib>
+
+#include "evaluation_kernel.h"
+
+namespace {
+
+// The portable kernel: one field at a time in a plain 32 bit word.
+struct ScalarOps {
+  typedef std::uint32_t V;
+  static const int LANES = 1;
+
+  static V load(const std::uint32_t *p) { return *p; }
+  static void store(std::uint32_t *p, V v) { *p = v; }
+  static V zero() { return 0; }
+  static V set1(std::uint32_t x) { return x; }
+  static V bit_and(V a, V b) { return a & b; }
+  static V bit_or(V a, V b) { return a | b; }
+  static V bit_xor(V a, V b) { return a ^ b; }
+  static V andnot(V a, V b) { return ~a & b; }
+  static V shl1(V a) { return a << 1; }
+  static V shr1(V a) { return a >> 1; }
+  static V add_bytes(V a, V b) { return a + b; }
+  static V add_lanes(V a, V b) { return a + b; }
+  static V count_bytes(V v) { return __builtin_popcount(v); }
+  static V widen(V count) { return count; }
+};
+
+}
+
+const char* get_kernel_name(EvaluationKernel kernel) {
+  switch (kernel) {
+  case EvaluationKernel::SCALAR: return "scalar";
+  case EvaluationKernel::SSSE3:  return "ssse3";
+  case EvaluationKernel::AVX2:   return "avx2";
+  default:                       return "Unknown";
+  }
+}
+
+bool is_kernel_supported(EvaluationKernel kernel) {
+  switch (kernel) {
+  case EvaluationKernel::SSSE3:
+    return ssse3_kernel_available();
+  case EvaluationKernel::AVX2:
+    return avx2_kernel_available();
+  default:
+    return true;
+  }
+}
+
+EvaluationKernel best_evaluation_kernel() {
+  static const EvaluationKernel best =
+    is_kernel_supported(EvaluationKernel::AVX2) ? EvaluationKernel::AVX2 :
+    is_kernel_supported(EvaluationKernel::SSSE3) ? EvaluationKernel::SSSE3 :
+    EvaluationKernel::SCALAR;
+  return best;
+}
+
+FieldBatch new_field_batch(int width, int height) {
+  return {width, height, 0, {}};
+}
+
+void clear_field_batch(FieldBatch &batch) {
+  batch.count = 0;
+  batch.rows.clear();
+}
+
+// Returns the first row of the next field's column of rows, starting a
+// new zeroed block when the last one is full.
+static std::uint32_t *next_field_rows(FieldBatch &batch) {
+  std::size_t lane = batch.count % EVALUATION_BLOCK_FIELDS;
+  if (lane == 0) {
+    batch.rows.resize(batch.rows.size() + batch.height * EVALUATION_BLOCK_FIELDS, 0);
+  }
+  batch.count++;
+  return batch.rows.data() + batch.rows.size()
+       - batch.height * EVALUATION_BLOCK_FIELDS + lane;
+}
+
+void add_field(FieldBatch &batch, const Field &field) {
+  std::uint32_t *rows = next_field_rows(batch);
+  for (int y = 0; y < batch.height; y++) {
+    std::uint32_t row = 0;
+    for (int x = 0; x < batch.width; x++) {
+      if (field.lines[y][x] == CellState::FILLED) {
+        row |= 1u << x;
+      }
+    }
+    rows[y * EVALUATION_BLOCK_FIELDS] = row;
+  }
+}
+
+void add_packed_field(FieldBatch &batch, const std::uint32_t *packed) {
+  std::uint32_t *rows = next_field_rows(batch);
+  for (int y = 0; y < batch.height; y++) {
+    rows[y * EVALUATION_BLOCK_FIELDS] = packed[y];
+  }
+}
+
+void evaluate_fields(const FieldBatch &batch,
+                     std::vector<BoardFeatures> &features,
+                     EvaluationKernel kernel) {
+  // Kernels write whole blocks, including the unused lanes of the last.
+  features.resize(batch.rows.size() / (batch.height > 0 ? batch.height : 1));
+  if (!is_kernel_supported(kernel)) {
+    kernel = EvaluationKernel::SCALAR; // the stubs would leave features unset
+  }
+  if (batch.count > 0) {
+    switch (kernel) {
+    case EvaluationKernel::AVX2:
+      evaluate_batch_avx2(batch, features.data());
+      break;
+    case EvaluationKernel::SSSE3:
+      evaluate_batch_ssse3(batch, features.data());
+      break;
+    default:
+      evaluate_batch<ScalarOps>(batch, features.data());
+      break;
+    }
+  }
+  features.resize(batch.count);
+}
+
+double score_features(const BoardFeatures &features, const FeatureWeights &weights) {
+  return features.holes * weights.holes
+       + features.aggregate_height * weights.aggregate_height
+       + features.bumpiness * weights.bumpiness
+       + features.row_transitions * weights.row_transitions
+       + features.column_transitions * weights.column_transitions
+       + features.wells * weights.wells;
+}
+
+void score_fields(const FieldBatch &batch,
+                  const FeatureWeights &weights,
+                  std::vector<double> &scores,
+                  EvaluationKernel kernel) {
+  static thread_local std::vector<BoardFeatures> features;
+  evaluate_fields(batch, features, kernel);
+  scores.resize(features.size());
+  for (std::size_t i = 0; i < features.size(); i++) {
+    scores[i] = score_features(features[i], weights);
+  }
+}
+
+static bool is_filled(const Field &field, int x, int y) {
+  if (x < 0 || x >= field.width) {
+    return true; // walls
+  }
+  return field.lines[y][x] == CellState::FILLED;
+}
+
+BoardFeatures evaluate_field(const Field &field) {
+  BoardFeatures features = {0, 0, 0, 0, 0, 0};
+  std::vector<int> heights(field.width, 0);
+  for (int x = 0; x < field.width; x++) {
+    int well_run = 0;
+    CellState below = CellState::FILLED; // the floor
+    for (int y = field.height - 1; y >= 0; y--) {
+      if (is_filled(field, x, y)) {
+        if (heights[x] == 0) {
+          heights[x] = y + 1;
+        }
+        well_run = 0;
+      } else {
+        if (heights[x] > y) {
+          features.holes++;
+        }
+        if (is_filled(field, x - 1, y) && is_filled(field, x + 1, y)) {
+          features.wells += ++well_run;
+        } else {
+          well_run = 0;
+        }
+      }
+    }
+    for (int y = 0; y < field.height; y++) {
+      if (field.lines[y][x] != below) {
+        features.column_transitions++;
+      }
+      below = field.lines[y][x];
+    }
+    features.aggregate_height += heights[x];
+    if (x > 0) {
+      features.bumpiness += std::abs(heights[x] - heights[x - 1]);
+    }
+  }
+  for (int y = 0; y < field.height; y++) {
+    for (int x = 0; x <= field.width; x++) {
+      if (is_filled(field, x - 1, y) != is_filled(field, x, y)) {
+        features.row_transitions++;
+      }
+    }
+  }
+  return features;
+}
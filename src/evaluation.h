@@ -0,0 +1,84 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "state.h"
+
+// Batched board evaluation for bots.
+//
+// Fields are packed one 32 bit mask per row (bit x set for a filled cell
+// in column x, row 0 at the bottom) and interleaved in blocks of eight:
+// a block stores row 0 of its eight fields, then row 1, and so on. Every
+// feature is then a handful of bitwise operations and popcounts per row,
+// applied to eight fields at once with AVX2, four with SSSE3, or one at
+// a time by the portable kernel. The kernel is chosen at run time.
+
+const int EVALUATION_MAX_WIDTH = 32;
+const int EVALUATION_MAX_HEIGHT = 64;
+const int EVALUATION_BLOCK_FIELDS = 8;
+
+const int FEATURE_COUNT = 6;
+
+// The Dellacherie features, all counted in cells.
+struct BoardFeatures {
+  int holes;              // empty cells with a filled cell above them
+  int aggregate_height;   // sum of the column heights
+  int bumpiness;          // sum of height differences of adjacent columns
+  int row_transitions;    // filled/empty changes along rows, walls filled
+  int column_transitions; // filled/empty changes up columns, floor filled
+  int wells;              // well cells, each counted by its depth in the well
+};
+
+struct FeatureWeights {
+  double holes;
+  double aggregate_height;
+  double bumpiness;
+  double row_transitions;
+  double column_transitions;
+  double wells;
+};
+
+struct FieldBatch {
+  int width;
+  int height;
+  std::size_t count;
+  std::vector<std::uint32_t> rows; // height * EVALUATION_BLOCK_FIELDS per block
+};
+
+enum class EvaluationKernel {
+  SCALAR,
+  SSSE3,
+  AVX2
+};
+
+const char* get_kernel_name(EvaluationKernel kernel);
+
+// The fastest kernel this processor supports.
+EvaluationKernel best_evaluation_kernel();
+bool is_kernel_supported(EvaluationKernel kernel);
+
+// Fields must be at most EVALUATION_MAX_WIDTH wide and
+// EVALUATION_MAX_HEIGHT tall, and every field in a batch the same size.
+FieldBatch new_field_batch(int width, int height);
+void clear_field_batch(FieldBatch &batch);
+void add_field(FieldBatch &batch, const Field &field);
+void add_packed_field(FieldBatch &batch, const std::uint32_t *rows); // bottom row first
+
+// Replaces features with one entry per field in the batch. A kernel the
+// processor does not support falls back to the scalar one.
+void evaluate_fields(const FieldBatch &batch,
+                     std::vector<BoardFeatures> &features,
+                     EvaluationKernel kernel = best_evaluation_kernel());
+
+// Replaces scores with the weighted sum of each field's features.
+void score_fields(const FieldBatch &batch,
+                  const FeatureWeights &weights,
+                  std::vector<double> &scores,
+                  EvaluationKernel kernel = best_evaluation_kernel());
+
+double score_features(const BoardFeatures &features, const FeatureWeights &weights);
+
+// Reference implementation that walks field.lines cell by cell.
+BoardFeatures evaluate_field(const Field &field);
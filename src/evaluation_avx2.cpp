@@ -0,0 +1,65 @@
+#include "evaluation_kernel.h"
+
+#if defined(__AVX2__)
+
+#include <immintrin.h>
+
+namespace {
+
+struct Avx2Ops {
+  typedef __m256i V;
+  static const int LANES = 8;
+
+  static V load(const std::uint32_t *p) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p));
+  }
+  static void store(std::uint32_t *p, V v) {
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(p), v);
+  }
+  static V zero() { return _mm256_setzero_si256(); }
+  static V set1(std::uint32_t x) { return _mm256_set1_epi32(static_cast<int>(x)); }
+  static V bit_and(V a, V b) { return _mm256_and_si256(a, b); }
+  static V bit_or(V a, V b) { return _mm256_or_si256(a, b); }
+  static V bit_xor(V a, V b) { return _mm256_xor_si256(a, b); }
+  static V andnot(V a, V b) { return _mm256_andnot_si256(a, b); } // ~a & b
+  static V shl1(V a) { return _mm256_slli_epi32(a, 1); }
+  static V shr1(V a) { return _mm256_srli_epi32(a, 1); }
+  static V add_bytes(V a, V b) { return _mm256_add_epi8(a, b); }
+  static V add_lanes(V a, V b) { return _mm256_add_epi32(a, b); }
+
+  // Looks up the popcount of each nibble; the shuffle works within each
+  // 128 bit half, so the table is repeated.
+  static V count_bytes(V v) {
+    const V table = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                     0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const V low_nibbles = _mm256_set1_epi8(0x0F);
+    V low = _mm256_and_si256(v, low_nibbles);
+    V high = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_nibbles);
+    return _mm256_add_epi8(_mm256_shuffle_epi8(table, low), _mm256_shuffle_epi8(table, high));
+  }
+  static V widen(V bytes) {
+    V pairs = _mm256_maddubs_epi16(bytes, _mm256_set1_epi8(1));
+    return _mm256_madd_epi16(pairs, _mm256_set1_epi16(1));
+  }
+};
+
+}
+
+bool avx2_kernel_available() {
+  return __builtin_cpu_supports("avx2");
+}
+
+void evaluate_batch_avx2(const FieldBatch &batch, BoardFeatures *features) {
+  evaluate_batch<Avx2Ops>(batch, features);
+}
+
+#else
+
+bool avx2_kernel_available() {
+  return false;
+}
+
+void evaluate_batch_avx2(const FieldBatch &, BoardFeatures *) {
+}
+
+#endif
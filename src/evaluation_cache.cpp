@@ -0,0 +1,207 @@
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "evaluation_cache.h"
+
+const std::uint64_t CACHE_MAGIC = 0x4843414352544554ull; // "TETRCACH"
+const std::uint32_t CACHE_VERSION = 1;
+const int CACHE_MAX_PROBES = 64;
+
+enum SlotState : std::uint32_t {
+  SLOT_EMPTY = 0, // the file is created zeroed
+  SLOT_WRITING = 1,
+  SLOT_READY = 2
+};
+
+struct CacheHeader {
+  std::uint64_t magic;
+  std::uint32_t version;
+  std::uint32_t slot_size;
+  std::uint64_t slot_count;
+  std::uint64_t entries; // updated atomically
+  std::uint8_t reserved[32];
+};
+
+struct CacheSlot {
+  std::uint32_t state; // a SlotState, updated atomically
+  std::int8_t block_x;
+  std::int8_t block_y;
+  std::uint8_t block_tetromino;
+  std::uint8_t block_rotation;
+  std::uint64_t hash;
+  std::uint64_t check;
+  double score;
+};
+
+static_assert(sizeof(CacheHeader) == 64, "cache header layout");
+static_assert(sizeof(CacheSlot) == 32, "cache slot layout");
+
+static std::uint64_t round_up_to_power_of_two(std::size_t count) {
+  std::uint64_t slots = 1;
+  while (slots < count) {
+    slots <<= 1;
+  }
+  return slots;
+}
+
+// Creates the header of a new, empty file, or checks the header of an
+// existing one. Callers hold the file lock, so only one process creates.
+static bool prepare_file(int fd, std::size_t slot_count, CacheHeader &header) {
+  struct stat status;
+  if (fstat(fd, &status) != 0) {
+    return false;
+  }
+  if (status.st_size == 0) {
+    header = {CACHE_MAGIC, CACHE_VERSION, sizeof(CacheSlot),
+              round_up_to_power_of_two(slot_count), 0, {}};
+    off_t size = sizeof(CacheHeader) + header.slot_count * sizeof(CacheSlot);
+    return ftruncate(fd, size) == 0 &&
+           pwrite(fd, &header, sizeof(header), 0) == sizeof(header);
+  }
+  if (pread(fd, &header, sizeof(header), 0) != sizeof(header)) {
+    return false;
+  }
+  return header.magic == CACHE_MAGIC &&
+         header.version == CACHE_VERSION &&
+         header.slot_size == sizeof(CacheSlot) &&
+         header.slot_count > 0 &&
+         (header.slot_count & (header.slot_count - 1)) == 0 &&
+         static_cast<std::uint64_t>(status.st_size) ==
+           sizeof(CacheHeader) + header.slot_count * sizeof(CacheSlot);
+}
+
+bool open_evaluation_cache(const std::string &path,
+                           std::size_t slot_count,
+                           EvaluationCache &cache) {
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  CacheHeader header;
+  bool prepared = flock(fd, LOCK_EX) == 0 && prepare_file(fd, slot_count, header);
+  flock(fd, LOCK_UN);
+  if (!prepared) {
+    close(fd);
+    return false;
+  }
+
+  std::size_t size = sizeof(CacheHeader) + header.slot_count * sizeof(CacheSlot);
+  void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  cache.fd = fd;
+  cache.mapping_size = size;
+  cache.header = static_cast<CacheHeader *>(mapping);
+  cache.slots = reinterpret_cast<CacheSlot *>(static_cast<char *>(mapping) + sizeof(CacheHeader));
+  cache.slot_mask = header.slot_count - 1;
+  return true;
+}
+
+void close_evaluation_cache(EvaluationCache &cache) {
+  if (cache.header != nullptr) {
+    munmap(cache.header, cache.mapping_size);
+    close(cache.fd);
+    cache.header = nullptr;
+    cache.slots = nullptr;
+  }
+}
+
+static std::uint64_t mix(std::uint64_t hash, std::uint64_t value) {
+  hash ^= value;
+  hash ^= hash >> 33;
+  hash *= 0xFF51AFD7ED558CCDull;
+  hash ^= hash >> 33;
+  hash *= 0xC4CEB9FE1A85EC53ull;
+  return hash ^ (hash >> 33);
+}
+
+CacheKey make_cache_key(const Field &field,
+                        const ActiveBlock &active_block,
+                        std::uint64_t context) {
+  std::uint64_t block = hash_active_block(active_block);
+  CacheKey key = {
+    mix(mix(hash_field(field), block), context),
+    0xCBF29CE484222325ull // FNV-1a over the cells, independent of hash_field
+  };
+  for (const Line &line : field.lines) {
+    for (CellState cell : line) {
+      key.check = (key.check ^ static_cast<std::uint64_t>(cell)) * 0x100000001B3ull;
+    }
+  }
+  key.check = mix(mix(key.check, block ^ 0x5555555555555555ull), context);
+  return key;
+}
+
+static bool matches(const CacheSlot &slot, const CacheKey &key) {
+  return slot.hash == key.hash && slot.check == key.check;
+}
+
+bool cache_lookup(const EvaluationCache &cache,
+                  const CacheKey &key,
+                  CachedEvaluation &evaluation) {
+  for (int probe = 0; probe < CACHE_MAX_PROBES; probe++) {
+    const CacheSlot &slot = cache.slots[(key.hash + probe) & cache.slot_mask];
+    std::uint32_t state = __atomic_load_n(&slot.state, __ATOMIC_ACQUIRE);
+    if (state == SLOT_EMPTY) {
+      return false;
+    }
+    // A slot still being written is skipped; at worst this is a miss.
+    if (state == SLOT_READY && matches(slot, key)) {
+      if (slot.block_tetromino >= TETROMINO_COUNT || slot.block_rotation >= 4) {
+        return false; // not a block; the file is damaged
+      }
+      evaluation.score = slot.score;
+      evaluation.best_block = {
+        slot.block_x,
+        slot.block_y,
+        static_cast<Tetromino>(slot.block_tetromino),
+        static_cast<Rotation>(slot.block_rotation)
+      };
+      return true;
+    }
+  }
+  return false;
+}
+
+bool cache_insert(EvaluationCache &cache,
+                  const CacheKey &key,
+                  const CachedEvaluation &evaluation) {
+  for (int probe = 0; probe < CACHE_MAX_PROBES; probe++) {
+    CacheSlot &slot = cache.slots[(key.hash + probe) & cache.slot_mask];
+    std::uint32_t state = __atomic_load_n(&slot.state, __ATOMIC_ACQUIRE);
+    if (state == SLOT_EMPTY &&
+        __atomic_compare_exchange_n(&slot.state, &state, SLOT_WRITING, false,
+                                    __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE)) {
+      slot.hash = key.hash;
+      slot.check = key.check;
+      slot.score = evaluation.score;
+      slot.block_x = static_cast<std::int8_t>(evaluation.best_block.position_x);
+      slot.block_y = static_cast<std::int8_t>(evaluation.best_block.position_y);
+      slot.block_tetromino = static_cast<std::uint8_t>(evaluation.best_block.tetromino);
+      slot.block_rotation = static_cast<std::uint8_t>(evaluation.best_block.rotation);
+      __atomic_store_n(&slot.state, SLOT_READY, __ATOMIC_RELEASE);
+      __atomic_fetch_add(&cache.header->entries, 1, __ATOMIC_RELAXED);
+      return true;
+    }
+    // Taken, or lost the race for it, so state is now the slot's current
+    // one. Two processes inserting the same key at once may both succeed
+    // in different slots, which wastes a slot but is otherwise harmless.
+    if (state == SLOT_READY && matches(slot, key)) {
+      return false;
+    }
+  }
+  return false;
+}
+
+std::uint64_t cache_entry_count(const EvaluationCache &cache) {
+  return __atomic_load_n(&cache.header->entries, __ATOMIC_RELAXED);
+}
+
+std::uint64_t cache_slot_count(const EvaluationCache &cache) {
+  return cache.slot_mask + 1;
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "state.h"
+
+// A persistent cache of bot decisions, shared by every process that maps
+// the same file.
+//
+// The file is a fixed-size open-addressing hash table with linear
+// probing. A key is the field and active block, through hash_field and
+// hash_active_block, plus a context the caller chooses (the bot uses its
+// weights), checked against a second, independent hash of the cells.
+// Each slot has a state word that goes from EMPTY to WRITING by
+// compare-and-swap and to READY once the entry is written, so processes
+// insert concurrently without locks and readers only see finished
+// entries. Entries are never removed; a full table stops accepting them.
+
+struct CacheKey {
+  std::uint64_t hash;  // chooses the slot
+  std::uint64_t check; // confirms the match
+};
+
+struct CachedEvaluation {
+  double score;
+  ActiveBlock best_block; // where the active block should lock
+};
+
+struct CacheHeader;
+struct CacheSlot;
+
+struct EvaluationCache {
+  int fd;
+  std::size_t mapping_size;
+  CacheHeader *header;
+  CacheSlot *slots;
+  std::uint64_t slot_mask;
+};
+
+// Opens the cache at path, creating it with slot_count slots (rounded up
+// to a power of two) if it does not exist yet. An existing file keeps its
+// own size. Returns false if the file cannot be opened, mapped, or is not
+// a cache.
+bool open_evaluation_cache(const std::string &path,
+                           std::size_t slot_count,
+                           EvaluationCache &cache);
+void close_evaluation_cache(EvaluationCache &cache);
+
+CacheKey make_cache_key(const Field &field,
+                        const ActiveBlock &active_block,
+                        std::uint64_t context);
+
+// An entry whose block is not a block is a miss.
+bool cache_lookup(const EvaluationCache &cache,
+                  const CacheKey &key,
+                  CachedEvaluation &evaluation);
+
+// Returns false if the key is already present or no free slot was found
+// within the probe limit.
+bool cache_insert(EvaluationCache &cache,
+                  const CacheKey &key,
+                  const CachedEvaluation &evaluation);
+
+// Entries inserted by every process since the file was created.
+std::uint64_t cache_entry_count(const EvaluationCache &cache);
+std::uint64_t cache_slot_count(const EvaluationCache &cache);
@@ -0,0 +1,168 @@
+#pragma once
+
+// The feature kernel shared by evaluation.cpp, evaluation_sse.cpp and
+// evaluation_avx2.cpp. Each includes this with its own Ops, a set of lane
+// operations over Ops::LANES packed rows, and is compiled for its own
+// instruction set, so everything here has internal linkage.
+//
+// Ops::count_bytes returns popcounts per byte, which the kernel sums for
+// BYTE_COUNT_ROWS rows at a time before Ops::widen adds the bytes of each
+// lane into one 32 bit count.
+
+#include <cstdint>
+
+#include "evaluation.h"
+
+// Defined in evaluation_sse.cpp and evaluation_avx2.cpp. Each reports
+// false when the processor, or the compiler, lacks its instruction set.
+bool ssse3_kernel_available();
+void evaluate_batch_ssse3(const FieldBatch &batch, BoardFeatures *features);
+bool avx2_kernel_available();
+void evaluate_batch_avx2(const FieldBatch &batch, BoardFeatures *features);
+
+namespace {
+
+const int BYTE_COUNT_ROWS = 15; // row transitions add up to 16 per byte per row
+const int WELL_COUNTER_BITS = 7; // well depths up to EVALUATION_MAX_HEIGHT
+
+enum KernelCount {
+  COUNT_HOLES,
+  COUNT_AGGREGATE_HEIGHT,
+  COUNT_BUMPINESS,
+  COUNT_ROW_TRANSITIONS,
+  COUNT_COLUMN_TRANSITIONS,
+  COUNT_WELL_BITS, // one count per bit of the well depth counters
+  KERNEL_COUNTS = COUNT_WELL_BITS + WELL_COUNTER_BITS
+};
+
+inline std::uint32_t full_row_mask(int width) {
+  return width >= 32 ? 0xFFFFFFFFu : (1u << width) - 1;
+}
+
+inline int well_counter_bits(int height) {
+  int bits = 1;
+  while (bits < WELL_COUNTER_BITS && (1 << bits) <= height) {
+    bits++;
+  }
+  return bits;
+}
+
+// Evaluates the Ops::LANES fields whose bottom rows start at rows, with
+// each row stride words above the last, writing their features to out.
+template <typename Ops>
+void evaluate_lanes(const std::uint32_t *rows,
+                    int stride,
+                    int width,
+                    int height,
+                    BoardFeatures *out) {
+  typedef typename Ops::V V;
+  const std::uint32_t full_mask = full_row_mask(width);
+  const V full = Ops::set1(full_mask);
+  const V adjacent = Ops::set1(full_mask >> 1); // columns with a right neighbour
+  const V left_wall = Ops::set1(1);
+  const V right_wall = Ops::set1(1u << (width - 1));
+  const int well_bits = well_counter_bits(height);
+
+  V totals[KERNEL_COUNTS];
+  V bytes[KERNEL_COUNTS];
+  for (int i = 0; i < KERNEL_COUNTS; i++) {
+    totals[i] = Ops::zero();
+    bytes[i] = Ops::zero();
+  }
+
+  // Walks down from the top, so that covered holds the union of the rows
+  // above and wells grow downwards.
+  V covered = Ops::zero();
+  V upper = Ops::load(rows + (height - 1) * stride);
+  V well_depth[WELL_COUNTER_BITS];
+  for (int bit = 0; bit < well_bits; bit++) {
+    well_depth[bit] = Ops::zero();
+  }
+  int rows_in_bytes = 0;
+  for (int y = height - 1; y >= 0; y--) {
+    V row = Ops::load(rows + y * stride);
+
+    V holes = Ops::andnot(row, covered);
+    covered = Ops::bit_or(covered, row);
+    V steps = Ops::bit_and(Ops::bit_xor(covered, Ops::shr1(covered)), adjacent);
+    V inner_changes = Ops::bit_and(Ops::bit_xor(row, Ops::shr1(row)), adjacent);
+    V wall_changes = Ops::andnot(row, Ops::bit_or(left_wall, right_wall));
+    V vertical_changes = Ops::bit_xor(row, upper);
+    upper = row;
+
+    bytes[COUNT_HOLES] = Ops::add_bytes(bytes[COUNT_HOLES], Ops::count_bytes(holes));
+    bytes[COUNT_AGGREGATE_HEIGHT] =
+      Ops::add_bytes(bytes[COUNT_AGGREGATE_HEIGHT], Ops::count_bytes(covered));
+    bytes[COUNT_BUMPINESS] = Ops::add_bytes(bytes[COUNT_BUMPINESS], Ops::count_bytes(steps));
+    bytes[COUNT_ROW_TRANSITIONS] = Ops::add_bytes(
+      bytes[COUNT_ROW_TRANSITIONS],
+      Ops::add_bytes(Ops::count_bytes(inner_changes), Ops::count_bytes(wall_changes)));
+    bytes[COUNT_COLUMN_TRANSITIONS] =
+      Ops::add_bytes(bytes[COUNT_COLUMN_TRANSITIONS], Ops::count_bytes(vertical_changes));
+
+    // A well cell is empty with both neighbours filled or a wall. Each
+    // column keeps a bit-sliced count of the well cells above it in an
+    // unbroken run, and every well cell adds its run length.
+    V well = Ops::bit_and(
+      Ops::andnot(row, full),
+      Ops::bit_and(Ops::bit_or(Ops::shl1(row), left_wall),
+                   Ops::bit_or(Ops::shr1(row), right_wall)));
+    V carry = well;
+    for (int bit = 0; bit < well_bits; bit++) {
+      V next_carry = Ops::bit_and(well_depth[bit], carry);
+      well_depth[bit] = Ops::bit_and(Ops::bit_xor(well_depth[bit], carry), well);
+      carry = next_carry;
+      bytes[COUNT_WELL_BITS + bit] = Ops::add_bytes(bytes[COUNT_WELL_BITS + bit],
+                                                    Ops::count_bytes(well_depth[bit]));
+    }
+
+    if (++rows_in_bytes == BYTE_COUNT_ROWS || y == 0) {
+      for (int i = 0; i < KERNEL_COUNTS; i++) {
+        totals[i] = Ops::add_lanes(totals[i], Ops::widen(bytes[i]));
+        bytes[i] = Ops::zero();
+      }
+      rows_in_bytes = 0;
+    }
+  }
+  // The floor counts as filled below the bottom row.
+  totals[COUNT_COLUMN_TRANSITIONS] = Ops::add_lanes(
+    totals[COUNT_COLUMN_TRANSITIONS],
+    Ops::widen(Ops::count_bytes(Ops::andnot(upper, full))));
+
+  std::uint32_t lanes[KERNEL_COUNTS][Ops::LANES];
+  for (int i = 0; i < KERNEL_COUNTS; i++) {
+    Ops::store(lanes[i], totals[i]);
+  }
+  for (int lane = 0; lane < Ops::LANES; lane++) {
+    BoardFeatures &features = out[lane];
+    features.holes = lanes[COUNT_HOLES][lane];
+    features.aggregate_height = lanes[COUNT_AGGREGATE_HEIGHT][lane];
+    features.bumpiness = lanes[COUNT_BUMPINESS][lane];
+    features.row_transitions = lanes[COUNT_ROW_TRANSITIONS][lane];
+    features.column_transitions = lanes[COUNT_COLUMN_TRANSITIONS][lane];
+    features.wells = 0;
+    for (int bit = 0; bit < well_bits; bit++) {
+      features.wells += lanes[COUNT_WELL_BITS + bit][lane] << bit;
+    }
+  }
+}
+
+// Evaluates every field of the batch, one block of
+// EVALUATION_BLOCK_FIELDS at a time.
+template <typename Ops>
+void evaluate_batch(const FieldBatch &batch, BoardFeatures *features) {
+  const int block_size = batch.height * EVALUATION_BLOCK_FIELDS;
+  std::size_t blocks = (batch.count + EVALUATION_BLOCK_FIELDS - 1) / EVALUATION_BLOCK_FIELDS;
+  for (std::size_t block = 0; block < blocks; block++) {
+    const std::uint32_t *rows = batch.rows.data() + block * block_size;
+    for (int lane = 0; lane < EVALUATION_BLOCK_FIELDS; lane += Ops::LANES) {
+      evaluate_lanes<Ops>(rows + lane,
+                          EVALUATION_BLOCK_FIELDS,
+                          batch.width,
+                          batch.height,
+                          features + block * EVALUATION_BLOCK_FIELDS + lane);
+    }
+  }
+}
+
+}
@@ -0,0 +1,63 @@
+#include "evaluation_kernel.h"
+
+#if defined(__SSSE3__)
+
+#include <tmmintrin.h>
+
+namespace {
+
+struct Ssse3Ops {
+  typedef __m128i V;
+  static const int LANES = 4;
+
+  static V load(const std::uint32_t *p) {
+    return _mm_loadu_si128(reinterpret_cast<const __m128i *>(p));
+  }
+  static void store(std::uint32_t *p, V v) {
+    _mm_storeu_si128(reinterpret_cast<__m128i *>(p), v);
+  }
+  static V zero() { return _mm_setzero_si128(); }
+  static V set1(std::uint32_t x) { return _mm_set1_epi32(static_cast<int>(x)); }
+  static V bit_and(V a, V b) { return _mm_and_si128(a, b); }
+  static V bit_or(V a, V b) { return _mm_or_si128(a, b); }
+  static V bit_xor(V a, V b) { return _mm_xor_si128(a, b); }
+  static V andnot(V a, V b) { return _mm_andnot_si128(a, b); } // ~a & b
+  static V shl1(V a) { return _mm_slli_epi32(a, 1); }
+  static V shr1(V a) { return _mm_srli_epi32(a, 1); }
+  static V add_bytes(V a, V b) { return _mm_add_epi8(a, b); }
+  static V add_lanes(V a, V b) { return _mm_add_epi32(a, b); }
+
+  // Looks up the popcount of each nibble.
+  static V count_bytes(V v) {
+    const V table = _mm_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+    const V low_nibbles = _mm_set1_epi8(0x0F);
+    V low = _mm_and_si128(v, low_nibbles);
+    V high = _mm_and_si128(_mm_srli_epi16(v, 4), low_nibbles);
+    return _mm_add_epi8(_mm_shuffle_epi8(table, low), _mm_shuffle_epi8(table, high));
+  }
+  static V widen(V bytes) {
+    V pairs = _mm_maddubs_epi16(bytes, _mm_set1_epi8(1));
+    return _mm_madd_epi16(pairs, _mm_set1_epi16(1));
+  }
+};
+
+}
+
+bool ssse3_kernel_available() {
+  return __builtin_cpu_supports("ssse3");
+}
+
+void evaluate_batch_ssse3(const FieldBatch &batch, BoardFeatures *features) {
+  evaluate_batch<Ssse3Ops>(batch, features);
+}
+
+#else
+
+bool ssse3_kernel_available() {
+  return false;
+}
+
+void evaluate_batch_ssse3(const FieldBatch &, BoardFeatures *) {
+}
+
+#endif
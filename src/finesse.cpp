@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <cstdlib>
+
+#include "finesse.h"
+#include "placements.h"
+
+const int ROTATION_COUNT = 4;
+
+struct FinesseTable {
+  FinesseRotation entries[TETROMINO_COUNT][ROTATION_COUNT][ROTATION_COUNT];
+};
+
+static FinesseTable build_finesse_table() {
+  FinesseTable table;
+  for (int tetromino = 0; tetromino < TETROMINO_COUNT; tetromino++) {
+    for (int from = 0; from < ROTATION_COUNT; from++) {
+      for (int to = 0; to < ROTATION_COUNT; to++) {
+        const Shape &target = get_shape(static_cast<Tetromino>(tetromino),
+                                        static_cast<Rotation>(to));
+        FinesseRotation best = {static_cast<Rotation>(to), Action::NO_ACTION, ROTATION_COUNT};
+        for (int rotation = 0; rotation < ROTATION_COUNT; rotation++) {
+          if (get_shape(static_cast<Tetromino>(tetromino), static_cast<Rotation>(rotation)) != target) {
+            continue;
+          }
+          // Three clockwise turns are one counterclockwise.
+          int turns = (rotation - from + ROTATION_COUNT) % ROTATION_COUNT;
+          int rotations = turns == 3 ? 1 : turns;
+          if (rotations < best.rotations) {
+            best = {
+              static_cast<Rotation>(rotation),
+              turns == 0 ? Action::NO_ACTION :
+              turns == 3 ? Action::ROTATE_COUNTERCLOCKWISE : Action::ROTATE_CLOCKWISE,
+              rotations
+            };
+          }
+        }
+        table.entries[tetromino][from][to] = best;
+      }
+    }
+  }
+  return table;
+}
+
+const FinesseRotation &finesse_rotation(Tetromino tetromino, Rotation from, Rotation to) {
+  static const FinesseTable table = build_finesse_table();
+  return table.entries[static_cast<int>(tetromino)][static_cast<int>(from)][static_cast<int>(to)];
+}
+
+bool same_cells(const ActiveBlock &lhs, const ActiveBlock &rhs) {
+  return lhs.position_x == rhs.position_x &&
+         lhs.position_y == rhs.position_y &&
+         lhs.tetromino == rhs.tetromino &&
+         finesse_rotation(lhs.tetromino, rhs.rotation, lhs.rotation).rotations == 0;
+}
+
+int finesse_input_count(const ActiveBlock &from, const ActiveBlock &to) {
+  return finesse_rotation(from.tetromino, from.rotation, to.rotation).rotations +
+         std::abs(to.position_x - from.position_x);
+}
+
+static void append_rotations(const FinesseRotation &rotation, std::vector<Action> &actions) {
+  actions.insert(actions.end(), rotation.rotations, rotation.rotate);
+}
+
+static void append_shifts(const ActiveBlock &from, const ActiveBlock &to, std::vector<Action> &actions) {
+  int shift = to.position_x - from.position_x;
+  actions.insert(actions.end(), std::abs(shift), shift < 0 ? Action::MOVE_LEFT : Action::MOVE_RIGHT);
+}
+
+static void append_drops(const ActiveBlock &from, const ActiveBlock &to, std::vector<Action> &actions) {
+  if (from.position_y > to.position_y) {
+    actions.insert(actions.end(), from.position_y - to.position_y, Action::MOVE_DOWN);
+  }
+  actions.push_back(Action::MOVE_DOWN); // locks
+}
+
+std::vector<Action> finesse_actions(const ActiveBlock &from, const ActiveBlock &to) {
+  std::vector<Action> actions;
+  append_rotations(finesse_rotation(from.tetromino, from.rotation, to.rotation), actions);
+  append_shifts(from, to, actions);
+  append_drops(from, to, actions);
+  return actions;
+}
+
+// Whether actions take the block from start to rest on target's cells.
+static bool follows(const Field &field,
+                    ActiveBlock block,
+                    const ActiveBlock &target,
+                    const std::vector<Action> &actions) {
+  for (std::size_t i = 0; i + 1 < actions.size(); i++) {
+    block = apply_to_block(block, actions[i]);
+    if (!is_legal_position(field, block)) {
+      return false;
+    }
+  }
+  return same_cells(block, target);
+}
+
+struct PathNode {
+  ActiveBlock block;
+  int parent; // index into the search order, -1 for the start
+  Action action;
+};
+
+const Action PATH_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::ROTATE_CLOCKWISE,
+  Action::ROTATE_COUNTERCLOCKWISE,
+  Action::MOVE_DOWN
+};
+
+// Breadth-first search over block positions, as in find_placements, but
+// stopping as soon as it reaches the target.
+static bool search_path(const Field &field,
+                        const ActiveBlock &start,
+                        const ActiveBlock &target,
+                        std::vector<Action> &actions) {
+  std::vector<bool> visited(field.width * field.height * ROTATION_COUNT, false);
+  auto index = [&](const ActiveBlock &block) {
+    return (block.position_y * field.width + block.position_x) * ROTATION_COUNT
+         + static_cast<int>(block.rotation);
+  };
+  std::vector<PathNode> nodes(1, {start, -1, Action::NO_ACTION});
+  visited[index(start)] = true;
+  for (std::size_t current = 0; current < nodes.size(); current++) {
+    if (same_cells(nodes[current].block, target)) {
+      actions.assign(1, Action::MOVE_DOWN);
+      for (int node = current; nodes[node].parent >= 0; node = nodes[node].parent) {
+        actions.push_back(nodes[node].action);
+      }
+      std::reverse(actions.begin(), actions.end());
+      return true;
+    }
+    for (Action action : PATH_ACTIONS) {
+      ActiveBlock next = apply_to_block(nodes[current].block, action);
+      if (is_legal_position(field, next) && !visited[index(next)]) {
+        visited[index(next)] = true;
+        nodes.push_back({next, static_cast<int>(current), action});
+      }
+    }
+  }
+  return false;
+}
+
+bool find_placement_inputs(const GameState &state,
+                           const ActiveBlock &target,
+                           std::vector<Action> &actions) {
+  const Field &field = state.field;
+  const ActiveBlock &start = state.active_block;
+  if (state.progress == GameProgress::GAME_OVER ||
+      target.tetromino != start.tetromino ||
+      !is_legal_position(field, start) ||
+      !is_legal_position(field, target) ||
+      is_legal_position(field, apply_to_block(target, Action::MOVE_DOWN))) {
+    return false;
+  }
+
+  // Any route that only rotates, shifts and drops is as short as any
+  // other, so try rotating first, then shifting first, before searching.
+  const FinesseRotation &rotation = finesse_rotation(start.tetromino, start.rotation, target.rotation);
+  actions.clear();
+  append_rotations(rotation, actions);
+  append_shifts(start, target, actions);
+  append_drops(start, target, actions);
+  if (follows(field, start, target, actions)) {
+    return true;
+  }
+  actions.clear();
+  append_shifts(start, target, actions);
+  append_rotations(rotation, actions);
+  append_drops(start, target, actions);
+  if (follows(field, start, target, actions)) {
+    return true;
+  }
+  return search_path(field, start, target, actions);
+}
@@ -0,0 +1,44 @@
+#pragma once
+
+#include <vector>
+
+#include "state.h"
+
+// The fewest keypresses that take a block to a placement.
+//
+// Rotating never moves a block, so on an open field the fewest inputs are
+// the rotations, then the shifts, then MOVE_DOWN until the block locks.
+// The table below gives the rotations: for each tetromino, current
+// rotation and target rotation, the closest rotation with the same cells
+// (an I or an O has fewer shapes than rotations) and how to get there.
+// The shifts and drops follow from the positions. Placements the direct
+// route cannot reach, because something is in the way or the block has
+// to tuck under an overhang, fall back to a search that stops at the
+// target.
+
+struct FinesseRotation {
+  Rotation rotation; // same cells as the target, fewest rotations away
+  Action rotate;     // NO_ACTION if none are needed
+  int rotations;
+};
+
+// Built once, from the block shapes, on first use.
+const FinesseRotation &finesse_rotation(Tetromino tetromino, Rotation from, Rotation to);
+
+// Whether the blocks cover the same cells.
+bool same_cells(const ActiveBlock &lhs, const ActiveBlock &rhs);
+
+// Rotations and shifts from one block to the other on an open field, not
+// counting drops.
+int finesse_input_count(const ActiveBlock &from, const ActiveBlock &to);
+
+// The open-field inputs from one block to the other, ending with the
+// MOVE_DOWN that locks it, without checking them against any field.
+std::vector<Action> finesse_actions(const ActiveBlock &from, const ActiveBlock &to);
+
+// The fewest inputs taking the active block to rest where target is,
+// ending with the MOVE_DOWN that locks it. Returns false if target is not
+// a resting position or cannot be reached.
+bool find_placement_inputs(const GameState &state,
+                           const ActiveBlock &target,
+                           std::vector<Action> &actions);
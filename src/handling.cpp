@@ -0,0 +1,231 @@
+#include <algorithm>
+#include <utility>
+
+#include "handling.h"
+
+HandlingController new_handling_controller(const HandlingSettings &settings,
+                                           GameState game,
+                                           std::uint64_t now) {
+  std::uint64_t next_fall = now + game.milliseconds_per_turn * 1000ull;
+  return {
+    settings,
+    std::move(game),
+    now,
+    {},
+    0,
+    false,
+    NO_DEADLINE,
+    NO_DEADLINE,
+    next_fall,
+    false,
+    NO_DEADLINE,
+    0
+  };
+}
+
+static bool can_move(const GameState &game, int dx, int dy) {
+  ActiveBlock moved = game.active_block;
+  moved.position_x += dx;
+  moved.position_y += dy;
+  return is_legal_position(game.field, moved);
+}
+
+// Starts or restarts the lock delay when the block lands or moves on the
+// ground. Restarts are limited to LOCK_DELAY_RESETS per block; a block
+// that lands again after that locks at once.
+static void track_landing(HandlingController &controller, bool moved, std::uint64_t now) {
+  if (controller.settings.lock_delay == 0) {
+    return; // gravity locks
+  }
+  bool grounded = !can_move(controller.game, 0, -1);
+  if (grounded && (!controller.landed || moved)) {
+    if (controller.lock_at == NO_DEADLINE) {
+      controller.lock_at = now + controller.settings.lock_delay;
+    } else if (controller.lock_resets < LOCK_DELAY_RESETS) {
+      controller.lock_resets++;
+      controller.lock_at = now + controller.settings.lock_delay;
+    }
+  }
+  controller.landed = grounded;
+}
+
+// Applies action, returning whether it changed the game.
+static bool take_action(HandlingController &controller,
+                        Action action,
+                        RNG::result_type seed,
+                        std::uint64_t now,
+                        std::vector<TimedAction> &actions) {
+  GameState &game = controller.game;
+  bool spawned;
+  bool moved;
+  if (action == Action::NEW_GAME) {
+    game = new_game(game.field.width, game.field.height, seed);
+    spawned = true;
+    moved = true;
+  } else {
+    if (game.progress == GameProgress::GAME_OVER) {
+      return false;
+    }
+    ActiveBlock before = game.active_block;
+    unsigned long long position = game.rng.position();
+    game = reduce(std::move(game), action);
+    spawned = game.rng.position() != position;
+    moved = spawned || !(game.active_block == before);
+    if (!moved) {
+      return false;
+    }
+  }
+  actions.push_back({now, action, action == Action::NEW_GAME ? seed : 0});
+
+  // A manual drop or a new game restarts gravity.
+  if (action == Action::NEW_GAME || action == Action::MOVE_DOWN) {
+    controller.next_fall = now + game.milliseconds_per_turn * 1000ull;
+  }
+  if (spawned) {
+    controller.landed = false;
+    controller.lock_at = NO_DEADLINE;
+    controller.lock_resets = 0;
+  }
+  track_landing(controller, moved, now);
+
+  // A held key that was blocked may be free to go again.
+  if (controller.shift != 0 && controller.shift_charged &&
+      controller.next_shift == NO_DEADLINE) {
+    controller.next_shift = now;
+  }
+  if (controller.held[static_cast<int>(InputKey::SOFT_DROP)] &&
+      controller.next_drop == NO_DEADLINE) {
+    controller.next_drop = now + controller.settings.soft_drop;
+  }
+  return true;
+}
+
+void apply_handling_action(HandlingController &controller,
+                           Action action,
+                           std::uint64_t now,
+                           std::vector<TimedAction> &actions) {
+  if (action == Action::NEW_GAME || action == Action::QUIT || action == Action::NO_ACTION) {
+    return;
+  }
+  now = std::max(now, controller.now);
+  advance_handling(controller, now, actions);
+  take_action(controller, action, 0, now, actions);
+}
+
+static Action shift_action(int direction) {
+  return direction < 0 ? Action::MOVE_LEFT : Action::MOVE_RIGHT;
+}
+
+static void start_shift(HandlingController &controller, int direction, std::uint64_t now) {
+  controller.shift = direction;
+  controller.shift_charged = false;
+  controller.next_shift = now + controller.settings.das;
+}
+
+void apply_input_event(HandlingController &controller,
+                       const InputEvent &event,
+                       std::vector<TimedAction> &actions) {
+  std::uint64_t now = std::max(event.microseconds, controller.now);
+  advance_handling(controller, now, actions);
+  if (event.key == InputKey::NEW_GAME) {
+    if (event.pressed) {
+      take_action(controller, Action::NEW_GAME, event.seed, now, actions);
+    }
+    return;
+  }
+  bool &held = controller.held[static_cast<int>(event.key)];
+  if (held == event.pressed) {
+    return;
+  }
+  held = event.pressed;
+
+  switch (event.key) {
+  case InputKey::LEFT:
+  case InputKey::RIGHT: {
+    int direction = event.key == InputKey::LEFT ? -1 : 1;
+    InputKey other = event.key == InputKey::LEFT ? InputKey::RIGHT : InputKey::LEFT;
+    if (event.pressed) {
+      // The last direction pressed wins, charging its DAS from scratch.
+      start_shift(controller, direction, now);
+      take_action(controller, shift_action(direction), 0, now, actions);
+    } else if (controller.shift == direction) {
+      if (controller.held[static_cast<int>(other)]) {
+        start_shift(controller, -direction, now);
+      } else {
+        controller.shift = 0;
+        controller.next_shift = NO_DEADLINE;
+      }
+    }
+    break;
+  }
+  case InputKey::SOFT_DROP:
+    if (event.pressed) {
+      // A press on the ground locks, as a key press always has.
+      take_action(controller, Action::MOVE_DOWN, 0, now, actions);
+      controller.next_drop = now + controller.settings.soft_drop;
+    } else {
+      controller.next_drop = NO_DEADLINE;
+    }
+    break;
+  case InputKey::ROTATE_CLOCKWISE:
+    if (event.pressed) {
+      take_action(controller, Action::ROTATE_CLOCKWISE, 0, now, actions);
+    }
+    break;
+  case InputKey::ROTATE_COUNTERCLOCKWISE:
+    if (event.pressed) {
+      take_action(controller, Action::ROTATE_COUNTERCLOCKWISE, 0, now, actions);
+    }
+    break;
+  default:
+    break;
+  }
+}
+
+std::uint64_t next_handling_deadline(const HandlingController &controller) {
+  if (controller.game.progress == GameProgress::GAME_OVER) {
+    return NO_DEADLINE;
+  }
+  std::uint64_t due = std::min(std::min(controller.next_shift, controller.next_drop),
+                               controller.next_fall);
+  if (controller.landed) {
+    due = std::min(due, controller.lock_at);
+  }
+  return due;
+}
+
+void advance_handling(HandlingController &controller,
+                      std::uint64_t until,
+                      std::vector<TimedAction> &actions) {
+  std::uint64_t due;
+  while ((due = next_handling_deadline(controller)) <= until) {
+    // Only a block that lands again after its last reset is overdue.
+    std::uint64_t now = std::max(controller.now, due);
+    controller.now = now;
+    const HandlingSettings &settings = controller.settings;
+    if (due == controller.next_shift) {
+      // A blocked shift waits for the block to change rather than
+      // retrying every repeat.
+      controller.shift_charged = true;
+      controller.next_shift = NO_DEADLINE;
+      if (take_action(controller, shift_action(controller.shift), 0, now, actions)) {
+        controller.next_shift = now + settings.arr;
+      }
+    } else if (due == controller.next_drop) {
+      controller.next_drop = NO_DEADLINE;
+      if (can_move(controller.game, 0, -1)) {
+        take_action(controller, Action::MOVE_DOWN, 0, now, actions);
+        controller.next_drop = now + settings.soft_drop;
+      }
+    } else if (due == controller.next_fall) {
+      controller.next_fall = now + controller.game.milliseconds_per_turn * 1000ull;
+      if (!controller.landed) {
+        take_action(controller, Action::TIME_FALL, 0, now, actions);
+      }
+    } else {
+      // The lock delay ran out; the block cannot fall, so this locks it.
+      take_action(controller, Action::TIME_FALL, 0, now, actions);
+    }
+  }
+  controller.now = std::max(controller.now, until);
+}
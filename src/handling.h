@@ -0,0 +1,109 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "state.h"
+
+// Turns held keys into actions on a microsecond clock: delayed auto shift
+// (DAS) and auto-repeat rate (ARR) for sideways movement, a repeat rate
+// for soft drop, gravity and a lock delay.
+//
+// A HandlingController owns a game and is driven by two calls: one for
+// each key press or release, stamped with when it happened, and one to
+// catch up to a time. Every repeat, fall and lock is scheduled from the
+// time of the press or the previous deadline, never from when the caller
+// happened to look, so the actions and their times depend only on the
+// input events. Calling advance_handling once per event or once per
+// microsecond gives the same game, and a log of input events plays back
+// headlessly to exactly what was on screen.
+//
+// The output is ordinary actions, each stamped with its time, so it can
+// be recorded as a replay. A lock after the lock delay is a TIME_FALL of
+// a block that cannot fall.
+
+enum class InputKey {
+  LEFT,
+  RIGHT,
+  SOFT_DROP,
+  ROTATE_CLOCKWISE,
+  ROTATE_COUNTERCLOCKWISE,
+  NEW_GAME
+};
+const int INPUT_KEY_COUNT = 6;
+
+struct InputEvent {
+  std::uint64_t microseconds;
+  InputKey key;
+  bool pressed;          // false for a release
+  RNG::result_type seed; // pressing NEW_GAME deals from this
+};
+
+struct TimedAction {
+  std::uint64_t microseconds;
+  Action action;
+  RNG::result_type seed; // NEW_GAME only
+};
+
+// All times in microseconds.
+struct HandlingSettings {
+  std::uint64_t das;        // a shift key is held this long before it repeats
+  std::uint64_t arr;        // between repeats; 0 shifts to the wall at once
+  std::uint64_t soft_drop;  // between moves down while soft drop is held
+  std::uint64_t lock_delay; // a landed block may still move this long;
+                            // 0 locks when gravity next pulls it
+};
+
+const HandlingSettings DEFAULT_HANDLING = {167000, 33000, 50000, 500000};
+
+// Moving or rotating a landed block restarts its lock delay at most this
+// many times, so it cannot be kept from locking forever.
+const int LOCK_DELAY_RESETS = 15;
+
+const std::uint64_t NO_DEADLINE = UINT64_MAX;
+
+struct HandlingController {
+  HandlingSettings settings;
+  GameState game;
+  std::uint64_t now;            // everything before this has been applied
+  bool held[INPUT_KEY_COUNT];
+  int shift;                    // -1 left, 1 right, 0 none
+  bool shift_charged;           // the DAS has elapsed
+  std::uint64_t next_shift;     // NO_DEADLINE while blocked or not held
+  std::uint64_t next_drop;      // likewise, for soft drop
+  std::uint64_t next_fall;
+  bool landed;
+  std::uint64_t lock_at;
+  int lock_resets;
+};
+
+// Starts controlling game from the time now.
+HandlingController new_handling_controller(const HandlingSettings &settings,
+                                           GameState game,
+                                           std::uint64_t now);
+
+// Catches up to now, then applies action as the controller's own inputs
+// are, for callers that make their own moves, such as a bot.
+// Actions that change nothing are left out of actions, and NEW_GAME,
+// which needs a seed, is ignored; press NEW_GAME with an InputEvent.
+void apply_handling_action(HandlingController &controller,
+                           Action action,
+                           std::uint64_t now,
+                           std::vector<TimedAction> &actions);
+
+// Catches up to the event's time, then applies the press or release.
+// Events from before the controller's time are taken as happening at
+// its time, and repeated presses of a held key are ignored. NEW_GAME is
+// not held: every press starts a game dealt from the event's seed.
+void apply_input_event(HandlingController &controller,
+                       const InputEvent &event,
+                       std::vector<TimedAction> &actions);
+
+// Applies every repeat, fall and lock due up to and including until, in
+// time order, appending the actions the game took.
+void advance_handling(HandlingController &controller,
+                      std::uint64_t until,
+                      std::vector<TimedAction> &actions);
+
+// When something is next due, or NO_DEADLINE.
+std::uint64_t next_handling_deadline(const HandlingController &controller);
@@ -0,0 +1,255 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "session_protocol.h"
+#include "timer_wheel.h"
+
+// Opens many sessions against TetrisServer and plays random actions at a
+// fixed rate per session, measuring the time from sending each action to
+// receiving the status report that acknowledges it.
+
+const int MAX_EVENTS = 256;
+
+const Action PLAYABLE_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::MOVE_DOWN,
+  Action::ROTATE_CLOCKWISE,
+  Action::ROTATE_COUNTERCLOCKWISE
+};
+
+struct Client {
+  int fd; // -1 once the server has closed the session
+  std::uint32_t actions_sent;
+  std::deque<std::uint64_t> send_times; // microseconds, oldest first
+  std::vector<std::uint8_t> partial_report;
+  GameProgress progress;
+};
+
+std::uint64_t now_microseconds() {
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+int connect_unix(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  if (fd >= 0 &&
+      connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int connect_loopback(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (fd >= 0 &&
+      connect(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0) {
+    close(fd);
+    return -1;
+  }
+  int yes = 1;
+  setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+  return fd;
+}
+
+std::uint64_t percentile(const std::vector<std::uint64_t> &sorted, double fraction) {
+  if (sorted.empty()) {
+    return 0;
+  }
+  std::size_t index = static_cast<std::size_t>(fraction * (sorted.size() - 1));
+  return sorted[index];
+}
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--unix PATH | --port PORT] [--sessions N]\n"
+               "          [--rate ACTIONS_PER_SECOND] [--seconds S]\n",
+               program);
+}
+
+int main(int argc, char *argv[]) {
+  const char *unix_path = nullptr;
+  int port = 7777;
+  int session_count = 1000;
+  int rate = 10;
+  int seconds = 10;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--unix" && i + 1 < argc) {
+      unix_path = argv[++i];
+    } else if (arg == "--port" && i + 1 < argc) {
+      port = std::atoi(argv[++i]);
+    } else if (arg == "--sessions" && i + 1 < argc) {
+      session_count = std::atoi(argv[++i]);
+    } else if (arg == "--rate" && i + 1 < argc) {
+      rate = std::atoi(argv[++i]);
+    } else if (arg == "--seconds" && i + 1 < argc) {
+      seconds = std::atoi(argv[++i]);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (session_count <= 0 || rate <= 0 || seconds <= 0) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+  signal(SIGPIPE, SIG_IGN);
+
+  int epoll_fd = epoll_create1(0);
+  std::vector<Client> clients;
+  clients.reserve(session_count);
+  for (int id = 0; id < session_count; id++) {
+    int fd = unix_path ? connect_unix(unix_path) : connect_loopback(port);
+    if (fd < 0) {
+      std::fprintf(stderr, "Connection %d failed: %s\n", id, std::strerror(errno));
+      return 1;
+    }
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    clients.push_back({fd, 0, {}, {}, GameProgress::IN_PROGRESS});
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = id;
+    epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event);
+  }
+  std::fprintf(stderr, "Connected %d sessions\n", session_count);
+
+  // Send times are spread across the interval so the server sees a
+  // steady load rather than synchronised bursts.
+  int interval_milliseconds = std::max(1, 1000 / rate);
+  std::uint64_t start = now_microseconds();
+  TimerWheel wheel = new_timer_wheel(1, 4096, start / 1000);
+  std::mt19937 rng(12345);
+  for (int id = 0; id < session_count; id++) {
+    schedule_timer(wheel, id, 0, start / 1000 + rng() % interval_milliseconds);
+  }
+
+  std::vector<std::uint64_t> latencies;
+  std::uint64_t reports_received = 0;
+  std::uint64_t send_failures = 0;
+  std::uint64_t disconnects = 0;
+  std::uint64_t end = start + static_cast<std::uint64_t>(seconds) * 1000000;
+  std::vector<TimerEntry> expired;
+  struct epoll_event events[MAX_EVENTS];
+  std::uint8_t buffer[4096];
+  while (now_microseconds() < end) {
+    int timeout = milliseconds_until_next_tick(wheel, now_microseconds() / 1000);
+    int ready = epoll_wait(epoll_fd, events, MAX_EVENTS, timeout);
+    for (int i = 0; i < ready; i++) {
+      Client &client = clients[events[i].data.u32];
+      ssize_t count = read(client.fd, buffer, sizeof(buffer));
+      if (count < 0 && (errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR)) {
+        continue;
+      }
+      if (count <= 0) {
+        // Closed or failed; epoll would report it ready forever.
+        epoll_ctl(epoll_fd, EPOLL_CTL_DEL, client.fd, nullptr);
+        close(client.fd);
+        client.fd = -1;
+        disconnects++;
+        continue;
+      }
+      std::uint64_t received = now_microseconds();
+      client.partial_report.insert(client.partial_report.end(), buffer, buffer + count);
+      std::size_t offset = 0;
+      while (client.partial_report.size() - offset >= STATUS_REPORT_SIZE) {
+        StatusReport report = decode_status_report(client.partial_report.data() + offset);
+        offset += STATUS_REPORT_SIZE;
+        reports_received++;
+        client.progress = report.progress;
+        std::uint32_t acknowledged = client.actions_sent - client.send_times.size();
+        while (acknowledged < report.actions_applied && !client.send_times.empty()) {
+          latencies.push_back(received - client.send_times.front());
+          client.send_times.pop_front();
+          acknowledged++;
+        }
+      }
+      client.partial_report.erase(client.partial_report.begin(),
+                                  client.partial_report.begin() + offset);
+    }
+
+    std::uint64_t now = now_microseconds();
+    expired.clear();
+    advance_timer_wheel(wheel, now / 1000, expired);
+    for (const TimerEntry &entry : expired) {
+      Client &client = clients[entry.id];
+      if (client.fd < 0) {
+        continue; // not rescheduled
+      }
+      Action action = client.progress == GameProgress::GAME_OVER ?
+        Action::NEW_GAME : PLAYABLE_ACTIONS[rng() % 5];
+      std::uint8_t byte = static_cast<std::uint8_t>(action);
+      if (send(client.fd, &byte, 1, MSG_NOSIGNAL) == 1) {
+        client.actions_sent++;
+        client.send_times.push_back(now);
+      } else {
+        send_failures++;
+      }
+      schedule_timer(wheel, entry.id, 0, now / 1000 + interval_milliseconds);
+    }
+  }
+
+  double elapsed = (now_microseconds() - start) / 1e6;
+  std::sort(latencies.begin(), latencies.end());
+  std::uint64_t outstanding = 0;
+  for (const Client &client : clients) {
+    outstanding += client.send_times.size();
+    if (client.fd >= 0) {
+      close(client.fd);
+    }
+  }
+  std::printf("sessions:          %d\n", session_count);
+  std::printf("actions acked:     %zu (%.0f/s)\n", latencies.size(), latencies.size() / elapsed);
+  std::printf("reports received:  %llu (%.0f/s)\n",
+              static_cast<unsigned long long>(reports_received), reports_received / elapsed);
+  std::printf("unacknowledged:    %llu\n", static_cast<unsigned long long>(outstanding));
+  std::printf("send failures:     %llu\n", static_cast<unsigned long long>(send_failures));
+  std::printf("disconnects:       %llu\n", static_cast<unsigned long long>(disconnects));
+  std::printf("latency p50:       %llu us\n",
+              static_cast<unsigned long long>(percentile(latencies, 0.50)));
+  std::printf("latency p99:       %llu us\n",
+              static_cast<unsigned long long>(percentile(latencies, 0.99)));
+  std::printf("latency p99.9:     %llu us\n",
+              static_cast<unsigned long long>(percentile(latencies, 0.999)));
+  std::printf("latency max:       %llu us\n",
+              static_cast<unsigned long long>(latencies.empty() ? 0 : latencies.back()));
+  close(epoll_fd);
+  return 0;
+}
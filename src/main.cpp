@@ -1,241 +1,116 @@
 #include <SDL2/SDL.h>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
 #include <iostream>
-
+#include <string>
+#include <utility>
+
+#include "client.h"
+#include "handling.h"
+#include "profiler.h"
+#include "replay.h"
+#include "shared_state.h"
 #include "state.h"
 
-Action handle_event(SDL_Event event) {
-  switch (event.type) {
-  case SDL_QUIT:
-    return Action::QUIT;
-  case SDL_KEYDOWN:
-    switch (event.key.keysym.sym) {
-    case SDLK_a:
-    case SDLK_LEFT:
-      return Action::MOVE_LEFT;
-    case SDLK_d:
-    case SDLK_RIGHT:
-      return Action::MOVE_RIGHT;
-    case SDLK_s:
-    case SDLK_DOWN:
-      return Action::MOVE_DOWN;
-    case SDLK_q:
-    case SDLK_PAGEUP:
-      return Action::ROTATE_COUNTERCLOCKWISE;
-    case SDLK_e:
-    case SDLK_PAGEDOWN:
-      return Action::ROTATE_CLOCKWISE;
-    case SDLK_ESCAPE:
-      return Action::QUIT;
-    case SDLK_n:
-      return Action::NEW_GAME;
-    default:
-      SDL_LogInfo(
-        SDL_LOG_CATEGORY_INPUT,
-        "Unrecognized key: %s\n",
-        SDL_GetKeyName(event.key.keysym.sym)
-      );
-      return Action::NO_ACTION;
-    }
-  case SDL_USEREVENT:
-    return Action::TIME_FALL;
-  }
-  return Action::NO_ACTION;
+void usage(const char *program) {
+  std::cerr << "Usage: " << program << " [--demo] [--record PATH] [--profile PATH]\n"
+            << "       " << program << "   [--das MS] [--arr MS] [--soft-drop MS] [--lock-delay MS]\n"
+            << "       " << program << " --replay PATH [--speed X] [--profile PATH]\n"
+            << "Both also take --publish NAME, which shares the live game with\n"
+            << "other local processes in the shared memory segment NAME.\n"
+            << "--demo lets the bot play, starting over after each game,\n"
+            << "until a game key is pressed.\n"
+            << "Handling, in milliseconds: --das (167) before a held shift\n"
+            << "repeats, --arr (33) between repeats, 0 shifting to the wall,\n"
+            << "--soft-drop (50) between moves down, --lock-delay (500) before\n"
+            << "a landed block locks, 0 leaving it to gravity.\n"
+            << "Replay keys: space pauses, up and down change speed (0.25x to\n"
+            << "1000x), left and right seek 5 s, page up and page down 60 s,\n"
+            << "home restarts.\n"
+            << "--profile writes the profiling zones on exit, as folded stacks\n"
+            << "if PATH ends in .folded and as a Chrome trace otherwise; it needs\n"
+            << "a build with TETRIS_PROFILE.\n";
 }
 
-int calculate_cell_size(GameState state, int view_width, int view_height) {
-  int height_per_cell = view_height / state.field.height;
-  int width_per_cell = view_width / state.field.width;
-  if (height_per_cell > width_per_cell) {
-    return width_per_cell;
-  } else {
-    return height_per_cell;
+// Reads a time in milliseconds, fractions allowed, as microseconds.
+bool parse_handling_time(const char *text, std::uint64_t &microseconds) {
+  char *end;
+  double milliseconds = std::strtod(text, &end);
+  if (end == text || *end != '\0' || !(milliseconds >= 0 && milliseconds <= 60000)) {
+    return false;
   }
+  microseconds = static_cast<std::uint64_t>(milliseconds * 1000 + 0.5);
+  return true;
 }
 
-void render_field(SDL_Renderer *renderer, Field field, int cell_size) {
-  SDL_SetRenderDrawColor(renderer, 0xFF, 0xFF, 0xFF, 0xFF);
-  for (int field_y = 0; field_y < field.height; field_y++) {
-    for (int field_x = 0; field_x < field.width; field_x++) {
-      if (field.lines[field_y][field_x] == CellState::FILLED) {
-        SDL_Rect rect = {
-          cell_size * field_x,
-          cell_size * ((field.height - 1) - field_y),
-          cell_size,
-          cell_size
-        };
-        SDL_RenderFillRect(renderer, &rect);
-      }
+int main(int argc, char *argv[]) {
+  std::string record_path;
+  std::string replay_path;
+  std::string profile_path;
+  std::string publish_name;
+  double replay_speed = 1;
+  HandlingSettings handling = DEFAULT_HANDLING;
+  bool valid_handling = true;
+  bool demo = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--record" && i + 1 < argc) {
+      record_path = argv[++i];
+    } else if (arg == "--replay" && i + 1 < argc) {
+      replay_path = argv[++i];
+    } else if (arg == "--speed" && i + 1 < argc) {
+      replay_speed = std::atof(argv[++i]);
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profile_path = argv[++i];
+    } else if (arg == "--publish" && i + 1 < argc) {
+      publish_name = argv[++i];
+    } else if (arg == "--das" && i + 1 < argc) {
+      valid_handling = parse_handling_time(argv[++i], handling.das) && valid_handling;
+    } else if (arg == "--arr" && i + 1 < argc) {
+      valid_handling = parse_handling_time(argv[++i], handling.arr) && valid_handling;
+    } else if (arg == "--soft-drop" && i + 1 < argc) {
+      valid_handling = parse_handling_time(argv[++i], handling.soft_drop) && valid_handling;
+    } else if (arg == "--lock-delay" && i + 1 < argc) {
+      valid_handling = parse_handling_time(argv[++i], handling.lock_delay) && valid_handling;
+    } else if (arg == "--demo") {
+      demo = true;
+    } else {
+      usage(argv[0]);
+      return 1;
     }
   }
-}
-
-void render_active_block(SDL_Renderer *renderer,
-                         ActiveBlock active_block,
-                         int field_height,
-                         int cell_size) {
-  SDL_SetRenderDrawColor(renderer, 0, 0, 0xFF, 0xFF);
-  Shape shape = get_shape(active_block.tetromino, active_block.rotation);
-  for (int shape_y = 0; shape_y < MAX_TETROMINO_HEIGHT; shape_y++) {
-    for (int shape_x = 0; shape_x < MAX_TETROMINO_WIDTH; shape_x++) {
-      if (shape[shape_y][shape_x] == CellState::FILLED) {
-        int field_x = active_block.position_x + shape_x;
-        int field_y = active_block.position_y - shape_y;
-        SDL_Rect rect = {
-          cell_size * field_x,
-          cell_size * (field_height - 1 - field_y),
-          cell_size,
-          cell_size
-        };
-        SDL_RenderFillRect(renderer, &rect);
-      }
-    }
+  if (replay_speed < REPLAY_SPEEDS[0] || replay_speed > 1000 ||
+      (demo && !replay_path.empty()) || !valid_handling) {
+    usage(argv[0]);
+    return 1;
   }
-}
-
-void render_next_block(SDL_Renderer *renderer,
-                       SDL_Rect next_block_view,
-                       int cell_size,
-                       Tetromino next_block) {
-  SDL_RenderSetViewport(renderer, &next_block_view);
-  SDL_SetRenderDrawColor(renderer, 0x10, 0x10, 0x10, 0xFF);
-  SDL_RenderFillRect(renderer, NULL);
-
-  SDL_SetRenderDrawColor(renderer, 0, 0xFF, 0, 0xFF);
-  Shape shape = get_shape(next_block, Rotation::UNROTATED);
-  for (int shape_y = 0; shape_y < MAX_TETROMINO_HEIGHT; shape_y++) {
-    for (int shape_x = 0; shape_x < MAX_TETROMINO_WIDTH; shape_x++) {
-      if (shape[shape_y][shape_x] == CellState::FILLED) {
-        SDL_Rect rect = {
-          cell_size * shape_x,
-          cell_size * shape_y,
-          cell_size,
-          cell_size
-        };
-        SDL_RenderFillRect(renderer, &rect);
-      }
-    }
+  if (!profile_path.empty() && !PROFILING_ENABLED) {
+    std::cerr << "Built without TETRIS_PROFILE; the profile will be empty\n";
   }
-}
-
-void render(SDL_Renderer *renderer, GameState state) {
-  int width, height;
-  SDL_GetRendererOutputSize(renderer, &width, &height);
 
-  SDL_RenderSetViewport(renderer, NULL);
-  SDL_SetRenderDrawColor(renderer, 0x40, 0x40, 0x40, 0xFF);
-  SDL_RenderClear(renderer);
-
-  int cell_size = calculate_cell_size(state, width, height);
-  SDL_Rect field = {
-    (width - (cell_size * state.field.width)) / 2,
-    (height - (cell_size * state.field.height)) / 2,
-    cell_size * state.field.width,
-    cell_size * state.field.height
-  };
-  SDL_RenderSetViewport(renderer, &field);
-  SDL_SetRenderDrawColor(renderer, 0x10, 0x10, 0x10, 0xFF);
-  SDL_RenderFillRect(renderer, NULL);
-
-  render_field(renderer, state.field, cell_size);
-  render_active_block(renderer, state.active_block, state.field.height, cell_size);
-
-  SDL_Rect next_block = {
-    field.x + field.w + 10,
-    10,
-    cell_size * MAX_TETROMINO_WIDTH,
-    cell_size * MAX_TETROMINO_HEIGHT
-  };
-  render_next_block(renderer, next_block, cell_size, state.next_block);
-
-  SDL_RenderPresent(renderer);
-}
-
-Uint32 timer_callback(Uint32 interval, void *param) {
-  SDL_Event event;
-  SDL_zero(event);
-  event.type = SDL_USEREVENT;
-  SDL_PushEvent(&event);
-
-  return interval;
-}
-
-struct UIGameState {
-  GameState game_state;
-  SDL_TimerID timer_id;
-};
-
-UIGameState ui_reduce(UIGameState state, Action action) {
-  GameState new_game_state = reduce(state.game_state, action);
-  switch (action) {
-  case Action::NEW_GAME:
-  case Action::MOVE_DOWN:
-    SDL_RemoveTimer(state.timer_id);
-    return {
-      new_game_state,
-      SDL_AddTimer(
-        new_game_state.milliseconds_per_turn,
-        timer_callback,
-        nullptr
-      )
-    };
-  case Action::TIME_FALL:
-    if (state.game_state.milliseconds_per_turn !=
-        new_game_state.milliseconds_per_turn) {
-      SDL_RemoveTimer(state.timer_id);
-      return {
-        new_game_state,
-        SDL_AddTimer(
-          new_game_state.milliseconds_per_turn,
-          timer_callback,
-          nullptr
-        )
-      };
-    } else {
-      return {
-        new_game_state,
-        state.timer_id
-      };
+  Replay recording = {DEFAULT_WIDTH, DEFAULT_HEIGHT, {}};
+  ReplayPlayer player;
+  if (!replay_path.empty()) {
+    std::ifstream in(replay_path);
+    Replay replay;
+    if (!read_replay(in, replay)) {
+      std::cerr << "Unable to read replay " << replay_path << "\n";
+      return 1;
     }
-  default:
-    return {
-      new_game_state,
-      state.timer_id
-    };
+    player = new_replay_player(std::move(replay), 256);
   }
-}
 
-void game_loop(SDL_Renderer *renderer) {
-  UIGameState state = ui_reduce({
-      {},
-      0
-    },
-    Action::NEW_GAME
-  );
-
-  bool should_quit = false;
-  SDL_Event event;
-  while (should_quit == false) {
-    if (SDL_WaitEvent(&event) == 0) {
-      SDL_Log("Error waiting for event: %s\n", SDL_GetError());
-      should_quit = true;
-    }
-    Action action = handle_event(event);
-    if (action == Action::QUIT) {
-      should_quit = true;
+  StatePublisher publisher = {};
+  if (!publish_name.empty()) {
+    int width = replay_path.empty() ? DEFAULT_WIDTH : player.replay.width;
+    int height = replay_path.empty() ? DEFAULT_HEIGHT : player.replay.height;
+    if (!open_state_publisher(publish_name, width, height, publisher)) {
+      std::cerr << "Unable to publish to " << publish_name << "\n";
+      return 1;
     }
-    SDL_LogInfo(
-      SDL_LOG_CATEGORY_APPLICATION,
-      "Applying action: %s\n",
-      get_action_name(action)
-    );
-
-    state = ui_reduce(state, action);
-
-    render(renderer, state.game_state);
   }
-}
 
-int main(int argc, char *argv[]) {
   if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER) != 0) {
     SDL_Log("Unable to initialize SDL: %s\n", SDL_GetError());
     return 1;
@@ -260,7 +135,28 @@ int main(int argc, char *argv[]) {
     return 1;
   }
 
-  game_loop(renderer);
+  game_loop(
+    renderer,
+    record_path.empty() ? nullptr : &recording,
+    replay_path.empty() ? nullptr : &player,
+    replay_speed,
+    publish_name.empty() ? nullptr : &publisher,
+    handling,
+    demo,
+    nullptr
+  );
+  close_state_publisher(publisher);
+
+  if (!record_path.empty()) {
+    std::ofstream out(record_path);
+    write_replay(out, recording);
+    if (!out) {
+      SDL_Log("Unable to write replay %s\n", record_path.c_str());
+    }
+  }
+  if (!profile_path.empty() && !write_profile(profile_path)) {
+    SDL_Log("Unable to write profile %s\n", profile_path.c_str());
+  }
 
   SDL_DestroyWindow(window);
   SDL_Quit();
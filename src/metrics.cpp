@@ -0,0 +1,314 @@
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "allocation_counter.h"
+#include "metrics.h"
+
+static std::mutex &registry_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Shards are never freed, so counts from finished threads still add up.
+static std::vector<MetricsShard *> &registry() {
+  static std::vector<MetricsShard *> shards;
+  return shards;
+}
+
+static MetricsShard *new_shard() {
+  MetricsShard *shard = new MetricsShard();
+  shard->games_started = 0;
+  shard->games_finished = 0;
+  shard->lines_cleared = 0;
+  for (std::atomic<std::uint64_t> &count : shard->actions) {
+    count = 0;
+  }
+  shard->reduce_nanoseconds = 0;
+  shard->reduce_allocations = 0;
+  for (std::atomic<std::uint64_t> &count : shard->reduce_buckets) {
+    count = 0;
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  registry().push_back(shard);
+  return shard;
+}
+
+MetricsShard &metrics_shard() {
+  static thread_local MetricsShard *shard = new_shard();
+  return *shard;
+}
+
+// Only the owning thread writes a shard, so a plain load and store is
+// enough; readers see each counter whole.
+static void add(std::atomic<std::uint64_t> &counter, std::uint64_t amount) {
+  counter.store(counter.load(std::memory_order_relaxed) + amount,
+                std::memory_order_relaxed);
+}
+
+void record_game_started() {
+  add(metrics_shard().games_started, 1);
+}
+
+void record_step(Action action,
+                 int lines_cleared,
+                 bool game_finished,
+                 std::uint64_t nanoseconds,
+                 std::uint64_t allocations) {
+  MetricsShard &shard = metrics_shard();
+  int index = static_cast<int>(action);
+  if (index >= 0 && index < ACTION_COUNT) {
+    add(shard.actions[index], 1);
+  }
+  if (action == Action::NEW_GAME) {
+    add(shard.games_started, 1);
+  }
+  if (lines_cleared > 0) {
+    add(shard.lines_cleared, lines_cleared);
+  }
+  if (game_finished) {
+    add(shard.games_finished, 1);
+  }
+  add(shard.reduce_nanoseconds, nanoseconds);
+  add(shard.reduce_allocations, allocations);
+  int bucket = 0;
+  while (bucket < LATENCY_BUCKET_COUNT && nanoseconds > LATENCY_BUCKET_BOUNDS[bucket]) {
+    bucket++;
+  }
+  add(shard.reduce_buckets[bucket], 1);
+}
+
+GameState measured_reduce(GameState state, Action action) {
+  int lines_before = state.lines;
+  bool was_in_progress = state.progress == GameProgress::IN_PROGRESS;
+  AllocationCount allocations = thread_allocation_count();
+  auto start = std::chrono::steady_clock::now();
+  GameState after = reduce(std::move(state), action);
+  std::uint64_t nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - start).count();
+  bool new_game = action == Action::NEW_GAME;
+  record_step(action,
+              new_game ? 0 : after.lines - lines_before,
+              !new_game && was_in_progress && after.progress == GameProgress::GAME_OVER,
+              nanoseconds,
+              allocations_since(allocations).allocations);
+  return after;
+}
+
+MetricsSnapshot collect_metrics() {
+  MetricsSnapshot metrics;
+  std::memset(&metrics, 0, sizeof(metrics));
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for (const MetricsShard *shard : registry()) {
+    metrics.games_started += shard->games_started.load(std::memory_order_relaxed);
+    metrics.games_finished += shard->games_finished.load(std::memory_order_relaxed);
+    metrics.lines_cleared += shard->lines_cleared.load(std::memory_order_relaxed);
+    for (int i = 0; i < ACTION_COUNT; i++) {
+      metrics.actions[i] += shard->actions[i].load(std::memory_order_relaxed);
+    }
+    metrics.reduce_nanoseconds += shard->reduce_nanoseconds.load(std::memory_order_relaxed);
+    metrics.reduce_allocations += shard->reduce_allocations.load(std::memory_order_relaxed);
+    for (int i = 0; i <= LATENCY_BUCKET_COUNT; i++) {
+      std::uint64_t count = shard->reduce_buckets[i].load(std::memory_order_relaxed);
+      metrics.reduce_buckets[i] += count;
+      metrics.reduce_count += count;
+    }
+  }
+  return metrics;
+}
+
+double reduce_latency_quantile(const MetricsSnapshot &metrics, double quantile) {
+  if (metrics.reduce_count == 0) {
+    return 0;
+  }
+  double rank = quantile * metrics.reduce_count;
+  double below = 0;
+  for (int i = 0; i <= LATENCY_BUCKET_COUNT; i++) {
+    std::uint64_t count = metrics.reduce_buckets[i];
+    if (count > 0 && below + count >= rank) {
+      double lower = i == 0 ? 0 : LATENCY_BUCKET_BOUNDS[i - 1];
+      if (i == LATENCY_BUCKET_COUNT) {
+        return lower / 1e9; // no upper bound to interpolate towards
+      }
+      double upper = LATENCY_BUCKET_BOUNDS[i];
+      return (lower + (upper - lower) * (rank - below) / count) / 1e9;
+    }
+    below += count;
+  }
+  return LATENCY_BUCKET_BOUNDS[LATENCY_BUCKET_COUNT - 1] / 1e9;
+}
+
+static void append_metric(std::string &out,
+                          const char *name,
+                          const char *type,
+                          const char *help) {
+  out += "# HELP ";
+  out += name;
+  out += ' ';
+  out += help;
+  out += "\n# TYPE ";
+  out += name;
+  out += ' ';
+  out += type;
+  out += '\n';
+}
+
+static void append_sample(std::string &out,
+                          const char *name,
+                          const char *labels,
+                          double value) {
+  char line[256];
+  std::snprintf(line, sizeof(line), "%s%s %.17g\n", name, labels, value);
+  out += line;
+}
+
+std::string format_prometheus(const MetricsSnapshot &metrics) {
+  std::string out;
+  append_metric(out, "tetris_games_started_total", "counter", "Games started.");
+  append_sample(out, "tetris_games_started_total", "", metrics.games_started);
+  append_metric(out, "tetris_games_finished_total", "counter", "Games that ended in a game over.");
+  append_sample(out, "tetris_games_finished_total", "", metrics.games_finished);
+  append_metric(out, "tetris_game_over_ratio", "gauge",
+                "Games finished per game started.");
+  append_sample(out, "tetris_game_over_ratio", "",
+                metrics.games_started > 0
+                  ? static_cast<double>(metrics.games_finished) / metrics.games_started
+                  : 0);
+  append_metric(out, "tetris_lines_cleared_total", "counter", "Lines cleared.");
+  append_sample(out, "tetris_lines_cleared_total", "", metrics.lines_cleared);
+
+  append_metric(out, "tetris_actions_total", "counter", "Actions applied, by type.");
+  for (int i = 0; i < ACTION_COUNT; i++) {
+    char labels[64];
+    std::snprintf(labels, sizeof(labels), "{action=\"%s\"}",
+                  get_action_name(static_cast<Action>(i)));
+    append_sample(out, "tetris_actions_total", labels, metrics.actions[i]);
+  }
+
+  append_metric(out, "tetris_reduce_duration_seconds", "histogram",
+                "Time spent in reduce per action.");
+  std::uint64_t cumulative = 0;
+  for (int i = 0; i <= LATENCY_BUCKET_COUNT; i++) {
+    cumulative += metrics.reduce_buckets[i];
+    char labels[64];
+    if (i < LATENCY_BUCKET_COUNT) {
+      std::snprintf(labels, sizeof(labels), "{le=\"%g\"}", LATENCY_BUCKET_BOUNDS[i] / 1e9);
+    } else {
+      std::snprintf(labels, sizeof(labels), "{le=\"+Inf\"}");
+    }
+    append_sample(out, "tetris_reduce_duration_seconds_bucket", labels, cumulative);
+  }
+  append_sample(out, "tetris_reduce_duration_seconds_sum", "", metrics.reduce_nanoseconds / 1e9);
+  append_sample(out, "tetris_reduce_duration_seconds_count", "", metrics.reduce_count);
+  append_metric(out, "tetris_reduce_duration_p50_seconds", "gauge",
+                "Median reduce time, estimated from the histogram.");
+  append_sample(out, "tetris_reduce_duration_p50_seconds", "",
+                reduce_latency_quantile(metrics, 0.5));
+  append_metric(out, "tetris_reduce_duration_p99_seconds", "gauge",
+                "99th percentile reduce time, estimated from the histogram.");
+  append_sample(out, "tetris_reduce_duration_p99_seconds", "",
+                reduce_latency_quantile(metrics, 0.99));
+
+  append_metric(out, "tetris_reduce_allocations_total", "counter",
+                "Heap allocations made inside reduce.");
+  append_sample(out, "tetris_reduce_allocations_total", "", metrics.reduce_allocations);
+  append_metric(out, "tetris_reduce_allocations_per_step", "gauge",
+                "Heap allocations per reduce, on average.");
+  append_sample(out, "tetris_reduce_allocations_per_step", "",
+                metrics.reduce_count > 0
+                  ? static_cast<double>(metrics.reduce_allocations) / metrics.reduce_count
+                  : 0);
+  return out;
+}
+
+bool write_metrics_file(const std::string &path) {
+  std::string text = format_prometheus(collect_metrics());
+  std::string temporary = path + ".tmp";
+  std::FILE *file = std::fopen(temporary.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+  written = std::fclose(file) == 0 && written;
+  return written && std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+// Answers one scrape. The request itself is not parsed: every path gets
+// the metrics.
+static void serve_scrape(int fd) {
+  struct timeval timeout = {1, 0};
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+  std::string request;
+  char buffer[1024];
+  while (request.find("\r\n\r\n") == std::string::npos && request.size() < 8192) {
+    ssize_t count = read(fd, buffer, sizeof(buffer));
+    if (count <= 0) {
+      return;
+    }
+    request.append(buffer, count);
+  }
+
+  std::string body = format_prometheus(collect_metrics());
+  std::string response =
+    "HTTP/1.0 200 OK\r\n"
+    "Content-Type: text/plain; version=0.0.4\r\n"
+    "Content-Length: " + std::to_string(body.size()) + "\r\n"
+    "Connection: close\r\n\r\n" + body;
+  std::size_t sent = 0;
+  while (sent < response.size()) {
+    ssize_t count = send(fd, response.data() + sent, response.size() - sent, MSG_NOSIGNAL);
+    if (count <= 0) {
+      return;
+    }
+    sent += count;
+  }
+}
+
+bool start_metrics_endpoint(int port) {
+  int listen_fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (listen_fd < 0) {
+    return false;
+  }
+  int yes = 1;
+  setsockopt(listen_fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(listen_fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+      listen(listen_fd, 16) != 0) {
+    close(listen_fd);
+    return false;
+  }
+  std::thread([listen_fd]() {
+    while (true) {
+      int fd = accept(listen_fd, nullptr, nullptr);
+      if (fd >= 0) {
+        serve_scrape(fd);
+        close(fd);
+      }
+    }
+  }).detach();
+  return true;
+}
+
+void start_metrics_file_writer(const std::string &path, int interval_milliseconds) {
+  std::thread([path, interval_milliseconds]() {
+    while (true) {
+      write_metrics_file(path);
+      std::this_thread::sleep_for(std::chrono::milliseconds(interval_milliseconds));
+    }
+  }).detach();
+}
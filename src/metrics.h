@@ -0,0 +1,83 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+#include "state.h"
+
+// Process-wide game metrics in the Prometheus text exposition format.
+//
+// Every thread counts into its own shard, registered on first use and
+// kept for the life of the process, so updates are uncontended relaxed
+// stores and nothing is lost when a thread exits. Readers sum the shards
+// at any time from any thread. Timing and allocation counts come from
+// measured_reduce, which needs allocation_counter.cpp linked in.
+
+const int ACTION_COUNT = static_cast<int>(Action::ROTATE_COUNTERCLOCKWISE) + 1;
+
+// Upper bounds of the reduce latency buckets, in nanoseconds; a final
+// bucket takes everything slower.
+const int LATENCY_BUCKET_COUNT = 15;
+const std::uint64_t LATENCY_BUCKET_BOUNDS[LATENCY_BUCKET_COUNT] = {
+  100, 250, 500,
+  1000, 2500, 5000,
+  10000, 25000, 50000,
+  100000, 250000, 500000,
+  1000000, 2500000, 5000000
+};
+
+struct MetricsShard {
+  std::atomic<std::uint64_t> games_started;
+  std::atomic<std::uint64_t> games_finished;
+  std::atomic<std::uint64_t> lines_cleared;
+  std::atomic<std::uint64_t> actions[ACTION_COUNT];
+  std::atomic<std::uint64_t> reduce_nanoseconds;
+  std::atomic<std::uint64_t> reduce_allocations;
+  std::atomic<std::uint64_t> reduce_buckets[LATENCY_BUCKET_COUNT + 1];
+};
+
+struct MetricsSnapshot {
+  std::uint64_t games_started;
+  std::uint64_t games_finished;
+  std::uint64_t lines_cleared;
+  std::uint64_t actions[ACTION_COUNT];
+  std::uint64_t reduce_count;
+  std::uint64_t reduce_nanoseconds;
+  std::uint64_t reduce_allocations;
+  std::uint64_t reduce_buckets[LATENCY_BUCKET_COUNT + 1];
+};
+
+// The calling thread's shard.
+MetricsShard &metrics_shard();
+
+// A game started outside reduce, such as with new_game.
+void record_game_started();
+
+// Counts one step of reduce. A NEW_GAME step also counts a game started.
+void record_step(Action action,
+                 int lines_cleared,
+                 bool game_finished,
+                 std::uint64_t nanoseconds,
+                 std::uint64_t allocations);
+
+// reduce, timed and counted into the calling thread's shard.
+GameState measured_reduce(GameState state, Action action);
+
+MetricsSnapshot collect_metrics();
+
+// Estimates a quantile of reduce latency in seconds, interpolating within
+// the histogram bucket it falls in.
+double reduce_latency_quantile(const MetricsSnapshot &metrics, double quantile);
+
+std::string format_prometheus(const MetricsSnapshot &metrics);
+
+// Rewrites path with the current metrics, atomically by rename.
+bool write_metrics_file(const std::string &path);
+
+// Serves the metrics over HTTP on 127.0.0.1:port from a background
+// thread, for a Prometheus scraper. Returns false if the port is taken.
+bool start_metrics_endpoint(int port);
+
+// Rewrites path every interval_milliseconds from a background thread.
+void start_metrics_file_writer(const std::string &path, int interval_milliseconds);
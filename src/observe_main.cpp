@@ -0,0 +1,87 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "shared_state.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--interval MS] [--once] NAME\n"
+               "Prints the game published in the shared memory segment NAME\n"
+               "(by Tetris or TetrisServer with --publish) whenever it changes,\n"
+               "checking every MS milliseconds, or just once with --once.\n",
+               program);
+}
+
+void print_state(const GameState &state, std::uint64_t version) {
+  std::string text;
+  for (int y = state.field.height - 1; y >= 0; y--) {
+    text += '|';
+    for (int x = 0; x < state.field.width; x++) {
+      bool active = false;
+      int shape_x = x - state.active_block.position_x;
+      int shape_y = state.active_block.position_y - y;
+      if (shape_x >= 0 && shape_x < MAX_TETROMINO_WIDTH &&
+          shape_y >= 0 && shape_y < MAX_TETROMINO_HEIGHT) {
+        const Shape &shape = get_shape(state.active_block.tetromino, state.active_block.rotation);
+        active = shape[shape_y][shape_x] == CellState::FILLED;
+      }
+      text += active ? '@' : state.field.lines[y][x] == CellState::FILLED ? '#' : ' ';
+    }
+    text += "|\n";
+  }
+  std::printf("%s#%llu score %d, lines %d%s\n\n",
+              text.c_str(),
+              static_cast<unsigned long long>(version),
+              state.score,
+              state.lines,
+              state.progress == GameProgress::GAME_OVER ? ", game over" : "");
+  std::fflush(stdout);
+}
+
+int main(int argc, char *argv[]) {
+  int interval = 16;
+  bool once = false;
+  std::string name;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--interval" && i + 1 < argc) {
+      interval = std::atoi(argv[++i]);
+    } else if (arg == "--once") {
+      once = true;
+    } else if (arg.compare(0, 2, "--") != 0 && name.empty()) {
+      name = arg;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (name.empty() || interval < 1) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  StateObserver observer;
+  if (!open_state_observer(name, observer)) {
+    std::fprintf(stderr, "Nothing published as %s\n", name.c_str());
+    return 1;
+  }
+  GameState state;
+  std::uint64_t shown = 0;
+  while (true) {
+    std::uint64_t version;
+    if (published_state_version(observer) != shown &&
+        read_published_state(observer, state, version)) {
+      print_state(state, version);
+      shown = version;
+      if (once) {
+        break;
+      }
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(interval));
+  }
+  close_state_observer(observer);
+  return 0;
+}
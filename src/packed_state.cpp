@@ -0,0 +1,151 @@
+#include <algorithm>
+#include <limits>
+
+#include "packed_state.h"
+
+const int PACKED_WORDS = PACKED_STATE_SIZE / 8;
+const int PACKED_CELL_WORDS = PACKED_MAX_CELLS / 64;
+const int PACKED_COUNTERS = PACKED_CELL_WORDS;     // position, score
+const int PACKED_BLOCKS = PACKED_CELL_WORDS + 1;   // lines, blocks, progress
+
+static void store_word(std::uint8_t *bytes, std::uint64_t word) {
+  for (int i = 7; i >= 0; i--) {
+    bytes[i] = static_cast<std::uint8_t>(word);
+    word >>= 8;
+  }
+}
+
+static std::uint64_t load_word(const std::uint8_t *bytes) {
+  std::uint64_t word = 0;
+  for (int i = 0; i < 8; i++) {
+    word = (word << 8) | bytes[i];
+  }
+  return word;
+}
+
+std::uint64_t hash_packed_state(const PackedState &state) {
+  std::uint64_t hash = 0;
+  for (int i = 0; i < PACKED_WORDS; i++) {
+    // splitmix64 finaliser over the running hash
+    hash ^= load_word(state.bytes + i * 8) + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+    hash ^= hash >> 30;
+    hash *= 0xBF58476D1CE4E5B9ull;
+    hash ^= hash >> 27;
+    hash *= 0x94D049BB133111EBull;
+    hash ^= hash >> 31;
+  }
+  return hash;
+}
+
+PackedFormat packed_format(const GameState &state) {
+  return {state.field.width, state.field.height, state.rng.seed(), state.milliseconds_per_turn};
+}
+
+static bool fits_byte(int value) {
+  return value >= std::numeric_limits<std::int8_t>::min() &&
+         value <= std::numeric_limits<std::int8_t>::max();
+}
+
+bool pack_state(const PackedFormat &format, const GameState &state, PackedState &packed) {
+  const Field &field = state.field;
+  const ActiveBlock &block = state.active_block;
+  if (field.width != format.width || field.height != format.height ||
+      field.width * field.height > PACKED_MAX_CELLS ||
+      static_cast<int>(field.lines.size()) != field.height ||
+      state.rng.seed() != format.seed ||
+      state.milliseconds_per_turn != format.milliseconds_per_turn ||
+      state.rng.position() > std::numeric_limits<std::uint32_t>::max() ||
+      !fits_byte(block.position_x) || !fits_byte(block.position_y)) {
+    return false;
+  }
+
+  // Cell i is bit 63 - i % 64 of word i / 64, so the bytes list the cells
+  // in order, bottom row first.
+  std::uint64_t cells[PACKED_CELL_WORDS] = {};
+  int cell = 0;
+  for (const Line &line : field.lines) {
+    for (CellState value : line) {
+      if (value == CellState::FILLED) {
+        cells[cell / 64] |= 1ull << (63 - cell % 64);
+      }
+      cell++;
+    }
+  }
+  for (int i = 0; i < PACKED_CELL_WORDS; i++) {
+    store_word(packed.bytes + i * 8, cells[i]);
+  }
+  store_word(packed.bytes + PACKED_COUNTERS * 8,
+             state.rng.position() << 32 | static_cast<std::uint32_t>(state.score));
+  store_word(packed.bytes + PACKED_BLOCKS * 8,
+             static_cast<std::uint64_t>(static_cast<std::uint32_t>(state.lines)) << 32 |
+             static_cast<std::uint64_t>(static_cast<std::uint8_t>(block.position_x)) << 24 |
+             static_cast<std::uint64_t>(static_cast<std::uint8_t>(block.position_y)) << 16 |
+             static_cast<std::uint64_t>(block.tetromino) << 13 |
+             static_cast<std::uint64_t>(block.rotation) << 11 |
+             static_cast<std::uint64_t>(state.next_block) << 8 |
+             static_cast<std::uint64_t>(state.progress) << 7);
+  return true;
+}
+
+void unpack_state(const PackedFormat &format, const PackedState &packed, GameState &state) {
+  Field &field = state.field;
+  if (field.width != format.width || field.height != format.height ||
+      static_cast<int>(field.lines.size()) != format.height) {
+    field = {
+      format.height,
+      format.width,
+      std::vector<Line>(format.height, Line(format.width, CellState::EMPTY))
+    };
+  }
+  std::uint64_t cells[PACKED_CELL_WORDS];
+  for (int i = 0; i < PACKED_CELL_WORDS; i++) {
+    cells[i] = load_word(packed.bytes + i * 8);
+  }
+  int cell = 0;
+  for (Line &line : field.lines) {
+    for (CellState &value : line) {
+      value = (cells[cell / 64] >> (63 - cell % 64)) & 1 ? CellState::FILLED : CellState::EMPTY;
+      cell++;
+    }
+  }
+
+  std::uint64_t counters = load_word(packed.bytes + PACKED_COUNTERS * 8);
+  std::uint64_t blocks = load_word(packed.bytes + PACKED_BLOCKS * 8);
+  state.active_block = {
+    static_cast<std::int8_t>(blocks >> 24),
+    static_cast<std::int8_t>(blocks >> 16),
+    static_cast<Tetromino>(blocks >> 13 & 7),
+    static_cast<Rotation>(blocks >> 11 & 3)
+  };
+  state.next_block = static_cast<Tetromino>(blocks >> 8 & 7);
+  state.milliseconds_per_turn = format.milliseconds_per_turn;
+  state.score = static_cast<std::int32_t>(counters);
+  state.lines = static_cast<std::int32_t>(blocks >> 32);
+  state.progress = static_cast<GameProgress>(blocks >> 7 & 1);
+
+  // Searches mostly unpack states of one game in increasing position, so
+  // drawing forward is usually far cheaper than starting over.
+  unsigned long long position = counters >> 32;
+  if (state.rng.seed() != format.seed || state.rng.position() > position) {
+    state.rng = RNG::at_position(format.seed, position);
+  }
+  while (state.rng.position() < position) {
+    state.rng();
+  }
+  refresh_versions(state);
+}
+
+bool push_state(PackedFrontier &frontier, const GameState &state) {
+  PackedState packed;
+  if (!pack_state(frontier.format, state, packed)) {
+    return false;
+  }
+  frontier.states.push_back(packed);
+  return true;
+}
+
+void sort_unique(PackedFrontier &frontier) {
+  std::sort(frontier.states.begin(), frontier.states.end());
+  frontier.states.erase(std::unique(frontier.states.begin(), frontier.states.end()),
+                        frontier.states.end());
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "state.h"
+
+// Fixed-size encoding of a GameState for searches that hold millions of
+// them.
+//
+// A GameState is a vector of rows plus a whole Mersenne twister, which is
+// kilobytes each. A PackedState is 48 bytes: the cells as one bit each
+// (up to 256, enough for 10x20), then the generator position, score,
+// lines, the active and next blocks and progress. What every state in a
+// search shares (the field size, the seed and the gravity interval) is
+// kept once, in a PackedFormat, and the generator is rebuilt from the
+// seed and position on unpacking.
+//
+// The bytes are big-endian, most significant first, so comparing them
+// with memcmp orders states the same on every platform, and equal states
+// always have equal bytes. That makes them directly sortable and
+// hashable.
+
+const std::size_t PACKED_STATE_SIZE = 48;
+const int PACKED_MAX_CELLS = 256;
+
+struct PackedState {
+  std::uint8_t bytes[PACKED_STATE_SIZE];
+};
+
+inline bool operator==(const PackedState &lhs, const PackedState &rhs) {
+  return std::memcmp(lhs.bytes, rhs.bytes, PACKED_STATE_SIZE) == 0;
+}
+
+inline bool operator<(const PackedState &lhs, const PackedState &rhs) {
+  return std::memcmp(lhs.bytes, rhs.bytes, PACKED_STATE_SIZE) < 0;
+}
+
+std::uint64_t hash_packed_state(const PackedState &state);
+
+struct PackedStateHash {
+  std::size_t operator()(const PackedState &state) const {
+    return static_cast<std::size_t>(hash_packed_state(state));
+  }
+};
+
+struct PackedFormat {
+  int width;
+  int height;
+  RNG::result_type seed;
+  int milliseconds_per_turn;
+};
+
+// The format of state and everything reachable from it in the same game.
+PackedFormat packed_format(const GameState &state);
+
+// Returns false if state does not fit: a different format, more than
+// PACKED_MAX_CELLS cells, or a value too large for its bits.
+bool pack_state(const PackedFormat &format, const GameState &state, PackedState &packed);
+
+// Overwrites state, reusing its rows if the field is the format's size
+// and its generator if that can be advanced to the packed position
+// rather than rebuilt. The state gets fresh versions.
+void unpack_state(const PackedFormat &format, const PackedState &packed, GameState &state);
+
+// A contiguous array of packed states of one format.
+struct PackedFrontier {
+  PackedFormat format;
+  std::vector<PackedState> states;
+};
+
+// Returns false, leaving the frontier as it was, if state does not fit.
+bool push_state(PackedFrontier &frontier, const GameState &state);
+
+// Sorts the states into canonical order and drops duplicates.
+void sort_unique(PackedFrontier &frontier);
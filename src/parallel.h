@@ -0,0 +1,27 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <thread>
+#include <vector>
+
+// Runs work(index) for every index below count on the given number of
+// threads, handing out indexes one at a time.
+template <typename Work>
+void run_parallel(std::size_t count, int threads, Work work) {
+  std::atomic<std::size_t> next_index(0);
+  auto worker = [&]() {
+    std::size_t index;
+    while ((index = next_index++) < count) {
+      work(index);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int i = 1; i < threads; i++) {
+    pool.emplace_back(worker);
+  }
+  worker();
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+}
@@ -0,0 +1,198 @@
+#include <algorithm>
+#include <chrono>
+#include <limits>
+#include <unordered_map>
+#include <utility>
+
+#include "packed_state.h"
+#include "parallel.h"
+#include "perft.h"
+#include "placements.h"
+
+const Action PERFT_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::MOVE_DOWN,
+  Action::ROTATE_CLOCKWISE,
+  Action::ROTATE_COUNTERCLOCKWISE
+};
+
+static bool changed_by(const GameState &before, const GameState &after) {
+  // Any lock changes the field; anything else must have moved the block.
+  return !(before.active_block == after.active_block)
+      || !(before.field == after.field);
+}
+
+static std::vector<GameState> children(const GameState &state, PerftMode mode) {
+  if (mode == PerftMode::PIECES) {
+    return find_placement_results(state);
+  }
+  std::vector<GameState> result;
+  if (state.progress == GameProgress::GAME_OVER) {
+    return result;
+  }
+  for (Action action : PERFT_ACTIONS) {
+    GameState next = reduce(state, action);
+    if (changed_by(state, next)) {
+      result.push_back(std::move(next));
+    }
+  }
+  return result;
+}
+
+// Plain perft: counts[d] accumulates the move sequences of length
+// depth + d + 1 below state.
+static void count_sequences(const GameState &state,
+                            PerftMode mode,
+                            int depth,
+                            int max_depth,
+                            std::vector<unsigned long long> &counts,
+                            unsigned long long &nodes) {
+  if (depth == max_depth) {
+    return;
+  }
+  std::vector<GameState> next = children(state, mode);
+  counts[depth] += next.size();
+  nodes += next.size();
+  for (const GameState &child : next) {
+    count_sequences(child, mode, depth + 1, max_depth, counts, nodes);
+  }
+}
+
+static void perft_sequences(const GameState &root,
+                            const PerftOptions &options,
+                            PerftResult &result) {
+  // Split the tree two levels down so there is enough work to share.
+  std::vector<GameState> frontier(1, root);
+  int split_depth = 0;
+  while (split_depth < std::min(2, options.depth)) {
+    std::vector<GameState> next_frontier;
+    for (const GameState &state : frontier) {
+      for (GameState &child : children(state, options.mode)) {
+        next_frontier.push_back(std::move(child));
+      }
+    }
+    result.counts[split_depth] = next_frontier.size();
+    result.nodes += next_frontier.size();
+    frontier = std::move(next_frontier);
+    split_depth++;
+  }
+
+  int remaining = options.depth - split_depth;
+  std::vector<std::vector<unsigned long long>> counts(
+    frontier.size(), std::vector<unsigned long long>(remaining, 0));
+  std::vector<unsigned long long> nodes(frontier.size(), 0);
+  run_parallel(frontier.size(), options.threads, [&](std::size_t index) {
+    count_sequences(frontier[index], options.mode, 0, remaining,
+                    counts[index], nodes[index]);
+  });
+  for (std::size_t index = 0; index < frontier.size(); index++) {
+    for (int depth = 0; depth < remaining; depth++) {
+      result.counts[split_depth + depth] += counts[index][depth];
+    }
+    result.nodes += nodes[index];
+  }
+}
+
+const std::size_t PACKED_CHUNK = 1024;
+
+// Deduplicated perft on packed states: each depth's frontier is a sorted,
+// duplicate-free array of 48-byte states, expanded in chunks on the pool.
+// Every move draws at most one generator number, so the children of a
+// root that fits, down to the given depth, fit too.
+static bool perft_distinct_packed(const GameState &root,
+                                  const PerftOptions &options,
+                                  PerftResult &result) {
+  PackedFrontier frontier = {packed_format(root), {}};
+  if (root.rng.position() + options.depth > std::numeric_limits<std::uint32_t>::max() ||
+      !push_state(frontier, root)) {
+    return false;
+  }
+  for (int depth = 0; depth < options.depth; depth++) {
+    std::size_t chunks = (frontier.states.size() + PACKED_CHUNK - 1) / PACKED_CHUNK;
+    std::vector<PackedFrontier> expanded(chunks, {frontier.format, {}});
+    run_parallel(chunks, options.threads, [&](std::size_t chunk) {
+      std::size_t end = std::min(frontier.states.size(), (chunk + 1) * PACKED_CHUNK);
+      GameState state;
+      for (std::size_t index = chunk * PACKED_CHUNK; index < end; index++) {
+        unpack_state(frontier.format, frontier.states[index], state);
+        for (const GameState &child : children(state, options.mode)) {
+          push_state(expanded[chunk], child);
+        }
+      }
+    });
+
+    frontier.states.clear();
+    for (const PackedFrontier &chunk : expanded) {
+      result.nodes += chunk.states.size();
+      frontier.states.insert(frontier.states.end(), chunk.states.begin(), chunk.states.end());
+    }
+    sort_unique(frontier);
+    result.counts[depth] = frontier.states.size();
+  }
+  return true;
+}
+
+// Everything the packed form keeps, so that both sweeps count the same
+// states as distinct.
+static bool same_state(const GameState &lhs, const GameState &rhs) {
+  return lhs == rhs
+      && lhs.progress == rhs.progress
+      && lhs.rng.seed() == rhs.rng.seed()
+      && lhs.rng.position() == rhs.rng.position();
+}
+
+// Deduplicated perft: a breadth-first sweep that keeps one copy of each
+// distinct state per depth. States are bucketed by hash and compared in
+// full, so two states that share a hash are both kept.
+static void perft_distinct(const GameState &root,
+                           const PerftOptions &options,
+                           PerftResult &result) {
+  std::vector<GameState> frontier(1, root);
+  for (int depth = 0; depth < options.depth; depth++) {
+    std::vector<std::vector<GameState>> expanded(frontier.size());
+    run_parallel(frontier.size(), options.threads, [&](std::size_t index) {
+      expanded[index] = children(frontier[index], options.mode);
+    });
+
+    std::unordered_multimap<std::uint64_t, std::size_t> seen; // hash to index
+    std::vector<GameState> next_frontier;
+    for (std::vector<GameState> &states : expanded) {
+      result.nodes += states.size();
+      for (GameState &state : states) {
+        std::uint64_t hash = hash_game_state(state);
+        auto range = seen.equal_range(hash);
+        bool duplicate = false;
+        for (auto it = range.first; it != range.second && !duplicate; ++it) {
+          duplicate = same_state(next_frontier[it->second], state);
+        }
+        if (!duplicate) {
+          seen.emplace(hash, next_frontier.size());
+          next_frontier.push_back(std::move(state));
+        }
+      }
+    }
+    result.counts[depth] = next_frontier.size();
+    frontier = std::move(next_frontier);
+  }
+}
+
+PerftResult perft(const GameState &root, PerftOptions options) {
+  options.threads = std::max(1, options.threads);
+  PerftResult result = {
+    std::vector<unsigned long long>(std::max(0, options.depth), 0),
+    0,
+    0
+  };
+  auto start = std::chrono::steady_clock::now();
+  if (options.deduplicate) {
+    if (!perft_distinct_packed(root, options, result)) {
+      perft_distinct(root, options, result);
+    }
+  } else {
+    perft_sequences(root, options, result);
+  }
+  result.seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  return result;
+}
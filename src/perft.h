@@ -0,0 +1,34 @@
+#pragma once
+
+#include <vector>
+
+#include "state.h"
+
+// State-space counting in the style of chess perft, used both to check
+// the reducer against known counts and to benchmark it.
+//
+// In ACTIONS mode a move is one of MOVE_LEFT, MOVE_RIGHT, MOVE_DOWN,
+// ROTATE_CLOCKWISE or ROTATE_COUNTERCLOCKWISE that changes the state; a
+// blocked move is not a move, and a finished game has none. In PIECES
+// mode a move is one distinct placement of the active block, as found by
+// find_placements.
+
+enum class PerftMode {
+  ACTIONS,
+  PIECES
+};
+
+struct PerftOptions {
+  PerftMode mode;
+  int depth;
+  bool deduplicate; // count distinct states instead of move sequences
+  int threads;
+};
+
+struct PerftResult {
+  std::vector<unsigned long long> counts; // counts[d] is the count at depth d + 1
+  unsigned long long nodes; // states generated, for nodes per second
+  double seconds;
+};
+
+PerftResult perft(const GameState &root, PerftOptions options);
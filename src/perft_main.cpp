@@ -0,0 +1,87 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "perft.h"
+#include "profiler.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--seed N] [--depth N] [--pieces] [--distinct]\n"
+               "          [--threads N] [--width N] [--height N] [--profile PATH]\n"
+               "Counts action sequences (or, with --pieces, placements) reachable\n"
+               "from a new game; --distinct counts distinct states instead.\n"
+               "--profile writes the profiling zones of a TETRIS_PROFILE build,\n"
+               "as folded stacks if PATH ends in .folded and as a Chrome trace\n"
+               "otherwise.\n",
+               program);
+}
+
+int main(int argc, char *argv[]) {
+  RNG::result_type seed = 0;
+  int width = DEFAULT_WIDTH;
+  int height = DEFAULT_HEIGHT;
+  std::string profile_path;
+  PerftOptions options = {
+    PerftMode::ACTIONS,
+    6,
+    false,
+    static_cast<int>(std::thread::hardware_concurrency())
+  };
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--seed" && i + 1 < argc) {
+      seed = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--depth" && i + 1 < argc) {
+      options.depth = std::atoi(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--width" && i + 1 < argc) {
+      width = std::atoi(argv[++i]);
+    } else if (arg == "--height" && i + 1 < argc) {
+      height = std::atoi(argv[++i]);
+    } else if (arg == "--pieces") {
+      options.mode = PerftMode::PIECES;
+    } else if (arg == "--distinct") {
+      options.deduplicate = true;
+    } else if (arg == "--profile" && i + 1 < argc) {
+      profile_path = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (options.depth < 1 || width < MAX_TETROMINO_WIDTH || height < MAX_TETROMINO_HEIGHT) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  PerftResult result = perft(new_game(width, height, seed), options);
+  for (std::size_t depth = 0; depth < result.counts.size(); depth++) {
+    std::printf("perft(%zu) = %llu\n", depth + 1, result.counts[depth]);
+  }
+  std::printf("%llu nodes in %.3f s: %.0f nodes/s\n",
+              result.nodes,
+              result.seconds,
+              result.seconds > 0 ? result.nodes / result.seconds : 0.0);
+
+  if (!profile_path.empty()) {
+    if (!PROFILING_ENABLED) {
+      std::fprintf(stderr, "Built without TETRIS_PROFILE; the profile is empty\n");
+    }
+    std::uint64_t dropped = 0;
+    for (const ThreadProfile &thread : collect_profile()) {
+      dropped += thread.dropped;
+    }
+    if (dropped > 0) {
+      std::fprintf(stderr, "%llu zones did not fit in the profile buffers\n",
+                   static_cast<unsigned long long>(dropped));
+    }
+    if (!write_profile(profile_path)) {
+      std::fprintf(stderr, "Unable to write profile %s\n", profile_path.c_str());
+      return 1;
+    }
+  }
+  return 0;
+}
@@ -0,0 +1,149 @@
+#include <unordered_map>
+#include <utility>
+
+#include "placements.h"
+
+const Action SEARCH_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::ROTATE_CLOCKWISE,
+  Action::ROTATE_COUNTERCLOCKWISE,
+  Action::MOVE_DOWN
+};
+
+struct SearchNode {
+  ActiveBlock block;
+  int parent; // index into the search order, -1 for the start
+  Action action;
+};
+
+ActiveBlock apply_to_block(ActiveBlock block, Action action) {
+  switch (action) {
+  case Action::MOVE_LEFT:
+    block.position_x--;
+    break;
+  case Action::MOVE_RIGHT:
+    block.position_x++;
+    break;
+  case Action::MOVE_DOWN:
+    block.position_y--;
+    break;
+  case Action::ROTATE_CLOCKWISE:
+    block.rotation = rotate_clockwise(block.rotation);
+    break;
+  case Action::ROTATE_COUNTERCLOCKWISE:
+    block.rotation = rotate_counterclockwise(block.rotation);
+    break;
+  default:
+    break;
+  }
+  return block;
+}
+
+// Legal blocks always sit inside the field, so (x, y, rotation) indexes a
+// dense visited table.
+static int block_index(const Field &field, const ActiveBlock &block) {
+  return (block.position_y * field.width + block.position_x) * 4
+       + static_cast<int>(block.rotation);
+}
+
+// Breadth-first search over block positions. Calls on_lock with the
+// index of each resting block, in order of increasing path length.
+template <typename OnLock>
+static void search_locks(const GameState &state,
+                         std::vector<SearchNode> &nodes,
+                         OnLock on_lock) {
+  const Field &field = state.field;
+  if (state.progress == GameProgress::GAME_OVER ||
+      !is_legal_position(field, state.active_block)) {
+    return;
+  }
+  std::vector<bool> visited(field.width * field.height * 4, false);
+  nodes.push_back({state.active_block, -1, Action::NO_ACTION});
+  visited[block_index(field, state.active_block)] = true;
+
+  for (std::size_t current = 0; current < nodes.size(); current++) {
+    ActiveBlock block = nodes[current].block;
+    for (Action action : SEARCH_ACTIONS) {
+      ActiveBlock next = apply_to_block(block, action);
+      if (!is_legal_position(field, next)) {
+        if (action == Action::MOVE_DOWN) {
+          on_lock(current);
+        }
+        continue;
+      }
+      int index = block_index(field, next);
+      if (!visited[index]) {
+        visited[index] = true;
+        nodes.push_back({next, static_cast<int>(current), action});
+      }
+    }
+  }
+}
+
+static GameState lock_at(const GameState &state, const ActiveBlock &block) {
+  GameState locked = state;
+  locked.active_block = block;
+  return reduce(std::move(locked), Action::MOVE_DOWN);
+}
+
+// True if field differs from every field found so far, which are
+// field_of(0) to field_of(count - 1) and indexed by hash in seen. A new
+// field is recorded as index count. Equal hashes are only candidates;
+// the fields themselves are compared.
+template <typename FieldOf>
+static bool first_sighting(std::unordered_multimap<std::uint64_t, std::size_t> &seen,
+                           const Field &field,
+                           std::size_t count,
+                           FieldOf field_of) {
+  std::uint64_t hash = hash_field(field);
+  auto candidates = seen.equal_range(hash);
+  for (auto candidate = candidates.first; candidate != candidates.second; ++candidate) {
+    if (field_of(candidate->second) == field) {
+      return false;
+    }
+  }
+  seen.emplace(hash, count);
+  return true;
+}
+
+std::vector<Placement> find_placements(const GameState &state) {
+  std::vector<Placement> placements;
+  std::vector<SearchNode> nodes;
+  std::unordered_multimap<std::uint64_t, std::size_t> seen_fields;
+  search_locks(state, nodes, [&](int index) {
+    GameState result = lock_at(state, nodes[index].block);
+    if (!first_sighting(seen_fields, result.field, placements.size(),
+                        [&](std::size_t seen) -> const Field & {
+                          return placements[seen].result.field;
+                        })) {
+      return;
+    }
+    std::vector<Action> actions(1, Action::MOVE_DOWN);
+    for (int node = index; nodes[node].parent >= 0; node = nodes[node].parent) {
+      actions.push_back(nodes[node].action);
+    }
+    placements.push_back({
+      nodes[index].block,
+      std::vector<Action>(actions.rbegin(), actions.rend()),
+      std::move(result)
+    });
+  });
+  return placements;
+}
+
+std::vector<GameState> find_placement_results(const GameState &state) {
+  std::vector<GameState> results;
+  std::vector<SearchNode> nodes;
+  std::unordered_multimap<std::uint64_t, std::size_t> seen_fields;
+  search_locks(state, nodes, [&](int index) {
+    GameState result = lock_at(state, nodes[index].block);
+    if (first_sighting(seen_fields, result.field, results.size(),
+                       [&](std::size_t seen) -> const Field & {
+                         return results[seen].field;
+                       })) {
+      results.push_back(std::move(result));
+    }
+  });
+  return results;
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <vector>
+
+#include "state.h"
+
+// Every distinct way the active block can come to rest.
+//
+// The search follows the reducer's own rules: from the current active
+// block it tries MOVE_LEFT, MOVE_RIGHT, ROTATE_CLOCKWISE,
+// ROTATE_COUNTERCLOCKWISE and MOVE_DOWN, and a block that cannot move
+// down locks. Placements that leave the same field (for example the two
+// identical orientations of the I block) are reported once, with the
+// shortest action sequence that reaches them.
+
+struct Placement {
+  ActiveBlock final_block;   // where the block is when it locks
+  std::vector<Action> actions; // ends with the MOVE_DOWN that locks it
+  GameState result;
+};
+
+std::vector<Placement> find_placements(const GameState &state);
+
+// Where action would move the block, legal or not; actions that do not
+// move the block leave it as it is.
+ActiveBlock apply_to_block(ActiveBlock block, Action action);
+
+// Like find_placements, but without the action sequences, for searches
+// that only need the resulting positions.
+std::vector<GameState> find_placement_results(const GameState &state);
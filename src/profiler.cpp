@@ -0,0 +1,175 @@
+#include <chrono>
+#include <cstdio>
+#include <map>
+#include <mutex>
+#include <unordered_map>
+
+#include "profiler.h"
+
+static std::mutex &registry_mutex() {
+  static std::mutex mutex;
+  return mutex;
+}
+
+// Buffers are never freed, so zones from finished threads can still be
+// exported.
+static std::vector<ProfileBuffer *> &registry() {
+  static std::vector<ProfileBuffer *> buffers;
+  return buffers;
+}
+
+static std::chrono::steady_clock::time_point profile_epoch() {
+  static const std::chrono::steady_clock::time_point epoch = std::chrono::steady_clock::now();
+  return epoch;
+}
+
+std::uint64_t profile_clock() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+    std::chrono::steady_clock::now() - profile_epoch()).count();
+}
+
+static ProfileBuffer *new_buffer() {
+  ProfileBuffer *buffer = new ProfileBuffer();
+  // Left uninitialised, so pages are only touched as zones fill them.
+  buffer->records.reset(new ProfileRecord[PROFILE_BUFFER_ZONES]);
+  buffer->count = 0;
+  buffer->dropped = 0;
+  buffer->next_sequence = 1;
+  buffer->open_zone = 0;
+  profile_epoch();
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  buffer->thread = static_cast<int>(registry().size());
+  registry().push_back(buffer);
+  return buffer;
+}
+
+ProfileBuffer &profile_buffer() {
+  static thread_local ProfileBuffer *buffer = new_buffer();
+  return *buffer;
+}
+
+ProfileZone::ProfileZone(const char *name)
+  : buffer(profile_buffer()),
+    name(name),
+    start(profile_clock()),
+    sequence(buffer.next_sequence++),
+    parent(buffer.open_zone) {
+  buffer.open_zone = sequence;
+}
+
+ProfileZone::~ProfileZone() {
+  std::uint64_t end = profile_clock();
+  buffer.open_zone = parent;
+  std::size_t count = buffer.count.load(std::memory_order_relaxed);
+  if (count == PROFILE_BUFFER_ZONES) {
+    buffer.dropped.store(buffer.dropped.load(std::memory_order_relaxed) + 1,
+                         std::memory_order_relaxed);
+    return;
+  }
+  buffer.records[count] = {name, start, end, sequence, parent};
+  buffer.count.store(count + 1, std::memory_order_release);
+}
+
+std::vector<ThreadProfile> collect_profile() {
+  std::vector<ThreadProfile> profile;
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for (const ProfileBuffer *buffer : registry()) {
+    std::size_t count = buffer->count.load(std::memory_order_acquire);
+    profile.push_back({
+      buffer->thread,
+      std::vector<ProfileRecord>(buffer->records.get(), buffer->records.get() + count),
+      buffer->dropped.load(std::memory_order_relaxed)
+    });
+  }
+  return profile;
+}
+
+void clear_profile() {
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for (ProfileBuffer *buffer : registry()) {
+    buffer->count = 0;
+    buffer->dropped = 0;
+  }
+}
+
+std::string format_chrome_trace(const std::vector<ThreadProfile> &profile) {
+  std::string out = "{\"traceEvents\":[";
+  bool first = true;
+  for (const ThreadProfile &thread : profile) {
+    for (const ProfileRecord &record : thread.records) {
+      char event[256];
+      std::snprintf(event, sizeof(event),
+                    "%s\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,"
+                    "\"ts\":%.3f,\"dur\":%.3f}",
+                    first ? "" : ",",
+                    record.name,
+                    thread.thread,
+                    record.start / 1e3,
+                    (record.end - record.start) / 1e3);
+      out += event;
+      first = false;
+    }
+  }
+  out += "\n],\"displayTimeUnit\":\"ns\"}\n";
+  return out;
+}
+
+// The stack of names from the outermost recorded zone down to index.
+static const std::string &stack_of(const std::vector<ProfileRecord> &records,
+                                   const std::unordered_map<std::uint64_t, std::size_t> &by_sequence,
+                                   std::vector<std::string> &stacks,
+                                   std::size_t index) {
+  if (stacks[index].empty()) {
+    auto parent = by_sequence.find(records[index].parent);
+    if (parent != by_sequence.end()) {
+      stacks[index] = stack_of(records, by_sequence, stacks, parent->second) + ";";
+    }
+    stacks[index] += records[index].name;
+  }
+  return stacks[index];
+}
+
+std::string format_folded_stacks(const std::vector<ThreadProfile> &profile) {
+  std::map<std::string, std::uint64_t> totals;
+  for (const ThreadProfile &thread : profile) {
+    const std::vector<ProfileRecord> &records = thread.records;
+    std::unordered_map<std::uint64_t, std::size_t> by_sequence;
+    for (std::size_t i = 0; i < records.size(); i++) {
+      by_sequence[records[i].sequence] = i;
+    }
+    std::vector<std::uint64_t> self(records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+      self[i] += records[i].end - records[i].start;
+      auto parent = by_sequence.find(records[i].parent);
+      if (parent != by_sequence.end()) {
+        self[parent->second] -= records[i].end - records[i].start;
+      }
+    }
+    std::vector<std::string> stacks(records.size());
+    for (std::size_t i = 0; i < records.size(); i++) {
+      totals[stack_of(records, by_sequence, stacks, i)] += self[i];
+    }
+  }
+  std::string out;
+  for (const auto &total : totals) {
+    out += total.first;
+    out += ' ';
+    out += std::to_string(total.second);
+    out += '\n';
+  }
+  return out;
+}
+
+bool write_profile(const std::string &path) {
+  std::vector<ThreadProfile> profile = collect_profile();
+  const std::string suffix = ".folded";
+  bool folded = path.size() >= suffix.size() &&
+                path.compare(path.size() - suffix.size(), suffix.size(), suffix) == 0;
+  std::string text = folded ? format_folded_stacks(profile) : format_chrome_trace(profile);
+  std::FILE *file = std::fopen(path.c_str(), "w");
+  if (file == nullptr) {
+    return false;
+  }
+  bool written = std::fwrite(text.data(), 1, text.size(), file) == text.size();
+  return std::fclose(file) == 0 && written;
+}
@@ -0,0 +1,90 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// Exact timings of small, nested scopes on the hot path.
+//
+// PROFILE_ZONE("name") times the rest of the enclosing scope. Zones are
+// compiled in only when TETRIS_PROFILE is defined (cmake -DTETRIS_PROFILE=ON);
+// otherwise the macro expands to nothing and costs nothing. Each thread
+// appends finished zones to its own fixed-size buffer, registered on
+// first use and kept for the life of the process; zones past the end of a
+// full buffer are counted as dropped. The buffers can be exported as a
+// Chrome trace (chrome://tracing, Perfetto) or as folded stacks for
+// flamegraph.pl.
+
+#ifdef TETRIS_PROFILE
+#define PROFILE_CONCATENATE_(a, b) a##b
+#define PROFILE_CONCATENATE(a, b) PROFILE_CONCATENATE_(a, b)
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCATENATE(profile_zone_, __LINE__)(name)
+const bool PROFILING_ENABLED = true;
+#else
+#define PROFILE_ZONE(name) do {} while (false)
+const bool PROFILING_ENABLED = false;
+#endif
+
+const std::size_t PROFILE_BUFFER_ZONES = 1 << 20;
+
+struct ProfileRecord {
+  const char *name;          // a string literal
+  std::uint64_t start;       // nanoseconds since the profiler started
+  std::uint64_t end;
+  std::uint64_t sequence;    // numbers zones by the order they opened
+  std::uint64_t parent;      // sequence of the enclosing zone, 0 at the top
+};
+
+struct ProfileBuffer {
+  int thread;
+  std::unique_ptr<ProfileRecord[]> records;
+  std::atomic<std::size_t> count; // published after each record is written
+  std::atomic<std::uint64_t> dropped;
+  std::uint64_t next_sequence;
+  std::uint64_t open_zone;
+};
+
+// The calling thread's buffer.
+ProfileBuffer &profile_buffer();
+
+std::uint64_t profile_clock();
+
+struct ProfileZone {
+  explicit ProfileZone(const char *name);
+  ~ProfileZone();
+  ProfileZone(const ProfileZone &) = delete;
+  ProfileZone &operator=(const ProfileZone &) = delete;
+
+  ProfileBuffer &buffer;
+  const char *name;
+  std::uint64_t start;
+  std::uint64_t sequence;
+  std::uint64_t parent;
+};
+
+struct ThreadProfile {
+  int thread;
+  std::vector<ProfileRecord> records; // in the order the zones closed
+  std::uint64_t dropped;
+};
+
+// Copies every thread's finished zones. Zones still open are left out,
+// and their children are reported as top-level zones.
+std::vector<ThreadProfile> collect_profile();
+
+// Forgets every recorded zone. No thread may be inside a zone meanwhile.
+void clear_profile();
+
+// Chrome trace event JSON, one complete ("X") event per zone.
+std::string format_chrome_trace(const std::vector<ThreadProfile> &profile);
+
+// One "outer;inner nanoseconds" line per distinct stack, counting only
+// the time spent in each zone itself and not in its children.
+std::string format_folded_stacks(const std::vector<ThreadProfile> &profile);
+
+// Writes the current profile to path, as folded stacks if path ends in
+// ".folded" and as a Chrome trace otherwise.
+bool write_profile(const std::string &path);
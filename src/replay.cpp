@@ -0,0 +1,146 @@
+#include <algorithm>
+#include <string>
+#include <utility>
+
+#include "replay.h"
+
+const char REPLAY_HEADER[] = "tetris-replay";
+const int REPLAY_VERSION = 1;
+
+GameState apply_replay_event(GameState state, const ReplayEvent &event,
+                             int width, int height) {
+  if (event.action == Action::NEW_GAME) {
+    return new_game(width, height, event.seed);
+  }
+  return reduce(std::move(state), event.action);
+}
+
+std::uint32_t replay_duration(const Replay &replay) {
+  return replay.events.empty() ? 0 : replay.events.back().milliseconds;
+}
+
+void write_replay(std::ostream &out, const Replay &replay) {
+  out << REPLAY_HEADER << ' ' << REPLAY_VERSION << '\n'
+      << replay.width << ' ' << replay.height << '\n';
+  for (const ReplayEvent &event : replay.events) {
+    out << event.milliseconds << ' ' << get_action_name(event.action);
+    if (event.action == Action::NEW_GAME) {
+      out << ' ' << event.seed;
+    }
+    out << '\n';
+  }
+}
+
+static bool parse_action(const std::string &name, Action &action) {
+  const Action RECORDED_ACTIONS[] = {
+    Action::NEW_GAME,
+    Action::TIME_FALL,
+    Action::MOVE_LEFT,
+    Action::MOVE_RIGHT,
+    Action::MOVE_DOWN,
+    Action::ROTATE_CLOCKWISE,
+    Action::ROTATE_COUNTERCLOCKWISE
+  };
+  for (Action candidate : RECORDED_ACTIONS) {
+    if (name == get_action_name(candidate)) {
+      action = candidate;
+      return true;
+    }
+  }
+  return false;
+}
+
+bool read_replay(std::istream &in, Replay &replay) {
+  std::string header;
+  int version;
+  if (!(in >> header >> version) || header != REPLAY_HEADER ||
+      version != REPLAY_VERSION) {
+    return false;
+  }
+  if (!(in >> replay.width >> replay.height) ||
+      replay.width < MAX_TETROMINO_WIDTH || replay.height < MAX_TETROMINO_HEIGHT) {
+    return false;
+  }
+
+  replay.events.clear();
+  std::uint32_t milliseconds;
+  std::string name;
+  while (in >> milliseconds >> name) {
+    ReplayEvent event = {milliseconds, Action::NO_ACTION, 0};
+    if (!parse_action(name, event.action)) {
+      return false;
+    }
+    if (event.action == Action::NEW_GAME && !(in >> event.seed)) {
+      return false;
+    }
+    if (!replay.events.empty() && milliseconds < replay.events.back().milliseconds) {
+      return false;
+    }
+    replay.events.push_back(event);
+  }
+  // Playback needs a seeded game to start from.
+  return in.eof() && !replay.events.empty() &&
+         replay.events.front().action == Action::NEW_GAME;
+}
+
+ReplayPlayer new_replay_player(Replay replay, int snapshot_interval) {
+  ReplayPlayer player = {std::move(replay), {}, 0, 0, {}};
+  snapshot_interval = std::max(snapshot_interval, 1);
+  const std::vector<ReplayEvent> &events = player.replay.events;
+  GameState state;
+  for (std::size_t i = 0; i < events.size(); i++) {
+    if (i % snapshot_interval == 0) {
+      player.snapshots.push_back({i, state});
+    }
+    state = apply_replay_event(std::move(state), events[i],
+                               player.replay.width, player.replay.height);
+  }
+  seek_replay(player, 0);
+  return player;
+}
+
+std::size_t advance_replay(ReplayPlayer &player, std::uint32_t milliseconds) {
+  const std::vector<ReplayEvent> &events = player.replay.events;
+  std::size_t applied = 0;
+  while (player.next_event < events.size() &&
+         events[player.next_event].milliseconds <= milliseconds) {
+    player.state = apply_replay_event(std::move(player.state),
+                                      events[player.next_event],
+                                      player.replay.width,
+                                      player.replay.height);
+    player.next_event++;
+    applied++;
+  }
+  player.milliseconds = std::max(player.milliseconds, milliseconds);
+  return applied;
+}
+
+void seek_replay(ReplayPlayer &player, std::uint32_t milliseconds) {
+  const std::vector<ReplayEvent> &events = player.replay.events;
+  if (events.empty()) {
+    player.milliseconds = milliseconds;
+    return;
+  }
+  // The first event starts the game, so playback never shows less.
+  milliseconds = std::max(milliseconds, events.front().milliseconds);
+  // The last snapshot taken before any event later than milliseconds.
+  auto later = std::upper_bound(
+    player.snapshots.begin() + 1,
+    player.snapshots.end(),
+    milliseconds,
+    [&](std::uint32_t target, const ReplaySnapshot &snapshot) {
+      return target < events[snapshot.next_event - 1].milliseconds;
+    });
+  const ReplaySnapshot &snapshot = *(later - 1);
+  // Restore it when going backwards, or when it skips events going forwards.
+  if (milliseconds < player.milliseconds || snapshot.next_event > player.next_event) {
+    player.state = snapshot.state;
+    player.next_event = snapshot.next_event;
+  }
+  player.milliseconds = milliseconds;
+  advance_replay(player, milliseconds);
+}
+
+bool replay_finished(const ReplayPlayer &player) {
+  return player.next_event == player.replay.events.size();
+}
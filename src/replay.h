@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <istream>
+#include <ostream>
+#include <vector>
+
+#include "state.h"
+
+// Recorded games and a player that seeks through them.
+//
+// A replay is the timed action stream of a session. Gravity is recorded
+// as TIME_FALL like any other action, so playing the events back through
+// reduce reproduces every state exactly, at any speed; the timestamps only
+// say when each state was on screen. A NEW_GAME event carries the seed its
+// game was dealt from, since reduce would otherwise pick a fresh one.
+
+struct ReplayEvent {
+  std::uint32_t milliseconds; // since the start of the recording
+  Action action;
+  RNG::result_type seed;      // NEW_GAME only
+};
+
+struct Replay {
+  int width;
+  int height;
+  std::vector<ReplayEvent> events; // in time order
+};
+
+GameState apply_replay_event(GameState state, const ReplayEvent &event,
+                             int width, int height);
+
+std::uint32_t replay_duration(const Replay &replay);
+
+// A line-oriented text format: a header, the field size, then one event
+// per line as "<milliseconds> <action name> [seed]".
+void write_replay(std::ostream &out, const Replay &replay);
+
+// Returns false if the input is not a well-formed replay.
+bool read_replay(std::istream &in, Replay &replay);
+
+struct ReplaySnapshot {
+  std::size_t next_event; // events before this one have been applied
+  GameState state;
+};
+
+// Playback position within a replay. Snapshots of the state are taken
+// every snapshot_interval events when the player is created, so a seek
+// backwards replays at most that many events from the nearest one. An
+// interval below 1 is taken as 1.
+struct ReplayPlayer {
+  Replay replay;
+  std::vector<ReplaySnapshot> snapshots;
+  std::size_t next_event;
+  std::uint32_t milliseconds;
+  GameState state;
+};
+
+ReplayPlayer new_replay_player(Replay replay, int snapshot_interval);
+
+// Applies the events up to and including milliseconds. Returns the number
+// of events applied.
+std::size_t advance_replay(ReplayPlayer &player, std::uint32_t milliseconds);
+
+// Moves to milliseconds in either direction.
+void seek_replay(ReplayPlayer &player, std::uint32_t milliseconds);
+
+bool replay_finished(const ReplayPlayer &player);
@@ -0,0 +1,723 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <utility>
+
+#include "delta.h"
+#include "replay_archive.h"
+
+const char ARCHIVE_MAGIC[8] = {'T', 'E', 'T', 'R', 'A', 'R', 'C', 'H'};
+const char ARCHIVE_INDEX_MAGIC[8] = {'T', 'E', 'T', 'R', 'A', 'I', 'D', 'X'};
+const std::uint32_t ARCHIVE_VERSION = 1;
+const std::uint32_t GAME_BLOCK_MAGIC = 0x454D4147; // "GAME"
+
+struct ArchiveHeader {
+  char magic[8];
+  std::uint32_t version;
+  std::uint32_t reserved;
+};
+
+struct GameBlockHeader {
+  std::uint32_t magic;
+  std::uint16_t width;
+  std::uint16_t height;
+  std::uint64_t seed;
+  std::uint32_t start_milliseconds; // of the NEW_GAME event
+  std::uint32_t steps;
+  std::uint32_t keyframe_interval;
+  std::uint32_t keyframe_count;
+  std::uint32_t actions_size;
+  std::uint32_t times_size;
+  std::uint32_t states_size;
+  std::uint32_t reserved;
+};
+
+// Where decoding can start. The first keyframe is the new game itself and
+// has no stored state.
+struct KeyframeEntry {
+  std::uint32_t step;
+  std::uint32_t milliseconds;
+  std::uint32_t actions_offset;
+  std::uint32_t times_offset;
+  std::uint32_t state_offset;
+  std::uint32_t state_size;
+};
+
+struct ArchiveTrailer {
+  std::uint64_t index_offset;
+  std::uint64_t game_count;
+  char magic[8];
+};
+
+static_assert(sizeof(ArchiveHeader) == 16, "archive header layout");
+static_assert(sizeof(GameBlockHeader) == 48, "game block header layout");
+static_assert(sizeof(KeyframeEntry) == 24, "keyframe entry layout");
+static_assert(sizeof(ArchiveGameEntry) == 16, "index entry layout");
+static_assert(sizeof(ArchiveTrailer) == 24, "archive trailer layout");
+
+// Actions as coded, NEW_GAME being implied by the start of each block.
+const Action ARCHIVE_ACTIONS[] = {
+  Action::TIME_FALL,
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::MOVE_DOWN,
+  Action::ROTATE_CLOCKWISE,
+  Action::ROTATE_COUNTERCLOCKWISE
+};
+const int ARCHIVE_SYMBOLS = 6;
+
+static int action_symbol(Action action) {
+  for (int symbol = 0; symbol < ARCHIVE_SYMBOLS; symbol++) {
+    if (ARCHIVE_ACTIONS[symbol] == action) {
+      return symbol;
+    }
+  }
+  return -1;
+}
+
+// A binary range coder with adaptive probabilities, after LZMA's.
+
+typedef std::uint16_t Probability;
+
+const int PROBABILITY_BITS = 11;
+const Probability PROBABILITY_HALF = 1 << (PROBABILITY_BITS - 1);
+const int ADAPTATION_SHIFT = 5;
+const std::uint32_t RANGE_TOP = 1 << 24;
+const int DELTA_MAX_LENGTH = 33; // bits in a delta plus one
+
+struct RangeEncoder {
+  std::vector<std::uint8_t> bytes;
+  std::uint64_t low;
+  std::uint32_t range;
+  std::uint8_t cache;
+  std::uint64_t cache_size;
+};
+
+static RangeEncoder new_range_encoder() {
+  return {{}, 0, 0xFFFFFFFF, 0, 1};
+}
+
+// Emits the top byte of low once no carry can change it any more.
+static void shift_low(RangeEncoder &encoder) {
+  if (static_cast<std::uint32_t>(encoder.low) < 0xFF000000 || (encoder.low >> 32) != 0) {
+    std::uint8_t carry = static_cast<std::uint8_t>(encoder.low >> 32);
+    std::uint8_t pending = encoder.cache;
+    do {
+      encoder.bytes.push_back(static_cast<std::uint8_t>(pending + carry));
+      pending = 0xFF;
+    } while (--encoder.cache_size != 0);
+    encoder.cache = static_cast<std::uint8_t>(encoder.low >> 24);
+  }
+  encoder.cache_size++;
+  encoder.low = (encoder.low & 0x00FFFFFF) << 8;
+}
+
+static void encode_bit(RangeEncoder &encoder, Probability &probability, int bit) {
+  std::uint32_t bound = (encoder.range >> PROBABILITY_BITS) * probability;
+  if (bit == 0) {
+    encoder.range = bound;
+    probability += ((1 << PROBABILITY_BITS) - probability) >> ADAPTATION_SHIFT;
+  } else {
+    encoder.low += bound;
+    encoder.range -= bound;
+    probability -= probability >> ADAPTATION_SHIFT;
+  }
+  while (encoder.range < RANGE_TOP) {
+    encoder.range <<= 8;
+    shift_low(encoder);
+  }
+}
+
+static void encode_direct_bits(RangeEncoder &encoder, std::uint64_t value, int count) {
+  for (int i = count - 1; i >= 0; i--) {
+    encoder.range >>= 1;
+    if ((value >> i) & 1) {
+      encoder.low += encoder.range;
+    }
+    while (encoder.range < RANGE_TOP) {
+      encoder.range <<= 8;
+      shift_low(encoder);
+    }
+  }
+}
+
+static void finish_range_encoder(RangeEncoder &encoder, std::vector<std::uint8_t> &column) {
+  for (int i = 0; i < 5; i++) {
+    shift_low(encoder);
+  }
+  column.insert(column.end(), encoder.bytes.begin(), encoder.bytes.end());
+}
+
+struct RangeDecoder {
+  const std::uint8_t *data;
+  std::size_t size;
+  std::size_t position;
+  std::uint32_t range;
+  std::uint32_t code;
+};
+
+// Reads past the end of a damaged column as zeros rather than failing;
+// the symbols decoded from them are checked instead.
+static std::uint8_t next_byte(RangeDecoder &decoder) {
+  return decoder.position < decoder.size ? decoder.data[decoder.position++] : 0;
+}
+
+static RangeDecoder new_range_decoder(const std::uint8_t *data, std::size_t size) {
+  RangeDecoder decoder = {data, size, 0, 0xFFFFFFFF, 0};
+  for (int i = 0; i < 5; i++) {
+    decoder.code = (decoder.code << 8) | next_byte(decoder);
+  }
+  return decoder;
+}
+
+static int decode_bit(RangeDecoder &decoder, Probability &probability) {
+  std::uint32_t bound = (decoder.range >> PROBABILITY_BITS) * probability;
+  int bit;
+  if (decoder.code < bound) {
+    decoder.range = bound;
+    probability += ((1 << PROBABILITY_BITS) - probability) >> ADAPTATION_SHIFT;
+    bit = 0;
+  } else {
+    decoder.code -= bound;
+    decoder.range -= bound;
+    probability -= probability >> ADAPTATION_SHIFT;
+    bit = 1;
+  }
+  while (decoder.range < RANGE_TOP) {
+    decoder.range <<= 8;
+    decoder.code = (decoder.code << 8) | next_byte(decoder);
+  }
+  return bit;
+}
+
+static std::uint64_t decode_direct_bits(RangeDecoder &decoder, int count) {
+  std::uint64_t value = 0;
+  for (int i = 0; i < count; i++) {
+    decoder.range >>= 1;
+    int bit = decoder.code >= decoder.range;
+    if (bit) {
+      decoder.code -= decoder.range;
+    }
+    value = (value << 1) | bit;
+    while (decoder.range < RANGE_TOP) {
+      decoder.range <<= 8;
+      decoder.code = (decoder.code << 8) | next_byte(decoder);
+    }
+  }
+  return value;
+}
+
+// The adaptive models of both columns, reset at every keyframe. An action
+// is coded as a three bit tree conditioned on the action before it. The
+// time since the previous event is conditioned on the action itself,
+// since gravity ticks at a steady rate and input does not: either it
+// repeats the last delta seen with that action, or it is coded as its bit
+// length in unary followed by the bits below the leading one.
+struct ColumnModels {
+  Probability actions[ARCHIVE_SYMBOLS][8];
+  int previous_symbol;
+  Probability repeats[ARCHIVE_SYMBOLS];
+  Probability lengths[ARCHIVE_SYMBOLS][DELTA_MAX_LENGTH];
+  std::uint32_t last_deltas[ARCHIVE_SYMBOLS];
+};
+
+static ColumnModels new_column_models() {
+  ColumnModels models;
+  std::fill(&models.actions[0][0], &models.actions[0][0] + ARCHIVE_SYMBOLS * 8, PROBABILITY_HALF);
+  models.previous_symbol = 0;
+  std::fill(models.repeats, models.repeats + ARCHIVE_SYMBOLS, PROBABILITY_HALF);
+  std::fill(&models.lengths[0][0], &models.lengths[0][0] + ARCHIVE_SYMBOLS * DELTA_MAX_LENGTH,
+            PROBABILITY_HALF);
+  std::fill(models.last_deltas, models.last_deltas + ARCHIVE_SYMBOLS, 0);
+  return models;
+}
+
+static void encode_action(RangeEncoder &encoder, ColumnModels &models, int symbol) {
+  Probability *tree = models.actions[models.previous_symbol];
+  int node = 1;
+  for (int i = 2; i >= 0; i--) {
+    int bit = (symbol >> i) & 1;
+    encode_bit(encoder, tree[node], bit);
+    node = node * 2 + bit;
+  }
+  models.previous_symbol = symbol;
+}
+
+static int decode_action(RangeDecoder &decoder, ColumnModels &models) {
+  Probability *tree = models.actions[models.previous_symbol];
+  int node = 1;
+  for (int i = 0; i < 3; i++) {
+    node = node * 2 + decode_bit(decoder, tree[node]);
+  }
+  int symbol = node - 8;
+  if (symbol < ARCHIVE_SYMBOLS) {
+    models.previous_symbol = symbol;
+    return symbol;
+  }
+  return -1;
+}
+
+static void encode_time(RangeEncoder &encoder, ColumnModels &models, int symbol, std::uint32_t delta) {
+  bool repeated = delta == models.last_deltas[symbol];
+  encode_bit(encoder, models.repeats[symbol], repeated);
+  if (repeated) {
+    return;
+  }
+  std::uint64_t value = static_cast<std::uint64_t>(delta) + 1;
+  int length = 1;
+  while ((value >> length) != 0) {
+    length++;
+  }
+  for (int i = 1; i < DELTA_MAX_LENGTH; i++) {
+    encode_bit(encoder, models.lengths[symbol][i - 1], i < length);
+    if (i == length) {
+      break;
+    }
+  }
+  encode_direct_bits(encoder, value, length - 1);
+  models.last_deltas[symbol] = delta;
+}
+
+static bool decode_time(RangeDecoder &decoder, ColumnModels &models, int symbol, std::uint32_t &delta) {
+  if (decode_bit(decoder, models.repeats[symbol])) {
+    delta = models.last_deltas[symbol];
+    return true;
+  }
+  int length = 1;
+  while (length < DELTA_MAX_LENGTH && decode_bit(decoder, models.lengths[symbol][length - 1])) {
+    length++;
+  }
+  std::uint64_t value = (std::uint64_t(1) << (length - 1)) | decode_direct_bits(decoder, length - 1);
+  if (value - 1 > std::numeric_limits<std::uint32_t>::max()) {
+    return false;
+  }
+  delta = static_cast<std::uint32_t>(value - 1);
+  models.last_deltas[symbol] = delta;
+  return true;
+}
+
+// Writing
+
+static bool write_all(int fd, const void *data, std::size_t size, std::uint64_t offset) {
+  const char *bytes = static_cast<const char *>(data);
+  while (size > 0) {
+    ssize_t written = pwrite(fd, bytes, size, offset);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    size -= written;
+    offset += written;
+  }
+  return true;
+}
+
+template <typename T>
+static void append_bytes(std::vector<std::uint8_t> &out, const T &value) {
+  const std::uint8_t *bytes = reinterpret_cast<const std::uint8_t *>(&value);
+  out.insert(out.end(), bytes, bytes + sizeof(value));
+}
+
+template <typename T>
+static T read_bytes(const std::uint8_t *data) {
+  T value;
+  std::memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+// The size of the block at offset, if a whole one is there.
+static bool game_block_at(const std::uint8_t *data,
+                          std::size_t size,
+                          std::uint64_t offset,
+                          GameBlockHeader &header,
+                          std::uint64_t &block_size) {
+  if (offset > size || size - offset < sizeof(GameBlockHeader)) {
+    return false;
+  }
+  header = read_bytes<GameBlockHeader>(data + offset);
+  if (header.magic != GAME_BLOCK_MAGIC) {
+    return false;
+  }
+  block_size = sizeof(GameBlockHeader) +
+               static_cast<std::uint64_t>(header.keyframe_count) * sizeof(KeyframeEntry) +
+               header.actions_size + header.times_size + header.states_size;
+  return block_size <= size - offset;
+}
+
+// Lists the games from the index, or by scanning the blocks if there is
+// no index. end is set to where the games stop.
+static bool index_archive(const std::uint8_t *data,
+                          std::size_t size,
+                          std::vector<ArchiveGameEntry> &games,
+                          std::uint64_t &end) {
+  if (size < sizeof(ArchiveHeader)) {
+    return false;
+  }
+  ArchiveHeader header = read_bytes<ArchiveHeader>(data);
+  if (std::memcmp(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0 ||
+      header.version != ARCHIVE_VERSION) {
+    return false;
+  }
+  games.clear();
+  if (size >= sizeof(ArchiveHeader) + sizeof(ArchiveTrailer)) {
+    ArchiveTrailer trailer = read_bytes<ArchiveTrailer>(data + size - sizeof(ArchiveTrailer));
+    if (std::memcmp(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(ARCHIVE_INDEX_MAGIC)) == 0 &&
+        trailer.index_offset >= sizeof(ArchiveHeader) &&
+        trailer.game_count <= size / sizeof(ArchiveGameEntry) &&
+        trailer.index_offset + trailer.game_count * sizeof(ArchiveGameEntry) +
+          sizeof(ArchiveTrailer) == size) {
+      for (std::uint64_t i = 0; i < trailer.game_count; i++) {
+        games.push_back(read_bytes<ArchiveGameEntry>(
+          data + trailer.index_offset + i * sizeof(ArchiveGameEntry)));
+      }
+      end = trailer.index_offset;
+      return true;
+    }
+  }
+  std::uint64_t offset = sizeof(ArchiveHeader);
+  GameBlockHeader block;
+  std::uint64_t block_size;
+  while (game_block_at(data, size, offset, block, block_size)) {
+    games.push_back({offset, block.steps});
+    offset += block_size;
+  }
+  end = offset;
+  return true;
+}
+
+bool open_archive_writer(const std::string &path,
+                         int keyframe_interval,
+                         ArchiveWriter &writer) {
+  if (keyframe_interval < 1) {
+    return false;
+  }
+  int fd = open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  writer = {fd, sizeof(ArchiveHeader), keyframe_interval, {}};
+  struct stat status;
+  bool opened = fstat(fd, &status) == 0;
+  if (opened && status.st_size == 0) {
+    ArchiveHeader header = {{}, ARCHIVE_VERSION, 0};
+    std::memcpy(header.magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC));
+    opened = write_all(fd, &header, sizeof(header), 0);
+  } else if (opened) {
+    void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    opened = mapping != MAP_FAILED &&
+             index_archive(static_cast<const std::uint8_t *>(mapping), status.st_size,
+                           writer.games, writer.end);
+    if (mapping != MAP_FAILED) {
+      munmap(mapping, status.st_size);
+    }
+    // New games go over the old index, which is rewritten on close.
+    opened = opened && ftruncate(fd, writer.end) == 0;
+  }
+  if (!opened) {
+    close(fd);
+    writer.fd = -1;
+  }
+  return opened;
+}
+
+static bool fits_in_32_bits(std::size_t size) {
+  return size <= std::numeric_limits<std::uint32_t>::max();
+}
+
+bool append_archived_game(ArchiveWriter &writer, const Replay &game) {
+  const std::vector<ReplayEvent> &events = game.events;
+  if (events.empty() || events.front().action != Action::NEW_GAME ||
+      !fits_in_32_bits(events.size()) ||
+      game.width < MAX_TETROMINO_WIDTH || game.width > ARCHIVE_MAX_FIELD_SIDE ||
+      game.height < MAX_TETROMINO_HEIGHT || game.height > ARCHIVE_MAX_FIELD_SIDE) {
+    return false;
+  }
+  for (std::size_t i = 1; i < events.size(); i++) {
+    if (action_symbol(events[i].action) < 0 ||
+        events[i].milliseconds < events[i - 1].milliseconds) {
+      return false;
+    }
+  }
+
+  std::uint32_t steps = static_cast<std::uint32_t>(events.size() - 1);
+  std::vector<KeyframeEntry> keyframes = {{0, events.front().milliseconds, 0, 0, 0, 0}};
+  std::vector<std::uint8_t> actions;
+  std::vector<std::uint8_t> times;
+  std::vector<std::uint8_t> states;
+  RangeEncoder action_encoder = new_range_encoder();
+  RangeEncoder time_encoder = new_range_encoder();
+  ColumnModels models = new_column_models();
+  GameState state = new_game(game.width, game.height, events.front().seed);
+  for (std::uint32_t step = 0; step < steps; step++) {
+    if (step > 0 && step % writer.keyframe_interval == 0) {
+      finish_range_encoder(action_encoder, actions);
+      finish_range_encoder(time_encoder, times);
+      Frame keyframe = encode_keyframe(state);
+      keyframes.push_back({
+        step,
+        events[step].milliseconds,
+        static_cast<std::uint32_t>(actions.size()),
+        static_cast<std::uint32_t>(times.size()),
+        static_cast<std::uint32_t>(states.size()),
+        static_cast<std::uint32_t>(keyframe.size())
+      });
+      states.insert(states.end(), keyframe.begin(), keyframe.end());
+      action_encoder = new_range_encoder();
+      time_encoder = new_range_encoder();
+      models = new_column_models();
+    }
+    const ReplayEvent &event = events[step + 1];
+    int symbol = action_symbol(event.action);
+    encode_action(action_encoder, models, symbol);
+    encode_time(time_encoder, models, symbol, event.milliseconds - events[step].milliseconds);
+    state = reduce(std::move(state), event.action);
+  }
+  finish_range_encoder(action_encoder, actions);
+  finish_range_encoder(time_encoder, times);
+  if (!fits_in_32_bits(actions.size()) || !fits_in_32_bits(times.size()) ||
+      !fits_in_32_bits(states.size())) {
+    return false;
+  }
+
+  GameBlockHeader header = {
+    GAME_BLOCK_MAGIC,
+    static_cast<std::uint16_t>(game.width),
+    static_cast<std::uint16_t>(game.height),
+    static_cast<std::uint64_t>(events.front().seed),
+    events.front().milliseconds,
+    steps,
+    static_cast<std::uint32_t>(writer.keyframe_interval),
+    static_cast<std::uint32_t>(keyframes.size()),
+    static_cast<std::uint32_t>(actions.size()),
+    static_cast<std::uint32_t>(times.size()),
+    static_cast<std::uint32_t>(states.size()),
+    0
+  };
+  std::vector<std::uint8_t> block;
+  append_bytes(block, header);
+  for (const KeyframeEntry &keyframe : keyframes) {
+    append_bytes(block, keyframe);
+  }
+  block.insert(block.end(), actions.begin(), actions.end());
+  block.insert(block.end(), times.begin(), times.end());
+  block.insert(block.end(), states.begin(), states.end());
+  if (!write_all(writer.fd, block.data(), block.size(), writer.end)) {
+    return false;
+  }
+  writer.games.push_back({writer.end, steps});
+  writer.end += block.size();
+  return true;
+}
+
+bool close_archive_writer(ArchiveWriter &writer) {
+  std::vector<std::uint8_t> index;
+  for (const ArchiveGameEntry &entry : writer.games) {
+    append_bytes(index, entry);
+  }
+  ArchiveTrailer trailer = {writer.end, writer.games.size(), {}};
+  std::memcpy(trailer.magic, ARCHIVE_INDEX_MAGIC, sizeof(ARCHIVE_INDEX_MAGIC));
+  append_bytes(index, trailer);
+  bool written = write_all(writer.fd, index.data(), index.size(), writer.end) &&
+                 ftruncate(writer.fd, writer.end + index.size()) == 0;
+  written = close(writer.fd) == 0 && written;
+  writer.fd = -1;
+  return written;
+}
+
+std::vector<Replay> split_replay_games(const Replay &replay) {
+  std::vector<Replay> games;
+  for (const ReplayEvent &event : replay.events) {
+    if (event.action == Action::NEW_GAME) {
+      games.push_back({replay.width, replay.height, {event}});
+    } else if (!games.empty()) {
+      games.back().events.push_back(event);
+    }
+  }
+  return games;
+}
+
+// Reading
+
+bool open_archive_reader(const std::string &path, ArchiveReader &reader) {
+  int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  if (fstat(fd, &status) != 0 || status.st_size < static_cast<off_t>(sizeof(ArchiveHeader))) {
+    close(fd);
+    return false;
+  }
+  void *mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  reader = {fd, static_cast<const std::uint8_t *>(mapping),
+            static_cast<std::size_t>(status.st_size), 0, {}};
+  if (!index_archive(reader.data, reader.size, reader.games, reader.end)) {
+    close_archive_reader(reader);
+    return false;
+  }
+  return true;
+}
+
+void close_archive_reader(ArchiveReader &reader) {
+  if (reader.data != nullptr) {
+    munmap(const_cast<std::uint8_t *>(reader.data), reader.size);
+    close(reader.fd);
+    reader.data = nullptr;
+  }
+}
+
+struct GameBlock {
+  GameBlockHeader header;
+  std::vector<KeyframeEntry> keyframes;
+  const std::uint8_t *actions;
+  const std::uint8_t *times;
+  const std::uint8_t *states;
+};
+
+static bool parse_game_block(const ArchiveReader &reader, std::size_t game, GameBlock &block) {
+  std::uint64_t block_size;
+  if (game >= reader.games.size() ||
+      !game_block_at(reader.data, reader.size, reader.games[game].offset, block.header, block_size)) {
+    return false;
+  }
+  const GameBlockHeader &header = block.header;
+  std::uint64_t interval = header.keyframe_interval;
+  if (header.width < MAX_TETROMINO_WIDTH || header.width > ARCHIVE_MAX_FIELD_SIDE ||
+      header.height < MAX_TETROMINO_HEIGHT || header.height > ARCHIVE_MAX_FIELD_SIDE ||
+      interval == 0 ||
+      header.keyframe_count != std::max<std::uint64_t>(1, (header.steps + interval - 1) / interval)) {
+    return false;
+  }
+  const std::uint8_t *data = reader.data + reader.games[game].offset + sizeof(GameBlockHeader);
+  block.keyframes.clear();
+  for (std::uint32_t i = 0; i < header.keyframe_count; i++) {
+    KeyframeEntry keyframe = read_bytes<KeyframeEntry>(data + i * sizeof(KeyframeEntry));
+    const KeyframeEntry *previous = i > 0 ? &block.keyframes.back() : nullptr;
+    if (keyframe.step != i * interval ||
+        keyframe.actions_offset > header.actions_size ||
+        keyframe.times_offset > header.times_size ||
+        keyframe.state_offset > header.states_size ||
+        keyframe.state_size > header.states_size - keyframe.state_offset ||
+        (i == 0) != (keyframe.state_size == 0) ||
+        (previous != nullptr &&
+         (keyframe.actions_offset < previous->actions_offset ||
+          keyframe.times_offset < previous->times_offset ||
+          keyframe.milliseconds < previous->milliseconds))) {
+      return false;
+    }
+    block.keyframes.push_back(keyframe);
+  }
+  block.actions = data + header.keyframe_count * sizeof(KeyframeEntry);
+  block.times = block.actions + header.actions_size;
+  block.states = block.times + header.times_size;
+  return true;
+}
+
+struct SegmentDecoder {
+  RangeDecoder actions;
+  RangeDecoder times;
+  ColumnModels models;
+  std::uint32_t milliseconds;
+};
+
+static SegmentDecoder start_segment(const GameBlock &block, std::size_t segment) {
+  const KeyframeEntry &keyframe = block.keyframes[segment];
+  bool last = segment + 1 == block.keyframes.size();
+  std::uint32_t actions_end = last ? block.header.actions_size
+                                   : block.keyframes[segment + 1].actions_offset;
+  std::uint32_t times_end = last ? block.header.times_size
+                                 : block.keyframes[segment + 1].times_offset;
+  return {
+    new_range_decoder(block.actions + keyframe.actions_offset,
+                      actions_end - keyframe.actions_offset),
+    new_range_decoder(block.times + keyframe.times_offset,
+                      times_end - keyframe.times_offset),
+    new_column_models(),
+    keyframe.milliseconds
+  };
+}
+
+static bool decode_event(SegmentDecoder &decoder, ReplayEvent &event) {
+  int symbol = decode_action(decoder.actions, decoder.models);
+  std::uint32_t delta;
+  if (symbol < 0 || !decode_time(decoder.times, decoder.models, symbol, delta) ||
+      delta > std::numeric_limits<std::uint32_t>::max() - decoder.milliseconds) {
+    return false;
+  }
+  decoder.milliseconds += delta;
+  event = {decoder.milliseconds, ARCHIVE_ACTIONS[symbol], 0};
+  return true;
+}
+
+bool read_archived_game(const ArchiveReader &reader, std::size_t game, Replay &replay) {
+  GameBlock block;
+  if (!parse_game_block(reader, game, block)) {
+    return false;
+  }
+  const GameBlockHeader &header = block.header;
+  replay = {header.width, header.height, {}};
+  replay.events.reserve(header.steps + 1);
+  replay.events.push_back({
+    header.start_milliseconds,
+    Action::NEW_GAME,
+    static_cast<RNG::result_type>(header.seed)
+  });
+  for (std::size_t segment = 0; segment < block.keyframes.size(); segment++) {
+    SegmentDecoder decoder = start_segment(block, segment);
+    std::uint32_t end = segment + 1 < block.keyframes.size()
+                          ? block.keyframes[segment + 1].step : header.steps;
+    for (std::uint32_t step = block.keyframes[segment].step; step < end; step++) {
+      ReplayEvent event;
+      if (!decode_event(decoder, event)) {
+        return false;
+      }
+      replay.events.push_back(event);
+    }
+  }
+  return true;
+}
+
+bool archived_game_state(const ArchiveReader &reader,
+                         std::size_t game,
+                         std::uint64_t step,
+                         GameState &state) {
+  GameBlock block;
+  if (!parse_game_block(reader, game, block) || step > block.header.steps) {
+    return false;
+  }
+  std::size_t segment = std::min<std::size_t>(step / block.header.keyframe_interval,
+                                              block.keyframes.size() - 1);
+  const KeyframeEntry &keyframe = block.keyframes[segment];
+  if (segment == 0) {
+    state = new_game(block.header.width, block.header.height,
+                     static_cast<RNG::result_type>(block.header.seed));
+  } else {
+    const std::uint8_t *frame = block.states + keyframe.state_offset;
+    DeltaDecoder keyframe_decoder = new_delta_decoder();
+    if (!apply_frame(keyframe_decoder, Frame(frame, frame + keyframe.state_size)) ||
+        !keyframe_decoder.synchronized ||
+        keyframe_decoder.state.field.width != block.header.width ||
+        keyframe_decoder.state.field.height != block.header.height) {
+      return false;
+    }
+    state = std::move(keyframe_decoder.state);
+  }
+  SegmentDecoder decoder = start_segment(block, segment);
+  for (std::uint64_t current = keyframe.step; current < step; current++) {
+    ReplayEvent event;
+    if (!decode_event(decoder, event)) {
+      return false;
+    }
+    state = reduce(std::move(state), event.action);
+  }
+  return true;
+}
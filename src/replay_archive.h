@@ -0,0 +1,76 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "replay.h"
+
+// A compact, seekable store for many recorded games.
+//
+// An archive is a header, one block per game, and an index of the blocks
+// that is written when the archive is closed. A block stores its columns
+// apart: the seed and field size, then the actions and the times between
+// them, each range coded with an adaptive model conditioned on the
+// action. Every keyframe_interval steps a block keeps a keyframe, the
+// whole GameState in the delta stream's keyframe encoding, and restarts
+// both coded columns there, so decoding step K of a game starts from the
+// nearest keyframe at or before K. Games are appended as they finish and
+// archives are read through a read-only mapping. An archive whose index
+// was never written, because its writer died, is recovered by scanning
+// the blocks. Numbers are in host byte order.
+
+const int ARCHIVE_DEFAULT_KEYFRAME_INTERVAL = 1024;
+
+// Games on larger fields are not archived, and blocks claiming them are
+// taken as damaged, so a flipped bit cannot ask for a huge field.
+const int ARCHIVE_MAX_FIELD_SIDE = 1024;
+
+struct ArchiveGameEntry {
+  std::uint64_t offset; // of the game's block
+  std::uint64_t steps;  // events after the game's NEW_GAME
+};
+
+struct ArchiveWriter {
+  int fd;
+  std::uint64_t end; // where the next block goes
+  int keyframe_interval;
+  std::vector<ArchiveGameEntry> games;
+};
+
+// Creates the archive at path, or opens an existing one to append to.
+bool open_archive_writer(const std::string &path,
+                         int keyframe_interval,
+                         ArchiveWriter &writer);
+
+// A game starts with its NEW_GAME event and has no other. Returns false
+// if it does not, or if the block could not be written.
+bool append_archived_game(ArchiveWriter &writer, const Replay &game);
+
+// Writes the index and closes the file.
+bool close_archive_writer(ArchiveWriter &writer);
+
+// Splits a recording into games at each NEW_GAME, dropping any events
+// before the first.
+std::vector<Replay> split_replay_games(const Replay &replay);
+
+struct ArchiveReader {
+  int fd;
+  const std::uint8_t *data;
+  std::size_t size;
+  std::uint64_t end; // where the games stop and the index starts
+  std::vector<ArchiveGameEntry> games;
+};
+
+bool open_archive_reader(const std::string &path, ArchiveReader &reader);
+void close_archive_reader(ArchiveReader &reader);
+
+// Decodes a whole game. Returns false if its block is damaged.
+bool read_archived_game(const ArchiveReader &reader, std::size_t game, Replay &replay);
+
+// The state after the given number of steps, step 0 being the new game.
+bool archived_game_state(const ArchiveReader &reader,
+                         std::size_t game,
+                         std::uint64_t step,
+                         GameState &state);
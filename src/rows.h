@@ -0,0 +1,123 @@
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <utility>
+#include <vector>
+
+enum class CellState {
+  EMPTY,
+  FILLED
+};
+
+typedef std::vector<CellState> Line;
+
+template <typename RowsType, typename Value>
+class RowIterator {
+public:
+  typedef std::forward_iterator_tag iterator_category;
+  typedef Line value_type;
+  typedef std::ptrdiff_t difference_type;
+  typedef Value *pointer;
+  typedef Value &reference;
+
+  RowIterator(RowsType *rows, std::size_t y) : rows(rows), y(y) {}
+
+  Value &operator*() const { return (*rows)[y]; }
+  Value *operator->() const { return &(*rows)[y]; }
+  RowIterator &operator++() { y++; return *this; }
+  RowIterator operator++(int) { RowIterator old = *this; y++; return old; }
+  bool operator==(const RowIterator &other) const { return y == other.y; }
+  bool operator!=(const RowIterator &other) const { return y != other.y; }
+
+private:
+  RowsType *rows;
+  std::size_t y;
+};
+
+// The rows of a field, bottom first, indexed and iterated like a vector
+// of lines.
+//
+// The rows sit in a ring: row 0 is wherever base points. Removing rows
+// rotates the ring rather than moving every row above them, and the
+// removed rows, blanked, become the new empty rows at the top, so the
+// ring never allocates after it is built. Rows are moved by swapping,
+// which only exchanges their buffers.
+class Rows {
+public:
+  typedef RowIterator<Rows, Line> iterator;
+  typedef RowIterator<const Rows, const Line> const_iterator;
+
+  Rows() : base(0) {}
+  // Implicit, so that a field can still be built from a vector of lines.
+  Rows(std::vector<Line> lines) : storage(std::move(lines)), base(0) {}
+
+  std::size_t size() const { return storage.size(); }
+
+  Line &operator[](std::size_t y) { return storage[physical(y)]; }
+  const Line &operator[](std::size_t y) const { return storage[physical(y)]; }
+
+  iterator begin() { return iterator(this, 0); }
+  iterator end() { return iterator(this, size()); }
+  const_iterator begin() const { return const_iterator(this, 0); }
+  const_iterator end() const { return const_iterator(this, size()); }
+
+  // Removes the rows listed, in ascending order, shifting the rows above
+  // them down and adding empty rows at the top. Costs a swap for each row
+  // below the highest removed one or above the lowest, whichever is
+  // fewer, plus blanking the removed rows.
+  void remove(const int *removed, int count) {
+    if (count == 0) {
+      return;
+    }
+    int lowest = removed[0];
+    int highest = removed[count - 1];
+    if (highest + 1 <= static_cast<int>(size()) - lowest) {
+      // Carry the surviving rows below highest up over the removed ones,
+      // leaving those at the bottom, then rotate them round to the top.
+      int gap = 0;
+      for (int y = highest, next = count - 1; y >= 0; y--) {
+        if (next >= 0 && removed[next] == y) {
+          gap++;
+          next--;
+        } else if (gap > 0) {
+          std::swap((*this)[y], (*this)[y + gap]);
+        }
+      }
+      for (int y = 0; y < count; y++) {
+        std::fill((*this)[y].begin(), (*this)[y].end(), CellState::EMPTY);
+      }
+      base = physical(count);
+    } else {
+      // Carry the rows above lowest down over the removed ones, leaving
+      // those at the top.
+      int gap = 0;
+      for (int y = lowest, next = 0; y < static_cast<int>(size()); y++) {
+        if (next < count && removed[next] == y) {
+          gap++;
+          next++;
+        } else if (gap > 0) {
+          std::swap((*this)[y], (*this)[y - gap]);
+        }
+      }
+      for (int y = static_cast<int>(size()) - count; y < static_cast<int>(size()); y++) {
+        std::fill((*this)[y].begin(), (*this)[y].end(), CellState::EMPTY);
+      }
+    }
+  }
+
+  bool operator==(const Rows &other) const {
+    return size() == other.size() && std::equal(begin(), end(), other.begin());
+  }
+  bool operator!=(const Rows &other) const { return !(*this == other); }
+
+private:
+  std::size_t physical(std::size_t y) const {
+    std::size_t index = base + y;
+    return index < storage.size() ? index : index - storage.size();
+  }
+
+  std::vector<Line> storage;
+  std::size_t base;
+};
@@ -0,0 +1,449 @@
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "metrics.h"
+#include "session_protocol.h"
+#include "shared_state.h"
+#include "state.h"
+#include "timer_wheel.h"
+
+// Runs many independent games in one process. Each connection owns one
+// GameState; input is applied with reduce as it arrives and gravity is
+// driven for every session from a single timer wheel, so the cost of a
+// session is one socket and one wheel entry rather than one thread or
+// one OS timer.
+
+const int TICK_MILLISECONDS = 5;
+const int WHEEL_SLOTS = 1024;
+const int MAX_EVENTS = 256;
+const std::size_t MAX_PENDING_OUTPUT = 64 * 1024;
+const std::uint32_t LISTENER_ID = 0xFFFFFFFF;
+const int METRICS_FILE_MILLISECONDS = 1000;
+
+struct Session {
+  int fd;
+  GameState game_state;
+  unsigned timer_generation;
+  std::uint32_t actions_applied;
+  std::vector<std::uint8_t> pending_output;
+  bool watching_output;
+  StatePublisher publisher; // header is null unless publishing
+};
+
+struct ServerState {
+  int epoll_fd;
+  int listen_fd;
+  TimerWheel wheel;
+  std::vector<Session> sessions; // indexed by id; fd < 0 when free
+  std::vector<int> free_ids;
+  int active_sessions;
+  std::uint64_t actions_total;
+  std::uint64_t gravity_total;
+  std::string publish_prefix; // sessions are published as PREFIX-ID if set
+};
+
+volatile sig_atomic_t should_quit = 0;
+
+void handle_signal(int) {
+  should_quit = 1;
+}
+
+std::uint64_t now_milliseconds() {
+  return std::chrono::duration_cast<std::chrono::milliseconds>(
+    std::chrono::steady_clock::now().time_since_epoch()
+  ).count();
+}
+
+bool set_nonblocking(int fd) {
+  int flags = fcntl(fd, F_GETFL, 0);
+  return flags >= 0 && fcntl(fd, F_SETFL, flags | O_NONBLOCK) == 0;
+}
+
+void raise_file_limit() {
+  struct rlimit limit;
+  if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+    limit.rlim_cur = limit.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &limit);
+  }
+}
+
+int listen_unix(const char *path) {
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  struct sockaddr_un address;
+  std::memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  std::strncpy(address.sun_path, path, sizeof(address.sun_path) - 1);
+  unlink(path);
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+int listen_loopback(int port) {
+  int fd = socket(AF_INET, SOCK_STREAM, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  int yes = 1;
+  setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &yes, sizeof(yes));
+  struct sockaddr_in address;
+  std::memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_port = htons(port);
+  address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+  if (bind(fd, reinterpret_cast<struct sockaddr *>(&address), sizeof(address)) != 0 ||
+      listen(fd, SOMAXCONN) != 0) {
+    close(fd);
+    return -1;
+  }
+  return fd;
+}
+
+void close_session(ServerState &server, int id) {
+  Session &session = server.sessions[id];
+  epoll_ctl(server.epoll_fd, EPOLL_CTL_DEL, session.fd, nullptr);
+  close(session.fd);
+  session.fd = -1;
+  session.timer_generation++; // orphan any pending gravity timer
+  session.pending_output.clear();
+  session.pending_output.shrink_to_fit();
+  close_state_publisher(session.publisher);
+  server.free_ids.push_back(id);
+  server.active_sessions--;
+}
+
+void watch_output(ServerState &server, int id, bool want_output) {
+  if (server.sessions[id].watching_output == want_output) {
+    return; // avoid a syscall per report in the common case
+  }
+  server.sessions[id].watching_output = want_output;
+  struct epoll_event event;
+  event.events = want_output ? EPOLLIN | EPOLLOUT : EPOLLIN;
+  event.data.u32 = id;
+  epoll_ctl(server.epoll_fd, EPOLL_CTL_MOD, server.sessions[id].fd, &event);
+}
+
+// Returns false if the session had to be closed.
+bool flush_output(ServerState &server, int id) {
+  Session &session = server.sessions[id];
+  std::size_t sent = 0;
+  while (sent < session.pending_output.size()) {
+    ssize_t written = send(session.fd,
+                           session.pending_output.data() + sent,
+                           session.pending_output.size() - sent,
+                           MSG_NOSIGNAL);
+    if (written < 0) {
+      if (errno == EAGAIN || errno == EWOULDBLOCK) {
+        break;
+      }
+      close_session(server, id);
+      return false;
+    }
+    sent += written;
+  }
+  bool was_blocked = sent < session.pending_output.size();
+  session.pending_output.erase(session.pending_output.begin(),
+                               session.pending_output.begin() + sent);
+  watch_output(server, id, was_blocked);
+  return true;
+}
+
+bool send_report(ServerState &server, int id) {
+  Session &session = server.sessions[id];
+  // Observers see every state the client is sent.
+  if (session.publisher.header != nullptr) {
+    publish_game_state(session.publisher, session.game_state);
+  }
+  std::uint8_t buffer[STATUS_REPORT_SIZE];
+  encode_status_report(
+    make_status_report(session.game_state, session.actions_applied),
+    buffer
+  );
+  bool was_idle = session.pending_output.empty();
+  session.pending_output.insert(session.pending_output.end(),
+                                buffer,
+                                buffer + STATUS_REPORT_SIZE);
+  if (session.pending_output.size() > MAX_PENDING_OUTPUT) {
+    close_session(server, id); // client is not reading; drop it
+    return false;
+  }
+  return was_idle ? flush_output(server, id) : true;
+}
+
+void schedule_gravity(ServerState &server, int id, std::uint64_t now) {
+  Session &session = server.sessions[id];
+  session.timer_generation++;
+  schedule_timer(server.wheel,
+                 id,
+                 session.timer_generation,
+                 now + session.game_state.milliseconds_per_turn);
+}
+
+void accept_sessions(ServerState &server) {
+  while (true) {
+    int fd = accept(server.listen_fd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+        std::fprintf(stderr, "accept failed: %s\n", std::strerror(errno));
+      }
+      return;
+    }
+    set_nonblocking(fd);
+    int yes = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &yes, sizeof(yes));
+
+    int id;
+    if (server.free_ids.empty()) {
+      id = server.sessions.size();
+      server.sessions.push_back({-1, {}, 0, 0, {}, false, {}});
+    } else {
+      id = server.free_ids.back();
+      server.free_ids.pop_back();
+    }
+    Session &session = server.sessions[id];
+    session.fd = fd;
+    session.actions_applied = 0;
+    session.watching_output = false;
+
+    struct epoll_event event;
+    event.events = EPOLLIN;
+    event.data.u32 = id;
+    if (epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      close(fd);
+      session.fd = -1;
+      server.free_ids.push_back(id);
+      continue;
+    }
+    server.active_sessions++;
+
+    std::uint64_t now = now_milliseconds();
+    session.game_state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, now ^ (id * 2654435761u));
+    record_game_started();
+    if (!server.publish_prefix.empty()) {
+      std::string name = server.publish_prefix + "-" + std::to_string(id);
+      if (!open_state_publisher(name, DEFAULT_WIDTH, DEFAULT_HEIGHT, session.publisher)) {
+        std::fprintf(stderr, "Unable to publish %s: %s\n", name.c_str(), std::strerror(errno));
+      }
+    }
+    schedule_gravity(server, id, now);
+    send_report(server, id);
+  }
+}
+
+void read_actions(ServerState &server, int id) {
+  std::uint8_t buffer[4096];
+  bool any_applied = false;
+  while (true) {
+    Session &session = server.sessions[id];
+    ssize_t count = read(session.fd, buffer, sizeof(buffer));
+    if (count == 0 || (count < 0 && errno != EAGAIN && errno != EWOULDBLOCK)) {
+      close_session(server, id);
+      return;
+    }
+    if (count < 0) {
+      break;
+    }
+    for (ssize_t i = 0; i < count; i++) {
+      if (!is_valid_action_byte(buffer[i])) {
+        continue;
+      }
+      Action action = static_cast<Action>(buffer[i]);
+      if (action == Action::QUIT) {
+        close_session(server, id);
+        return;
+      }
+      session.game_state = measured_reduce(std::move(session.game_state), action);
+      session.actions_applied++;
+      server.actions_total++;
+      any_applied = true;
+      // As in the local game, a manual drop or a new game restarts the
+      // gravity interval.
+      if (action == Action::MOVE_DOWN || action == Action::NEW_GAME) {
+        schedule_gravity(server, id, now_milliseconds());
+      }
+    }
+    if (count < static_cast<ssize_t>(sizeof(buffer))) {
+      break;
+    }
+  }
+  if (any_applied) {
+    send_report(server, id);
+  }
+}
+
+void apply_gravity(ServerState &server, const std::vector<TimerEntry> &expired) {
+  std::uint64_t now = now_milliseconds();
+  for (const TimerEntry &entry : expired) {
+    Session &session = server.sessions[entry.id];
+    if (session.fd < 0 || session.timer_generation != entry.generation) {
+      continue; // closed, or rescheduled since this timer was set
+    }
+    session.game_state = measured_reduce(std::move(session.game_state), Action::TIME_FALL);
+    server.gravity_total++;
+    schedule_gravity(server, entry.id, now);
+    send_report(server, entry.id);
+  }
+}
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--unix PATH | --port PORT]\n"
+               "          [--metrics-port PORT] [--metrics-file PATH] [--publish PREFIX]\n"
+               "Serves one game per connection; default is 127.0.0.1:7777.\n"
+               "Metrics are served in Prometheus text format over HTTP on\n"
+               "127.0.0.1:PORT, or rewritten to PATH every second. With\n"
+               "--publish, each session's game is shared with local processes\n"
+               "in the shared memory segment PREFIX-ID.\n",
+               program);
+}
+
+int main(int argc, char *argv[]) {
+  const char *unix_path = nullptr;
+  int port = 7777;
+  int metrics_port = 0;
+  std::string metrics_file;
+  std::string publish_prefix;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--unix" && i + 1 < argc) {
+      unix_path = argv[++i];
+    } else if (arg == "--port" && i + 1 < argc) {
+      port = std::atoi(argv[++i]);
+    } else if (arg == "--metrics-port" && i + 1 < argc) {
+      metrics_port = std::atoi(argv[++i]);
+    } else if (arg == "--metrics-file" && i + 1 < argc) {
+      metrics_file = argv[++i];
+    } else if (arg == "--publish" && i + 1 < argc) {
+      publish_prefix = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+
+  raise_file_limit();
+  signal(SIGINT, handle_signal);
+  signal(SIGTERM, handle_signal);
+  signal(SIGPIPE, SIG_IGN);
+
+  ServerState server = {
+    epoll_create1(0),
+    unix_path ? listen_unix(unix_path) : listen_loopback(port),
+    new_timer_wheel(TICK_MILLISECONDS, WHEEL_SLOTS, now_milliseconds()),
+    {},
+    {},
+    0,
+    0,
+    0,
+    publish_prefix
+  };
+  if (server.epoll_fd < 0 || server.listen_fd < 0) {
+    std::fprintf(stderr, "Unable to listen: %s\n", std::strerror(errno));
+    return 1;
+  }
+  set_nonblocking(server.listen_fd);
+  struct epoll_event listen_event;
+  listen_event.events = EPOLLIN;
+  listen_event.data.u32 = LISTENER_ID;
+  epoll_ctl(server.epoll_fd, EPOLL_CTL_ADD, server.listen_fd, &listen_event);
+
+  if (unix_path) {
+    std::fprintf(stderr, "Listening on %s\n", unix_path);
+  } else {
+    std::fprintf(stderr, "Listening on 127.0.0.1:%d\n", port);
+  }
+  if (metrics_port > 0) {
+    if (!start_metrics_endpoint(metrics_port)) {
+      std::fprintf(stderr, "Unable to serve metrics: %s\n", std::strerror(errno));
+      return 1;
+    }
+    std::fprintf(stderr, "Metrics on http://127.0.0.1:%d/metrics\n", metrics_port);
+  }
+  if (!metrics_file.empty()) {
+    start_metrics_file_writer(metrics_file, METRICS_FILE_MILLISECONDS);
+  }
+
+  std::vector<TimerEntry> expired;
+  struct epoll_event events[MAX_EVENTS];
+  std::uint64_t last_log = now_milliseconds();
+  std::uint64_t last_actions = 0;
+  while (!should_quit) {
+    int timeout = milliseconds_until_next_tick(server.wheel, now_milliseconds());
+    int ready = epoll_wait(server.epoll_fd, events, MAX_EVENTS, timeout);
+    if (ready < 0 && errno != EINTR) {
+      std::fprintf(stderr, "epoll_wait failed: %s\n", std::strerror(errno));
+      break;
+    }
+    for (int i = 0; i < ready; i++) {
+      std::uint32_t id = events[i].data.u32;
+      if (id == LISTENER_ID) {
+        accept_sessions(server);
+        continue;
+      }
+      if (server.sessions[id].fd < 0) {
+        continue; // closed earlier in this batch
+      }
+      if (events[i].events & (EPOLLERR | EPOLLHUP)) {
+        close_session(server, id);
+        continue;
+      }
+      if ((events[i].events & EPOLLOUT) && !flush_output(server, id)) {
+        continue;
+      }
+      if (events[i].events & EPOLLIN) {
+        read_actions(server, id);
+      }
+    }
+
+    std::uint64_t now = now_milliseconds();
+    expired.clear();
+    advance_timer_wheel(server.wheel, now, expired);
+    apply_gravity(server, expired);
+
+    if (now - last_log >= 5000) {
+      std::fprintf(stderr,
+                   "sessions: %d, actions/s: %.0f, gravity steps: %llu\n",
+                   server.active_sessions,
+                   (server.actions_total - last_actions) * 1000.0 / (now - last_log),
+                   static_cast<unsigned long long>(server.gravity_total));
+      last_log = now;
+      last_actions = server.actions_total;
+    }
+  }
+
+  for (std::size_t id = 0; id < server.sessions.size(); id++) {
+    if (server.sessions[id].fd >= 0) {
+      close_session(server, id);
+    }
+  }
+  close(server.listen_fd);
+  close(server.epoll_fd);
+  if (unix_path) {
+    unlink(unix_path);
+  }
+  return 0;
+}
@@ -0,0 +1,62 @@
+#include "session_protocol.h"
+
+bool is_valid_action_byte(std::uint8_t byte) {
+  return byte <= static_cast<std::uint8_t>(Action::ROTATE_COUNTERCLOCKWISE);
+}
+
+StatusReport make_status_report(const GameState &state,
+                                std::uint32_t actions_applied) {
+  return {
+    actions_applied,
+    static_cast<std::uint32_t>(state.score),
+    static_cast<std::uint16_t>(state.lines),
+    static_cast<std::int8_t>(state.active_block.position_x),
+    static_cast<std::int8_t>(state.active_block.position_y),
+    state.active_block.tetromino,
+    state.active_block.rotation,
+    state.next_block,
+    state.progress
+  };
+}
+
+static void put_u32(std::uint8_t *out, std::uint32_t value) {
+  out[0] = value & 0xFF;
+  out[1] = (value >> 8) & 0xFF;
+  out[2] = (value >> 16) & 0xFF;
+  out[3] = (value >> 24) & 0xFF;
+}
+
+static std::uint32_t get_u32(const std::uint8_t *in) {
+  return static_cast<std::uint32_t>(in[0])
+       | static_cast<std::uint32_t>(in[1]) << 8
+       | static_cast<std::uint32_t>(in[2]) << 16
+       | static_cast<std::uint32_t>(in[3]) << 24;
+}
+
+void encode_status_report(const StatusReport &report,
+                          std::uint8_t buffer[STATUS_REPORT_SIZE]) {
+  put_u32(buffer, report.actions_applied);
+  put_u32(buffer + 4, report.score);
+  buffer[8] = report.lines & 0xFF;
+  buffer[9] = (report.lines >> 8) & 0xFF;
+  buffer[10] = static_cast<std::uint8_t>(report.position_x);
+  buffer[11] = static_cast<std::uint8_t>(report.position_y);
+  buffer[12] = static_cast<std::uint8_t>(report.tetromino);
+  buffer[13] = static_cast<std::uint8_t>(report.rotation);
+  buffer[14] = static_cast<std::uint8_t>(report.next_block);
+  buffer[15] = static_cast<std::uint8_t>(report.progress);
+}
+
+StatusReport decode_status_report(const std::uint8_t buffer[STATUS_REPORT_SIZE]) {
+  return {
+    get_u32(buffer),
+    get_u32(buffer + 4),
+    static_cast<std::uint16_t>(buffer[8] | buffer[9] << 8),
+    static_cast<std::int8_t>(buffer[10]),
+    static_cast<std::int8_t>(buffer[11]),
+    static_cast<Tetromino>(buffer[12]),
+    static_cast<Rotation>(buffer[13]),
+    static_cast<Tetromino>(buffer[14]),
+    static_cast<GameProgress>(buffer[15])
+  };
+}
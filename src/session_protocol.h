@@ -0,0 +1,33 @@
+#pragma once
+
+#include <cstdint>
+
+#include "state.h"
+
+// Wire format shared by TetrisServer and TetrisLoadGen.
+//
+// Clients send a stream of single bytes, each the numeric value of an
+// Action. After handling a batch of input, and after every gravity step,
+// the server answers with one fixed-size little-endian StatusReport.
+
+const int STATUS_REPORT_SIZE = 16;
+
+struct StatusReport {
+  std::uint32_t actions_applied; // running count of client actions handled
+  std::uint32_t score;
+  std::uint16_t lines;
+  std::int8_t position_x;
+  std::int8_t position_y;
+  Tetromino tetromino;
+  Rotation rotation;
+  Tetromino next_block;
+  GameProgress progress;
+};
+
+bool is_valid_action_byte(std::uint8_t byte);
+
+StatusReport make_status_report(const GameState &state,
+                                std::uint32_t actions_applied);
+void encode_status_report(const StatusReport &report,
+                          std::uint8_t buffer[STATUS_REPORT_SIZE]);
+StatusReport decode_status_report(const std::uint8_t buffer[STATUS_REPORT_SIZE]);
@@ -0,0 +1,273 @@
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <vector>
+
+#include "shared_state.h"
+
+const std::uint64_t SHARED_STATE_MAGIC = 0x004D485352544554ull; // "TETRSHM"
+const std::uint32_t SHARED_STATE_VERSION = 1;
+
+struct SharedStateHeader {
+  std::uint64_t magic; // stored last, once the rest is set
+  std::uint32_t version;
+  std::uint32_t width;
+  std::uint32_t height;
+  std::uint32_t word_count;
+  std::uint64_t sequence; // odd while the writer is mid-write
+  std::uint8_t reserved[32];
+};
+
+static_assert(sizeof(SharedStateHeader) == 64, "shared state header layout");
+
+// The published words, after the header. The cells follow the rest, one
+// bit each, bottom row first.
+enum SharedStateWord {
+  WORD_POSITION_X,
+  WORD_POSITION_Y,
+  WORD_TETROMINO,
+  WORD_ROTATION,
+  WORD_NEXT_BLOCK,
+  WORD_MILLISECONDS_PER_TURN,
+  WORD_SCORE,
+  WORD_LINES,
+  WORD_PROGRESS,
+  WORD_CELLS
+};
+
+static std::uint32_t word_count(int width, int height) {
+  return WORD_CELLS + (static_cast<std::uint32_t>(width * height) + 63) / 64;
+}
+
+static std::size_t segment_size(std::uint32_t words) {
+  return sizeof(SharedStateHeader) + words * sizeof(std::uint64_t);
+}
+
+static std::uint64_t *words_of(SharedStateHeader *header) {
+  return reinterpret_cast<std::uint64_t *>(header + 1);
+}
+
+static const std::uint64_t *words_of(const SharedStateHeader *header) {
+  return reinterpret_cast<const std::uint64_t *>(header + 1);
+}
+
+static std::string segment_name(const std::string &name) {
+  return name.compare(0, 1, "/") == 0 ? name : "/" + name;
+}
+
+bool open_state_publisher(const std::string &name,
+                          int width,
+                          int height,
+                          StatePublisher &publisher) {
+  if (width <= 0 || height <= 0) {
+    return false;
+  }
+  // A fresh segment rather than reusing a stale one, so observers still
+  // mapping the old one never see it resized under them.
+  std::string path = segment_name(name);
+  shm_unlink(path.c_str());
+  int fd = shm_open(path.c_str(), O_RDWR | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  std::uint32_t words = word_count(width, height);
+  std::size_t size = segment_size(words);
+  void *mapping = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) {
+    mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    shm_unlink(path.c_str());
+    return false;
+  }
+
+  SharedStateHeader *header = static_cast<SharedStateHeader *>(mapping);
+  header->version = SHARED_STATE_VERSION;
+  header->width = width;
+  header->height = height;
+  header->word_count = words;
+  header->sequence = 0;
+  __atomic_store_n(&header->magic, SHARED_STATE_MAGIC, __ATOMIC_RELEASE);
+  publisher = {path, fd, size, header, width, height, 0};
+  return true;
+}
+
+void close_state_publisher(StatePublisher &publisher) {
+  if (publisher.header != nullptr) {
+    munmap(publisher.header, publisher.mapping_size);
+    close(publisher.fd);
+    shm_unlink(publisher.name.c_str());
+    publisher.header = nullptr;
+  }
+}
+
+static void store_word(std::uint64_t *words, int index, std::uint64_t value) {
+  __atomic_store_n(&words[index], value, __ATOMIC_RELAXED);
+}
+
+bool publish_game_state(StatePublisher &publisher, const GameState &state) {
+  if (state.field.width != publisher.width || state.field.height != publisher.height) {
+    return false;
+  }
+  SharedStateHeader *header = publisher.header;
+  std::uint64_t *words = words_of(header);
+  // Only this process writes the sequence, so it can be read plainly.
+  std::uint64_t sequence = __atomic_load_n(&header->sequence, __ATOMIC_RELAXED);
+  __atomic_store_n(&header->sequence, sequence + 1, __ATOMIC_RELAXED);
+  // Keeps the words below from being seen before the odd sequence.
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  const ActiveBlock &block = state.active_block;
+  store_word(words, WORD_POSITION_X, static_cast<std::int64_t>(block.position_x));
+  store_word(words, WORD_POSITION_Y, static_cast<std::int64_t>(block.position_y));
+  store_word(words, WORD_TETROMINO, static_cast<std::uint64_t>(block.tetromino));
+  store_word(words, WORD_ROTATION, static_cast<std::uint64_t>(block.rotation));
+  store_word(words, WORD_NEXT_BLOCK, static_cast<std::uint64_t>(state.next_block));
+  store_word(words, WORD_MILLISECONDS_PER_TURN,
+             static_cast<std::int64_t>(state.milliseconds_per_turn));
+  store_word(words, WORD_SCORE, static_cast<std::int64_t>(state.score));
+  store_word(words, WORD_LINES, static_cast<std::int64_t>(state.lines));
+  store_word(words, WORD_PROGRESS, static_cast<std::uint64_t>(state.progress));
+
+  // The cells from the last publish are still in place, and only this
+  // process writes them.
+  if (!same_version(publisher.field_version, state.versions.field)) {
+    publisher.field_version = state.versions.field;
+    std::uint64_t bits = 0;
+    int cell = 0;
+    int index = WORD_CELLS;
+    for (const Line &line : state.field.lines) {
+      for (CellState value : line) {
+        if (value == CellState::FILLED) {
+          bits |= 1ull << cell;
+        }
+        if (++cell == 64) {
+          store_word(words, index++, bits);
+          bits = 0;
+          cell = 0;
+        }
+      }
+    }
+    if (cell > 0) {
+      store_word(words, index, bits);
+    }
+  }
+
+  __atomic_store_n(&header->sequence, sequence + 2, __ATOMIC_RELEASE);
+  return true;
+}
+
+bool open_state_observer(const std::string &name, StateObserver &observer) {
+  int fd = shm_open(segment_name(name).c_str(), O_RDONLY | O_CLOEXEC, 0);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat status;
+  void *mapping = MAP_FAILED;
+  if (fstat(fd, &status) == 0 &&
+      static_cast<std::size_t>(status.st_size) >= sizeof(SharedStateHeader)) {
+    mapping = mmap(nullptr, status.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  if (mapping == MAP_FAILED) {
+    close(fd);
+    return false;
+  }
+  const SharedStateHeader *header = static_cast<const SharedStateHeader *>(mapping);
+  bool valid = __atomic_load_n(&header->magic, __ATOMIC_ACQUIRE) == SHARED_STATE_MAGIC &&
+               header->version == SHARED_STATE_VERSION &&
+               header->width > 0 &&
+               header->height > 0 &&
+               header->word_count == word_count(header->width, header->height) &&
+               static_cast<std::size_t>(status.st_size) == segment_size(header->word_count);
+  if (!valid) {
+    munmap(mapping, status.st_size);
+    close(fd);
+    return false;
+  }
+  observer = {
+    fd,
+    static_cast<std::size_t>(status.st_size),
+    header,
+    static_cast<int>(header->width),
+    static_cast<int>(header->height)
+  };
+  return true;
+}
+
+void close_state_observer(StateObserver &observer) {
+  if (observer.header != nullptr) {
+    munmap(const_cast<SharedStateHeader *>(observer.header), observer.mapping_size);
+    close(observer.fd);
+    observer.header = nullptr;
+  }
+}
+
+std::uint64_t published_state_version(const StateObserver &observer) {
+  return __atomic_load_n(&observer.header->sequence, __ATOMIC_ACQUIRE) / 2;
+}
+
+static void decode_state(const std::vector<std::uint64_t> &words,
+                         int width,
+                         int height,
+                         GameState &state) {
+  state.active_block = {
+    static_cast<int>(static_cast<std::int64_t>(words[WORD_POSITION_X])),
+    static_cast<int>(static_cast<std::int64_t>(words[WORD_POSITION_Y])),
+    static_cast<Tetromino>(words[WORD_TETROMINO]),
+    static_cast<Rotation>(words[WORD_ROTATION])
+  };
+  state.next_block = static_cast<Tetromino>(words[WORD_NEXT_BLOCK]);
+  state.milliseconds_per_turn =
+    static_cast<int>(static_cast<std::int64_t>(words[WORD_MILLISECONDS_PER_TURN]));
+  state.score = static_cast<int>(static_cast<std::int64_t>(words[WORD_SCORE]));
+  state.lines = static_cast<int>(static_cast<std::int64_t>(words[WORD_LINES]));
+  state.progress = static_cast<GameProgress>(words[WORD_PROGRESS]);
+
+  if (state.field.width != width || state.field.height != height ||
+      static_cast<int>(state.field.lines.size()) != height) {
+    state.field = {height, width, std::vector<Line>(height, Line(width, CellState::EMPTY))};
+  }
+  int cell = 0;
+  for (Line &line : state.field.lines) {
+    for (CellState &value : line) {
+      bool filled = (words[WORD_CELLS + cell / 64] >> (cell % 64)) & 1;
+      value = filled ? CellState::FILLED : CellState::EMPTY;
+      cell++;
+    }
+  }
+  refresh_versions(state);
+}
+
+bool read_published_state(const StateObserver &observer,
+                          GameState &state,
+                          std::uint64_t &version) {
+  const SharedStateHeader *header = observer.header;
+  const std::uint64_t *words = words_of(header);
+  // A copy per thread, so a torn read is never decoded and reading does
+  // not allocate once the buffer has grown.
+  thread_local std::vector<std::uint64_t> copy;
+  copy.resize(header->word_count);
+  for (int attempt = 0; attempt < SHARED_STATE_READ_ATTEMPTS; attempt++) {
+    std::uint64_t before = __atomic_load_n(&header->sequence, __ATOMIC_ACQUIRE);
+    if (before == 0) {
+      return false;
+    }
+    if (before % 2 == 1) {
+      continue;
+    }
+    for (std::size_t i = 0; i < copy.size(); i++) {
+      copy[i] = __atomic_load_n(&words[i], __ATOMIC_RELAXED);
+    }
+    // Keeps the copy above from being read after the sequence below.
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&header->sequence, __ATOMIC_RELAXED) == before) {
+      decode_state(copy, observer.width, observer.height, state);
+      version = before / 2;
+      return true;
+    }
+  }
+  return false;
+}
@@ -0,0 +1,75 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "state.h"
+
+// Publishes a live game to other local processes through a POSIX shared
+// memory segment, for overlays, stream encoders and out-of-process bots.
+//
+// The segment holds one copy of the state, packed into 64-bit words with
+// the field as one bit per cell, behind a seqlock: the writer makes the
+// sequence odd, rewrites the words and makes it even again, so it never
+// waits for anyone. Readers copy the words and keep the copy only if the
+// sequence was even and unchanged around it, retrying otherwise. Neither
+// side takes a lock or makes a syscall once the segment is mapped, and
+// any number of readers can watch one writer. Every word is accessed
+// atomically, so a torn copy is discarded rather than undefined.
+//
+// The generator is not published; readers get the rest of the GameState.
+
+struct SharedStateHeader;
+
+struct StatePublisher {
+  std::string name;
+  int fd;
+  std::size_t mapping_size;
+  SharedStateHeader *header;
+  int width;
+  int height;
+  std::uint64_t field_version; // of the cells last published
+};
+
+struct StateObserver {
+  int fd;
+  std::size_t mapping_size;
+  const SharedStateHeader *header;
+  int width;
+  int height;
+};
+
+// Names follow shm_open, with the leading slash optional. Creates the
+// segment for a field of the given size, replacing any stale segment of
+// the same name. Returns false if it cannot be created or mapped.
+bool open_state_publisher(const std::string &name,
+                          int width,
+                          int height,
+                          StatePublisher &publisher);
+// Unmaps and removes the segment; observers keep their mapping.
+void close_state_publisher(StatePublisher &publisher);
+
+// Returns false, publishing nothing, if the field is not the size the
+// segment was created for. The cells are only rewritten when the field's
+// version differs from the last one published.
+bool publish_game_state(StatePublisher &publisher, const GameState &state);
+
+// Returns false if there is no such segment or it is not a published game.
+bool open_state_observer(const std::string &name, StateObserver &observer);
+void close_state_observer(StateObserver &observer);
+
+// Counts the states published so far, so a reader can poll for changes
+// without copying anything.
+std::uint64_t published_state_version(const StateObserver &observer);
+
+// Copies the latest state into state, reusing its rows when the field is
+// already the right size, and sets version to the one copied. The state
+// gets fresh versions. Returns
+// false if nothing has been published yet, or if the writer was still
+// mid-write after SHARED_STATE_READ_ATTEMPTS tries, as when it died
+// halfway through one.
+const int SHARED_STATE_READ_ATTEMPTS = 1000;
+bool read_published_state(const StateObserver &observer,
+                          GameState &state,
+                          std::uint64_t &version);
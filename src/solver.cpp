@@ -0,0 +1,556 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+
+#include "placements.h"
+#include "solver.h"
+
+const int SOLVER_MAX_WIDTH = 32;
+const int SOLVER_MAX_HEIGHT = 64;
+
+struct Board {
+  std::uint32_t rows[SOLVER_MAX_HEIGHT]; // row 0 is the bottom, bit x is column x
+  int width;
+  int height;
+};
+
+struct PieceShape {
+  std::uint32_t rows[MAX_TETROMINO_HEIGHT]; // top row first
+  int width;
+  int height;
+};
+
+struct PiecePlacement {
+  Board board;
+  int lines;
+  bool game_over; // the following piece cannot spawn
+};
+
+static PieceShape make_piece_shape(Tetromino tetromino, Rotation rotation) {
+  const Shape &shape = get_shape(tetromino, rotation);
+  PieceShape piece = {{0, 0, 0, 0}, 0, 0};
+  for (int y = 0; y < MAX_TETROMINO_HEIGHT; y++) {
+    for (int x = 0; x < MAX_TETROMINO_WIDTH; x++) {
+      if (shape[y][x] == CellState::FILLED) {
+        piece.rows[y] |= 1u << x;
+        piece.width = std::max(piece.width, x + 1);
+        piece.height = std::max(piece.height, y + 1);
+      }
+    }
+  }
+  return piece;
+}
+
+static const PieceShape &piece_shape(Tetromino tetromino, Rotation rotation) {
+  static std::vector<PieceShape> shapes = [] {
+    std::vector<PieceShape> all;
+    for (int tetromino = 0; tetromino < TETROMINO_COUNT; tetromino++) {
+      for (int rotation = 0; rotation < 4; rotation++) {
+        all.push_back(make_piece_shape(static_cast<Tetromino>(tetromino),
+                                       static_cast<Rotation>(rotation)));
+      }
+    }
+    return all;
+  }();
+  return shapes[static_cast<int>(tetromino) * 4 + static_cast<int>(rotation)];
+}
+
+static std::uint32_t full_row(int width) {
+  return width == 32 ? 0xFFFFFFFFu : (1u << width) - 1;
+}
+
+static bool fits(const Board &board, const PieceShape &piece, int x, int y) {
+  if (x < 0 || x + piece.width > board.width ||
+      y - (piece.height - 1) < 0 || y >= board.height) {
+    return false;
+  }
+  for (int row = 0; row < piece.height; row++) {
+    if (board.rows[y - row] & (piece.rows[row] << x)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+static int lock_piece(Board &board, const PieceShape &piece, int x, int y) {
+  for (int row = 0; row < piece.height; row++) {
+    board.rows[y - row] |= piece.rows[row] << x;
+  }
+  std::uint32_t full = full_row(board.width);
+  int kept = 0;
+  for (int row = 0; row < board.height; row++) {
+    if (board.rows[row] != full) {
+      board.rows[kept++] = board.rows[row];
+    }
+  }
+  int cleared = board.height - kept;
+  for (int row = kept; row < board.height; row++) {
+    board.rows[row] = 0;
+  }
+  return cleared;
+}
+
+static int stack_height(const Board &board) {
+  int height = board.height;
+  while (height > 0 && board.rows[height - 1] == 0) {
+    height--;
+  }
+  return height;
+}
+
+static int filled_cells(const Board &board, int height) {
+  int cells = 0;
+  for (int row = 0; row < height; row++) {
+    cells += __builtin_popcount(board.rows[row]);
+  }
+  return cells;
+}
+
+static bool same_board(const Board &lhs, const Board &rhs) {
+  return std::equal(lhs.rows, lhs.rows + lhs.height, rhs.rows);
+}
+
+static std::uint64_t hash_board(const Board &board, int piece_index, int extra) {
+  std::uint64_t hash = 0xCBF29CE484222325ull ^ (piece_index * 0x100000001B3ull) ^ extra;
+  for (int row = 0; row < stack_height(board); row++) {
+    hash = (hash ^ board.rows[row]) * 0x100000001B3ull;
+    hash ^= hash >> 29;
+  }
+  return hash;
+}
+
+// A searched position. The memo keeps the whole board rather than its
+// hash, so a collision cannot hand one board another's result.
+struct MemoKey {
+  Board board;
+  int piece_index;
+  int extra;
+};
+
+struct MemoKeyHash {
+  std::size_t operator()(const MemoKey &key) const {
+    return hash_board(key.board, key.piece_index, key.extra);
+  }
+};
+
+struct MemoKeyEqual {
+  bool operator()(const MemoKey &lhs, const MemoKey &rhs) const {
+    return lhs.piece_index == rhs.piece_index && lhs.extra == rhs.extra &&
+           same_board(lhs.board, rhs.board);
+  }
+};
+
+struct SearchContext {
+  const std::vector<Tetromino> *queue;
+  std::vector<std::uint32_t> visited; // stamp per (x, y, rotation)
+  std::uint32_t stamp;
+  std::unordered_map<MemoKey, int, MemoKeyHash, MemoKeyEqual> memo;
+  unsigned long long nodes;
+};
+
+struct Position {
+  int x;
+  int y;
+  int rotation;
+};
+
+// Breadth-first search over the reducer's moves, on the bitboard.
+static void generate_placements(SearchContext &context,
+                                const Board &board,
+                                Tetromino tetromino,
+                                Tetromino following,
+                                Position start,
+                                std::vector<PiecePlacement> &placements) {
+  placements.clear();
+  if (!fits(board, piece_shape(tetromino, static_cast<Rotation>(start.rotation)),
+            start.x, start.y)) {
+    return;
+  }
+  std::size_t cells = board.width * board.height * 4;
+  if (context.visited.size() < cells) {
+    context.visited.assign(cells, 0);
+  }
+  if (++context.stamp == 0) {
+    std::fill(context.visited.begin(), context.visited.end(), 0);
+    context.stamp = 1;
+  }
+  auto index = [&](const Position &position) {
+    return (position.y * board.width + position.x) * 4 + position.rotation;
+  };
+  std::vector<Position> queue(1, start);
+  context.visited[index(start)] = context.stamp;
+
+  // Above the stack every row is empty, so any orientation and column
+  // that fits there can be reached from any other. Start the search at
+  // the lowest such row instead of walking down to it.
+  int free_row = stack_height(board) + MAX_TETROMINO_HEIGHT - 1;
+  if (start.y > free_row) {
+    queue.clear();
+    for (int rotation = 0; rotation < 4; rotation++) {
+      const PieceShape &shape = piece_shape(tetromino, static_cast<Rotation>(rotation));
+      for (int x = 0; x + shape.width <= board.width; x++) {
+        Position position = {x, free_row, rotation};
+        if (fits(board, shape, x, free_row)) {
+          context.visited[index(position)] = context.stamp;
+          queue.push_back(position);
+        }
+      }
+    }
+  }
+  const PieceShape &spawn_shape = piece_shape(following, Rotation::UNROTATED);
+
+  for (std::size_t current = 0; current < queue.size(); current++) {
+    Position position = queue[current];
+    const Position moves[] = {
+      {position.x - 1, position.y, position.rotation},
+      {position.x + 1, position.y, position.rotation},
+      {position.x, position.y, (position.rotation + 1) % 4},
+      {position.x, position.y, (position.rotation + 3) % 4},
+      {position.x, position.y - 1, position.rotation}
+    };
+    for (int move = 0; move < 5; move++) {
+      const Position &next = moves[move];
+      const PieceShape &shape = piece_shape(tetromino, static_cast<Rotation>(next.rotation));
+      if (!fits(board, shape, next.x, next.y)) {
+        if (move == 4) {
+          PiecePlacement placement = {board, 0, false};
+          placement.lines = lock_piece(
+            placement.board,
+            piece_shape(tetromino, static_cast<Rotation>(position.rotation)),
+            position.x,
+            position.y
+          );
+          placement.game_over = !fits(placement.board, spawn_shape,
+                                      board.width / 2, board.height - 1);
+          bool duplicate = false;
+          for (const PiecePlacement &existing : placements) {
+            if (same_board(existing.board, placement.board)) {
+              duplicate = true;
+              break;
+            }
+          }
+          if (!duplicate) {
+            placements.push_back(placement);
+          }
+        }
+        continue;
+      }
+      if (context.visited[index(next)] != context.stamp) {
+        context.visited[index(next)] = context.stamp;
+        queue.push_back(next);
+      }
+    }
+  }
+}
+
+static Position spawn_position(const Board &board) {
+  return {board.width / 2, board.height - 1, static_cast<int>(Rotation::UNROTATED)};
+}
+
+// True if some number of pieces up to remaining could make the filled
+// cells a whole number of rows, and the empty cells under the stack can
+// all be filled.
+static bool perfect_clear_possible(const Board &board, int remaining) {
+  int height = stack_height(board);
+  int cells = filled_cells(board, height);
+  if (board.width * height - cells > 4 * remaining) {
+    return false;
+  }
+  for (int pieces = 1; pieces <= remaining; pieces++) {
+    if ((cells + 4 * pieces) % board.width == 0) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static bool search_perfect_clear(SearchContext &context,
+                                 const Board &board,
+                                 int piece_index,
+                                 Position start,
+                                 int remaining,
+                                 std::vector<Board> &path) {
+  if (remaining == 0 || !perfect_clear_possible(board, remaining)) {
+    return false;
+  }
+  MemoKey key = {board, piece_index, 0};
+  auto known = context.memo.find(key);
+  if (known != context.memo.end() && known->second >= remaining) {
+    return false; // already shown to fail with at least this many pieces
+  }
+  const std::vector<Tetromino> &queue = *context.queue;
+  std::vector<PiecePlacement> placements;
+  generate_placements(context, board, queue[piece_index], queue[piece_index + 1],
+                      start, placements);
+  for (const PiecePlacement &placement : placements) {
+    context.nodes++;
+    if (stack_height(placement.board) == 0) {
+      path.push_back(placement.board);
+      return true;
+    }
+    if (placement.game_over) {
+      continue;
+    }
+    if (search_perfect_clear(context, placement.board, piece_index + 1,
+                             spawn_position(placement.board), remaining - 1, path)) {
+      path.push_back(placement.board);
+      return true;
+    }
+  }
+  int &failed_with = context.memo[key];
+  failed_with = std::max(failed_with, remaining);
+  return false;
+}
+
+static int line_bound(const Board &board, int remaining) {
+  int height = stack_height(board);
+  return std::min(remaining * 4, (filled_cells(board, height) + 4 * remaining) / board.width);
+}
+
+// Exact maximum number of lines clearable with the remaining pieces.
+static int search_max_lines(SearchContext &context,
+                            const Board &board,
+                            int piece_index,
+                            Position start,
+                            int remaining) {
+  if (remaining == 0) {
+    return 0;
+  }
+  MemoKey key = {board, piece_index, remaining};
+  auto known = context.memo.find(key);
+  if (known != context.memo.end()) {
+    return known->second;
+  }
+  const std::vector<Tetromino> &queue = *context.queue;
+  std::vector<PiecePlacement> placements;
+  generate_placements(context, board, queue[piece_index], queue[piece_index + 1],
+                      start, placements);
+  int bound = line_bound(board, remaining);
+  int best = 0;
+  for (const PiecePlacement &placement : placements) {
+    if (best == bound) {
+      break;
+    }
+    context.nodes++;
+    if (placement.game_over) {
+      best = std::max(best, placement.lines);
+      continue;
+    }
+    if (placement.lines + line_bound(placement.board, remaining - 1) <= best) {
+      continue;
+    }
+    best = std::max(best, placement.lines +
+      search_max_lines(context, placement.board, piece_index + 1,
+                       spawn_position(placement.board), remaining - 1));
+  }
+  context.memo[key] = best;
+  return best;
+}
+
+// Walks the memoised values down from a node to recover the boards of a
+// best line. Each step repeats the search of one node, which is cheap
+// because its children are already known.
+static void collect_max_lines_path(SearchContext &context,
+                                   Board board,
+                                   int piece_index,
+                                   Position start,
+                                   int remaining,
+                                   std::vector<Board> &path) {
+  while (remaining > 0) {
+    int target = search_max_lines(context, board, piece_index, start, remaining);
+    if (target == 0) {
+      return; // nothing more to clear; the caller stops here
+    }
+    const std::vector<Tetromino> &queue = *context.queue;
+    std::vector<PiecePlacement> placements;
+    generate_placements(context, board, queue[piece_index], queue[piece_index + 1],
+                        start, placements);
+    bool advanced = false;
+    for (const PiecePlacement &placement : placements) {
+      int value = placement.lines;
+      if (!placement.game_over) {
+        value += search_max_lines(context, placement.board, piece_index + 1,
+                                  spawn_position(placement.board), remaining - 1);
+      }
+      if (value == target) {
+        path.push_back(placement.board);
+        board = placement.board;
+        advanced = !placement.game_over;
+        break;
+      }
+    }
+    if (!advanced) {
+      return;
+    }
+    piece_index++;
+    start = spawn_position(board);
+    remaining--;
+  }
+}
+
+static bool board_matches(const Board &board, const Field &field) {
+  for (int y = 0; y < field.height; y++) {
+    std::uint32_t row = 0;
+    for (int x = 0; x < field.width; x++) {
+      if (field.lines[y][x] == CellState::FILLED) {
+        row |= 1u << x;
+      }
+    }
+    if (row != board.rows[y]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// Replays the solution through the real reducer to recover its actions.
+static bool replay_path(const GameState &state,
+                        const std::vector<Board> &path,
+                        SolverResult &result) {
+  GameState current = state;
+  for (const Board &board : path) {
+    bool matched = false;
+    for (Placement &placement : find_placements(current)) {
+      if (board_matches(board, placement.result.field)) {
+        result.actions.insert(result.actions.end(),
+                              placement.actions.begin(),
+                              placement.actions.end());
+        current = std::move(placement.result);
+        matched = true;
+        break;
+      }
+    }
+    if (!matched) {
+      return false;
+    }
+  }
+  result.lines = current.lines - state.lines;
+  result.pieces_used = path.size();
+  return true;
+}
+
+template <typename Work>
+static void run_on_threads(int threads, std::size_t count, Work work) {
+  std::atomic<std::size_t> next_index(0);
+  auto worker = [&](int thread) {
+    std::size_t index;
+    while ((index = next_index++) < count) {
+      work(thread, index);
+    }
+  };
+  std::vector<std::thread> pool;
+  for (int thread = 1; thread < threads; thread++) {
+    pool.emplace_back(worker, thread);
+  }
+  worker(0);
+  for (std::thread &thread : pool) {
+    thread.join();
+  }
+}
+
+SolverResult solve(const GameState &state, SolverOptions options) {
+  SolverResult result = {false, 0, 0, {}, 0};
+  const Field &field = state.field;
+  if (field.width > SOLVER_MAX_WIDTH || field.height > SOLVER_MAX_HEIGHT ||
+      options.max_pieces < 1 || state.progress == GameProgress::GAME_OVER) {
+    return result;
+  }
+  int threads = std::max(1, options.threads);
+
+  std::vector<Tetromino> queue;
+  queue.push_back(state.active_block.tetromino);
+  queue.push_back(state.next_block);
+  RNG rng = state.rng;
+  while (static_cast<int>(queue.size()) < options.max_pieces + 1) {
+    queue.push_back(next_random_block(rng));
+  }
+
+  Board root = {{0}, field.width, field.height};
+  for (int y = 0; y < field.height; y++) {
+    for (int x = 0; x < field.width; x++) {
+      if (field.lines[y][x] == CellState::FILLED) {
+        root.rows[y] |= 1u << x;
+      }
+    }
+  }
+  Position start = {
+    state.active_block.position_x,
+    state.active_block.position_y,
+    static_cast<int>(state.active_block.rotation)
+  };
+
+  std::vector<SearchContext> contexts(threads, {&queue, {}, 0, {}, 0});
+  std::vector<PiecePlacement> first;
+  generate_placements(contexts[0], root, queue[0], queue[1], start, first);
+  std::vector<std::vector<Board>> paths(first.size());
+  std::vector<int> values(first.size(), -1);
+
+  if (options.goal == SolverGoal::PERFECT_CLEAR) {
+    // Iterative deepening finds the shortest clear; failures proven at
+    // one depth stay in the memo for the next. found_at is the lowest
+    // first placement solved so far.
+    std::atomic<int> found_at(-1);
+    for (int depth = 1; depth <= options.max_pieces && found_at < 0; depth++) {
+      run_on_threads(threads, first.size(), [&](int thread, std::size_t index) {
+        int solved = found_at;
+        if (solved >= 0 && solved < static_cast<int>(index)) {
+          return; // an earlier first move already works
+        }
+        SearchContext &context = contexts[thread];
+        const PiecePlacement &placement = first[index];
+        context.nodes++;
+        bool cleared = stack_height(placement.board) == 0;
+        if (!cleared && !placement.game_over) {
+          cleared = search_perfect_clear(context, placement.board, 1,
+                                         spawn_position(placement.board),
+                                         depth - 1, paths[index]);
+        }
+        if (cleared) {
+          paths[index].push_back(placement.board);
+          int expected = found_at;
+          while ((expected < 0 || expected > static_cast<int>(index)) &&
+                 !found_at.compare_exchange_weak(expected, index)) {
+          }
+        }
+      });
+    }
+    if (found_at >= 0) {
+      std::vector<Board> &path = paths[found_at];
+      std::reverse(path.begin(), path.end());
+      result.found = replay_path(state, path, result);
+    }
+  } else {
+    run_on_threads(threads, first.size(), [&](int thread, std::size_t index) {
+      SearchContext &context = contexts[thread];
+      const PiecePlacement &placement = first[index];
+      context.nodes++;
+      values[index] = placement.lines;
+      paths[index].push_back(placement.board);
+      if (!placement.game_over) {
+        values[index] += search_max_lines(context, placement.board, 1,
+                                          spawn_position(placement.board),
+                                          options.max_pieces - 1);
+        collect_max_lines_path(context, placement.board, 1,
+                               spawn_position(placement.board),
+                               options.max_pieces - 1, paths[index]);
+      }
+    });
+    int best = -1;
+    for (std::size_t index = 0; index < first.size(); index++) {
+      if (values[index] > (best < 0 ? -1 : values[best])) {
+        best = index;
+      }
+    }
+    if (best >= 0) {
+      result.found = replay_path(state, paths[best], result);
+    }
+  }
+
+  for (const SearchContext &context : contexts) {
+    result.nodes += context.nodes;
+  }
+  return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <vector>
+
+#include "state.h"
+
+// Offline search over the known piece sequence.
+//
+// The pieces a game will deal are fixed by its generator, so the solver
+// reads the queue ahead from a copy of state.rng and searches placements
+// depth first on a bitboard copy of the field. It prunes with admissible
+// bounds only, so answers are exact:
+//  - parity: a perfect clear needs the filled cells plus four per piece
+//    placed to be a whole number of rows;
+//  - height: every empty cell below the top of the stack, holes
+//    included, must be filled before the board can be empty;
+//  - lines: no more rows can clear than the cells available can fill.
+// Positions already searched are remembered per thread, and the first
+// placements are shared out between threads.
+
+enum class SolverGoal {
+  PERFECT_CLEAR, // the shortest sequence that empties the field
+  MAX_LINES      // the most lines cleared within max_pieces
+};
+
+struct SolverOptions {
+  SolverGoal goal;
+  int max_pieces;
+  int threads;
+};
+
+struct SolverResult {
+  bool found;
+  int lines;       // lines cleared by the solution
+  int pieces_used;
+  std::vector<Action> actions; // replays the solution through reduce
+  unsigned long long nodes;
+};
+
+// The solver supports fields up to 32 cells wide and 64 tall; larger
+// fields report no solution.
+SolverResult solve(const GameState &state, SolverOptions options);
@@ -0,0 +1,66 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <thread>
+
+#include "solver.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--seed N] [--pieces K] [--lines] [--threads N]\n"
+               "          [--width N] [--height N]\n"
+               "Finds the shortest perfect clear within K pieces of a new game,\n"
+               "or with --lines the most lines that K pieces can clear.\n",
+               program);
+}
+
+int main(int argc, char *argv[]) {
+  RNG::result_type seed = 0;
+  int width = DEFAULT_WIDTH;
+  int height = DEFAULT_HEIGHT;
+  SolverOptions options = {
+    SolverGoal::PERFECT_CLEAR,
+    10,
+    static_cast<int>(std::thread::hardware_concurrency())
+  };
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--seed" && i + 1 < argc) {
+      seed = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--pieces" && i + 1 < argc) {
+      options.max_pieces = std::atoi(argv[++i]);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--width" && i + 1 < argc) {
+      width = std::atoi(argv[++i]);
+    } else if (arg == "--height" && i + 1 < argc) {
+      height = std::atoi(argv[++i]);
+    } else if (arg == "--lines") {
+      options.goal = SolverGoal::MAX_LINES;
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  if (width < MAX_TETROMINO_WIDTH || height < MAX_TETROMINO_HEIGHT) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  auto start = std::chrono::steady_clock::now();
+  SolverResult result = solve(new_game(width, height, seed), options);
+  double seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+
+  if (result.found) {
+    std::printf("%d lines with %d pieces:\n", result.lines, result.pieces_used);
+    for (Action action : result.actions) {
+      std::printf("%s\n", get_action_name(action));
+    }
+  } else {
+    std::printf("No solution within %d pieces\n", options.max_pieces);
+  }
+  std::printf("%llu nodes in %.3f s\n", result.nodes, seconds);
+  return result.found ? 0 : 2;
+}
@@ -0,0 +1,43 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// A bounded single-producer, single-consumer queue. One thread may call
+// try_push and one other thread may call try_pop; neither ever blocks or
+// takes a lock.
+template <typename T, std::size_t CAPACITY>
+class SpscQueue {
+  static_assert((CAPACITY & (CAPACITY - 1)) == 0, "capacity must be a power of two");
+
+public:
+  SpscQueue() : head(0), tail(0) {
+  }
+
+  bool try_push(const T &value) {
+    std::size_t write = tail.load(std::memory_order_relaxed);
+    if (write - head.load(std::memory_order_acquire) == CAPACITY) {
+      return false; // full
+    }
+    slots[write & (CAPACITY - 1)] = value;
+    tail.store(write + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool try_pop(T &value) {
+    std::size_t read = head.load(std::memory_order_relaxed);
+    if (read == tail.load(std::memory_order_acquire)) {
+      return false; // empty
+    }
+    value = slots[read & (CAPACITY - 1)];
+    head.store(read + 1, std::memory_order_release);
+    return true;
+  }
+
+private:
+  std::array<T, CAPACITY> slots;
+  // Kept on separate cache lines so the two threads do not contend.
+  alignas(64) std::atomic<std::size_t> head;
+  alignas(64) std::atomic<std::size_t> tail;
+};
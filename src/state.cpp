@@ -1,8 +1,39 @@
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <utility>
 
+#include "profiler.h"
 #include "state.h"
 
+RNG::RNG()
+  : engine(), initial_seed(std::mt19937::default_seed), draws(0) {
+}
+
+RNG::RNG(result_type seed)
+  : engine(seed), initial_seed(seed), draws(0) {
+}
+
+RNG RNG::at_position(result_type seed, unsigned long long position) {
+  RNG rng(seed);
+  rng.engine.discard(position);
+  rng.draws = position;
+  return rng;
+}
+
+RNG::result_type RNG::operator()() {
+  draws++;
+  return engine();
+}
+
+RNG::result_type RNG::seed() const {
+  return initial_seed;
+}
+
+unsigned long long RNG::position() const {
+  return draws;
+}
+
 Rotation rotate_clockwise(Rotation rotation) {
   switch(rotation) {
     case Rotation::UNROTATED: return Rotation::CLOCKWISE;
@@ -36,6 +67,31 @@ const char* get_action_name(Action action) {
   }
 }
 
+// Each thread takes stamps from its own block of VERSION_BLOCK, so
+// stamping costs an atomic operation only once per block.
+const std::uint64_t VERSION_BLOCK = 4096;
+
+std::uint64_t new_version() {
+  static std::atomic<std::uint64_t> next_block(1);
+  static thread_local std::uint64_t next = 0;
+  static thread_local std::uint64_t end = 0;
+  if (next == end) {
+    next = next_block.fetch_add(VERSION_BLOCK, std::memory_order_relaxed);
+    end = next + VERSION_BLOCK;
+  }
+  return next++;
+}
+
+void refresh_versions(GameState &state) {
+  std::uint64_t version = new_version();
+  StateVersions &versions = state.versions;
+  versions.field = version;
+  versions.rows.assign(state.field.lines.size(), version);
+  versions.active_block = version;
+  versions.next_block = version;
+  versions.score = version;
+}
+
 Tetromino next_random_block(RNG &rng) {
   auto dist = std::uniform_int_distribution<int>(0, TETROMINO_COUNT - 1);
   int random_number = dist(rng);
@@ -61,14 +117,16 @@ GameState new_game(int width, int height, RNG::result_type seed) {
     0,
     0,
     GameProgress::IN_PROGRESS,
-    rng
+    rng,
+    {}
   };
-
+  refresh_versions(state);
   return state;
 }
 
-bool is_legal_position(Field field, ActiveBlock active_block) {
-  Shape shape = get_shape(active_block.tetromino, active_block.rotation);
+bool is_legal_position(const Field &field, const ActiveBlock &active_block) {
+  PROFILE_ZONE("is_legal_position");
+  const Shape &shape = get_shape(active_block.tetromino, active_block.rotation);
   for (int shape_y = 0; shape_y < MAX_TETROMINO_HEIGHT; shape_y++) {
     for (int shape_x = 0; shape_x < MAX_TETROMINO_WIDTH; shape_x++) {
       if (shape[shape_y][shape_x] == CellState::FILLED) {
@@ -87,113 +145,96 @@ bool is_legal_position(Field field, ActiveBlock active_block) {
   return true;
 }
 
-GameState update_active_block(GameState state, ActiveBlock active_block) {
-  return {
-    state.field,
-    active_block,
-    state.next_block,
-    state.milliseconds_per_turn,
-    state.score,
-    state.lines,
-    state.progress,
-    state.rng
-  };
-}
+// The reducers below take the state by value and update it in place, so a
+// caller that moves its state in (state = reduce(std::move(state), ...))
+// reuses the game's existing row storage and never touches the heap.
 
 GameState update_active_block_if_legal(GameState state, ActiveBlock active_block) {
-  GameState new_state = update_active_block(state, active_block);
-
-  if (is_legal_position(new_state.field, new_state.active_block)) {
-    return new_state;
-  } else {
-    return state;
+  if (is_legal_position(state.field, active_block)) {
+    state.active_block = active_block;
+    state.versions.active_block = new_version();
   }
+  return state;
 }
 
 GameState move_left(GameState old_state) {
-  return update_active_block_if_legal(old_state, {
+  ActiveBlock moved = {
     old_state.active_block.position_x - 1,
     old_state.active_block.position_y,
     old_state.active_block.tetromino,
     old_state.active_block.rotation
-  });
+  };
+  return update_active_block_if_legal(std::move(old_state), moved);
 }
 
 GameState move_right(GameState old_state) {
-  return update_active_block_if_legal(old_state, {
+  ActiveBlock moved = {
     old_state.active_block.position_x + 1,
     old_state.active_block.position_y,
     old_state.active_block.tetromino,
     old_state.active_block.rotation
-  });
+  };
+  return update_active_block_if_legal(std::move(old_state), moved);
 }
 
 GameState rotate_clockwise(GameState old_state) {
-  return update_active_block_if_legal(old_state, {
+  ActiveBlock rotated = {
     old_state.active_block.position_x,
     old_state.active_block.position_y,
     old_state.active_block.tetromino,
     rotate_clockwise(old_state.active_block.rotation)
-  });
+  };
+  return update_active_block_if_legal(std::move(old_state), rotated);
 }
 
 GameState rotate_counterclockwise(GameState old_state) {
-  return update_active_block_if_legal(old_state, {
+  ActiveBlock rotated = {
     old_state.active_block.position_x,
     old_state.active_block.position_y,
     old_state.active_block.tetromino,
     rotate_counterclockwise(old_state.active_block.rotation)
-  });
+  };
+  return update_active_block_if_legal(std::move(old_state), rotated);
 }
 
-Field add_block_to_field(Field field, ActiveBlock active_block) {
-  Field new_field = {
-    field.height,
-    field.width,
-    field.lines
-  };
-  Shape shape = get_shape(active_block.tetromino, active_block.rotation);
+void add_block_to_field(Field &field, const ActiveBlock &active_block) {
+  PROFILE_ZONE("add_block_to_field");
+  const Shape &shape = get_shape(active_block.tetromino, active_block.rotation);
   for (int shape_y = 0; shape_y < MAX_TETROMINO_HEIGHT; shape_y++) {
     int field_y = active_block.position_y - shape_y;
     for (int shape_x = 0; shape_x < MAX_TETROMINO_WIDTH; shape_x++) {
       int field_x = active_block.position_x + shape_x;
       if (shape[shape_y][shape_x] == CellState::FILLED) {
-        new_field.lines[field_y][field_x] = CellState::FILLED;
+        field.lines[field_y][field_x] = CellState::FILLED;
       }
     }
   }
-  return new_field;
 }
 
-bool line_is_filled(Line line) {
+bool line_is_filled(const Line &line) {
   return std::all_of(
     line.begin(),
     line.end(),
     [](CellState cell){ return cell == CellState::FILLED; });
 }
 
-typedef std::pair<Field, int> FieldWithFilledLineCount;
-
-FieldWithFilledLineCount remove_filled_lines(Field field) {
-  int removed_lines = 0;
-  Field new_field = {
-    field.height,
-    field.width,
-    std::vector<Line>()
-  };
-  new_field.lines.reserve(field.height);
-  for (Line line : field.lines) {
-    if (line_is_filled(line)) {
-      removed_lines++;
-    } else {
-      new_field.lines.push_back(line);
+// Only rows the locked block reached can have filled up, so only rows
+// bottom to top are checked, and a lock that fills none touches nothing
+// else. Returns the number removed.
+int remove_filled_lines(Field &field, int bottom, int top) {
+  PROFILE_ZONE("remove_filled_lines");
+  int filled[MAX_TETROMINO_HEIGHT];
+  int count = 0;
+  for (int y = std::max(bottom, 0); y <= std::min(top, field.height - 1); y++) {
+    if (line_is_filled(field.lines[y])) {
+      filled[count++] = y;
     }
   }
-  new_field.lines.resize(field.height, std::vector<CellState>(field.width, CellState::EMPTY));
-  return FieldWithFilledLineCount(new_field, removed_lines);
+  field.lines.remove(filled, count);
+  return count;
 }
 
-ActiveBlock next_active_block(GameState state) {
+ActiveBlock next_active_block(const GameState &state) {
   return {
     state.field.width / 2,
     state.field.height - 1,
@@ -210,37 +251,68 @@ int new_score(int old_score, int removed_lines) {
   return old_score + removed_line_value;
 }
 
-GameState move_down(GameState old_state) {
-  GameState moved = update_active_block(old_state, {
-    old_state.active_block.position_x,
-    old_state.active_block.position_y - 1,
-    old_state.active_block.tetromino,
-    old_state.active_block.rotation
-  });
-
-  if (is_legal_position(moved.field, moved.active_block)) {
-    return moved;
-  } else {
-    Field field = add_block_to_field(old_state.field, old_state.active_block);
-    FieldWithFilledLineCount fieldLines = remove_filled_lines(field);
-    ActiveBlock active_block = next_active_block(old_state);
-    RNG rng = old_state.rng;
-    Tetromino next_block = next_random_block(rng);
-    return {
-      fieldLines.first,
-      active_block,
-      next_block,
-      old_state.milliseconds_per_turn,
-      new_score(old_state.score, fieldLines.second),
-      old_state.lines + fieldLines.second,
-      is_legal_position(fieldLines.first, active_block)?
-        GameProgress::IN_PROGRESS : GameProgress::GAME_OVER,
-      rng
-    };
+// The lowest row of the field the block covers.
+int lowest_row(const ActiveBlock &active_block) {
+  const Shape &shape = get_shape(active_block.tetromino, active_block.rotation);
+  for (int shape_y = MAX_TETROMINO_HEIGHT - 1; shape_y > 0; shape_y--) {
+    if (std::find(shape[shape_y].begin(), shape[shape_y].end(), CellState::FILLED) !=
+        shape[shape_y].end()) {
+      return active_block.position_y - shape_y;
+    }
+  }
+  return active_block.position_y;
+}
+
+// Stamps everything a lock changes: the rows from bottom to top, which
+// reach the top of the field when lines were removed, since every row
+// above the lowest removed one moved down, and the rest of the state.
+void stamp_lock(GameState &state, int bottom, int top) {
+  StateVersions &versions = state.versions;
+  if (versions.rows.size() != state.field.lines.size()) {
+    refresh_versions(state); // written directly and never stamped
+    return;
+  }
+  std::uint64_t version = new_version();
+  for (int y = std::max(bottom, 0); y <= std::min(top, state.field.height - 1); y++) {
+    versions.rows[y] = version;
+  }
+  versions.field = version;
+  versions.active_block = version;
+  versions.next_block = version;
+  versions.score = version;
+}
+
+GameState move_down(GameState state) {
+  PROFILE_ZONE("move_down");
+  ActiveBlock moved = {
+    state.active_block.position_x,
+    state.active_block.position_y - 1,
+    state.active_block.tetromino,
+    state.active_block.rotation
+  };
+
+  if (is_legal_position(state.field, moved)) {
+    state.active_block = moved;
+    state.versions.active_block = new_version();
+    return state;
   }
+
+  add_block_to_field(state.field, state.active_block);
+  int bottom = lowest_row(state.active_block);
+  int top = state.active_block.position_y;
+  int removed_lines = remove_filled_lines(state.field, bottom, top);
+  state.active_block = next_active_block(state);
+  state.next_block = next_random_block(state.rng);
+  state.score = new_score(state.score, removed_lines);
+  state.lines += removed_lines;
+  state.progress = is_legal_position(state.field, state.active_block)?
+    GameProgress::IN_PROGRESS : GameProgress::GAME_OVER;
+  stamp_lock(state, bottom, removed_lines > 0 ? state.field.height - 1 : top);
+  return state;
 }
 
 GameState reduce(GameState state, Action action) {
+  PROFILE_ZONE("reduce");
   if (state.progress == GameProgress::GAME_OVER && action != Action::NEW_GAME) {
     return state;
   }
@@ -253,22 +325,22 @@ GameState reduce(GameState state, Action action) {
       );
 
     case Action::TIME_FALL:
-      return move_down(state);
+      return move_down(std::move(state));
 
     case Action::MOVE_LEFT:
-      return move_left(state);
+      return move_left(std::move(state));
 
     case Action::MOVE_RIGHT:
-      return move_right(state);
+      return move_right(std::move(state));
 
     case Action::MOVE_DOWN:
-      return move_down(state);
+      return move_down(std::move(state));
 
     case Action::ROTATE_CLOCKWISE:
-      return rotate_clockwise(state);
+      return rotate_clockwise(std::move(state));
 
     case Action::ROTATE_COUNTERCLOCKWISE:
-      return rotate_counterclockwise(state);
+      return rotate_counterclockwise(std::move(state));
 
     default:
       return state;
@@ -296,3 +368,53 @@ bool operator==(const GameState& lhs, const GameState& rhs) {
       && lhs.score == rhs.score
       && lhs.lines == rhs.lines;
 }
+
+static std::uint64_t mix_hash(std::uint64_t hash, std::uint64_t value) {
+  // splitmix64 finaliser over the running hash
+  hash ^= value + 0x9E3779B97F4A7C15ull + (hash << 6) + (hash >> 2);
+  hash ^= hash >> 30;
+  hash *= 0xBF58476D1CE4E5B9ull;
+  hash ^= hash >> 27;
+  hash *= 0x94D049BB133111EBull;
+  return hash ^ (hash >> 31);
+}
+
+std::uint64_t hash_field(const Field &field) {
+  std::uint64_t hash = mix_hash(field.width, field.height);
+  for (const Line &line : field.lines) {
+    std::uint64_t bits = 0;
+    for (std::size_t x = 0; x < line.size(); x++) {
+      if (line[x] == CellState::FILLED) {
+        bits |= 1ull << (x % 64);
+      }
+      if (x % 64 == 63) {
+        hash = mix_hash(hash, bits);
+        bits = 0;
+      }
+    }
+    hash = mix_hash(hash, bits);
+  }
+  return hash;
+}
+
+std::uint64_t hash_active_block(const ActiveBlock &active_block) {
+  // The whole block is packed into mix_hash's value argument, in which
+  // mix_hash is one-to-one, so distinct blocks hash differently.
+  return mix_hash(
+    0,
+    static_cast<std::uint64_t>(static_cast<std::uint32_t>(active_block.position_x))
+      | static_cast<std::uint64_t>(static_cast<std::uint16_t>(active_block.position_y)) << 32
+      | static_cast<std::uint64_t>(active_block.tetromino) << 48
+      | static_cast<std::uint64_t>(active_block.rotation) << 56
+  );
+}
+
+std::uint64_t hash_game_state(const GameState &state) {
+  std::uint64_t hash = hash_field(state.field);
+  hash = mix_hash(hash, hash_active_block(state.active_block));
+  hash = mix_hash(hash, static_cast<std::uint64_t>(state.next_block)
+                        | static_cast<std::uint64_t>(state.progress) << 4
+                        | static_cast<std::uint64_t>(state.milliseconds_per_turn) << 8);
+  return mix_hash(hash, static_cast<std::uint64_t>(static_cast<std::uint32_t>(state.score)) << 32
+                        | static_cast<std::uint32_t>(state.lines));
+}
@@ -1,12 +1,10 @@
 #pragma once
 
+#include <cstdint>
 #include <random>
 #include <vector>
 
-enum class CellState {
-  EMPTY,
-  FILLED
-};
+#include "rows.h"
 
 const int MAX_TETROMINO_WIDTH = 4;
 const int MAX_TETROMINO_HEIGHT = 4;
@@ -39,14 +37,13 @@ Rotation rotate_clockwise(Rotation);
 Rotation rotate_counterclockwise(Rotation);
 
 typedef std::vector<std::vector<CellState>> Shape;
-Shape get_shape(Tetromino tetromino, Rotation rotation);
+const Shape& get_shape(Tetromino tetromino, Rotation rotation);
 
-typedef std::vector<CellState> Line;
 
 struct Field {
   int height;
   int width;
-  std::vector<Line> lines;
+  Rows lines;
 };
 
 const int DEFAULT_WIDTH = 10;
@@ -64,7 +61,48 @@ enum class GameProgress {
   GAME_OVER
 };
 
-typedef std::mt19937 RNG;
+// A Mersenne twister that also counts the numbers it has produced, so the
+// exact generator state can be stored or sent as a seed and a position.
+class RNG {
+public:
+  typedef std::mt19937::result_type result_type;
+
+  RNG();
+  explicit RNG(result_type seed);
+  static RNG at_position(result_type seed, unsigned long long position);
+
+  static constexpr result_type min() { return std::mt19937::min(); }
+  static constexpr result_type max() { return std::mt19937::max(); }
+  result_type operator()();
+
+  result_type seed() const;
+  unsigned long long position() const;
+
+private:
+  std::mt19937 engine;
+  result_type initial_seed;
+  unsigned long long draws;
+};
+
+// Stamps telling consumers which parts of a state may have changed since
+// they last looked, without comparing cells. reduce gives every part it
+// changes a fresh stamp from new_version, unique across all threads, and
+// leaves the rest alone, so a renderer or encoder that keeps the stamps
+// it last handled redoes only the parts whose stamps differ. Copies keep
+// their stamps, and since a stamp is never given out twice, equal
+// nonzero stamps mean equal contents even across copies that went their
+// own ways. Zero is never given out and means "unknown".
+//
+// Versions are not part of operator==, the hashes or packing. Code that
+// writes a state's fields directly, rather than through reduce, must
+// call refresh_versions afterwards or stamp what it changed.
+struct StateVersions {
+  std::uint64_t field;                // any cell
+  std::vector<std::uint64_t> rows;    // each row, bottom first
+  std::uint64_t active_block;
+  std::uint64_t next_block;
+  std::uint64_t score;                // score, lines and progress
+};
 
 struct GameState {
   Field field;
@@ -75,6 +113,7 @@ struct GameState {
   int lines;
   GameProgress progress;
   RNG rng;
+  StateVersions versions; // left out of initialisers; see refresh_versions
 };
 
 enum class Action {
@@ -91,7 +130,29 @@ enum class Action {
 
 const char* get_action_name(Action);
 
+// Stamps only ever increase along one thread; compare them for equality.
+std::uint64_t new_version();
+// Gives every part of state a fresh stamp, sizing rows to the field.
+void refresh_versions(GameState &state);
+// Whether a part stamped now is known to match one stamped before.
+inline bool same_version(std::uint64_t before, std::uint64_t now) {
+  return before != 0 && before == now;
+}
+
+Tetromino next_random_block(RNG &rng);
+GameState new_game(int width, int height, RNG::result_type seed);
 GameState reduce(GameState state, Action action);
+// The score after a lock that cleared removed_lines.
+int new_score(int old_score, int removed_lines);
+bool is_legal_position(const Field &field, const ActiveBlock &active_block);
 bool operator==(const Field& lhs, const Field& rhs);
 bool operator==(const ActiveBlock& lhs, const ActiveBlock& rhs);
 bool operator==(const GameState& lhs, const GameState& rhs);
+
+// Hashes cover the same components as operator==, plus progress. Within
+// one game the generator position follows from the field and line count,
+// so equal positions have equal hashes. Different positions can share a
+// hash too, so search and deduplication compare positions that match.
+std::uint64_t hash_field(const Field &field);
+std::uint64_t hash_active_block(const ActiveBlock &active_block);
+std::uint64_t hash_game_state(const GameState &state);
@@ -0,0 +1,59 @@
+#include "timer_wheel.h"
+
+TimerWheel new_timer_wheel(int tick_milliseconds,
+                           int slot_count,
+                           std::uint64_t now_milliseconds) {
+  return {
+    tick_milliseconds,
+    now_milliseconds / tick_milliseconds,
+    std::vector<std::vector<TimerEntry>>(slot_count)
+  };
+}
+
+void schedule_timer(TimerWheel &wheel,
+                    int id,
+                    unsigned generation,
+                    std::uint64_t deadline_milliseconds) {
+  std::uint64_t deadline_tick = deadline_milliseconds / wheel.tick_milliseconds;
+  if (deadline_tick <= wheel.current_tick) {
+    deadline_tick = wheel.current_tick + 1; // never schedule into the past
+  }
+  wheel.slots[deadline_tick % wheel.slots.size()].push_back({
+    id,
+    generation,
+    deadline_tick
+  });
+}
+
+int advance_timer_wheel(TimerWheel &wheel,
+                        std::uint64_t now_milliseconds,
+                        std::vector<TimerEntry> &expired) {
+  int expired_count = 0;
+  std::uint64_t now_tick = now_milliseconds / wheel.tick_milliseconds;
+  while (wheel.current_tick < now_tick) {
+    wheel.current_tick++;
+    std::vector<TimerEntry> &slot =
+      wheel.slots[wheel.current_tick % wheel.slots.size()];
+    // Timers more than one revolution away share the slot; keep those.
+    std::size_t kept = 0;
+    for (std::size_t i = 0; i < slot.size(); i++) {
+      if (slot[i].deadline_tick <= wheel.current_tick) {
+        expired.push_back(slot[i]);
+        expired_count++;
+      } else {
+        slot[kept++] = slot[i];
+      }
+    }
+    slot.resize(kept);
+  }
+  return expired_count;
+}
+
+int milliseconds_until_next_tick(const TimerWheel &wheel,
+                                 std::uint64_t now_milliseconds) {
+  std::uint64_t next = (wheel.current_tick + 1) * wheel.tick_milliseconds;
+  if (next <= now_milliseconds) {
+    return 0;
+  }
+  return static_cast<int>(next - now_milliseconds);
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+// A hashed timing wheel: each slot holds the timers due in one tick, so
+// scheduling is O(1) and advancing costs only the timers that are due.
+// Timers are never removed; a timer whose generation no longer matches
+// its owner's is simply ignored by the caller when it expires.
+
+struct TimerEntry {
+  int id;
+  unsigned generation;
+  std::uint64_t deadline_tick;
+};
+
+struct TimerWheel {
+  int tick_milliseconds;
+  std::uint64_t current_tick;
+  std::vector<std::vector<TimerEntry>> slots;
+};
+
+TimerWheel new_timer_wheel(int tick_milliseconds,
+                           int slot_count,
+                           std::uint64_t now_milliseconds);
+
+void schedule_timer(TimerWheel &wheel,
+                    int id,
+                    unsigned generation,
+                    std::uint64_t deadline_milliseconds);
+
+// Moves every timer due at or before now into expired, in deadline order
+// by tick. Returns the number of timers expired.
+int advance_timer_wheel(TimerWheel &wheel,
+                        std::uint64_t now_milliseconds,
+                        std::vector<TimerEntry> &expired);
+
+// Milliseconds from now until the next tick boundary, for use as a poll
+// timeout.
+int milliseconds_until_next_tick(const TimerWheel &wheel,
+                                 std::uint64_t now_milliseconds);
@@ -0,0 +1,266 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <memory>
+#include <random>
+#include <utility>
+
+#include "parallel.h"
+#include "tournament.h"
+
+TournamentEntrant weighted_bot_entrant(const std::string &name,
+                                       const FeatureWeights &weights,
+                                       int width,
+                                       int height) {
+  return {name, [weights, width, height]() {
+    std::shared_ptr<Bot> bot = std::make_shared<Bot>(new_bot(weights, width, height));
+    return MovePolicy([bot](GameState &state) { return play_bot_move(*bot, state); });
+  }};
+}
+
+TournamentEntrant dropping_entrant(const std::string &name) {
+  return {name, []() {
+    return MovePolicy([](GameState &state) {
+      if (state.progress != GameProgress::IN_PROGRESS) {
+        return false;
+      }
+      // A block that moved down has not locked yet.
+      while (true) {
+        ActiveBlock moved = state.active_block;
+        moved.position_y--;
+        state = reduce(std::move(state), Action::MOVE_DOWN);
+        if (!(state.active_block == moved)) {
+          return true;
+        }
+      }
+    });
+  }};
+}
+
+double match_score(const BotGame &first, const BotGame &second) {
+  if (first.lines != second.lines) {
+    return first.lines > second.lines ? 1 : 0;
+  }
+  if (first.pieces != second.pieces) {
+    return first.pieces > second.pieces ? 1 : 0;
+  }
+  return 0.5;
+}
+
+BotGame play_policy_game(MovePolicy &policy,
+                         int width,
+                         int height,
+                         RNG::result_type seed,
+                         int max_pieces) {
+  GameState state = new_game(width, height, seed);
+  BotGame game = {0, 0, 0, true};
+  while (game.pieces < max_pieces && policy(state)) {
+    game.pieces++;
+    if (state.progress == GameProgress::GAME_OVER) {
+      break;
+    }
+  }
+  game.lines = state.lines;
+  game.score = state.score;
+  game.survived = state.progress == GameProgress::IN_PROGRESS;
+  return game;
+}
+
+static std::uint32_t match_seed(RNG::result_type seed, int round, int match) {
+  std::seed_seq sequence = {
+    static_cast<std::uint32_t>(seed),
+    static_cast<std::uint32_t>(round),
+    static_cast<std::uint32_t>(match)
+  };
+  std::uint32_t derived;
+  sequence.generate(&derived, &derived + 1);
+  return derived;
+}
+
+static std::vector<std::pair<int, int>> round_robin_pairings(int players) {
+  std::vector<std::pair<int, int>> pairings;
+  for (int first = 0; first < players; first++) {
+    for (int second = first + 1; second < players; second++) {
+      pairings.push_back({first, second});
+    }
+  }
+  return pairings;
+}
+
+// Pairs the unpaired players in order, each with the highest placed
+// player it has not met, backtracking when that leaves someone without a
+// fresh opponent. Gives up after a bounded number of attempts.
+static bool pair_without_rematches(const std::vector<int> &order,
+                                   const std::vector<std::vector<bool>> &met,
+                                   std::vector<bool> &paired,
+                                   std::vector<std::pair<int, int>> &pairings,
+                                   int &attempts) {
+  auto first = std::find_if(order.begin(), order.end(),
+                            [&](int player) { return !paired[player]; });
+  if (first == order.end()) {
+    return true;
+  }
+  paired[*first] = true;
+  for (auto second = first + 1; second != order.end() && attempts > 0; ++second) {
+    if (paired[*second] || met[*first][*second]) {
+      continue;
+    }
+    attempts--;
+    paired[*second] = true;
+    pairings.push_back({*first, *second});
+    if (pair_without_rematches(order, met, paired, pairings, attempts)) {
+      return true;
+    }
+    pairings.pop_back();
+    paired[*second] = false;
+  }
+  paired[*first] = false;
+  return false;
+}
+
+const int SWISS_PAIRING_ATTEMPTS = 100000;
+
+// Pairs players from the top of the standings down, avoiding rematches
+// where possible and otherwise pairing neighbours. With an odd number of
+// players the lowest placed one without a bye yet sits out.
+static std::vector<std::pair<int, int>> swiss_pairings(
+    const std::vector<PlayerStanding> &players,
+    const std::vector<std::vector<bool>> &met,
+    std::vector<bool> &had_bye,
+    int &bye) {
+  int count = static_cast<int>(players.size());
+  std::vector<int> order(count);
+  for (int i = 0; i < count; i++) {
+    order[i] = i;
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    if (players[a].points != players[b].points) {
+      return players[a].points > players[b].points;
+    }
+    return players[a].rating > players[b].rating;
+  });
+
+  bye = -1;
+  if (count % 2 == 1) {
+    auto sitting_out = std::find_if(order.rbegin(), order.rend(),
+                                    [&](int player) { return !had_bye[player]; });
+    bye = sitting_out != order.rend() ? *sitting_out : order.back();
+    had_bye[bye] = true;
+    order.erase(std::find(order.begin(), order.end(), bye));
+  }
+
+  std::vector<std::pair<int, int>> pairings;
+  std::vector<bool> paired(count, false);
+  int attempts = SWISS_PAIRING_ATTEMPTS;
+  if (!pair_without_rematches(order, met, paired, pairings, attempts)) {
+    pairings.clear();
+    for (std::size_t i = 0; i + 1 < order.size(); i += 2) {
+      pairings.push_back({order[i], order[i + 1]});
+    }
+  }
+  return pairings;
+}
+
+static void play_matches(const std::vector<TournamentEntrant> &entrants,
+                       const TournamentOptions &options,
+                       std::vector<MatchResult> &matches) {
+  // One task per game, so a few long matches still spread over the pool.
+  run_parallel(matches.size() * 2, options.threads, [&](std::size_t task) {
+    MatchResult &match = matches[task / 2];
+    bool first = task % 2 == 0;
+    MovePolicy policy = entrants[first ? match.first : match.second].new_policy();
+    BotGame game = play_policy_game(policy, options.width, options.height,
+                                    match.seed, options.max_pieces);
+    (first ? match.first_game : match.second_game) = game;
+  });
+}
+
+static void update_ratings(std::vector<PlayerStanding> &players,
+                           MatchResult &match,
+                           double k_factor) {
+  match.first_score = match_score(match.first_game, match.second_game);
+  PlayerStanding &first = players[match.first];
+  PlayerStanding &second = players[match.second];
+  double expected = 1 / (1 + std::pow(10, (second.rating - first.rating) / 400));
+  first.rating += k_factor * (match.first_score - expected);
+  second.rating -= k_factor * (match.first_score - expected);
+  first.points += match.first_score;
+  second.points += 1 - match.first_score;
+  if (match.first_score == 1) {
+    first.wins++;
+    second.losses++;
+  } else if (match.first_score == 0) {
+    first.losses++;
+    second.wins++;
+  } else {
+    first.draws++;
+    second.draws++;
+  }
+}
+
+// The rating difference at which the expected score is score.
+static double elo_difference(double score) {
+  score = std::min(std::max(score, 0.001), 0.999);
+  return -400 * std::log10(1 / score - 1);
+}
+
+static void rate_performance(PlayerStanding &player) {
+  int matches = player.wins + player.draws + player.losses;
+  if (matches == 0) {
+    return;
+  }
+  double score = (player.wins + 0.5 * player.draws) / matches;
+  double square = (player.wins + 0.25 * player.draws) / matches;
+  double error = 1.96 * std::sqrt(std::max(0.0, square - score * score) / matches);
+  player.performance = elo_difference(score);
+  player.performance_low = elo_difference(score - error);
+  player.performance_high = elo_difference(score + error);
+}
+
+TournamentResult run_tournament(const std::vector<TournamentEntrant> &entrants,
+                                const TournamentOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  int count = static_cast<int>(entrants.size());
+  TournamentResult result = {
+    {},
+    std::vector<PlayerStanding>(count, {0, 0, 0, 0, INITIAL_RATING, 0, 0, 0}),
+    0
+  };
+  std::vector<std::vector<bool>> met(count, std::vector<bool>(count, false));
+  std::vector<bool> had_bye(count, false);
+  std::vector<MatchResult> matches;
+  for (int round = 0; round < options.rounds; round++) {
+    std::vector<std::pair<int, int>> pairings;
+    if (options.format == TournamentFormat::ROUND_ROBIN) {
+      pairings = round_robin_pairings(count);
+    } else {
+      int bye;
+      pairings = swiss_pairings(result.players, met, had_bye, bye);
+      if (bye >= 0) {
+        result.players[bye].points += 1;
+      }
+    }
+    for (std::size_t i = 0; i < pairings.size(); i++) {
+      matches.push_back({round, pairings[i].first, pairings[i].second,
+                         match_seed(options.seed, round, static_cast<int>(i)), {}, {}, 0});
+    }
+
+    // Round-robin pairings never depend on results, so every round is
+    // played at once; Swiss pairings wait for the round before.
+    bool last_round = round + 1 == options.rounds;
+    if (options.format == TournamentFormat::SWISS || last_round) {
+      play_matches(entrants, options, matches);
+      for (MatchResult &match : matches) {
+        update_ratings(result.players, match, options.k_factor);
+        met[match.first][match.second] = met[match.second][match.first] = true;
+        result.matches.push_back(match);
+      }
+      matches.clear();
+    }
+  }
+  for (PlayerStanding &player : result.players) {
+    rate_performance(player);
+  }
+  result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
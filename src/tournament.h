@@ -0,0 +1,95 @@
+#pragma once
+
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "bot.h"
+
+// Bot-versus-bot tournaments.
+//
+// A match is a pair of games, one per bot, dealt from the same seed so
+// both see the same pieces. The bot that clears more lines wins. On equal
+// lines the one that placed more pieces before its game ended wins, and
+// otherwise the match is drawn. Every game is a task on a fixed pool of
+// threads: all of a round-robin tournament at once, and a Swiss one round
+// by round. Results are applied in schedule order once the games are
+// done, so a tournament plays out the same on any number of threads.
+// Ratings are Elo, updated after every match. Each player also gets a
+// performance rating from its overall score, with a 95% confidence
+// interval.
+
+// Locks the active block somewhere, returning false if it cannot.
+typedef std::function<bool(GameState &)> MovePolicy;
+
+struct TournamentEntrant {
+  std::string name;
+  std::function<MovePolicy()> new_policy; // a fresh one for every game
+};
+
+// The greedy bot with the given weights.
+TournamentEntrant weighted_bot_entrant(const std::string &name,
+                                       const FeatureWeights &weights,
+                                       int width,
+                                       int height);
+
+// Drops every piece straight down where it appears, as a baseline.
+TournamentEntrant dropping_entrant(const std::string &name);
+
+enum class TournamentFormat {
+  ROUND_ROBIN, // every pair meets once per round
+  SWISS        // each round pairs players with similar scores
+};
+
+struct TournamentOptions {
+  TournamentFormat format;
+  int rounds;
+  int max_pieces; // per game, so strong bots finish
+  int width;
+  int height;
+  double k_factor;
+  RNG::result_type seed;
+  int threads;
+};
+
+struct MatchResult {
+  int round;
+  int first;  // entrant indexes
+  int second;
+  RNG::result_type seed;
+  BotGame first_game;
+  BotGame second_game;
+  double first_score; // 1 for a win, 0.5 for a draw, 0 for a loss
+};
+
+struct PlayerStanding {
+  double points; // a Swiss bye counts as a win
+  int wins;
+  int draws;
+  int losses;
+  double rating;
+  double performance; // relative to the average opponent
+  double performance_low;
+  double performance_high;
+};
+
+struct TournamentResult {
+  std::vector<MatchResult> matches;    // in schedule order
+  std::vector<PlayerStanding> players; // in entrant order
+  double seconds;
+};
+
+const double INITIAL_RATING = 1500;
+
+// The first player's score for a match.
+double match_score(const BotGame &first, const BotGame &second);
+
+// Plays a new game from seed until it ends or max_pieces have locked.
+BotGame play_policy_game(MovePolicy &policy,
+                         int width,
+                         int height,
+                         RNG::result_type seed,
+                         int max_pieces);
+
+TournamentResult run_tournament(const std::vector<TournamentEntrant> &entrants,
+                                const TournamentOptions &options);
@@ -0,0 +1,145 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+
+#include "tournament.h"
+#include "tuner.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--rounds N] [--swiss] [--pieces N] [--k F] [--seed N]\n"
+               "          [--threads N] [--width N] [--height N] BOT BOT...\n"
+               "Plays the bots against each other, every pair once a round or,\n"
+               "with --swiss, paired by score. A BOT is \"default\", \"drop\",\n"
+               "NAME=W1,W2,W3,W4,W5,W6 for feature weights, or NAME=PATH for the\n"
+               "best weights in a tuner checkpoint.\n",
+               program);
+}
+
+bool parse_weights(const std::string &text, FeatureWeights &weights) {
+  std::istringstream in(text);
+  double values[FEATURE_COUNT];
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    char separator;
+    if (!(in >> values[i]) || (i + 1 < FEATURE_COUNT && !(in >> separator && separator == ','))) {
+      return false;
+    }
+  }
+  weights = weights_from_array(values);
+  return in.eof() || (in >> std::ws).eof();
+}
+
+bool parse_entrant(const std::string &arg,
+                   const TournamentOptions &options,
+                   TournamentEntrant &entrant) {
+  if (arg == "default") {
+    entrant = weighted_bot_entrant(arg, DEFAULT_BOT_WEIGHTS, options.width, options.height);
+    return true;
+  }
+  if (arg == "drop") {
+    entrant = dropping_entrant(arg);
+    return true;
+  }
+  std::size_t equals = arg.find('=');
+  if (equals == std::string::npos || equals == 0) {
+    return false;
+  }
+  std::string name = arg.substr(0, equals);
+  std::string value = arg.substr(equals + 1);
+  FeatureWeights weights;
+  if (!parse_weights(value, weights)) {
+    std::ifstream in(value);
+    TunerState state;
+    if (!in || !read_tuner_state(in, state)) {
+      return false;
+    }
+    weights = state.best_weights;
+  }
+  entrant = weighted_bot_entrant(name, weights, options.width, options.height);
+  return true;
+}
+
+int main(int argc, char *argv[]) {
+  TournamentOptions options = {
+    TournamentFormat::ROUND_ROBIN,
+    10,
+    1000,
+    DEFAULT_WIDTH,
+    DEFAULT_HEIGHT,
+    16,
+    0,
+    static_cast<int>(std::thread::hardware_concurrency())
+  };
+  std::vector<std::string> bots;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--rounds" && i + 1 < argc) {
+      options.rounds = std::atoi(argv[++i]);
+    } else if (arg == "--swiss") {
+      options.format = TournamentFormat::SWISS;
+    } else if (arg == "--pieces" && i + 1 < argc) {
+      options.max_pieces = std::atoi(argv[++i]);
+    } else if (arg == "--k" && i + 1 < argc) {
+      options.k_factor = std::atof(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--width" && i + 1 < argc) {
+      options.width = std::atoi(argv[++i]);
+    } else if (arg == "--height" && i + 1 < argc) {
+      options.height = std::atoi(argv[++i]);
+    } else if (arg.compare(0, 2, "--") != 0) {
+      bots.push_back(arg);
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  options.threads = std::max(1, options.threads);
+  if (bots.size() < 2 || options.rounds < 1 || options.max_pieces < 1 ||
+      options.width < MAX_TETROMINO_WIDTH || options.width > EVALUATION_MAX_WIDTH ||
+      options.height < MAX_TETROMINO_HEIGHT || options.height > EVALUATION_MAX_HEIGHT) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  std::vector<TournamentEntrant> entrants;
+  for (const std::string &bot : bots) {
+    TournamentEntrant entrant;
+    if (!parse_entrant(bot, options, entrant)) {
+      std::fprintf(stderr, "Unable to load bot %s\n", bot.c_str());
+      return 1;
+    }
+    entrants.push_back(entrant);
+  }
+
+  TournamentResult result = run_tournament(entrants, options);
+  std::vector<int> order;
+  for (std::size_t i = 0; i < entrants.size(); i++) {
+    order.push_back(static_cast<int>(i));
+  }
+  std::stable_sort(order.begin(), order.end(), [&](int a, int b) {
+    return result.players[a].rating > result.players[b].rating;
+  });
+  std::printf("%-16s %7s %14s %7s %24s\n", "bot", "points", "W-D-L", "rating", "performance (95%)");
+  for (int index : order) {
+    const PlayerStanding &player = result.players[index];
+    char record[32];
+    std::snprintf(record, sizeof(record), "%d-%d-%d", player.wins, player.draws, player.losses);
+    std::printf("%-16s %7.1f %14s %7.0f %+7.0f [%+6.0f, %+6.0f]\n",
+                entrants[index].name.c_str(),
+                player.points,
+                record,
+                player.rating,
+                player.performance,
+                player.performance_low,
+                player.performance_high);
+  }
+  std::printf("%zu matches in %.1f s\n", result.matches.size(), result.seconds);
+  return 0;
+}
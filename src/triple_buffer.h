@@ -0,0 +1,54 @@
+#pragma once
+
+#include <atomic>
+
+// Hands the latest value from one writer thread to one reader thread
+// without locks. The writer fills write_buffer() and publishes it; the
+// reader calls update() and then reads read_buffer(), which stays valid
+// and unchanged until its next update(). Values the reader never picks up
+// are simply overwritten, so neither side waits for the other.
+template <typename T>
+class TripleBuffer {
+public:
+  TripleBuffer() : back(0), middle(1), front(2) {
+  }
+
+  explicit TripleBuffer(const T &initial)
+    : back(0), middle(1), front(2) {
+    buffers[0] = buffers[1] = buffers[2] = initial;
+  }
+
+  T &write_buffer() {
+    return buffers[back];
+  }
+
+  void publish() {
+    // Swap the freshly written buffer into the middle, marked as new.
+    int previous = middle.exchange(back | NEW_VALUE, std::memory_order_acq_rel);
+    back = previous & INDEX_MASK;
+  }
+
+  // Returns true if a newer value was published since the last update.
+  bool update() {
+    if ((middle.load(std::memory_order_relaxed) & NEW_VALUE) == 0) {
+      return false;
+    }
+    int previous = middle.exchange(front, std::memory_order_acq_rel);
+    front = previous & INDEX_MASK;
+    return true;
+  }
+
+  const T &read_buffer() const {
+    return buffers[front];
+  }
+
+private:
+  static const int INDEX_BITS = 2;
+  static const int INDEX_MASK = (1 << INDEX_BITS) - 1;
+  static const int NEW_VALUE = 1 << INDEX_BITS;
+
+  T buffers[3];
+  int back;                // owned by the writer
+  std::atomic<int> middle; // index of the shared buffer, plus NEW_VALUE
+  int front;               // owned by the reader
+};
@@ -0,0 +1,208 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "bot.h"
+#include "parallel.h"
+#include "tuner.h"
+
+const char CHECKPOINT_HEADER[] = "tetris-tuner";
+const int CHECKPOINT_VERSION = 1;
+
+struct Candidate {
+  FeatureWeights weights;
+  std::vector<int> lines; // per game played so far
+  bool pruned;
+};
+
+FeatureWeights weights_from_array(const double *values) {
+  return {values[0], values[1], values[2], values[3], values[4], values[5]};
+}
+
+void weights_to_array(const FeatureWeights &weights, double *values) {
+  values[0] = weights.holes;
+  values[1] = weights.aggregate_height;
+  values[2] = weights.bumpiness;
+  values[3] = weights.row_transitions;
+  values[4] = weights.column_transitions;
+  values[5] = weights.wells;
+}
+
+TunerState new_tuner_state(double initial_deviation) {
+  TunerState state;
+  state.generation = 0;
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    state.mean[i] = 0;
+    state.deviation[i] = initial_deviation;
+  }
+  state.elite_cutoff = 0;
+  state.best_fitness = -1;
+  state.best_weights = weights_from_array(state.mean);
+  return state;
+}
+
+static std::uint32_t derived_seed(RNG::result_type seed, int generation, int index) {
+  std::seed_seq sequence = {
+    static_cast<std::uint32_t>(seed),
+    static_cast<std::uint32_t>(generation),
+    static_cast<std::uint32_t>(index)
+  };
+  std::uint32_t derived;
+  sequence.generate(&derived, &derived + 1);
+  return derived;
+}
+
+static double fitness(const Candidate &candidate) {
+  if (candidate.lines.empty()) {
+    return 0;
+  }
+  double total = 0;
+  for (int lines : candidate.lines) {
+    total += lines;
+  }
+  return total / candidate.lines.size();
+}
+
+GenerationReport run_generation(TunerState &state, const TunerOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  GenerationReport report = {0, 0, 0, 0, 0};
+
+  std::mt19937 sampler(derived_seed(options.seed, state.generation, -1));
+  std::vector<Candidate> candidates(options.population);
+  for (Candidate &candidate : candidates) {
+    double values[FEATURE_COUNT];
+    for (int i = 0; i < FEATURE_COUNT; i++) {
+      values[i] = std::normal_distribution<double>(state.mean[i], state.deviation[i])(sampler);
+    }
+    candidate.weights = weights_from_array(values);
+    candidate.pruned = false;
+  }
+
+  // Every candidate plays the same games, so they are compared on equal
+  // terms; pruning decisions are made between rounds, never mid-round, so
+  // they do not depend on thread timing.
+  for (int first_game = 0; first_game < options.games; first_game += options.round_games) {
+    int round_games = std::min(options.round_games, options.games - first_game);
+    std::vector<int> playing;
+    for (int i = 0; i < options.population; i++) {
+      if (!candidates[i].pruned) {
+        playing.push_back(i);
+        candidates[i].lines.resize(first_game + round_games);
+      }
+    }
+    run_parallel(playing.size() * round_games, options.threads, [&](std::size_t task) {
+      Candidate &candidate = candidates[playing[task / round_games]];
+      int game = first_game + static_cast<int>(task % round_games);
+      Bot bot = new_bot(candidate.weights, options.width, options.height);
+      BotGame result = play_bot_game(
+        bot,
+        derived_seed(options.seed, state.generation, game),
+        options.max_pieces);
+      candidate.lines[game] = result.lines;
+    });
+    report.games += playing.size() * round_games;
+
+    bool last_round = first_game + round_games >= options.games;
+    for (int index : playing) {
+      Candidate &candidate = candidates[index];
+      if (!last_round && fitness(candidate) < options.prune_fraction * state.elite_cutoff) {
+        candidate.pruned = true;
+        report.pruned++;
+      }
+    }
+  }
+
+  // Candidates that played every game rank above those pruned early.
+  std::vector<int> ranking(options.population);
+  for (int i = 0; i < options.population; i++) {
+    ranking[i] = i;
+  }
+  std::stable_sort(ranking.begin(), ranking.end(), [&](int lhs, int rhs) {
+    if (candidates[lhs].pruned != candidates[rhs].pruned) {
+      return !candidates[lhs].pruned;
+    }
+    return fitness(candidates[lhs]) > fitness(candidates[rhs]);
+  });
+
+  int elite = std::max(1, std::min(options.elite, options.population));
+  double means[FEATURE_COUNT] = {0};
+  double squares[FEATURE_COUNT] = {0};
+  for (int rank = 0; rank < elite; rank++) {
+    double values[FEATURE_COUNT];
+    weights_to_array(candidates[ranking[rank]].weights, values);
+    for (int i = 0; i < FEATURE_COUNT; i++) {
+      means[i] += values[i] / elite;
+      squares[i] += values[i] * values[i] / elite;
+    }
+    report.elite_fitness += fitness(candidates[ranking[rank]]) / elite;
+  }
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    state.mean[i] = means[i];
+    double variance = std::max(0.0, squares[i] - means[i] * means[i]);
+    state.deviation[i] = std::sqrt(variance + options.noise);
+  }
+
+  const Candidate &best = candidates[ranking[0]];
+  report.best_fitness = fitness(best);
+  if (!best.pruned && report.best_fitness > state.best_fitness) {
+    state.best_fitness = report.best_fitness;
+    state.best_weights = best.weights;
+  }
+  state.elite_cutoff = fitness(candidates[ranking[elite - 1]]);
+  state.generation++;
+
+  report.seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  return report;
+}
+
+static void write_values(std::ostream &out, const double *values) {
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    out << (i == 0 ? "" : " ") << values[i];
+  }
+  out << '\n';
+}
+
+void write_tuner_state(std::ostream &out, const TunerState &state) {
+  double best[FEATURE_COUNT];
+  weights_to_array(state.best_weights, best);
+  out << std::setprecision(17);
+  out << CHECKPOINT_HEADER << ' ' << CHECKPOINT_VERSION << '\n'
+      << state.generation << '\n';
+  write_values(out, state.mean);
+  write_values(out, state.deviation);
+  out << state.elite_cutoff << ' ' << state.best_fitness << '\n';
+  write_values(out, best);
+}
+
+static bool read_values(std::istream &in, double *values) {
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    if (!(in >> values[i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool read_tuner_state(std::istream &in, TunerState &state) {
+  std::string header;
+  int version;
+  if (!(in >> header >> version) || header != CHECKPOINT_HEADER ||
+      version != CHECKPOINT_VERSION) {
+    return false;
+  }
+  double best[FEATURE_COUNT];
+  if (!(in >> state.generation) ||
+      !read_values(in, state.mean) ||
+      !read_values(in, state.deviation) ||
+      !(in >> state.elite_cutoff >> state.best_fitness) ||
+      !read_values(in, best)) {
+    return false;
+  }
+  state.best_weights = weights_from_array(best);
+  return state.generation >= 0;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <istream>
+#include <ostream>
+
+#include "evaluation.h"
+
+// Cross-entropy tuning of the bot's feature weights.
+//
+// Each generation samples a population of weight vectors from independent
+// normal distributions, plays every candidate through the same seeded
+// games, and refits the distributions to the elite: the candidates that
+// cleared the most lines. Games run in rounds across all threads; after
+// each round a candidate whose average falls below prune_fraction of the
+// previous generation's elite cutoff stops playing. Sampling and game
+// seeds follow from the seed and the generation alone, so a run resumed
+// from a checkpoint continues exactly as if it had not stopped.
+
+struct TunerOptions {
+  int population;        // candidates per generation
+  int elite;             // candidates the next distributions are fitted to
+  int games;             // games per candidate
+  int round_games;       // games between pruning checks
+  int max_pieces;        // per game, so good candidates finish
+  double prune_fraction; // of the last elite cutoff, 0 to never prune
+  double noise;          // variance added to each refit, against early collapse
+  int width;
+  int height;
+  RNG::result_type seed;
+  int threads;
+};
+
+struct TunerState {
+  int generation;
+  double mean[FEATURE_COUNT];
+  double deviation[FEATURE_COUNT];
+  double elite_cutoff;  // fitness of the worst elite in the last generation
+  double best_fitness;  // lines per game, over all generations
+  FeatureWeights best_weights;
+};
+
+struct GenerationReport {
+  double best_fitness;  // of this generation
+  double elite_fitness; // average over the elite
+  int pruned;
+  unsigned long long games;
+  double seconds;
+};
+
+TunerState new_tuner_state(double initial_deviation);
+
+// Runs one generation and advances state to the next.
+GenerationReport run_generation(TunerState &state, const TunerOptions &options);
+
+FeatureWeights weights_from_array(const double *values);
+void weights_to_array(const FeatureWeights &weights, double *values);
+
+// Checkpoints are text, with every number written exactly.
+void write_tuner_state(std::ostream &out, const TunerState &state);
+bool read_tuner_state(std::istream &in, TunerState &state);
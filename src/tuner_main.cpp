@@ -0,0 +1,139 @@
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <thread>
+
+#include "tuner.h"
+
+void usage(const char *program) {
+  std::fprintf(stderr,
+               "Usage: %s [--generations N] [--population N] [--elite N]\n"
+               "          [--games N] [--round N] [--pieces N] [--prune F]\n"
+               "          [--noise F] [--seed N] [--threads N]\n"
+               "          [--width N] [--height N] [--checkpoint PATH]\n"
+               "Tunes the bot's feature weights by the cross-entropy method.\n"
+               "With --checkpoint, resumes from PATH if it exists and saves\n"
+               "there after every generation.\n",
+               program);
+}
+
+bool save_checkpoint(const std::string &path, const TunerState &state) {
+  // Written aside and renamed over, so a crash never leaves half a file.
+  std::string temporary = path + ".tmp";
+  {
+    std::ofstream out(temporary);
+    write_tuner_state(out, state);
+    if (!out) {
+      return false;
+    }
+  }
+  return std::rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+void print_weights(const char *label, const double *values) {
+  std::printf("%s", label);
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    std::printf(" %8.3f", values[i]);
+  }
+  std::printf("\n");
+}
+
+int main(int argc, char *argv[]) {
+  int generations = 20;
+  std::string checkpoint;
+  TunerOptions options = {
+    100,
+    10,
+    20,
+    5,
+    2000,
+    0.5,
+    0.1,
+    DEFAULT_WIDTH,
+    DEFAULT_HEIGHT,
+    0,
+    static_cast<int>(std::thread::hardware_concurrency())
+  };
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--generations" && i + 1 < argc) {
+      generations = std::atoi(argv[++i]);
+    } else if (arg == "--population" && i + 1 < argc) {
+      options.population = std::atoi(argv[++i]);
+    } else if (arg == "--elite" && i + 1 < argc) {
+      options.elite = std::atoi(argv[++i]);
+    } else if (arg == "--games" && i + 1 < argc) {
+      options.games = std::atoi(argv[++i]);
+    } else if (arg == "--round" && i + 1 < argc) {
+      options.round_games = std::atoi(argv[++i]);
+    } else if (arg == "--pieces" && i + 1 < argc) {
+      options.max_pieces = std::atoi(argv[++i]);
+    } else if (arg == "--prune" && i + 1 < argc) {
+      options.prune_fraction = std::atof(argv[++i]);
+    } else if (arg == "--noise" && i + 1 < argc) {
+      options.noise = std::atof(argv[++i]);
+    } else if (arg == "--seed" && i + 1 < argc) {
+      options.seed = std::strtoul(argv[++i], nullptr, 10);
+    } else if (arg == "--threads" && i + 1 < argc) {
+      options.threads = std::atoi(argv[++i]);
+    } else if (arg == "--width" && i + 1 < argc) {
+      options.width = std::atoi(argv[++i]);
+    } else if (arg == "--height" && i + 1 < argc) {
+      options.height = std::atoi(argv[++i]);
+    } else if (arg == "--checkpoint" && i + 1 < argc) {
+      checkpoint = argv[++i];
+    } else {
+      usage(argv[0]);
+      return 1;
+    }
+  }
+  options.threads = std::max(1, options.threads);
+  if (options.population < 1 || options.elite < 1 || options.games < 1 ||
+      options.round_games < 1 || options.max_pieces < 1 ||
+      options.width < MAX_TETROMINO_WIDTH || options.width > EVALUATION_MAX_WIDTH ||
+      options.height < MAX_TETROMINO_HEIGHT || options.height > EVALUATION_MAX_HEIGHT) {
+    usage(argv[0]);
+    return 1;
+  }
+
+  TunerState state = new_tuner_state(10);
+  if (!checkpoint.empty()) {
+    std::ifstream in(checkpoint);
+    if (in && !read_tuner_state(in, state)) {
+      std::fprintf(stderr, "Unable to read checkpoint %s\n", checkpoint.c_str());
+      return 1;
+    }
+    if (state.generation > 0) {
+      std::printf("Resuming at generation %d\n", state.generation);
+    }
+  }
+
+  std::printf("holes, aggregate height, bumpiness, row transitions, "
+              "column transitions, wells\n");
+  while (state.generation < generations) {
+    GenerationReport report = run_generation(state, options);
+    std::printf("generation %d: best %.1f, elite %.1f lines per game; "
+                "%d pruned, %llu games in %.1f s\n",
+                state.generation,
+                report.best_fitness,
+                report.elite_fitness,
+                report.pruned,
+                report.games,
+                report.seconds);
+    print_weights("  mean     ", state.mean);
+    print_weights("  deviation", state.deviation);
+    std::fflush(stdout);
+    if (!checkpoint.empty() && !save_checkpoint(checkpoint, state)) {
+      std::fprintf(stderr, "Unable to write checkpoint %s\n", checkpoint.c_str());
+      return 1;
+    }
+  }
+
+  double best[FEATURE_COUNT];
+  weights_to_array(state.best_weights, best);
+  std::printf("best %.1f lines per game\n", state.best_fitness);
+  print_weights("  weights  ", best);
+  return 0;
+}
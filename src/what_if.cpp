@@ -0,0 +1,177 @@
+#include <algorithm>
+#include <chrono>
+#include <utility>
+
+#include "parallel.h"
+#include "what_if.h"
+
+// Splitting stops at this depth, or once there are this many subtrees per
+// thread.
+const int WHAT_IF_SPLIT_DEPTH = 3;
+const std::size_t WHAT_IF_TASKS_PER_THREAD = 8;
+
+struct TrieNode {
+  Action action; // the action leading here from the parent
+  int parent;
+  int first_child;
+  int next_sibling;
+  int first_end; // the first sequence ending here, -1 for none
+};
+
+struct Trie {
+  std::vector<TrieNode> nodes; // the root is node 0
+  std::vector<int> next_end;   // links the sequences ending at a node
+};
+
+static Trie build_trie(const std::vector<std::vector<Action>> &sequences) {
+  Trie trie = {
+    std::vector<TrieNode>(1, {Action::NO_ACTION, -1, -1, -1, -1}),
+    std::vector<int>(sequences.size(), -1)
+  };
+  for (std::size_t sequence = 0; sequence < sequences.size(); sequence++) {
+    int node = 0;
+    for (Action action : sequences[sequence]) {
+      int child = trie.nodes[node].first_child;
+      while (child >= 0 && trie.nodes[child].action != action) {
+        child = trie.nodes[child].next_sibling;
+      }
+      if (child < 0) {
+        child = static_cast<int>(trie.nodes.size());
+        trie.nodes.push_back({action, node, -1, trie.nodes[node].first_child, -1});
+        trie.nodes[node].first_child = child;
+      }
+      node = child;
+    }
+    trie.next_end[sequence] = trie.nodes[node].first_end;
+    trie.nodes[node].first_end = static_cast<int>(sequence);
+  }
+  return trie;
+}
+
+struct WhatIfTask {
+  int node;
+  GameState state; // after the actions leading to node
+};
+
+static void record_ends(const Trie &trie,
+                        int node,
+                        const GameState &state,
+                        const WhatIfOptions &options,
+                        WhatIfResult &result) {
+  for (int sequence = trie.nodes[node].first_end; sequence >= 0;
+       sequence = trie.next_end[sequence]) {
+    result.summaries[sequence] = {
+      state.score,
+      state.lines,
+      state.progress,
+      options.evaluate ? options.evaluate(state) : 0
+    };
+    if (options.keep_states) {
+      result.states[sequence] = state;
+    }
+  }
+}
+
+// Walks the subtree below task.node without recursion, since sequences
+// can be far longer than the stack is deep. The state at depth d below
+// task.node is in slots[slot_at[d]]; an only child shares its parent's
+// slot, since nothing else needs the parent's state.
+static unsigned long long walk_subtree(const Trie &trie,
+                                       WhatIfTask &task,
+                                       const WhatIfOptions &options,
+                                       WhatIfResult &result) {
+  unsigned long long reductions = 0;
+  record_ends(trie, task.node, task.state, options, result);
+  std::vector<GameState> slots;
+  slots.push_back(std::move(task.state));
+  std::vector<int> slot_at(1, 0);
+  int depth = 0;
+  int node = trie.nodes[task.node].first_child;
+  while (node >= 0) {
+    const TrieNode &current = trie.nodes[node];
+    depth++;
+    if (static_cast<int>(slot_at.size()) <= depth) {
+      slot_at.push_back(0);
+    }
+    int parent_slot = slot_at[depth - 1];
+    bool only_child = current.next_sibling < 0 &&
+                      trie.nodes[current.parent].first_child == node;
+    if (only_child) {
+      slot_at[depth] = parent_slot;
+    } else {
+      slot_at[depth] = parent_slot + 1;
+      if (static_cast<int>(slots.size()) <= slot_at[depth]) {
+        slots.emplace_back();
+      }
+      slots[slot_at[depth]] = slots[parent_slot]; // reuses the slot's rows
+    }
+    GameState &state = slots[slot_at[depth]];
+    state = reduce(std::move(state), current.action);
+    reductions++;
+    record_ends(trie, node, state, options, result);
+
+    if (current.first_child >= 0) {
+      node = current.first_child;
+      continue;
+    }
+    // Climb to the nearest ancestor with a sibling left to visit.
+    while (node != task.node && trie.nodes[node].next_sibling < 0) {
+      node = trie.nodes[node].parent;
+      depth--;
+    }
+    if (node == task.node) {
+      break;
+    }
+    node = trie.nodes[node].next_sibling;
+    depth--;
+  }
+  return reductions;
+}
+
+WhatIfResult evaluate_sequences(const GameState &root,
+                                const std::vector<std::vector<Action>> &sequences,
+                                const WhatIfOptions &options) {
+  auto start = std::chrono::steady_clock::now();
+  WhatIfResult result = {
+    std::vector<WhatIfSummary>(sequences.size()),
+    std::vector<GameState>(options.keep_states ? sequences.size() : 0),
+    0,
+    0,
+    0
+  };
+  for (const std::vector<Action> &sequence : sequences) {
+    result.sequence_actions += sequence.size();
+  }
+  Trie trie = build_trie(sequences);
+
+  // Split the top of the trie into enough subtrees to share out, playing
+  // the levels above the split here.
+  int threads = std::max(1, options.threads);
+  std::vector<WhatIfTask> tasks(1, {0, root});
+  for (int depth = 0;
+       threads > 1 && depth < WHAT_IF_SPLIT_DEPTH &&
+       tasks.size() < threads * WHAT_IF_TASKS_PER_THREAD;
+       depth++) {
+    std::vector<WhatIfTask> next_tasks;
+    for (const WhatIfTask &task : tasks) {
+      record_ends(trie, task.node, task.state, options, result);
+      for (int child = trie.nodes[task.node].first_child; child >= 0;
+           child = trie.nodes[child].next_sibling) {
+        next_tasks.push_back({child, reduce(task.state, trie.nodes[child].action)});
+        result.reductions++;
+      }
+    }
+    tasks = std::move(next_tasks);
+  }
+
+  std::vector<unsigned long long> reductions(tasks.size(), 0);
+  run_parallel(tasks.size(), threads, [&](std::size_t index) {
+    reductions[index] = walk_subtree(trie, tasks[index], options, result);
+  });
+  for (unsigned long long count : reductions) {
+    result.reductions += count;
+  }
+  result.seconds = std::chrono::duration<double>(
+    std::chrono::steady_clock::now() - start).count();
+  return result;
+}
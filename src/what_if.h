@@ -0,0 +1,44 @@
+#pragma once
+
+#include <functional>
+#include <vector>
+
+#include "state.h"
+
+// Plays many action sequences from one state at once, for planners that
+// ask what each of thousands of rollouts would lead to.
+//
+// The sequences are merged into a trie, so a prefix they share is reduced
+// once. The trie is walked depth first, reducing one working state in
+// place down each chain of single children. Where a node branches, each
+// child starts from a copy of the node's state, assigned into a state
+// kept from earlier branches so that its rows are reused. With more than
+// one thread the trie is split a few levels down and the subtrees are
+// walked on the pool.
+
+struct WhatIfOptions {
+  bool keep_states; // return every final state, not just the summaries
+  int threads;
+  // Scores each final state into its summary if set. Called from the
+  // worker threads.
+  std::function<double(const GameState &)> evaluate;
+};
+
+struct WhatIfSummary {
+  int score;
+  int lines;
+  GameProgress progress;
+  double value; // from evaluate, or 0
+};
+
+struct WhatIfResult {
+  std::vector<WhatIfSummary> summaries; // in the order of the sequences
+  std::vector<GameState> states;        // likewise, if kept
+  unsigned long long reductions;        // calls to reduce
+  unsigned long long sequence_actions;  // calls to reduce one by one
+  double seconds;
+};
+
+WhatIfResult evaluate_sequences(const GameState &root,
+                                const std::vector<std::vector<Action>> &sequences,
+                                const WhatIfOptions &options);
@@ -0,0 +1,193 @@
+#include "catch.hpp"
+
+#include <cstring>
+#include <utility>
+#include <vector>
+
+#include "../src/agent_protocol.h"
+#include "../src/allocation_counter.h"
+#include "../src/packed_state.h"
+#include "../src/session_protocol.h"
+
+static const Action STEP_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::ROTATE_CLOCKWISE,
+  Action::MOVE_DOWN,
+  Action::TIME_FALL,
+  Action::MOVE_RIGHT
+};
+
+// Handles one whole frame, checking that the reply is one whole frame.
+static bool exchange(AgentGames &games,
+                     const std::vector<std::uint8_t> &request,
+                     std::vector<std::uint8_t> &reply) {
+  reply.clear();
+  REQUIRE(get_agent_u32(request.data()) + AGENT_LENGTH_SIZE == request.size());
+  if (!handle_agent_frame(games, request.data() + AGENT_LENGTH_SIZE,
+                          request.size() - AGENT_LENGTH_SIZE, reply)) {
+    return false;
+  }
+  REQUIRE(get_agent_u32(reply.data()) + AGENT_LENGTH_SIZE == reply.size());
+  return true;
+}
+
+static const std::uint8_t *reply_entry(const std::vector<std::uint8_t> &reply,
+                                       AgentBlock block,
+                                       int index) {
+  return reply.data() + AGENT_LENGTH_SIZE + AGENT_HEADER_SIZE +
+         index * (AGENT_REPLY_ENTRY_SIZE + agent_block_size(block));
+}
+
+TEST_CASE("Agent frames step many games", "[agent_protocol]") {
+  AgentGames games = new_agent_games(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::vector<std::uint8_t> request;
+  std::vector<std::uint8_t> reply;
+  std::size_t start = begin_agent_frame(request, AgentRequestKind::NEW_GAME, AgentBlock::STATUS, 2);
+  add_new_game_entry(request, 7, 100);
+  add_new_game_entry(request, 900000, 200);
+  finish_agent_frame(request, start);
+  REQUIRE(exchange(games, request, reply));
+  CHECK(reply[AGENT_LENGTH_SIZE] == static_cast<std::uint8_t>(AgentRequestKind::NEW_GAME));
+  CHECK(get_agent_u32(reply.data() + AGENT_LENGTH_SIZE + 4) == 2);
+
+  GameState expected[] = {new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 100),
+                          new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 200)};
+  for (AgentBlock block : {AgentBlock::NONE, AgentBlock::STATUS, AgentBlock::PACKED}) {
+    request.clear();
+    start = begin_agent_frame(request, AgentRequestKind::STEP, block, 2);
+    add_step_entry(request, 7, STEP_ACTIONS, 5);
+    add_step_entry(request, 900000, STEP_ACTIONS + 1, 3);
+    finish_agent_frame(request, start);
+    REQUIRE(exchange(games, request, reply));
+    for (int i = 0; i < 5; i++) {
+      expected[0] = reduce(std::move(expected[0]), STEP_ACTIONS[i]);
+    }
+    for (int i = 1; i < 4; i++) {
+      expected[1] = reduce(std::move(expected[1]), STEP_ACTIONS[i]);
+    }
+    CHECK(reply.size() == AGENT_LENGTH_SIZE + AGENT_HEADER_SIZE +
+                          2 * (AGENT_REPLY_ENTRY_SIZE + agent_block_size(block)));
+
+    for (int game = 0; game < 2; game++) {
+      const std::uint8_t *entry = reply_entry(reply, block, game);
+      CHECK(get_agent_u32(entry) == (game == 0 ? 7u : 900000u));
+      CHECK(entry[4] == static_cast<std::uint8_t>(AgentStatus::OK));
+      const std::uint8_t *bytes = entry + AGENT_REPLY_ENTRY_SIZE;
+      if (block == AgentBlock::STATUS) {
+        StatusReport report = decode_status_report(bytes);
+        CHECK(report.actions_applied == (game == 0 ? 5u : 3u));
+        CHECK(report.position_x == expected[game].active_block.position_x);
+        CHECK(report.position_y == expected[game].active_block.position_y);
+        CHECK(report.rotation == expected[game].active_block.rotation);
+      } else if (block == AgentBlock::PACKED) {
+        PackedState packed;
+        std::memcpy(packed.bytes, bytes, PACKED_STATE_SIZE);
+        GameState unpacked;
+        unpack_state(packed_format(expected[game]), packed, unpacked);
+        CHECK(unpacked == expected[game]);
+      }
+    }
+  }
+  CHECK(games.games.at(7) == expected[0]);
+  CHECK(games.games.at(900000) == expected[1]);
+}
+
+TEST_CASE("Agent entries report unknown games and bad actions", "[agent_protocol]") {
+  AgentGames games = new_agent_games(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::vector<std::uint8_t> request;
+  std::vector<std::uint8_t> reply;
+  std::size_t start = begin_agent_frame(request, AgentRequestKind::NEW_GAME, AgentBlock::NONE, 1);
+  add_new_game_entry(request, 1, 5);
+  finish_agent_frame(request, start);
+  REQUIRE(exchange(games, request, reply));
+
+  const Action actions[] = {Action::MOVE_LEFT, Action::NEW_GAME, Action::MOVE_LEFT};
+  request.clear();
+  start = begin_agent_frame(request, AgentRequestKind::STEP, AgentBlock::STATUS, 2);
+  add_step_entry(request, 1, actions, 3);
+  add_step_entry(request, 2, actions, 1);
+  finish_agent_frame(request, start);
+  REQUIRE(exchange(games, request, reply));
+  const std::uint8_t *entry = reply_entry(reply, AgentBlock::STATUS, 0);
+  CHECK(entry[4] == static_cast<std::uint8_t>(AgentStatus::INVALID_ACTION));
+  CHECK(decode_status_report(entry + AGENT_REPLY_ENTRY_SIZE).actions_applied == 1);
+  entry = reply_entry(reply, AgentBlock::STATUS, 1);
+  CHECK(entry[4] == static_cast<std::uint8_t>(AgentStatus::UNKNOWN_GAME));
+  for (std::size_t i = 0; i < STATUS_REPORT_SIZE; i++) {
+    CHECK(entry[AGENT_REPLY_ENTRY_SIZE + i] == 0);
+  }
+
+  request.clear();
+  start = begin_agent_frame(request, AgentRequestKind::END_GAME, AgentBlock::NONE, 2);
+  add_end_game_entry(request, 1);
+  add_end_game_entry(request, 1);
+  finish_agent_frame(request, start);
+  REQUIRE(exchange(games, request, reply));
+  CHECK(reply_entry(reply, AgentBlock::NONE, 0)[4] == static_cast<std::uint8_t>(AgentStatus::OK));
+  CHECK(reply_entry(reply, AgentBlock::NONE, 1)[4] ==
+        static_cast<std::uint8_t>(AgentStatus::UNKNOWN_GAME));
+  CHECK(games.games.empty());
+}
+
+TEST_CASE("Malformed agent frames are rejected whole", "[agent_protocol]") {
+  AgentGames games = new_agent_games(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::vector<std::uint8_t> request;
+  std::size_t start = begin_agent_frame(request, AgentRequestKind::NEW_GAME, AgentBlock::NONE, 2);
+  add_new_game_entry(request, 1, 5);
+  add_new_game_entry(request, 2, 5);
+  finish_agent_frame(request, start);
+  std::vector<std::uint8_t> reply(3, 0xAA);
+
+  const std::uint8_t *body = request.data() + AGENT_LENGTH_SIZE;
+  std::size_t size = request.size() - AGENT_LENGTH_SIZE;
+  CHECK_FALSE(handle_agent_frame(games, body, size - 1, reply));
+  CHECK_FALSE(handle_agent_frame(games, body, AGENT_HEADER_SIZE - 1, reply));
+  std::vector<std::uint8_t> changed(body, body + size);
+  changed[0] = 9;
+  CHECK_FALSE(handle_agent_frame(games, changed.data(), size, reply));
+  changed[0] = body[0];
+  changed[1] = 3;
+  CHECK_FALSE(handle_agent_frame(games, changed.data(), size, reply));
+  changed[1] = body[1];
+  changed[4] = 3; // one more entry than the body holds
+  CHECK_FALSE(handle_agent_frame(games, changed.data(), size, reply));
+
+  std::vector<std::uint8_t> step;
+  start = begin_agent_frame(step, AgentRequestKind::STEP, AgentBlock::NONE, 1);
+  add_step_entry(step, 1, STEP_ACTIONS, 5);
+  finish_agent_frame(step, start);
+  step[AGENT_LENGTH_SIZE + AGENT_HEADER_SIZE + 4] = 6; // more actions than sent
+  CHECK_FALSE(handle_agent_frame(games, step.data() + AGENT_LENGTH_SIZE,
+                                 step.size() - AGENT_LENGTH_SIZE, reply));
+
+  CHECK(reply == std::vector<std::uint8_t>(3, 0xAA));
+  CHECK(games.games.empty());
+}
+
+TEST_CASE("Stepping agent games does not allocate", "[agent_protocol][allocation]") {
+  AgentGames games = new_agent_games(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::vector<std::uint8_t> request;
+  std::vector<std::uint8_t> reply;
+  std::size_t start = begin_agent_frame(request, AgentRequestKind::NEW_GAME, AgentBlock::NONE, 64);
+  for (std::uint32_t game = 0; game < 64; game++) {
+    add_new_game_entry(request, game, game);
+  }
+  finish_agent_frame(request, start);
+  REQUIRE(exchange(games, request, reply));
+
+  request.clear();
+  start = begin_agent_frame(request, AgentRequestKind::STEP, AgentBlock::PACKED, 64);
+  for (std::uint32_t game = 0; game < 64; game++) {
+    add_step_entry(request, game, STEP_ACTIONS, 5);
+  }
+  finish_agent_frame(request, start);
+  REQUIRE(exchange(games, request, reply));
+
+  AllocationCount before = thread_allocation_count();
+  for (int frame = 0; frame < 100; frame++) {
+    reply.clear();
+    REQUIRE(handle_agent_frame(games, request.data() + AGENT_LENGTH_SIZE,
+                               request.size() - AGENT_LENGTH_SIZE, reply));
+  }
+  CHECK(allocations_since(before).allocations == 0);
+}
@@ -0,0 +1,148 @@
+#include "catch.hpp"
+
+#include <random>
+#include <utility>
+
+#include "../src/analytics.h"
+
+TEST_CASE("Histograms are exact for small values", "[analytics]") {
+  Histogram histogram = new_histogram();
+  for (std::uint64_t value = 1; value <= 10; value++) {
+    record_value(histogram, value);
+  }
+  CHECK(histogram.count == 10);
+  CHECK(histogram.min == 1);
+  CHECK(histogram.max == 10);
+  CHECK(histogram_mean(histogram) == 5.5);
+  CHECK(histogram_quantile(histogram, 0) == 1);
+  CHECK(histogram_quantile(histogram, 0.5) == 5);
+  CHECK(histogram_quantile(histogram, 0.91) == 10);
+  CHECK(histogram_quantile(histogram, 1) == 10);
+  CHECK(histogram_quantile(new_histogram(), 0.5) == 0);
+}
+
+TEST_CASE("Histogram quantiles are within a bucket", "[analytics]") {
+  std::mt19937_64 random(3);
+  Histogram histogram = new_histogram();
+  std::vector<std::uint64_t> values;
+  for (int i = 0; i < 10000; i++) {
+    std::uint64_t value = random() >> (random() % 64);
+    values.push_back(value);
+    record_value(histogram, value);
+  }
+  std::sort(values.begin(), values.end());
+  for (double quantile : {0.01, 0.25, 0.5, 0.9, 0.999}) {
+    double exact = static_cast<double>(values[static_cast<std::size_t>(quantile * values.size()) - 1]);
+    double estimate = static_cast<double>(histogram_quantile(histogram, quantile));
+    CHECK(std::abs(estimate - exact) <= exact / HISTOGRAM_SUB_BUCKETS + 1);
+  }
+  CHECK(histogram_quantile(histogram, 1) == values.back());
+}
+
+TEST_CASE("Merged histograms count everything", "[analytics]") {
+  Histogram all = new_histogram();
+  Histogram low = new_histogram();
+  Histogram high = new_histogram();
+  for (std::uint64_t value = 0; value < 1000; value += 7) {
+    record_value(all, value);
+    record_value(value < 500 ? low : high, value);
+  }
+  merge_histogram(low, high);
+  CHECK(low.count == all.count);
+  CHECK(low.sum == all.sum);
+  CHECK(low.min == all.min);
+  CHECK(low.max == all.max);
+  CHECK(std::equal(low.buckets, low.buckets + HISTOGRAM_BUCKETS, all.buckets));
+}
+
+TEST_CASE("Bot analytics match the games played", "[analytics]") {
+  BotAnalyticsOptions options = {
+    12, 40, 150, DEFAULT_WIDTH, DEFAULT_HEIGHT, DEFAULT_BOT_WEIGHTS, 1, 25
+  };
+  GameAnalytics analytics = analyze_bot_games(options);
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::uint64_t lines = 0;
+  std::uint64_t pieces = 0;
+  for (int game = 0; game < 12; game++) {
+    BotGame played = play_bot_game(bot, 40 + game, 150);
+    lines += played.lines;
+    pieces += played.pieces;
+  }
+
+  CHECK(analytics.games == 12);
+  CHECK(analytics.lines.sum == lines);
+  CHECK(analytics.pieces.sum == pieces);
+  std::uint64_t locks = 0;
+  std::uint64_t cleared = 0;
+  for (int count = 0; count <= MAX_TETROMINO_HEIGHT; count++) {
+    locks += analytics.clears[count];
+    cleared += count * analytics.clears[count];
+  }
+  CHECK(locks == pieces);
+  CHECK(cleared == lines);
+  std::uint64_t dealt = 0;
+  for (std::uint64_t count : analytics.tetrominoes) {
+    dealt += count;
+  }
+  CHECK(dealt == pieces + 2 * 12);
+  std::uint64_t heights = 0;
+  for (const Histogram &window : analytics.heights) {
+    heights += window.count;
+    CHECK(window.max <= DEFAULT_HEIGHT);
+  }
+  CHECK(heights == pieces);
+  CHECK(analytics.heights[0].count == 12 * 25);
+}
+
+TEST_CASE("Analytics do not depend on the number of threads", "[analytics]") {
+  BotAnalyticsOptions options = {
+    30, 7, 80, DEFAULT_WIDTH, DEFAULT_HEIGHT, DEFAULT_BOT_WEIGHTS, 1, 10
+  };
+  GameAnalytics one = analyze_bot_games(options);
+  options.threads = 4;
+  GameAnalytics four = analyze_bot_games(options);
+  CHECK(one.games == four.games);
+  CHECK(one.score.sum == four.score.sum);
+  CHECK(std::equal(one.pieces.buckets, one.pieces.buckets + HISTOGRAM_BUCKETS,
+                   four.pieces.buckets));
+  CHECK(std::equal(one.clears, one.clears + MAX_TETROMINO_HEIGHT + 1, four.clears));
+  CHECK(std::equal(one.tetrominoes, one.tetrominoes + TETROMINO_COUNT, four.tetrominoes));
+  for (int window = 0; window < ANALYTICS_HEIGHT_WINDOWS; window++) {
+    CHECK(one.heights[window].sum == four.heights[window].sum);
+  }
+}
+
+TEST_CASE("Replayed games are tracked lock by lock", "[analytics]") {
+  std::mt19937 random(5);
+  const Action moves[] = {
+    Action::MOVE_LEFT, Action::MOVE_RIGHT, Action::ROTATE_CLOCKWISE, Action::TIME_FALL
+  };
+  std::vector<Replay> games;
+  std::uint64_t lines = 0;
+  std::uint64_t score = 0;
+  std::uint64_t over = 0;
+  for (int game = 0; game < 20; game++) {
+    Replay replay = {DEFAULT_WIDTH, DEFAULT_HEIGHT, {{0, Action::NEW_GAME, static_cast<RNG::result_type>(game)}}};
+    GameState state = apply_replay_event({}, replay.events[0], DEFAULT_WIDTH, DEFAULT_HEIGHT);
+    for (int step = 0; step < 600; step++) {
+      ReplayEvent event = {0, random() % 3 == 0 ? Action::MOVE_DOWN : moves[random() % 4], 0};
+      replay.events.push_back(event);
+      state = apply_replay_event(std::move(state), event, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+    }
+    lines += state.lines;
+    score += state.score;
+    over += state.progress == GameProgress::GAME_OVER;
+    games.push_back(replay);
+  }
+
+  GameAnalytics analytics = analyze_replays(games, 3, ANALYTICS_DEFAULT_HEIGHT_WINDOW);
+  CHECK(analytics.games == 20);
+  CHECK(analytics.games_over == over);
+  CHECK(analytics.lines.sum == lines);
+  CHECK(analytics.score.sum == score);
+  std::uint64_t points = 0;
+  for (int count = 0; count <= MAX_TETROMINO_HEIGHT; count++) {
+    points += analytics.clears[count] * new_score(0, count);
+  }
+  CHECK(points == score);
+}
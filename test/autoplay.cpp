@@ -0,0 +1,131 @@
+#include "catch.hpp"
+
+#include <chrono>
+#include <thread>
+#include <vector>
+
+#include "../src/autoplay.h"
+#include "../src/finesse.h"
+
+static bool never() {
+  return false;
+}
+
+static std::vector<PlannedMove> plan_all_depths(Bot &bot, const GameState &state) {
+  std::vector<PlannedMove> moves;
+  REQUIRE(plan_autoplay_move(bot, state, AUTOPLAY_MAX_DEPTH, never,
+                             [&](const PlannedMove &move) { moves.push_back(move); }));
+  return moves;
+}
+
+TEST_CASE("Autoplay deepens one placement at a time", "[autoplay]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 5);
+  std::vector<PlannedMove> moves = plan_all_depths(bot, state);
+
+  REQUIRE(moves.size() == AUTOPLAY_MAX_DEPTH);
+  for (int i = 0; i < AUTOPLAY_MAX_DEPTH; i++) {
+    CHECK(moves[i].depth == i + 1);
+    CHECK(moves[i].complete == (i + 1 == AUTOPLAY_MAX_DEPTH));
+    std::vector<Action> actions;
+    CHECK(find_placement_inputs(state, moves[i].target, actions));
+  }
+}
+
+TEST_CASE("Autoplay at depth 1 plays like the greedy bot", "[autoplay]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 8);
+  for (int piece = 0; piece < 20; piece++) {
+    std::vector<PlannedMove> moves;
+    REQUIRE(plan_autoplay_move(bot, state, 1, never,
+                               [&](const PlannedMove &move) { moves.push_back(move); }));
+    REQUIRE(moves.size() == 1);
+    GameState planned = state;
+    planned.active_block = moves[0].target;
+    planned = reduce(std::move(planned), Action::MOVE_DOWN);
+
+    REQUIRE(play_bot_move(bot, state));
+    REQUIRE(planned == state);
+  }
+}
+
+TEST_CASE("Autoplay with lookahead survives", "[autoplay]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 3);
+  for (int piece = 0; piece < 40; piece++) {
+    PlannedMove best = plan_all_depths(bot, state).back();
+    std::vector<Action> actions;
+    REQUIRE(find_placement_inputs(state, best.target, actions));
+    for (Action action : actions) {
+      state = reduce(std::move(state), action);
+    }
+  }
+  CHECK(state.progress == GameProgress::IN_PROGRESS);
+  CHECK(state.lines > 0);
+}
+
+TEST_CASE("Abandoned autoplay searches stop", "[autoplay]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 5);
+  int checks = 0;
+  int reported = 0;
+  bool finished = plan_autoplay_move(
+    bot, state, AUTOPLAY_MAX_DEPTH,
+    [&]() { return ++checks > 3; },
+    [&](const PlannedMove &) { reported++; });
+  CHECK_FALSE(finished);
+  CHECK(reported >= 1);
+  CHECK(reported < AUTOPLAY_MAX_DEPTH);
+
+  GameState over = state;
+  over.progress = GameProgress::GAME_OVER;
+  CHECK_FALSE(plan_autoplay_move(bot, over, AUTOPLAY_MAX_DEPTH, never,
+                                 [&](const PlannedMove &) { reported++; }));
+}
+
+TEST_CASE("The planner answers the latest request", "[autoplay]") {
+  AutoplayPlanner planner(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState first = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 1);
+  GameState second = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  PlannedMove move;
+  CHECK_FALSE(planner.best_move(1, move));
+
+  planner.request(first, 1);
+  planner.request(second, 2);
+  bool complete = false;
+  for (int i = 0; i < 2000 && !complete; i++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    complete = planner.best_move(2, move) && move.complete;
+  }
+  REQUIRE(complete);
+  CHECK(move.request == 2);
+  CHECK(move.depth == AUTOPLAY_MAX_DEPTH);
+  CHECK_FALSE(planner.best_move(1, move));
+
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  CHECK(move.target == plan_all_depths(bot, second).back().target);
+}
+
+TEST_CASE("Autoplay keeps its last choice when every deeper line loses", "[autoplay]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 3);
+  // Two free rows: some placements survive, but none leaves room for the
+  // next block.
+  for (int y = 0; y < DEFAULT_HEIGHT - 2; y++) {
+    for (int x = 0; x < DEFAULT_WIDTH; x++) {
+      state.field.lines[y][x] = x == y * 3 % DEFAULT_WIDTH ? CellState::EMPTY : CellState::FILLED;
+    }
+  }
+  refresh_versions(state);
+
+  std::vector<PlannedMove> moves;
+  REQUIRE(plan_autoplay_move(bot, state, 3, never,
+                             [&](const PlannedMove &move) { moves.push_back(move); }));
+  REQUIRE(moves.size() == 3);
+  GameState placed = state;
+  placed.active_block = moves[0].target;
+  placed = reduce(std::move(placed), Action::MOVE_DOWN);
+  REQUIRE(placed.progress == GameProgress::IN_PROGRESS);
+  CHECK(moves[1].target == moves[0].target);
+  CHECK(moves[2].target == moves[0].target);
+}
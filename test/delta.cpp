@@ -0,0 +1,193 @@
+#include "catch.hpp"
+
+#include <unistd.h>
+
+#include "../src/delta.h"
+
+const Action PLAYED_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::ROTATE_CLOCKWISE,
+  Action::MOVE_DOWN,
+  Action::MOVE_DOWN,
+  Action::TIME_FALL,
+  Action::ROTATE_COUNTERCLOCKWISE
+};
+
+void check_same_game(const GameState &lhs, const GameState &rhs) {
+  CHECK(lhs == rhs);
+  CHECK(lhs.progress == rhs.progress);
+  CHECK(lhs.rng.seed() == rhs.rng.seed());
+  CHECK(lhs.rng.position() == rhs.rng.position());
+}
+
+// Reads whatever the pipe holds and feeds each complete frame to decoder.
+void drain_pipe(int fd, std::vector<std::uint8_t> &pending, DeltaDecoder &decoder) {
+  std::uint8_t buffer[4096];
+  ssize_t count = read(fd, buffer, sizeof(buffer));
+  REQUIRE(count > 0);
+  pending.insert(pending.end(), buffer, buffer + count);
+  Frame frame;
+  std::size_t used;
+  while ((used = take_framed(pending.data(), pending.size(), frame)) > 0) {
+    REQUIRE(apply_frame(decoder, frame));
+    pending.erase(pending.begin(), pending.begin() + used);
+  }
+}
+
+TEST_CASE("Spectators reconstruct every state over a pipe", "[delta]") {
+  int fds[2];
+  REQUIRE(pipe(fds) == 0);
+
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 42);
+  DeltaEncoder encoder = new_delta_encoder(64);
+  DeltaDecoder decoder = new_delta_decoder();
+  std::vector<std::uint8_t> pending;
+
+  for (int step = 0; step < 2000 && state.progress == GameProgress::IN_PROGRESS; step++) {
+    std::vector<std::uint8_t> stream;
+    append_framed(stream, encode_frame(encoder, state));
+    REQUIRE(write(fds[1], stream.data(), stream.size()) ==
+            static_cast<ssize_t>(stream.size()));
+    drain_pipe(fds[0], pending, decoder);
+
+    REQUIRE(decoder.synchronized);
+    check_same_game(decoder.state, state);
+    state = reduce(state, PLAYED_ACTIONS[step % 7]);
+  }
+  CHECK(state.rng.position() > 2); // pieces were locked
+
+  close(fds[0]);
+  close(fds[1]);
+}
+
+TEST_CASE("Spectators joining mid-game wait for a keyframe", "[delta]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 7);
+  DeltaEncoder encoder = new_delta_encoder(10);
+  DeltaDecoder late = new_delta_decoder();
+
+  for (int step = 0; step < 35; step++) {
+    Frame frame = encode_frame(encoder, state);
+    if (step >= 13) {
+      REQUIRE(apply_frame(late, frame));
+      CHECK(late.synchronized == (step >= 20));
+    }
+    state = reduce(state, PLAYED_ACTIONS[step % 7]);
+  }
+  REQUIRE(late.synchronized);
+}
+
+TEST_CASE("Moving the active block costs a few bytes", "[delta]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  GameState moved = reduce(state, Action::MOVE_LEFT);
+
+  CHECK(encode_delta(state, moved).size() <= 6);
+  CHECK(encode_delta(state, state).size() == 2);
+}
+
+TEST_CASE("Line clears are sent as removed rows", "[delta]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  state.active_block = {0, 0, Tetromino::I, Rotation::UNROTATED};
+  for (int x = 4; x < DEFAULT_WIDTH; x++) {
+    state.field.lines[0][x] = CellState::FILLED;
+  }
+  state.field.lines[1][0] = CellState::FILLED;
+  GameState cleared = reduce(state, Action::MOVE_DOWN);
+  REQUIRE(cleared.lines == 1);
+
+  DeltaDecoder decoder = new_delta_decoder();
+  REQUIRE(apply_frame(decoder, encode_keyframe(state)));
+  Frame delta = encode_delta(state, cleared);
+  REQUIRE(apply_frame(decoder, delta));
+
+  check_same_game(decoder.state, cleared);
+  CHECK(delta.size() < 16);
+}
+
+TEST_CASE("Decoded states are stamped where frames changed them", "[delta][versions]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  DeltaDecoder decoder = new_delta_decoder();
+  REQUIRE(apply_frame(decoder, encode_keyframe(state)));
+  StateVersions keyframe = decoder.state.versions;
+  CHECK(keyframe.rows.size() == DEFAULT_HEIGHT);
+
+  GameState moved = reduce(state, Action::MOVE_LEFT);
+  REQUIRE(apply_frame(decoder, encode_delta(state, moved)));
+  CHECK(decoder.state.versions.active_block != keyframe.active_block);
+  CHECK(decoder.state.versions.field == keyframe.field);
+  CHECK(decoder.state.versions.rows == keyframe.rows);
+  CHECK(decoder.state.versions.score == keyframe.score);
+
+  GameState dropped = moved;
+  while (dropped.rng.position() == moved.rng.position()) {
+    dropped = reduce(std::move(dropped), Action::MOVE_DOWN);
+  }
+  REQUIRE(apply_frame(decoder, encode_delta(moved, dropped)));
+  CHECK(decoder.state.versions.field != keyframe.field);
+  CHECK(decoder.state.versions.rows[0] == decoder.state.versions.field);
+  CHECK(decoder.state.versions.rows[DEFAULT_HEIGHT - 1] == keyframe.field);
+  CHECK(decoder.state.versions.next_block != keyframe.next_block);
+}
+
+TEST_CASE("Malformed frames are rejected", "[delta]") {
+  DeltaDecoder decoder = new_delta_decoder();
+  Frame keyframe = encode_keyframe(new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0));
+  keyframe.pop_back();
+
+  CHECK_FALSE(apply_frame(decoder, keyframe));
+  CHECK_FALSE(decoder.synchronized);
+  CHECK_FALSE(apply_frame(decoder, Frame{9}));
+
+  // Sides of 2^32, whose product wraps to zero.
+  Frame wrapping = {static_cast<std::uint8_t>(FrameKind::KEYFRAME),
+                    0x80, 0x80, 0x80, 0x80, 0x10, 0x80, 0x80, 0x80, 0x80, 0x10, 0};
+  CHECK_FALSE(apply_frame(decoder, wrapping));
+  // One column by 2^24 rows, with none of the rows in the frame.
+  Frame tall = {static_cast<std::uint8_t>(FrameKind::KEYFRAME), 1, 0x80, 0x80, 0x80, 0x08};
+  CHECK_FALSE(apply_frame(decoder, tall));
+  // 4096 by 4096 is within bounds, but the rows are missing.
+  Frame empty = {static_cast<std::uint8_t>(FrameKind::KEYFRAME), 0x80, 0x20, 0x80, 0x20};
+  CHECK_FALSE(apply_frame(decoder, empty));
+  CHECK_FALSE(decoder.synchronized);
+}
+
+static void append_varint(Frame &frame, std::uint64_t value) {
+  while (value >= 0x80) {
+    frame.push_back(static_cast<std::uint8_t>(value | 0x80));
+    value >>= 7;
+  }
+  frame.push_back(static_cast<std::uint8_t>(value));
+}
+
+TEST_CASE("Frames that draw too many numbers are rejected", "[delta]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  REQUIRE(state.rng.position() < 0x80); // the keyframe's last byte
+
+  Frame keyframe = encode_keyframe(state);
+  keyframe.pop_back();
+  append_varint(keyframe, MAX_RNG_POSITION + 1);
+  DeltaDecoder decoder = new_delta_decoder();
+  CHECK_FALSE(apply_frame(decoder, keyframe));
+  CHECK_FALSE(decoder.synchronized);
+
+  REQUIRE(apply_frame(decoder, encode_keyframe(state)));
+  Frame delta = {static_cast<std::uint8_t>(FrameKind::DELTA), 1 << 6}; // RNG_ADVANCED
+  append_varint(delta, std::uint64_t(1) << 62);
+  CHECK_FALSE(apply_frame(decoder, delta));
+  CHECK_FALSE(decoder.synchronized);
+}
+
+TEST_CASE("Long gaps between frames are sent as keyframes", "[delta]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  DeltaEncoder encoder = new_delta_encoder(1000);
+  DeltaDecoder decoder = new_delta_decoder();
+  REQUIRE(apply_frame(decoder, encode_frame(encoder, state)));
+
+  for (std::uint64_t i = 0; i <= MAX_DELTA_DRAWS; i++) {
+    state.rng();
+  }
+  Frame frame = encode_frame(encoder, state);
+  CHECK(frame[0] == static_cast<std::uint8_t>(FrameKind::KEYFRAME));
+  REQUIRE(apply_frame(decoder, frame));
+  CHECK(decoder.state.rng.position() == state.rng.position());
+}
@@ -0,0 +1,143 @@
+#include "catch.hpp"
+
+#include <random>
+
+#include "../src/evaluation.h"
+
+const EvaluationKernel KERNELS[] = {
+  EvaluationKernel::SCALAR,
+  EvaluationKernel::SSSE3,
+  EvaluationKernel::AVX2
+};
+
+// Rows filled more densely towards the bottom, with some left empty, so
+// every feature sees both stacks and overhangs.
+Field random_field(int width, int height, std::mt19937 &rng) {
+  Field field = {height, width, std::vector<Line>(height, Line(width, CellState::EMPTY))};
+  int top = std::uniform_int_distribution<int>(0, height)(rng);
+  for (int y = 0; y < top; y++) {
+    double density = 1.0 - static_cast<double>(y) / (top + 1);
+    std::bernoulli_distribution filled(density);
+    for (int x = 0; x < width; x++) {
+      if (filled(rng)) {
+        field.lines[y][x] = CellState::FILLED;
+      }
+    }
+  }
+  return field;
+}
+
+bool operator==(const BoardFeatures &lhs, const BoardFeatures &rhs) {
+  return lhs.holes == rhs.holes &&
+         lhs.aggregate_height == rhs.aggregate_height &&
+         lhs.bumpiness == rhs.bumpiness &&
+         lhs.row_transitions == rhs.row_transitions &&
+         lhs.column_transitions == rhs.column_transitions &&
+         lhs.wells == rhs.wells;
+}
+
+TEST_CASE("Reference features of a small field", "[evaluation]") {
+  // y = 3  . . . .
+  // y = 2  . x . .
+  // y = 1  x . . x
+  // y = 0  x x . x
+  Field field = {4, 4, std::vector<Line>(4, Line(4, CellState::EMPTY))};
+  field.lines[0][0] = field.lines[0][1] = field.lines[0][3] = CellState::FILLED;
+  field.lines[1][0] = field.lines[1][3] = CellState::FILLED;
+  field.lines[2][1] = CellState::FILLED;
+
+  BoardFeatures features = evaluate_field(field);
+  CHECK(features.holes == 1);                     // under the overhang
+  CHECK(features.aggregate_height == 2 + 3 + 0 + 2);
+  CHECK(features.bumpiness == 1 + 3 + 2);
+  CHECK(features.row_transitions == 2 + 4 + 2 + 2);
+  CHECK(features.column_transitions == 1 + 3 + 1 + 1);
+  CHECK(features.wells == 1 + 1);                 // (0, 2) by the wall, (2, 0)
+}
+
+TEST_CASE("Every kernel matches the reference", "[evaluation]") {
+  const int sizes[][2] = {{10, 20}, {4, 4}, {32, 64}, {7, 33}};
+  std::mt19937 rng(5);
+  for (const auto &size : sizes) {
+    int width = size[0];
+    int height = size[1];
+    FieldBatch batch = new_field_batch(width, height);
+    std::vector<BoardFeatures> expected;
+    for (int i = 0; i < 203; i++) { // not a whole number of blocks
+      Field field = random_field(width, height, rng);
+      add_field(batch, field);
+      expected.push_back(evaluate_field(field));
+    }
+
+    for (EvaluationKernel kernel : KERNELS) {
+      if (!is_kernel_supported(kernel)) {
+        WARN("Skipping unsupported kernel " << get_kernel_name(kernel));
+        continue;
+      }
+      std::vector<BoardFeatures> features;
+      evaluate_fields(batch, features, kernel);
+      REQUIRE(features.size() == expected.size());
+      int mismatches = 0;
+      for (std::size_t i = 0; i < expected.size(); i++) {
+        mismatches += features[i] == expected[i] ? 0 : 1;
+      }
+      INFO(get_kernel_name(kernel) << " on " << width << "x" << height);
+      CHECK(mismatches == 0);
+    }
+  }
+}
+
+TEST_CASE("Unsupported kernels fall back to the scalar kernel", "[evaluation]") {
+  std::mt19937 rng(7);
+  FieldBatch batch = new_field_batch(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::vector<BoardFeatures> expected;
+  for (int i = 0; i < 40; i++) {
+    Field field = random_field(DEFAULT_WIDTH, DEFAULT_HEIGHT, rng);
+    add_field(batch, field);
+    expected.push_back(evaluate_field(field));
+  }
+
+  // Every kernel is asked for, whether or not this processor has it.
+  for (EvaluationKernel kernel : KERNELS) {
+    std::vector<BoardFeatures> features(expected.size(), {-1, -1, -1, -1, -1, -1});
+    evaluate_fields(batch, features, kernel);
+    REQUIRE(features.size() == expected.size());
+    int mismatches = 0;
+    for (std::size_t i = 0; i < expected.size(); i++) {
+      mismatches += features[i] == expected[i] ? 0 : 1;
+    }
+    INFO(get_kernel_name(kernel) << (is_kernel_supported(kernel) ? "" : " (unsupported)"));
+    CHECK(mismatches == 0);
+  }
+}
+
+TEST_CASE("Packed fields score by weighted features", "[evaluation]") {
+  std::mt19937 rng(9);
+  FieldBatch batch = new_field_batch(DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  std::vector<Field> fields;
+  for (int i = 0; i < 20; i++) {
+    fields.push_back(random_field(DEFAULT_WIDTH, DEFAULT_HEIGHT, rng));
+    std::uint32_t rows[DEFAULT_HEIGHT];
+    for (int y = 0; y < DEFAULT_HEIGHT; y++) {
+      rows[y] = 0;
+      for (int x = 0; x < DEFAULT_WIDTH; x++) {
+        if (fields.back().lines[y][x] == CellState::FILLED) {
+          rows[y] |= 1u << x;
+        }
+      }
+    }
+    add_packed_field(batch, rows);
+  }
+
+  FeatureWeights weights = {-7.9, -0.5, -0.2, -3.2, -9.3, -3.4};
+  std::vector<double> scores;
+  score_fields(batch, weights, scores);
+  REQUIRE(scores.size() == fields.size());
+  for (std::size_t i = 0; i < fields.size(); i++) {
+    CHECK(scores[i] == Approx(score_features(evaluate_field(fields[i]), weights)));
+  }
+
+  clear_field_batch(batch);
+  score_fields(batch, weights, scores);
+  CHECK(scores.empty());
+}
@@ -0,0 +1,172 @@
+#include "catch.hpp"
+
+#include <string>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "../src/bot.h"
+#include "../src/evaluation_cache.h"
+
+std::string temporary_cache_path() {
+  return "/tmp/tetris-evaluation-cache-" + std::to_string(getpid());
+}
+
+CacheKey numbered_key(int number) {
+  Field field = {DEFAULT_HEIGHT, DEFAULT_WIDTH,
+                 std::vector<Line>(DEFAULT_HEIGHT, Line(DEFAULT_WIDTH, CellState::EMPTY))};
+  for (int bit = 0; bit < 30; bit++) {
+    if (number & (1 << bit)) {
+      field.lines[bit / DEFAULT_WIDTH][bit % DEFAULT_WIDTH] = CellState::FILLED;
+    }
+  }
+  return make_cache_key(field, {5, 19, Tetromino::T, Rotation::UNROTATED}, 0);
+}
+
+CachedEvaluation numbered_evaluation(int number) {
+  return {number * 0.5, {number % 8, number % 20, Tetromino::L, Rotation::CLOCKWISE}};
+}
+
+TEST_CASE("Cached evaluations persist across openings", "[evaluation_cache]") {
+  std::string path = temporary_cache_path();
+  unlink(path.c_str());
+  EvaluationCache cache;
+  REQUIRE(open_evaluation_cache(path, 1000, cache));
+  CHECK(cache_slot_count(cache) == 1024);
+
+  CachedEvaluation found;
+  CHECK_FALSE(cache_lookup(cache, numbered_key(1), found));
+  for (int number = 0; number < 500; number++) {
+    REQUIRE(cache_insert(cache, numbered_key(number), numbered_evaluation(number)));
+  }
+  CHECK_FALSE(cache_insert(cache, numbered_key(7), numbered_evaluation(8)));
+  CHECK(cache_entry_count(cache) == 500);
+  close_evaluation_cache(cache);
+
+  REQUIRE(open_evaluation_cache(path, 16, cache)); // keeps its original size
+  CHECK(cache_slot_count(cache) == 1024);
+  for (int number = 0; number < 500; number++) {
+    REQUIRE(cache_lookup(cache, numbered_key(number), found));
+    CHECK(found.score == number * 0.5);
+    CHECK(found.best_block == numbered_evaluation(number).best_block);
+  }
+  CHECK_FALSE(cache_lookup(cache, numbered_key(500), found));
+  close_evaluation_cache(cache);
+  unlink(path.c_str());
+}
+
+TEST_CASE("Processes insert into one cache concurrently", "[evaluation_cache]") {
+  std::string path = temporary_cache_path();
+  unlink(path.c_str());
+  const int processes = 4;
+  const int keys = 2000;
+
+  std::vector<pid_t> children;
+  for (int process = 0; process < processes; process++) {
+    pid_t child = fork();
+    REQUIRE(child >= 0);
+    if (child == 0) {
+      EvaluationCache cache;
+      if (!open_evaluation_cache(path, 1 << 14, cache)) {
+        _exit(1);
+      }
+      // Each process inserts its own keys and races the others for a
+      // shared set.
+      for (int i = 0; i < keys; i++) {
+        int number = i % 2 == 0 ? i : process * keys + i;
+        cache_insert(cache, numbered_key(number), numbered_evaluation(number));
+      }
+      close_evaluation_cache(cache);
+      _exit(0);
+    }
+    children.push_back(child);
+  }
+  for (pid_t child : children) {
+    int status;
+    REQUIRE(waitpid(child, &status, 0) == child);
+    CHECK(WIFEXITED(status));
+    CHECK(WEXITSTATUS(status) == 0);
+  }
+
+  EvaluationCache cache;
+  REQUIRE(open_evaluation_cache(path, 1 << 14, cache));
+  int missing = 0;
+  for (int process = 0; process < processes; process++) {
+    for (int i = 0; i < keys; i++) {
+      int number = i % 2 == 0 ? i : process * keys + i;
+      CachedEvaluation found;
+      if (!cache_lookup(cache, numbered_key(number), found) ||
+          found.score != number * 0.5) {
+        missing++;
+      }
+    }
+  }
+  CHECK(missing == 0);
+  CHECK(cache_entry_count(cache) >= processes * keys / 2 + keys / 2);
+  close_evaluation_cache(cache);
+  unlink(path.c_str());
+}
+
+TEST_CASE("A warm cache replays the bot's decisions", "[evaluation_cache]") {
+  std::string path = temporary_cache_path();
+  unlink(path.c_str());
+  EvaluationCache cache;
+  REQUIRE(open_evaluation_cache(path, 1 << 12, cache));
+
+  Bot uncached = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  BotGame expected = play_bot_game(uncached, 4, 100);
+
+  Bot cold = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  use_cache(cold, &cache);
+  BotGame first = play_bot_game(cold, 4, 100);
+  std::uint64_t entries = cache_entry_count(cache);
+  CHECK(entries == 100);
+
+  Bot warm = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  use_cache(warm, &cache);
+  BotGame second = play_bot_game(warm, 4, 100);
+  CHECK(cache_entry_count(cache) == entries); // every move was a hit
+
+  for (const BotGame &game : {first, second}) {
+    CHECK(game.pieces == expected.pieces);
+    CHECK(game.lines == expected.lines);
+    CHECK(game.score == expected.score);
+  }
+
+  Bot other = new_bot({-1, -1, -1, -1, -1, -1}, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  use_cache(other, &cache);
+  play_bot_game(other, 4, 10);
+  CHECK(cache_entry_count(cache) == entries + 10); // other weights, other keys
+
+  close_evaluation_cache(cache);
+  unlink(path.c_str());
+}
+
+TEST_CASE("Cached blocks that would not lock in place are ignored", "[evaluation_cache]") {
+  std::string path = temporary_cache_path();
+  GameState start = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 4);
+  GameState expected = start;
+  Bot uncached = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  REQUIRE(play_bot_move(uncached, expected));
+
+  ActiveBlock spawned = start.active_block;
+  ActiveBlock other = spawned;
+  other.tetromino = spawned.tetromino == Tetromino::I ? Tetromino::O : Tetromino::I;
+  ActiveBlock outside = {-3, -3, spawned.tetromino, spawned.rotation};
+  ActiveBlock no_rotation = spawned;
+  no_rotation.rotation = static_cast<Rotation>(7);
+  for (const ActiveBlock &block : {spawned, other, outside, no_rotation}) {
+    unlink(path.c_str());
+    EvaluationCache cache;
+    REQUIRE(open_evaluation_cache(path, 1 << 8, cache));
+    Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+    use_cache(bot, &cache);
+    CacheKey key = make_cache_key(start.field, start.active_block, bot.cache_context);
+    REQUIRE(cache_insert(cache, key, {1e9, block}));
+
+    GameState state = start;
+    REQUIRE(play_bot_move(bot, state));
+    CHECK(state == expected);
+    close_evaluation_cache(cache);
+  }
+  unlink(path.c_str());
+}
@@ -0,0 +1,99 @@
+#include "catch.hpp"
+
+#include <utility>
+
+#include "../src/finesse.h"
+#include "../src/placements.h"
+
+static GameState spawned(Tetromino tetromino) {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  state.active_block = {DEFAULT_WIDTH / 2, DEFAULT_HEIGHT - 1, tetromino, Rotation::UNROTATED};
+  return state;
+}
+
+static GameState play(GameState state, const std::vector<Action> &actions) {
+  for (Action action : actions) {
+    state = reduce(std::move(state), action);
+  }
+  return state;
+}
+
+TEST_CASE("Rotations take the shortest way to the same cells", "[finesse]") {
+  const FinesseRotation &half_turn = finesse_rotation(Tetromino::T, Rotation::UNROTATED,
+                                                      Rotation::UPSIDE_DOWN);
+  CHECK(half_turn.rotation == Rotation::UPSIDE_DOWN);
+  CHECK(half_turn.rotations == 2);
+
+  const FinesseRotation &back = finesse_rotation(Tetromino::L, Rotation::UNROTATED,
+                                                 Rotation::COUNTERCLOCKWISE);
+  CHECK(back.rotate == Action::ROTATE_COUNTERCLOCKWISE);
+  CHECK(back.rotations == 1);
+
+  // The I block's upside-down shape is its spawn shape, and the O block
+  // has only one.
+  CHECK(finesse_rotation(Tetromino::I, Rotation::UNROTATED, Rotation::UPSIDE_DOWN).rotations == 0);
+  CHECK(finesse_rotation(Tetromino::I, Rotation::UNROTATED, Rotation::COUNTERCLOCKWISE).rotations == 1);
+  CHECK(finesse_rotation(Tetromino::O, Rotation::UNROTATED, Rotation::CLOCKWISE).rotation ==
+        Rotation::UNROTATED);
+
+  ActiveBlock spawn = {5, 19, Tetromino::T, Rotation::UNROTATED};
+  CHECK(finesse_input_count(spawn, {0, 3, Tetromino::T, Rotation::UPSIDE_DOWN}) == 7);
+  CHECK(finesse_actions(spawn, {6, 17, Tetromino::T, Rotation::CLOCKWISE}) ==
+        std::vector<Action>({Action::ROTATE_CLOCKWISE, Action::MOVE_RIGHT,
+                             Action::MOVE_DOWN, Action::MOVE_DOWN, Action::MOVE_DOWN}));
+}
+
+TEST_CASE("Placement inputs are as short as the placement search", "[finesse]") {
+  for (int tetromino = 0; tetromino < TETROMINO_COUNT; tetromino++) {
+    GameState start = spawned(static_cast<Tetromino>(tetromino));
+    for (const Placement &placement : find_placements(start)) {
+      std::vector<Action> actions;
+      REQUIRE(find_placement_inputs(start, placement.final_block, actions));
+      CHECK(actions.size() == placement.actions.size());
+      CHECK(play(start, actions) == placement.result);
+    }
+  }
+}
+
+TEST_CASE("Placement inputs tuck under overhangs", "[finesse]") {
+  // A roof over the left of the field, with room for an I block under it
+  // only by sliding in from the right.
+  GameState start = spawned(Tetromino::I);
+  for (int x = 0; x < 6; x++) {
+    start.field.lines[1][x] = CellState::FILLED;
+  }
+  ActiveBlock target = {0, 0, Tetromino::I, Rotation::UNROTATED};
+
+  std::vector<Action> actions;
+  REQUIRE(find_placement_inputs(start, target, actions));
+  CHECK_FALSE(actions == finesse_actions(start.active_block, target));
+  GameState result = play(start, actions);
+  for (int x = 0; x < MAX_TETROMINO_WIDTH; x++) {
+    CHECK(result.field.lines[0][x] == CellState::FILLED);
+  }
+  CHECK(result.lines == 0);
+
+  bool found = false;
+  for (const Placement &placement : find_placements(start)) {
+    if (same_cells(placement.final_block, target)) {
+      CHECK(actions.size() == placement.actions.size());
+      found = true;
+    }
+  }
+  CHECK(found);
+}
+
+TEST_CASE("Placement inputs reject unreachable targets", "[finesse]") {
+  GameState start = spawned(Tetromino::O);
+  std::vector<Action> actions;
+  // In mid-air.
+  CHECK_FALSE(find_placement_inputs(start, {3, 10, Tetromino::O, Rotation::UNROTATED}, actions));
+  // A different block.
+  CHECK_FALSE(find_placement_inputs(start, {3, 1, Tetromino::T, Rotation::UNROTATED}, actions));
+
+  // Sealed in.
+  for (int x = 0; x < DEFAULT_WIDTH; x++) {
+    start.field.lines[2][x] = CellState::FILLED;
+  }
+  CHECK_FALSE(find_placement_inputs(start, {3, 1, Tetromino::O, Rotation::UNROTATED}, actions));
+}
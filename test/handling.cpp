@@ -0,0 +1,201 @@
+#include "catch.hpp"
+
+#include <random>
+#include <vector>
+
+#include "../src/handling.h"
+#include "../src/replay.h"
+
+static const HandlingSettings SETTINGS = {100000, 20000, 30000, 400000};
+
+static HandlingController start(const HandlingSettings &settings) {
+  return new_handling_controller(settings, new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 4), 0);
+}
+
+static void press(HandlingController &controller,
+                  InputKey key,
+                  std::uint64_t microseconds,
+                  bool pressed,
+                  std::vector<TimedAction> &actions) {
+  apply_input_event(controller, {microseconds, key, pressed, 0}, actions);
+}
+
+TEST_CASE("A tap shifts once", "[handling]") {
+  HandlingController controller = start(SETTINGS);
+  std::vector<TimedAction> actions;
+  press(controller, InputKey::LEFT, 1000, true, actions);
+  press(controller, InputKey::LEFT, 90000, false, actions);
+  advance_handling(controller, 500000, actions);
+
+  REQUIRE(actions.size() == 1);
+  CHECK(actions[0].microseconds == 1000);
+  CHECK(actions[0].action == Action::MOVE_LEFT);
+  press(controller, InputKey::LEFT, 600000, false, actions);
+  CHECK(actions.size() == 1);
+}
+
+TEST_CASE("A held shift repeats after the DAS at the ARR", "[handling]") {
+  HandlingController controller = start(SETTINGS);
+  std::vector<TimedAction> actions;
+  press(controller, InputKey::LEFT, 1000, true, actions);
+  press(controller, InputKey::LEFT, 1000 + 100000 + 2 * 20000, false, actions);
+
+  const std::uint64_t expected[] = {1000, 101000, 121000, 141000};
+  REQUIRE(actions.size() == 4);
+  for (int i = 0; i < 4; i++) {
+    CHECK(actions[i].microseconds == expected[i]);
+    CHECK(actions[i].action == Action::MOVE_LEFT);
+  }
+  CHECK(controller.game.active_block.position_x == DEFAULT_WIDTH / 2 - 4);
+}
+
+TEST_CASE("A zero ARR shifts to the wall once charged", "[handling]") {
+  HandlingSettings settings = SETTINGS;
+  settings.arr = 0;
+  HandlingController controller = start(settings);
+  std::vector<TimedAction> actions;
+  press(controller, InputKey::RIGHT, 0, true, actions);
+  advance_handling(controller, settings.das, actions);
+
+  REQUIRE(actions.size() > 1);
+  for (std::size_t i = 1; i < actions.size(); i++) {
+    CHECK(actions[i].microseconds == settings.das);
+    CHECK(actions[i].action == Action::MOVE_RIGHT);
+  }
+  ActiveBlock moved = controller.game.active_block;
+  moved.position_x++;
+  CHECK_FALSE(is_legal_position(controller.game.field, moved));
+  CHECK(next_handling_deadline(controller) == controller.next_fall);
+}
+
+TEST_CASE("Releasing a direction hands over to the other after a fresh DAS", "[handling]") {
+  HandlingController controller = start(SETTINGS);
+  std::vector<TimedAction> actions;
+  press(controller, InputKey::LEFT, 0, true, actions);
+  press(controller, InputKey::RIGHT, 10000, true, actions);
+  press(controller, InputKey::RIGHT, 50000, false, actions);
+  advance_handling(controller, 50000 + SETTINGS.das, actions);
+
+  REQUIRE(actions.size() == 3);
+  CHECK(actions[0].action == Action::MOVE_LEFT);
+  CHECK(actions[1].action == Action::MOVE_RIGHT);
+  CHECK(actions[2].action == Action::MOVE_LEFT);
+  CHECK(actions[2].microseconds == 50000 + SETTINGS.das);
+}
+
+// Holds soft drop until the first block locks, returning when it landed.
+static std::uint64_t drop_first_block(HandlingController &controller,
+                                      std::vector<TimedAction> &actions) {
+  press(controller, InputKey::SOFT_DROP, 0, true, actions);
+  unsigned long long position = controller.game.rng.position();
+  std::uint64_t landed = 0;
+  while (controller.game.rng.position() == position) {
+    std::uint64_t due = next_handling_deadline(controller);
+    REQUIRE(due != NO_DEADLINE);
+    if (!controller.landed) {
+      landed = due;
+    }
+    advance_handling(controller, due, actions);
+  }
+  return landed;
+}
+
+TEST_CASE("Landed blocks lock after the lock delay", "[handling]") {
+  HandlingController controller = start(SETTINGS);
+  std::vector<TimedAction> actions;
+  std::uint64_t landed = drop_first_block(controller, actions);
+
+  CHECK(actions.back().action == Action::TIME_FALL);
+  CHECK(actions.back().microseconds == landed + SETTINGS.lock_delay);
+  for (std::size_t i = 0; i + 1 < actions.size(); i++) {
+    CHECK(actions[i].action == Action::MOVE_DOWN);
+    CHECK(actions[i].microseconds == i * SETTINGS.soft_drop);
+  }
+}
+
+TEST_CASE("Moving a landed block restarts its lock delay", "[handling]") {
+  HandlingController controller = start(SETTINGS);
+  std::vector<TimedAction> actions;
+  press(controller, InputKey::SOFT_DROP, 0, true, actions);
+  while (!controller.landed) {
+    advance_handling(controller, next_handling_deadline(controller), actions);
+  }
+  std::uint64_t lock_at = controller.lock_at;
+  std::uint64_t now = controller.now + 1000;
+  press(controller, InputKey::LEFT, now, true, actions);
+  CHECK(controller.lock_at == now + SETTINGS.lock_delay);
+  CHECK(controller.lock_at > lock_at);
+}
+
+TEST_CASE("Without a lock delay gravity locks", "[handling]") {
+  HandlingSettings settings = SETTINGS;
+  settings.lock_delay = 0;
+  HandlingController controller = start(settings);
+  std::vector<TimedAction> actions;
+  drop_first_block(controller, actions);
+
+  // Soft drop restarts gravity, which locks the block a turn later.
+  std::uint64_t period = controller.game.milliseconds_per_turn * 1000ull;
+  REQUIRE(actions.size() > 1);
+  CHECK(actions.back().action == Action::TIME_FALL);
+  CHECK(actions.back().microseconds == actions[actions.size() - 2].microseconds + period);
+}
+
+static std::vector<InputEvent> random_inputs(int count) {
+  std::mt19937 random(9);
+  std::vector<InputEvent> events;
+  std::uint64_t now = 0;
+  for (int i = 0; i < count; i++) {
+    now += random() % 150000;
+    InputKey key = static_cast<InputKey>(random() % (INPUT_KEY_COUNT - 1));
+    events.push_back({now, key, random() % 2 == 0, 0});
+  }
+  events.push_back({now + 1000, InputKey::NEW_GAME, true, 77});
+  events.push_back({now + 2000, InputKey::LEFT, true, 0});
+  return events;
+}
+
+TEST_CASE("Handling depends only on the input events", "[handling]") {
+  std::vector<InputEvent> events = random_inputs(400);
+  std::uint64_t end = events.back().microseconds + 2000000;
+
+  HandlingController by_event = start(DEFAULT_HANDLING);
+  std::vector<TimedAction> event_actions;
+  for (const InputEvent &event : events) {
+    apply_input_event(by_event, event, event_actions);
+  }
+  advance_handling(by_event, end, event_actions);
+
+  // Looking every 997 microseconds, as a busy loop might.
+  HandlingController by_tick = start(DEFAULT_HANDLING);
+  std::vector<TimedAction> tick_actions;
+  std::size_t next = 0;
+  for (std::uint64_t now = 0; now <= end; now += 997) {
+    while (next < events.size() && events[next].microseconds <= now) {
+      apply_input_event(by_tick, events[next++], tick_actions);
+    }
+    advance_handling(by_tick, now, tick_actions);
+  }
+  advance_handling(by_tick, end, tick_actions);
+
+  REQUIRE(tick_actions.size() == event_actions.size());
+  for (std::size_t i = 0; i < event_actions.size(); i++) {
+    CHECK(tick_actions[i].microseconds == event_actions[i].microseconds);
+    CHECK(tick_actions[i].action == event_actions[i].action);
+  }
+  CHECK(by_tick.game == by_event.game);
+  CHECK(event_actions.size() > events.size() / 2);
+
+  // The actions alone replay to the same game.
+  GameState replayed = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 4);
+  for (const TimedAction &action : event_actions) {
+    ReplayEvent event = {
+      static_cast<std::uint32_t>(action.microseconds / 1000),
+      action.action,
+      action.seed
+    };
+    replayed = apply_replay_event(std::move(replayed), event, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  }
+  CHECK(replayed == by_event.game);
+  CHECK(replayed.rng.seed() == 77);
+}
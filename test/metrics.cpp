@@ -0,0 +1,106 @@
+#include "catch.hpp"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "../src/metrics.h"
+
+TEST_CASE("Shards from every thread add up", "[metrics]") {
+  MetricsSnapshot before = collect_metrics();
+  const int threads = 4;
+  const int steps = 1000;
+  std::vector<std::thread> workers;
+  for (int thread = 0; thread < threads; thread++) {
+    workers.emplace_back([]() {
+      for (int step = 0; step < steps; step++) {
+        record_step(Action::MOVE_LEFT, 1, false, 300, 2);
+      }
+      record_game_started();
+    });
+  }
+  for (std::thread &worker : workers) {
+    worker.join();
+  }
+
+  MetricsSnapshot after = collect_metrics();
+  CHECK(after.games_started - before.games_started == threads);
+  CHECK(after.lines_cleared - before.lines_cleared == threads * steps);
+  CHECK(after.actions[static_cast<int>(Action::MOVE_LEFT)] -
+        before.actions[static_cast<int>(Action::MOVE_LEFT)] == threads * steps);
+  CHECK(after.reduce_count - before.reduce_count == threads * steps);
+  CHECK(after.reduce_allocations - before.reduce_allocations == 2 * threads * steps);
+  CHECK(after.reduce_buckets[2] - before.reduce_buckets[2] == threads * steps);
+}
+
+TEST_CASE("measured_reduce counts games, actions and lines", "[metrics]") {
+  MetricsSnapshot before = collect_metrics();
+  GameState state = measured_reduce(new_game(10, 20, 3), Action::NEW_GAME);
+  int steps = 1;
+  while (state.progress == GameProgress::IN_PROGRESS) {
+    state = measured_reduce(std::move(state), Action::MOVE_DOWN);
+    steps++;
+  }
+  std::uint64_t lines = state.lines;
+
+  MetricsSnapshot after = collect_metrics();
+  CHECK(after.games_started - before.games_started == 1);
+  CHECK(after.games_finished - before.games_finished == 1);
+  CHECK(after.lines_cleared - before.lines_cleared == lines);
+  CHECK(after.actions[static_cast<int>(Action::MOVE_DOWN)] -
+        before.actions[static_cast<int>(Action::MOVE_DOWN)] == static_cast<std::uint64_t>(steps - 1));
+  CHECK(after.reduce_count - before.reduce_count == static_cast<std::uint64_t>(steps));
+}
+
+TEST_CASE("Quantiles interpolate within a bucket", "[metrics]") {
+  MetricsSnapshot metrics = {};
+  metrics.reduce_buckets[3] = 50;  // 500ns to 1us
+  metrics.reduce_buckets[4] = 50;  // 1us to 2.5us
+  metrics.reduce_count = 100;
+  CHECK(reduce_latency_quantile(metrics, 0.5) == Approx(1000e-9));
+  CHECK(reduce_latency_quantile(metrics, 0.25) == Approx(750e-9));
+  CHECK(reduce_latency_quantile(metrics, 0.99) == Approx(2470e-9));
+
+  metrics.reduce_buckets[LATENCY_BUCKET_COUNT] = 100;
+  metrics.reduce_count = 200;
+  CHECK(reduce_latency_quantile(metrics, 0.99) == Approx(5000000e-9));
+  CHECK(reduce_latency_quantile(MetricsSnapshot(), 0.5) == 0);
+}
+
+TEST_CASE("Metrics format as Prometheus text", "[metrics]") {
+  MetricsSnapshot metrics = {};
+  metrics.games_started = 4;
+  metrics.games_finished = 1;
+  metrics.actions[static_cast<int>(Action::MOVE_DOWN)] = 7;
+  metrics.reduce_buckets[0] = 3;
+  metrics.reduce_buckets[LATENCY_BUCKET_COUNT] = 1;
+  metrics.reduce_count = 4;
+  metrics.reduce_allocations = 2;
+
+  std::string text = format_prometheus(metrics);
+  CHECK(text.find("# TYPE tetris_games_started_total counter\n") != std::string::npos);
+  CHECK(text.find("\ntetris_games_started_total 4\n") != std::string::npos);
+  CHECK(text.find("\ntetris_game_over_ratio 0.25\n") != std::string::npos);
+  CHECK(text.find("\ntetris_actions_total{action=\"MOVE_DOWN\"} 7\n") != std::string::npos);
+  CHECK(text.find("\ntetris_reduce_duration_seconds_bucket{le=\"1e-07\"} 3\n") != std::string::npos);
+  CHECK(text.find("\ntetris_reduce_duration_seconds_bucket{le=\"0.005\"} 3\n") != std::string::npos);
+  CHECK(text.find("\ntetris_reduce_duration_seconds_bucket{le=\"+Inf\"} 4\n") != std::string::npos);
+  CHECK(text.find("\ntetris_reduce_duration_seconds_count 4\n") != std::string::npos);
+  CHECK(text.find("\ntetris_reduce_allocations_per_step 0.5\n") != std::string::npos);
+}
+
+TEST_CASE("The metrics file holds the current metrics", "[metrics]") {
+  std::string path = "/tmp/tetris-metrics-" + std::to_string(getpid());
+  record_game_started();
+  REQUIRE(write_metrics_file(path));
+  std::ifstream file(path);
+  std::stringstream contents;
+  contents << file.rdbuf();
+  CHECK(contents.str().find("tetris_games_started_total ") != std::string::npos);
+  CHECK(contents.str().find("tetris_reduce_duration_seconds_count ") != std::string::npos);
+  std::remove(path.c_str());
+}
@@ -0,0 +1,106 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "../src/packed_state.h"
+
+static GameState played_game(RNG::result_type seed, int actions) {
+  const Action moves[] = {
+    Action::MOVE_LEFT,
+    Action::MOVE_DOWN,
+    Action::ROTATE_CLOCKWISE,
+    Action::MOVE_DOWN,
+    Action::MOVE_RIGHT,
+    Action::MOVE_DOWN,
+    Action::TIME_FALL
+  };
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, seed);
+  for (int i = 0; i < actions; i++) {
+    state = reduce(std::move(state), moves[(i * 5 + i / 7) % 7]);
+  }
+  return state;
+}
+
+static bool identical(const GameState &lhs, const GameState &rhs) {
+  return lhs == rhs &&
+         lhs.progress == rhs.progress &&
+         lhs.rng.seed() == rhs.rng.seed() &&
+         lhs.rng.position() == rhs.rng.position();
+}
+
+TEST_CASE("Packed states unpack to the same state", "[packed_state]") {
+  GameState root = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 8);
+  PackedFormat format = packed_format(root);
+  GameState unpacked;
+  for (int actions = 0; actions < 2000; actions += 97) {
+    GameState state = played_game(8, actions);
+    PackedState packed;
+    REQUIRE(pack_state(format, state, packed));
+    // Reused for every round, so the generator is sometimes advanced and
+    // sometimes rebuilt.
+    unpack_state(format, packed, unpacked);
+    CHECK(identical(unpacked, state));
+
+    // The next draw continues the game's sequence.
+    GameState fresh;
+    unpack_state(format, packed, fresh);
+    CHECK(fresh.rng() == state.rng());
+  }
+  CHECK(played_game(8, 2000).progress == GameProgress::GAME_OVER);
+}
+
+TEST_CASE("Packed states are canonical", "[packed_state]") {
+  GameState state = played_game(2, 300);
+  PackedFormat format = packed_format(state);
+  PackedState first;
+  PackedState second;
+  REQUIRE(pack_state(format, state, first));
+  REQUIRE(pack_state(format, GameState(state), second));
+  CHECK(first == second);
+  CHECK(hash_packed_state(first) == hash_packed_state(second));
+  CHECK(sizeof(PackedState) == PACKED_STATE_SIZE);
+
+  // The bytes list the cells from the bottom left, most significant bit
+  // first.
+  GameState empty = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  empty.field.lines[0][0] = CellState::FILLED;
+  empty.field.lines[1][1] = CellState::FILLED;
+  PackedState packed;
+  REQUIRE(pack_state(format, empty, packed));
+  CHECK(packed.bytes[0] == 0x80);
+  CHECK(packed.bytes[1] == 0x10);
+
+  GameState moved = state;
+  moved.active_block.position_x++;
+  PackedState other;
+  REQUIRE(pack_state(format, moved, other));
+  CHECK_FALSE(first == other);
+  CHECK((first < other) != (other < first));
+}
+
+TEST_CASE("Packing rejects states that do not fit", "[packed_state]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 1);
+  PackedFormat format = packed_format(state);
+  PackedState packed;
+  CHECK(pack_state(format, state, packed));
+  CHECK_FALSE(pack_state(format, new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2), packed));
+  CHECK_FALSE(pack_state(format, new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT + 1, 1), packed));
+
+  GameState tall = new_game(DEFAULT_WIDTH, 30, 1);
+  CHECK_FALSE(pack_state(packed_format(tall), tall, packed));
+}
+
+TEST_CASE("Packed frontiers sort and drop duplicates", "[packed_state]") {
+  GameState root = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 5);
+  PackedFrontier frontier = {packed_format(root), {}};
+  for (int i = 0; i < 50; i++) {
+    REQUIRE(push_state(frontier, played_game(5, i % 10 * 13)));
+  }
+  CHECK_FALSE(push_state(frontier, new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 6)));
+  CHECK(frontier.states.size() == 50);
+
+  sort_unique(frontier);
+  CHECK(frontier.states.size() == 10);
+  CHECK(std::is_sorted(frontier.states.begin(), frontier.states.end()));
+}
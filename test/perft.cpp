@@ -0,0 +1,107 @@
+#include "catch.hpp"
+
+#include "../src/perft.h"
+
+// Seed 0 starts with an O block, then S, T, T, S, Z.
+GameState perft_root() {
+  return new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+}
+
+unsigned long long naive_perft(const GameState &state, int depth) {
+  if (depth == 0) {
+    return 1;
+  }
+  const Action actions[] = {
+    Action::MOVE_LEFT,
+    Action::MOVE_RIGHT,
+    Action::MOVE_DOWN,
+    Action::ROTATE_CLOCKWISE,
+    Action::ROTATE_COUNTERCLOCKWISE
+  };
+  unsigned long long total = 0;
+  for (Action action : actions) {
+    GameState next = reduce(state, action);
+    if (!(next.field == state.field && next.active_block == state.active_block)) {
+      total += naive_perft(next, depth - 1);
+    }
+  }
+  return total;
+}
+
+TEST_CASE("Action perft matches known counts", "[perft]") {
+  PerftResult result = perft(perft_root(), {PerftMode::ACTIONS, 5, false, 1});
+
+  REQUIRE(result.counts.size() == 5);
+  CHECK(result.counts[0] == 5);
+  CHECK(result.counts[1] == 25);
+  CHECK(result.counts[2] == 125);
+  CHECK(result.counts[3] == 624);
+  CHECK(result.counts[4] == 3108);
+  CHECK(result.counts[4] == naive_perft(perft_root(), 5));
+}
+
+TEST_CASE("Distinct action perft matches known counts", "[perft]") {
+  PerftResult result = perft(perft_root(), {PerftMode::ACTIONS, 5, true, 1});
+
+  CHECK(result.counts[0] == 5);
+  CHECK(result.counts[1] == 13);
+  CHECK(result.counts[2] == 25);
+  CHECK(result.counts[3] == 40);
+  CHECK(result.counts[4] == 57);
+}
+
+TEST_CASE("Piece perft matches known counts", "[perft]") {
+  PerftResult result = perft(perft_root(), {PerftMode::PIECES, 3, false, 1});
+
+  CHECK(result.counts[0] == 9);   // O block, nine columns
+  CHECK(result.counts[1] == 153); // then seventeen S placements each
+  CHECK(result.counts[2] == 5381);
+}
+
+TEST_CASE("Perft counts do not depend on thread count", "[perft]") {
+  for (bool distinct : {false, true}) {
+    PerftResult single = perft(perft_root(), {PerftMode::ACTIONS, 6, distinct, 1});
+    PerftResult threaded = perft(perft_root(), {PerftMode::ACTIONS, 6, distinct, 4});
+
+    CHECK(single.counts == threaded.counts);
+    CHECK(single.nodes == threaded.nodes);
+  }
+}
+
+// Breadth-first, comparing every pair of states in full.
+static std::vector<unsigned long long> naive_distinct(const GameState &root, int depth) {
+  std::vector<unsigned long long> counts;
+  std::vector<GameState> frontier(1, root);
+  for (int d = 0; d < depth; d++) {
+    std::vector<GameState> next;
+    for (const GameState &state : frontier) {
+      for (Action action : {Action::MOVE_LEFT, Action::MOVE_RIGHT, Action::MOVE_DOWN,
+                            Action::ROTATE_CLOCKWISE, Action::ROTATE_COUNTERCLOCKWISE}) {
+        GameState child = reduce(state, action);
+        if (child.field == state.field && child.active_block == state.active_block) {
+          continue;
+        }
+        bool seen = false;
+        for (const GameState &other : next) {
+          seen = seen || (other == child && other.rng.position() == child.rng.position() &&
+                          other.progress == child.progress);
+        }
+        if (!seen) {
+          next.push_back(child);
+        }
+      }
+    }
+    counts.push_back(next.size());
+    frontier = std::move(next);
+  }
+  return counts;
+}
+
+TEST_CASE("Distinct perft compares whole states", "[perft]") {
+  CHECK(perft(perft_root(), {PerftMode::ACTIONS, 5, true, 1}).counts ==
+        naive_distinct(perft_root(), 5));
+
+  // Too many cells to pack, so states are kept whole.
+  GameState wide = new_game(16, 20, 0);
+  CHECK(perft(wide, {PerftMode::ACTIONS, 5, true, 2}).counts == naive_distinct(wide, 5));
+}
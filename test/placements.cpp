@@ -0,0 +1,41 @@
+#include "catch.hpp"
+
+#include <utility>
+
+#include "../src/placements.h"
+
+GameState empty_game_with(Tetromino tetromino) {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  state.active_block = {
+    DEFAULT_WIDTH / 2,
+    DEFAULT_HEIGHT - 1,
+    tetromino,
+    Rotation::UNROTATED
+  };
+  return state;
+}
+
+TEST_CASE("Identical orientations are reported once", "[placements]") {
+  CHECK(find_placements(empty_game_with(Tetromino::O)).size() == 9);
+  CHECK(find_placements(empty_game_with(Tetromino::I)).size() == 7 + 10);
+  CHECK(find_placements(empty_game_with(Tetromino::T)).size() == 8 + 9 + 8 + 9);
+}
+
+TEST_CASE("Placement actions reproduce the placement", "[placements]") {
+  GameState start = empty_game_with(Tetromino::J);
+  for (const Placement &placement : find_placements(start)) {
+    GameState state = start;
+    for (Action action : placement.actions) {
+      state = reduce(std::move(state), action);
+    }
+    CHECK(state == placement.result);
+  }
+}
+
+TEST_CASE("Finished games have no placements", "[placements]") {
+  GameState state = empty_game_with(Tetromino::L);
+  state.progress = GameProgress::GAME_OVER;
+
+  CHECK(find_placements(state).empty());
+  CHECK(find_placement_results(state).empty());
+}
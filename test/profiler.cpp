@@ -0,0 +1,109 @@
+#include "catch.hpp"
+
+#include <string>
+#include <thread>
+
+#include "../src/profiler.h"
+#include "../src/state.h"
+
+static void busy_zone(const char *name) {
+  ProfileZone zone(name);
+  std::uint64_t until = profile_clock() + 1000;
+  while (profile_clock() < until) {
+  }
+}
+
+static const ThreadProfile &current_thread_profile(const std::vector<ThreadProfile> &profile) {
+  int thread = profile_buffer().thread;
+  for (const ThreadProfile &entry : profile) {
+    if (entry.thread == thread) {
+      return entry;
+    }
+  }
+  FAIL("no profile for this thread");
+  return profile.front();
+}
+
+TEST_CASE("Zones record their nesting", "[profiler]") {
+  profile_buffer();
+  clear_profile();
+  {
+    ProfileZone outer("outer");
+    busy_zone("inner");
+    busy_zone("inner");
+    {
+      ProfileZone middle("middle");
+      busy_zone("inner");
+    }
+  }
+
+  std::vector<ThreadProfile> profile = collect_profile();
+  const ThreadProfile &thread = current_thread_profile(profile);
+  REQUIRE(thread.records.size() == 5);
+  CHECK(thread.dropped == 0);
+  const ProfileRecord &outer = thread.records[4];
+  CHECK(std::string(outer.name) == "outer");
+  CHECK(outer.parent == 0);
+  CHECK(thread.records[0].parent == outer.sequence);
+  CHECK(thread.records[1].parent == outer.sequence);
+  CHECK(thread.records[2].parent == thread.records[3].sequence);
+  for (const ProfileRecord &record : thread.records) {
+    CHECK(record.start >= outer.start);
+    CHECK(record.end <= outer.end);
+  }
+}
+
+TEST_CASE("Folded stacks count time spent in each zone itself", "[profiler]") {
+  ThreadProfile thread = {0, {
+    {"inner", 10, 30, 2, 1},
+    {"get_shape", 40, 45, 4, 3},
+    {"inner", 35, 60, 3, 1},
+    {"outer", 0, 100, 1, 0},
+    {"orphan", 120, 125, 9, 8} // its parent was still open
+  }, 0};
+  CHECK(format_folded_stacks({thread}) ==
+        "orphan 5\n"
+        "outer 55\n"
+        "outer;inner 40\n"
+        "outer;inner;get_shape 5\n");
+}
+
+TEST_CASE("Chrome traces have one complete event per zone", "[profiler]") {
+  ThreadProfile thread = {3, {{"reduce", 1500, 4000, 1, 0}}, 0};
+  CHECK(format_chrome_trace({thread}) ==
+        "{\"traceEvents\":[\n"
+        "{\"name\":\"reduce\",\"ph\":\"X\",\"pid\":1,\"tid\":3,\"ts\":1.500,\"dur\":2.500}\n"
+        "],\"displayTimeUnit\":\"ns\"}\n");
+}
+
+TEST_CASE("Threads record into their own buffers", "[profiler]") {
+  int main_thread = profile_buffer().thread;
+  int other_thread = -1;
+  std::thread worker([&]() {
+    other_thread = profile_buffer().thread;
+    busy_zone("worker");
+  });
+  worker.join();
+  CHECK(other_thread != main_thread);
+  bool found = false;
+  for (const ThreadProfile &thread : collect_profile()) {
+    if (thread.thread == other_thread) {
+      found = thread.records.size() == 1 && std::string(thread.records[0].name) == "worker";
+    }
+  }
+  CHECK(found);
+}
+
+TEST_CASE("The engine's zones are compiled in only when enabled", "[profiler]") {
+  profile_buffer();
+  clear_profile();
+  reduce(new_game(10, 20, 1), Action::MOVE_DOWN);
+  std::vector<ThreadProfile> profile = collect_profile();
+  const ThreadProfile &thread = current_thread_profile(profile);
+  if (PROFILING_ENABLED) {
+    std::string folded = format_folded_stacks({thread});
+    CHECK(folded.find("reduce;move_down;is_legal_position;get_shape ") != std::string::npos);
+  } else {
+    CHECK(thread.records.empty());
+  }
+}
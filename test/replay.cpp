@@ -0,0 +1,123 @@
+#include "catch.hpp"
+
+#include <sstream>
+
+#include "../src/replay.h"
+
+const Action RECORDED_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::ROTATE_CLOCKWISE,
+  Action::TIME_FALL,
+  Action::MOVE_RIGHT,
+  Action::MOVE_RIGHT,
+  Action::MOVE_DOWN,
+  Action::TIME_FALL,
+  Action::ROTATE_COUNTERCLOCKWISE,
+  Action::MOVE_LEFT,
+  Action::MOVE_DOWN
+};
+
+// A recording with a restart part way through, one event every 100 ms.
+Replay record_games(int count) {
+  Replay replay = {DEFAULT_WIDTH, DEFAULT_HEIGHT, {}};
+  replay.events.push_back({0, Action::NEW_GAME, 7});
+  for (int i = 1; i < count; i++) {
+    std::uint32_t milliseconds = i * 100;
+    if (i == count / 2) {
+      replay.events.push_back({milliseconds, Action::NEW_GAME, 8});
+    } else {
+      replay.events.push_back({milliseconds, RECORDED_ACTIONS[i % 10], 0});
+    }
+  }
+  return replay;
+}
+
+// Every state from playing the whole recording in order.
+std::vector<GameState> play_through(const Replay &replay) {
+  std::vector<GameState> states;
+  GameState state;
+  for (const ReplayEvent &event : replay.events) {
+    state = apply_replay_event(state, event, replay.width, replay.height);
+    states.push_back(state);
+  }
+  return states;
+}
+
+TEST_CASE("Replays survive a round trip through text", "[replay]") {
+  Replay replay = record_games(300);
+  std::stringstream stream;
+  write_replay(stream, replay);
+
+  Replay loaded;
+  REQUIRE(read_replay(stream, loaded));
+  CHECK(loaded.width == replay.width);
+  CHECK(loaded.height == replay.height);
+  REQUIRE(loaded.events.size() == replay.events.size());
+  for (std::size_t i = 0; i < replay.events.size(); i++) {
+    CHECK(loaded.events[i].milliseconds == replay.events[i].milliseconds);
+    CHECK(loaded.events[i].action == replay.events[i].action);
+    if (replay.events[i].action == Action::NEW_GAME) {
+      CHECK(loaded.events[i].seed == replay.events[i].seed);
+    }
+  }
+}
+
+TEST_CASE("Malformed replays are rejected", "[replay]") {
+  const char *inputs[] = {
+    "",
+    "tetris-replay 2\n10 20\n0 NEW_GAME 1\n",
+    "tetris-replay 1\n2 20\n0 NEW_GAME 1\n",
+    "tetris-replay 1\n10 20\n",
+    "tetris-replay 1\n10 20\n0 MOVE_LEFT\n",
+    "tetris-replay 1\n10 20\n0 NEW_GAME\n",
+    "tetris-replay 1\n10 20\n0 NEW_GAME 1\n5 JUMP\n",
+    "tetris-replay 1\n10 20\n0 NEW_GAME 1\n50 MOVE_LEFT\n40 MOVE_LEFT\n"
+  };
+  for (const char *input : inputs) {
+    std::istringstream stream(input);
+    Replay replay;
+    CHECK_FALSE(read_replay(stream, replay));
+  }
+}
+
+TEST_CASE("Playing forward applies events up to the clock", "[replay]") {
+  Replay replay = record_games(300);
+  std::vector<GameState> expected = play_through(replay);
+  ReplayPlayer player = new_replay_player(replay, 16);
+
+  CHECK(player.next_event == 1);
+  CHECK(player.state == expected[0]);
+  CHECK(advance_replay(player, 250) == 2);
+  CHECK(player.state == expected[2]);
+  CHECK(advance_replay(player, 250) == 0);
+  CHECK_FALSE(replay_finished(player));
+
+  advance_replay(player, replay_duration(replay));
+  CHECK(replay_finished(player));
+  CHECK(player.state == expected.back());
+}
+
+TEST_CASE("Seeking matches playing from the start", "[replay]") {
+  Replay replay = record_games(300);
+  std::vector<GameState> expected = play_through(replay);
+  ReplayPlayer player = new_replay_player(replay, 16);
+
+  const std::uint32_t targets[] = {29000, 100, 15050, 15000, 14999, 0, 29900, 12345};
+  for (std::uint32_t target : targets) {
+    seek_replay(player, target);
+    std::size_t applied = target / 100 + 1;
+    REQUIRE(player.next_event == applied);
+    CHECK(player.state == expected[applied - 1]);
+    CHECK(player.state.rng.position() == expected[applied - 1].rng.position());
+  }
+}
+
+TEST_CASE("Snapshot intervals below one take a snapshot per event", "[replay]") {
+  Replay replay = record_games(20);
+  for (int interval : {0, -3}) {
+    ReplayPlayer player = new_replay_player(replay, interval);
+    CHECK(player.snapshots.size() == replay.events.size());
+    seek_replay(player, 1000);
+    CHECK(player.state == play_through(replay)[10]);
+  }
+}
@@ -0,0 +1,253 @@
+#include "catch.hpp"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+
+#include "../src/replay_archive.h"
+
+static std::string temporary_archive_path() {
+  return "/tmp/tetris-archive-" + std::to_string(getpid());
+}
+
+// A game as a person plays it: gravity every 500 ms, with bursts of input
+// in between, until the game ends or steps run out.
+static Replay played_game(unsigned seed, std::uint32_t start, int steps) {
+  const Action INPUTS[] = {
+    Action::MOVE_LEFT,
+    Action::MOVE_RIGHT,
+    Action::MOVE_DOWN,
+    Action::ROTATE_CLOCKWISE,
+    Action::ROTATE_COUNTERCLOCKWISE
+  };
+  std::mt19937 random(seed);
+  Replay game = {DEFAULT_WIDTH, DEFAULT_HEIGHT, {{start, Action::NEW_GAME, seed}}};
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, seed);
+  std::uint32_t next_fall = start + 500;
+  std::uint32_t now = start;
+  while (static_cast<int>(game.events.size()) <= steps &&
+         state.progress == GameProgress::IN_PROGRESS) {
+    Action action;
+    if (random() % 3 == 0) {
+      now = next_fall;
+      next_fall += 500;
+      action = Action::TIME_FALL;
+    } else {
+      now = std::min(now + static_cast<std::uint32_t>(random() % 120), next_fall);
+      action = INPUTS[random() % 5];
+    }
+    game.events.push_back({now, action, 0});
+    state = reduce(std::move(state), action);
+  }
+  return game;
+}
+
+static void check_same_game(const Replay &actual, const Replay &expected) {
+  CHECK(actual.width == expected.width);
+  CHECK(actual.height == expected.height);
+  REQUIRE(actual.events.size() == expected.events.size());
+  CHECK(actual.events[0].seed == expected.events[0].seed);
+  for (std::size_t i = 0; i < expected.events.size(); i++) {
+    CHECK(actual.events[i].milliseconds == expected.events[i].milliseconds);
+    CHECK(actual.events[i].action == expected.events[i].action);
+  }
+}
+
+TEST_CASE("Archived games decode to the recorded events", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  std::vector<Replay> games;
+  for (unsigned seed = 1; seed <= 5; seed++) {
+    games.push_back(played_game(seed, seed * 100000, 2000));
+  }
+  games.push_back({DEFAULT_WIDTH, DEFAULT_HEIGHT, {{7, Action::NEW_GAME, 4000000000u}}});
+
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, 64, writer));
+  for (const Replay &game : games) {
+    REQUIRE(append_archived_game(writer, game));
+  }
+  REQUIRE(close_archive_writer(writer));
+
+  ArchiveReader reader;
+  REQUIRE(open_archive_reader(path, reader));
+  REQUIRE(reader.games.size() == games.size());
+  for (std::size_t i = 0; i < games.size(); i++) {
+    Replay replay;
+    REQUIRE(read_archived_game(reader, i, replay));
+    check_same_game(replay, games[i]);
+    CHECK(reader.games[i].steps == games[i].events.size() - 1);
+  }
+  Replay replay;
+  CHECK_FALSE(read_archived_game(reader, games.size(), replay));
+  close_archive_reader(reader);
+  unlink(path.c_str());
+}
+
+TEST_CASE("Archived games seek to any step from a keyframe", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  Replay game = played_game(11, 0, 700);
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, 16, writer));
+  REQUIRE(append_archived_game(writer, game));
+  REQUIRE(close_archive_writer(writer));
+
+  ArchiveReader reader;
+  REQUIRE(open_archive_reader(path, reader));
+  GameState expected = new_game(game.width, game.height, game.events[0].seed);
+  for (std::size_t step = 0; step < game.events.size(); step++) {
+    if (step > 0) {
+      expected = reduce(std::move(expected), game.events[step].action);
+    }
+    GameState state;
+    REQUIRE(archived_game_state(reader, 0, step, state));
+    CHECK(state == expected);
+  }
+  GameState state;
+  CHECK_FALSE(archived_game_state(reader, 0, game.events.size(), state));
+  close_archive_reader(reader);
+  unlink(path.c_str());
+}
+
+TEST_CASE("Archives are much smaller than text replays", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, ARCHIVE_DEFAULT_KEYFRAME_INTERVAL, writer));
+  std::size_t text_size = 0;
+  for (unsigned seed = 1; seed <= 20; seed++) {
+    Replay game = played_game(seed, 0, 5000);
+    std::ostringstream text;
+    write_replay(text, game);
+    text_size += text.str().size();
+    REQUIRE(append_archived_game(writer, game));
+  }
+  REQUIRE(close_archive_writer(writer));
+
+  ArchiveReader reader;
+  REQUIRE(open_archive_reader(path, reader));
+  CHECK(reader.size * 8 < text_size);
+  close_archive_reader(reader);
+  unlink(path.c_str());
+}
+
+TEST_CASE("Archives are appended to after reopening", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  Replay first = played_game(21, 0, 300);
+  Replay second = played_game(22, 0, 300);
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, 32, writer));
+  REQUIRE(append_archived_game(writer, first));
+  REQUIRE(close_archive_writer(writer));
+  REQUIRE(open_archive_writer(path, 32, writer));
+  CHECK(writer.games.size() == 1);
+  REQUIRE(append_archived_game(writer, second));
+  REQUIRE(close_archive_writer(writer));
+
+  ArchiveReader reader;
+  REQUIRE(open_archive_reader(path, reader));
+  REQUIRE(reader.games.size() == 2);
+  Replay replay;
+  REQUIRE(read_archived_game(reader, 0, replay));
+  check_same_game(replay, first);
+  REQUIRE(read_archived_game(reader, 1, replay));
+  check_same_game(replay, second);
+  close_archive_reader(reader);
+  unlink(path.c_str());
+}
+
+TEST_CASE("Archives without an index are recovered by scanning", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  Replay first = played_game(31, 0, 300);
+  Replay second = played_game(32, 0, 300);
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, 32, writer));
+  REQUIRE(append_archived_game(writer, first));
+  REQUIRE(append_archived_game(writer, second));
+  std::uint64_t second_offset = writer.games[1].offset;
+  close(writer.fd); // as if the writer died before writing its index
+
+  ArchiveReader reader;
+  REQUIRE(open_archive_reader(path, reader));
+  REQUIRE(reader.games.size() == 2);
+  Replay replay;
+  REQUIRE(read_archived_game(reader, 1, replay));
+  check_same_game(replay, second);
+  close_archive_reader(reader);
+
+  // A partly written block is dropped.
+  REQUIRE(truncate(path.c_str(), second_offset + 100) == 0);
+  REQUIRE(open_archive_reader(path, reader));
+  CHECK(reader.games.size() == 1);
+  close_archive_reader(reader);
+  REQUIRE(open_archive_writer(path, 32, writer));
+  CHECK(writer.end == second_offset);
+  REQUIRE(close_archive_writer(writer));
+  unlink(path.c_str());
+}
+
+TEST_CASE("Archives only take whole games", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, 32, writer));
+  Replay restarted = played_game(41, 0, 10);
+  restarted.events.push_back({10000, Action::NEW_GAME, 5});
+  CHECK_FALSE(append_archived_game(writer, restarted));
+  Replay headless = played_game(41, 0, 10);
+  headless.events.erase(headless.events.begin());
+  CHECK_FALSE(append_archived_game(writer, headless));
+  REQUIRE(close_archive_writer(writer));
+
+  std::vector<Replay> games = split_replay_games(restarted);
+  REQUIRE(games.size() == 2);
+  CHECK(games[0].events.size() == restarted.events.size() - 1);
+  CHECK(games[1].events.size() == 1);
+  CHECK(games[1].events[0].seed == 5);
+  unlink(path.c_str());
+}
+
+static void overwrite_u16(const std::string &path, std::uint64_t offset, std::uint16_t value) {
+  std::fstream file(path, std::ios::in | std::ios::out | std::ios::binary);
+  file.seekp(offset);
+  file.write(reinterpret_cast<const char *>(&value), sizeof(value));
+  REQUIRE(file);
+}
+
+TEST_CASE("Archived games on implausible fields are taken as damaged", "[replay_archive]") {
+  std::string path = temporary_archive_path();
+  unlink(path.c_str());
+  ArchiveWriter writer;
+  REQUIRE(open_archive_writer(path, 32, writer));
+  Replay huge = played_game(51, 0, 10);
+  huge.width = ARCHIVE_MAX_FIELD_SIDE + 1;
+  CHECK_FALSE(append_archived_game(writer, huge));
+  REQUIRE(append_archived_game(writer, played_game(51, 0, 300)));
+  std::uint64_t width_offset = writer.games[0].offset + 4; // after the magic
+  REQUIRE(close_archive_writer(writer));
+  ArchiveReader reader;
+  GameState state;
+  REQUIRE(open_archive_reader(path, reader));
+  REQUIRE(archived_game_state(reader, 0, 100, state));
+  close_archive_reader(reader);
+
+  // A flipped bit in the header's width.
+  overwrite_u16(path, width_offset, 0xFFFF);
+  REQUIRE(open_archive_reader(path, reader));
+  Replay replay;
+  CHECK_FALSE(read_archived_game(reader, 0, replay));
+  CHECK_FALSE(archived_game_state(reader, 0, 0, state));
+  close_archive_reader(reader);
+
+  // A plausible width that the keyframes disagree with.
+  overwrite_u16(path, width_offset, DEFAULT_WIDTH + 2);
+  REQUIRE(open_archive_reader(path, reader));
+  CHECK_FALSE(archived_game_state(reader, 0, 100, state));
+  close_archive_reader(reader);
+  unlink(path.c_str());
+}
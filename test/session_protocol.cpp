@@ -0,0 +1,30 @@
+#include "catch.hpp"
+
+#include "../src/session_protocol.h"
+
+TEST_CASE("Status reports survive encoding", "[session_protocol]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  state.score = 123456;
+  state.lines = 300;
+  StatusReport report = make_status_report(state, 70000);
+
+  std::uint8_t buffer[STATUS_REPORT_SIZE];
+  encode_status_report(report, buffer);
+  StatusReport decoded = decode_status_report(buffer);
+
+  CHECK(decoded.actions_applied == 70000);
+  CHECK(decoded.score == 123456);
+  CHECK(decoded.lines == 300);
+  CHECK(decoded.position_x == state.active_block.position_x);
+  CHECK(decoded.position_y == state.active_block.position_y);
+  CHECK(decoded.tetromino == state.active_block.tetromino);
+  CHECK(decoded.rotation == state.active_block.rotation);
+  CHECK(decoded.next_block == state.next_block);
+  CHECK(decoded.progress == GameProgress::IN_PROGRESS);
+}
+
+TEST_CASE("Only known actions are accepted from the wire", "[session_protocol]") {
+  CHECK(is_valid_action_byte(static_cast<std::uint8_t>(Action::MOVE_LEFT)));
+  CHECK(is_valid_action_byte(static_cast<std::uint8_t>(Action::ROTATE_COUNTERCLOCKWISE)));
+  CHECK_FALSE(is_valid_action_byte(200));
+}
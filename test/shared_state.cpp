@@ -0,0 +1,148 @@
+#include "catch.hpp"
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+#include "../src/shared_state.h"
+
+static std::string temporary_segment_name() {
+  return "tetris-shared-state-test-" + std::to_string(getpid());
+}
+
+static GameState played_game() {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 3);
+  for (int i = 0; i < 60; i++) {
+    state = reduce(std::move(state), i % 3 == 0 ? Action::MOVE_LEFT : Action::MOVE_DOWN);
+  }
+  return state;
+}
+
+TEST_CASE("Observers read the published state", "[shared_state]") {
+  std::string name = temporary_segment_name();
+  StatePublisher publisher;
+  REQUIRE(open_state_publisher(name, DEFAULT_WIDTH, DEFAULT_HEIGHT, publisher));
+  StateObserver observer;
+  REQUIRE(open_state_observer(name, observer));
+  CHECK(observer.width == DEFAULT_WIDTH);
+  CHECK(observer.height == DEFAULT_HEIGHT);
+
+  GameState read;
+  std::uint64_t version;
+  CHECK(published_state_version(observer) == 0);
+  CHECK_FALSE(read_published_state(observer, read, version));
+
+  GameState state = played_game();
+  REQUIRE(publish_game_state(publisher, state));
+  CHECK(published_state_version(observer) == 1);
+  REQUIRE(read_published_state(observer, read, version));
+  CHECK(version == 1);
+  CHECK(read == state);
+  CHECK(read.progress == state.progress);
+
+  state = reduce(std::move(state), Action::MOVE_DOWN);
+  REQUIRE(publish_game_state(publisher, state));
+  REQUIRE(read_published_state(observer, read, version));
+  CHECK(version == 2);
+  CHECK(read == state);
+
+  CHECK_FALSE(publish_game_state(publisher, new_game(DEFAULT_WIDTH + 1, DEFAULT_HEIGHT, 0)));
+  CHECK(published_state_version(observer) == 2);
+
+  close_state_publisher(publisher);
+  // The observer's mapping outlives the segment's name.
+  REQUIRE(read_published_state(observer, read, version));
+  CHECK(read == state);
+  close_state_observer(observer);
+  CHECK_FALSE(open_state_observer(name, observer));
+}
+
+TEST_CASE("Cells are republished only when the field's version changes", "[shared_state]") {
+  std::string name = temporary_segment_name();
+  StatePublisher publisher;
+  REQUIRE(open_state_publisher(name, DEFAULT_WIDTH, DEFAULT_HEIGHT, publisher));
+  StateObserver observer;
+  REQUIRE(open_state_observer(name, observer));
+
+  GameState state = played_game();
+  REQUIRE(publish_game_state(publisher, state));
+  GameState stale = state;
+  stale.field.lines[0][0] = CellState::FILLED; // unstamped, so not sent
+  stale.score++;
+  REQUIRE(publish_game_state(publisher, stale));
+  GameState read;
+  std::uint64_t version;
+  REQUIRE(read_published_state(observer, read, version));
+  CHECK(read.field == state.field);
+  CHECK(read.score == stale.score);
+
+  refresh_versions(stale);
+  REQUIRE(publish_game_state(publisher, stale));
+  REQUIRE(read_published_state(observer, read, version));
+  CHECK(read == stale);
+  close_state_observer(observer);
+  close_state_publisher(publisher);
+}
+
+TEST_CASE("Observers never see a state mid-write", "[shared_state]") {
+  std::string name = temporary_segment_name();
+  StatePublisher publisher;
+  REQUIRE(open_state_publisher(name, DEFAULT_WIDTH, DEFAULT_HEIGHT, publisher));
+  StateObserver observer;
+  REQUIRE(open_state_observer(name, observer));
+
+  // Every published state fills as many cells as its score, and has as
+  // many lines, so a mix of two states shows as a mismatch.
+  const int states = 20000;
+  std::atomic<bool> done(false);
+  std::thread writer([&]() {
+    GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+    for (int i = 1; i <= states; i++) {
+      int filled = i % (DEFAULT_WIDTH * DEFAULT_HEIGHT);
+      for (int cell = 0; cell < DEFAULT_WIDTH * DEFAULT_HEIGHT; cell++) {
+        state.field.lines[cell / DEFAULT_WIDTH][cell % DEFAULT_WIDTH] =
+          cell < filled ? CellState::FILLED : CellState::EMPTY;
+      }
+      state.score = filled;
+      state.lines = filled;
+      refresh_versions(state); // written directly
+      publish_game_state(publisher, state);
+    }
+    done = true;
+  });
+
+  GameState read;
+  std::uint64_t version;
+  std::uint64_t last_version = 0;
+  int reads = 0;
+  bool consistent = true;
+  bool in_order = true;
+  while (!done || last_version < states) {
+    if (!read_published_state(observer, read, version)) {
+      continue;
+    }
+    int filled = 0;
+    for (const Line &line : read.field.lines) {
+      for (CellState cell : line) {
+        filled += cell == CellState::FILLED;
+      }
+    }
+    consistent = consistent && filled == read.score && read.lines == read.score;
+    in_order = in_order && version >= last_version;
+    last_version = version;
+    reads++;
+  }
+  writer.join();
+  CHECK(consistent);
+  CHECK(in_order);
+  CHECK(reads > 0);
+  CHECK(last_version == states);
+  close_state_observer(observer);
+  close_state_publisher(publisher);
+}
+
+TEST_CASE("Observers reject missing segments", "[shared_state]") {
+  StateObserver observer;
+  CHECK_FALSE(open_state_observer(temporary_segment_name() + "-missing", observer));
+}
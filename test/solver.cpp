@@ -0,0 +1,134 @@
+#include "catch.hpp"
+
+#include <algorithm>
+#include <utility>
+
+#include "../src/placements.h"
+#include "../src/solver.h"
+
+bool field_is_empty(const Field &field) {
+  for (const Line &line : field.lines) {
+    for (CellState cell : line) {
+      if (cell == CellState::FILLED) {
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+// Exhaustive reference searches through the reducer.
+int reference_max_lines(const GameState &state, int pieces) {
+  if (pieces == 0) {
+    return 0;
+  }
+  int best = 0;
+  for (const GameState &next : find_placement_results(state)) {
+    best = std::max(best, next.lines - state.lines + reference_max_lines(next, pieces - 1));
+  }
+  return best;
+}
+
+bool reference_perfect_clear(const GameState &state, int pieces) {
+  if (pieces == 0) {
+    return false;
+  }
+  for (const GameState &next : find_placement_results(state)) {
+    if (field_is_empty(next.field) || reference_perfect_clear(next, pieces - 1)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// Fills the bottom rows with a few gaps, leaving a board that can be
+// cleared in a handful of pieces.
+GameState game_with_gaps(RNG::result_type seed, int rows) {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, seed);
+  RNG rng(seed);
+  for (int y = 0; y < rows; y++) {
+    int gap = rng() % (DEFAULT_WIDTH - 3);
+    for (int x = 0; x < DEFAULT_WIDTH; x++) {
+      if (x < gap || x >= gap + 4) {
+        state.field.lines[y][x] = CellState::FILLED;
+      }
+    }
+  }
+  return state;
+}
+
+GameState replay(GameState state, const std::vector<Action> &actions) {
+  for (Action action : actions) {
+    state = reduce(std::move(state), action);
+  }
+  return state;
+}
+
+TEST_CASE("Solver finds a one piece perfect clear", "[solver]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  state.active_block.tetromino = Tetromino::I;
+  for (int x = 4; x < DEFAULT_WIDTH; x++) {
+    state.field.lines[0][x] = CellState::FILLED;
+  }
+
+  SolverResult result = solve(state, {SolverGoal::PERFECT_CLEAR, 3, 1});
+
+  REQUIRE(result.found);
+  CHECK(result.pieces_used == 1);
+  CHECK(result.lines == 1);
+  GameState solved = replay(state, result.actions);
+  CHECK(field_is_empty(solved.field));
+  CHECK(solved.lines == 1);
+}
+
+TEST_CASE("Perfect clears agree with exhaustive search", "[solver]") {
+  // A two by four hole in the bottom rows, tried with every pair of
+  // leading pieces.
+  GameState hole = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  for (int y = 0; y < 2; y++) {
+    for (int x = 0; x < DEFAULT_WIDTH; x++) {
+      if (x < 3 || x >= 7) {
+        hole.field.lines[y][x] = CellState::FILLED;
+      }
+    }
+  }
+  int solvable = 0;
+  for (int first = 0; first < TETROMINO_COUNT; first++) {
+    for (int second = 0; second < TETROMINO_COUNT; second++) {
+      GameState state = hole;
+      state.active_block.tetromino = static_cast<Tetromino>(first);
+      state.next_block = static_cast<Tetromino>(second);
+      bool expected = reference_perfect_clear(state, 2);
+
+      SolverResult result = solve(state, {SolverGoal::PERFECT_CLEAR, 2, 2});
+
+      CHECK(result.found == expected);
+      if (result.found) {
+        solvable++;
+        CHECK(result.pieces_used == 2);
+        CHECK(field_is_empty(replay(state, result.actions).field));
+      }
+    }
+  }
+  CHECK(solvable > 0);
+}
+
+TEST_CASE("Most lines agree with exhaustive search", "[solver]") {
+  for (RNG::result_type seed = 0; seed < 8; seed++) {
+    GameState state = game_with_gaps(seed, 3);
+    int expected = reference_max_lines(state, 3);
+
+    SolverResult result = solve(state, {SolverGoal::MAX_LINES, 3, 2});
+
+    REQUIRE(result.found);
+    CHECK(result.lines == expected);
+    CHECK(result.pieces_used <= 3);
+    CHECK(replay(state, result.actions).lines - state.lines == expected);
+  }
+}
+
+TEST_CASE("Solver declines fields it cannot represent", "[solver]") {
+  GameState state = new_game(40, DEFAULT_HEIGHT, 0);
+
+  CHECK_FALSE(solve(state, {SolverGoal::MAX_LINES, 2, 1}).found);
+}
@@ -0,0 +1,51 @@
+#include "catch.hpp"
+
+#include <thread>
+
+#include "../src/spsc_queue.h"
+
+TEST_CASE("Queue keeps order and reports full and empty", "[spsc_queue]") {
+  SpscQueue<int, 4> queue;
+  int value;
+
+  CHECK_FALSE(queue.try_pop(value));
+  for (int i = 0; i < 4; i++) {
+    CHECK(queue.try_push(i));
+  }
+  CHECK_FALSE(queue.try_push(4));
+  for (int i = 0; i < 4; i++) {
+    REQUIRE(queue.try_pop(value));
+    CHECK(value == i);
+  }
+  CHECK_FALSE(queue.try_pop(value));
+}
+
+TEST_CASE("Queue passes every value between threads", "[spsc_queue]") {
+  const int count = 200000;
+  SpscQueue<int, 64> queue;
+  std::thread producer([&]() {
+    for (int i = 0; i < count; i++) {
+      while (!queue.try_push(i)) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  long long sum = 0;
+  bool in_order = true;
+  int expected = 0;
+  while (expected < count) {
+    int value;
+    if (queue.try_pop(value)) {
+      in_order = in_order && value == expected;
+      sum += value;
+      expected++;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+  producer.join();
+
+  CHECK(in_order);
+  CHECK(sum == static_cast<long long>(count) * (count - 1) / 2);
+}
@@ -1,5 +1,10 @@
 #include "catch.hpp"
 
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "../src/allocation_counter.h"
 #include "../src/state.h"
 
 void check_identical_except_active_block(GameState lhs, GameState rhs) {
@@ -12,7 +17,7 @@ void check_identical_except_active_block(GameState lhs, GameState rhs) {
 }
 
 GameState default_game_with_active_block(ActiveBlock active_block) {
-  return {
+  GameState state = {
     {
       DEFAULT_HEIGHT,
       DEFAULT_WIDTH,
@@ -25,8 +30,11 @@ GameState default_game_with_active_block(ActiveBlock active_block) {
     0,
     0,
     GameProgress::IN_PROGRESS,
-    RNG(0)
+    RNG(0),
+    {}
   };
+  refresh_versions(state);
+  return state;
 }
 
 TEST_CASE("Can create new game", "[reducer]") {
@@ -408,3 +416,189 @@ TEST_CASE("Next block is chosen randomly (and stably)", "[reducer]") {
   next = fall_until_new_block(next);
   CHECK(next.next_block == Tetromino::Z);
 }
+
+TEST_CASE("Moved-in states are reduced without allocating", "[reducer][allocation]") {
+  const Action actions[] = {
+    Action::MOVE_LEFT,
+    Action::ROTATE_CLOCKWISE,
+    Action::MOVE_RIGHT,
+    Action::MOVE_RIGHT,
+    Action::TIME_FALL,
+    Action::ROTATE_COUNTERCLOCKWISE,
+    Action::MOVE_DOWN
+  };
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 3);
+  int steps = 0;
+
+  AllocationCount before = thread_allocation_count();
+  while (state.progress == GameProgress::IN_PROGRESS) {
+    state = reduce(std::move(state), actions[steps % 7]);
+    steps++;
+  }
+  AllocationCount allocated = allocations_since(before);
+
+  CHECK(state.rng.position() > 10); // many blocks were locked
+  CHECK(allocated.allocations == 0);
+  CHECK(allocated.bytes == 0);
+}
+
+TEST_CASE("Copying a state is counted as allocation", "[allocation]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 3);
+
+  AllocationCount before = thread_allocation_count();
+  GameState copy = reduce(state, Action::MOVE_LEFT);
+  AllocationCount allocated = allocations_since(before);
+
+  CHECK(allocated.allocations == DEFAULT_HEIGHT + 2); // the rows, and their versions
+  CHECK(copy.active_block.position_x == state.active_block.position_x - 1);
+}
+
+TEST_CASE("Removing rows matches erasing them from a vector", "[rows]") {
+  const int height = 12;
+  std::mt19937 random(5);
+  std::vector<Line> expected;
+  for (int y = 0; y < height; y++) {
+    Line line(4, CellState::EMPTY);
+    for (int x = 0; x < 4; x++) {
+      line[x] = (y + 1) & (1 << x) ? CellState::FILLED : CellState::EMPTY;
+    }
+    expected.push_back(line);
+  }
+  Rows rows(expected);
+
+  for (int round = 0; round < 200; round++) {
+    std::vector<int> removed;
+    for (int y = 0; y < height; y++) {
+      if (random() % 5 == 0) {
+        removed.push_back(y);
+      }
+    }
+    rows.remove(removed.data(), static_cast<int>(removed.size()));
+    for (auto y = removed.rbegin(); y != removed.rend(); ++y) {
+      expected.erase(expected.begin() + *y);
+    }
+    expected.resize(height, Line(4, CellState::EMPTY));
+    // Refill the top so later rounds still have rows to tell apart.
+    for (int y = height - static_cast<int>(removed.size()); y < height; y++) {
+      expected[y][round % 4] = rows[y][round % 4] = CellState::FILLED;
+    }
+    REQUIRE(rows == Rows(expected));
+  }
+}
+
+TEST_CASE("Lines clear on tall fields", "[reducer]") {
+  const int height = 300;
+  GameState state = new_game(DEFAULT_WIDTH, height, 1);
+  state.active_block = {0, 3, Tetromino::I, Rotation::CLOCKWISE};
+  int column = -1;
+  const Shape &shape = get_shape(Tetromino::I, Rotation::CLOCKWISE);
+  for (int x = 0; x < MAX_TETROMINO_WIDTH && column < 0; x++) {
+    if (shape[0][x] == CellState::FILLED) {
+      column = x;
+    }
+  }
+  for (int y = 0; y < 4; y++) {
+    for (int x = 0; x < DEFAULT_WIDTH; x++) {
+      state.field.lines[y][x] = x == column ? CellState::EMPTY : CellState::FILLED;
+    }
+  }
+  state.field.lines[4][7] = CellState::FILLED;
+
+  state = reduce(std::move(state), Action::MOVE_DOWN);
+
+  CHECK(state.lines == 4);
+  CHECK(state.field.lines.size() == height);
+  CHECK(state.field.lines[0][7] == CellState::FILLED);
+  for (int y = 0; y < height; y++) {
+    for (int x = 0; x < DEFAULT_WIDTH; x++) {
+      if (y != 0 || x != 7) {
+        CHECK(state.field.lines[y][x] == CellState::EMPTY);
+      }
+    }
+  }
+}
+
+TEST_CASE("New games stamp every part", "[versions]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  const StateVersions &versions = state.versions;
+
+  CHECK(versions.field != 0);
+  CHECK(versions.rows == std::vector<std::uint64_t>(DEFAULT_HEIGHT, versions.field));
+  CHECK(versions.active_block == versions.field);
+  CHECK(versions.next_block == versions.field);
+  CHECK(versions.score == versions.field);
+
+  GameState restarted = reduce(state, Action::NEW_GAME);
+  CHECK(restarted.versions.field != versions.field);
+  CHECK(restarted.versions.active_block != versions.active_block);
+}
+
+TEST_CASE("Moves stamp only the active block", "[versions]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  GameState moved = reduce(state, Action::MOVE_LEFT);
+
+  CHECK(moved.versions.active_block != state.versions.active_block);
+  CHECK(moved.versions.field == state.versions.field);
+  CHECK(moved.versions.rows == state.versions.rows);
+  CHECK(moved.versions.next_block == state.versions.next_block);
+  CHECK(moved.versions.score == state.versions.score);
+
+  GameState against_wall = moved;
+  for (int i = 0; i < DEFAULT_WIDTH; i++) {
+    against_wall = reduce(std::move(against_wall), Action::MOVE_LEFT);
+  }
+  GameState blocked = reduce(against_wall, Action::MOVE_LEFT);
+  CHECK(blocked.versions.active_block == against_wall.versions.active_block);
+}
+
+TEST_CASE("Locks stamp the rows they reach", "[versions]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  state.active_block = {0, 3, Tetromino::I, Rotation::UNROTATED};
+  GameState locked = state;
+  while (locked.rng.position() == state.rng.position()) {
+    locked = reduce(std::move(locked), Action::MOVE_DOWN);
+  }
+  REQUIRE(locked.lines == 0);
+
+  CHECK(locked.versions.field != state.versions.field);
+  CHECK(locked.versions.next_block != state.versions.next_block);
+  CHECK(locked.versions.score != state.versions.score);
+  CHECK(locked.versions.active_block == locked.versions.field);
+  for (int y = 0; y < DEFAULT_HEIGHT; y++) {
+    // The block locked with its top at row 0, so only row 0 was reached.
+    CHECK((locked.versions.rows[y] == locked.versions.field) == (y == 0));
+  }
+}
+
+TEST_CASE("Line clears stamp every row above the lowest removed", "[versions]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  state.active_block = {0, 1, Tetromino::I, Rotation::UNROTATED};
+  for (int x = 4; x < DEFAULT_WIDTH; x++) {
+    state.field.lines[1][x] = CellState::FILLED;
+  }
+  state.field.lines[0][0] = CellState::FILLED;
+  refresh_versions(state); // written directly
+  std::uint64_t bottom = state.versions.rows[0];
+
+  GameState cleared = reduce(state, Action::MOVE_DOWN);
+  REQUIRE(cleared.lines == 1);
+
+  CHECK(cleared.versions.rows[0] == bottom);
+  for (int y = 1; y < DEFAULT_HEIGHT; y++) {
+    CHECK(cleared.versions.rows[y] == cleared.versions.field);
+  }
+}
+
+TEST_CASE("Copies share stamps until they diverge", "[versions]") {
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 2);
+  GameState left = reduce(state, Action::MOVE_LEFT);
+  GameState right = reduce(state, Action::MOVE_RIGHT);
+  GameState right_again = reduce(state, Action::MOVE_RIGHT);
+
+  CHECK(left.versions.active_block != right.versions.active_block);
+  // Equal contents reached separately are not known to be equal.
+  CHECK(right_again.active_block == right.active_block);
+  CHECK(right_again.versions.active_block != right.versions.active_block);
+  CHECK(same_version(left.versions.field, right.versions.field));
+  CHECK_FALSE(same_version(0, 0));
+}
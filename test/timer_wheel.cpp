@@ -0,0 +1,36 @@
+#include "catch.hpp"
+
+#include "../src/timer_wheel.h"
+
+TEST_CASE("Timers expire once their tick has passed", "[timer_wheel]") {
+  TimerWheel wheel = new_timer_wheel(10, 8, 1000);
+  std::vector<TimerEntry> expired;
+  schedule_timer(wheel, 1, 0, 1050);
+  schedule_timer(wheel, 2, 0, 1020);
+
+  CHECK(advance_timer_wheel(wheel, 1019, expired) == 0);
+  CHECK(advance_timer_wheel(wheel, 1020, expired) == 1);
+  CHECK(expired[0].id == 2);
+  CHECK(advance_timer_wheel(wheel, 1100, expired) == 1);
+  CHECK(expired[1].id == 1);
+}
+
+TEST_CASE("Timers further out than one revolution wait their turn", "[timer_wheel]") {
+  TimerWheel wheel = new_timer_wheel(10, 4, 0);
+  std::vector<TimerEntry> expired;
+  schedule_timer(wheel, 1, 0, 100); // shares a slot with tick 2, 6 and 8
+
+  CHECK(advance_timer_wheel(wheel, 60, expired) == 0);
+  CHECK(advance_timer_wheel(wheel, 100, expired) == 1);
+}
+
+TEST_CASE("Timers scheduled in the past fire on the next tick", "[timer_wheel]") {
+  TimerWheel wheel = new_timer_wheel(10, 4, 500);
+  std::vector<TimerEntry> expired;
+  schedule_timer(wheel, 7, 3, 100);
+
+  CHECK(milliseconds_until_next_tick(wheel, 505) == 5);
+  CHECK(advance_timer_wheel(wheel, 510, expired) == 1);
+  CHECK(expired[0].id == 7);
+  CHECK(expired[0].generation == 3);
+}
@@ -0,0 +1,102 @@
+#include "catch.hpp"
+
+#include "../src/tournament.h"
+
+static TournamentOptions small_tournament(TournamentFormat format, int rounds, int threads) {
+  return {format, rounds, 40, DEFAULT_WIDTH, DEFAULT_HEIGHT, 16, 3, threads};
+}
+
+TEST_CASE("Matches go to more lines, then to more pieces", "[tournament]") {
+  CHECK(match_score({50, 10, 1000, true}, {50, 9, 900, true}) == 1);
+  CHECK(match_score({50, 9, 900, true}, {50, 10, 1000, true}) == 0);
+  CHECK(match_score({30, 4, 400, false}, {20, 4, 400, false}) == 1);
+  CHECK(match_score({50, 10, 1000, true}, {50, 10, 1200, true}) == 0.5);
+}
+
+TEST_CASE("Both games of a match are dealt the same pieces", "[tournament]") {
+  std::vector<TournamentEntrant> entrants = {
+    weighted_bot_entrant("one", DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT),
+    weighted_bot_entrant("other", DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT)
+  };
+  TournamentResult result = run_tournament(
+    entrants, small_tournament(TournamentFormat::ROUND_ROBIN, 4, 2));
+  REQUIRE(result.matches.size() == 4);
+  for (const MatchResult &match : result.matches) {
+    CHECK(match.first_game.lines == match.second_game.lines);
+    CHECK(match.first_game.pieces == match.second_game.pieces);
+    CHECK(match.first_score == 0.5);
+  }
+  CHECK(result.players[0].draws == 4);
+  CHECK(result.players[0].rating == INITIAL_RATING);
+  CHECK(result.players[0].performance == Approx(0).margin(1e-9));
+}
+
+TEST_CASE("Stronger bots rate higher", "[tournament]") {
+  std::vector<TournamentEntrant> entrants = {
+    dropping_entrant("drop"),
+    weighted_bot_entrant("bot", DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT),
+    dropping_entrant("drop again")
+  };
+  TournamentResult result = run_tournament(
+    entrants, small_tournament(TournamentFormat::ROUND_ROBIN, 3, 4));
+  CHECK(result.matches.size() == 9);
+  const PlayerStanding &bot = result.players[1];
+  CHECK(bot.wins == 6);
+  CHECK(bot.points == 6);
+  CHECK(bot.rating > result.players[0].rating);
+  CHECK(bot.rating > result.players[2].rating);
+  CHECK(bot.performance > 0);
+  CHECK(bot.performance_low <= bot.performance);
+  CHECK(bot.performance_high >= bot.performance);
+  CHECK(result.players[0].performance < 0);
+  CHECK(result.players[0].performance_high - result.players[0].performance_low > 0);
+}
+
+TEST_CASE("Tournaments play out the same on any number of threads", "[tournament]") {
+  std::vector<TournamentEntrant> entrants = {
+    weighted_bot_entrant("default", DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT),
+    weighted_bot_entrant("holes", {-10, 0, 0, 0, 0, 0}, DEFAULT_WIDTH, DEFAULT_HEIGHT),
+    weighted_bot_entrant("height", {0, -1, 0, 0, 0, 0}, DEFAULT_WIDTH, DEFAULT_HEIGHT),
+    dropping_entrant("drop")
+  };
+  TournamentResult one = run_tournament(entrants, small_tournament(TournamentFormat::SWISS, 3, 1));
+  TournamentResult many = run_tournament(entrants, small_tournament(TournamentFormat::SWISS, 3, 4));
+  REQUIRE(one.matches.size() == many.matches.size());
+  for (std::size_t i = 0; i < one.matches.size(); i++) {
+    CHECK(one.matches[i].first == many.matches[i].first);
+    CHECK(one.matches[i].second == many.matches[i].second);
+    CHECK(one.matches[i].seed == many.matches[i].seed);
+    CHECK(one.matches[i].first_score == many.matches[i].first_score);
+  }
+  for (std::size_t i = 0; i < entrants.size(); i++) {
+    CHECK(one.players[i].rating == many.players[i].rating);
+  }
+}
+
+TEST_CASE("Swiss rounds avoid rematches and hand out byes", "[tournament]") {
+  for (int count : {5, 6}) {
+    std::vector<TournamentEntrant> entrants;
+    for (int i = 0; i < count; i++) {
+      entrants.push_back(dropping_entrant("drop " + std::to_string(i)));
+    }
+    TournamentResult result = run_tournament(
+      entrants, small_tournament(TournamentFormat::SWISS, 3, 2));
+    CHECK(result.matches.size() == static_cast<std::size_t>(3 * (count / 2)));
+    std::vector<std::vector<int>> meetings(count, std::vector<int>(count, 0));
+    std::vector<int> played(count, 0);
+    for (const MatchResult &match : result.matches) {
+      meetings[match.first][match.second]++;
+      meetings[match.second][match.first]++;
+      played[match.first]++;
+      played[match.second]++;
+    }
+    for (int i = 0; i < count; i++) {
+      CHECK(played[i] >= 2); // at most one bye each
+      for (int j = 0; j < count; j++) {
+        CHECK(meetings[i][j] <= 1);
+      }
+      const PlayerStanding &player = result.players[i];
+      CHECK(player.points == player.wins + 0.5 * player.draws + (3 - played[i]));
+    }
+  }
+}
@@ -0,0 +1,63 @@
+#include "catch.hpp"
+
+#include <thread>
+
+#include "../src/triple_buffer.h"
+
+TEST_CASE("Reader sees only published values", "[triple_buffer]") {
+  TripleBuffer<int> buffer(0);
+
+  CHECK_FALSE(buffer.update());
+  buffer.write_buffer() = 1;
+  CHECK_FALSE(buffer.update());
+  buffer.publish();
+  REQUIRE(buffer.update());
+  CHECK(buffer.read_buffer() == 1);
+  CHECK_FALSE(buffer.update());
+  CHECK(buffer.read_buffer() == 1);
+}
+
+TEST_CASE("Reader skips to the latest value", "[triple_buffer]") {
+  TripleBuffer<int> buffer(0);
+  for (int i = 1; i <= 3; i++) {
+    buffer.write_buffer() = i;
+    buffer.publish();
+  }
+
+  REQUIRE(buffer.update());
+  CHECK(buffer.read_buffer() == 3);
+}
+
+struct Snapshot {
+  int first;
+  int second; // always equal to first once published
+};
+
+TEST_CASE("Snapshots are never torn across threads", "[triple_buffer]") {
+  TripleBuffer<Snapshot> buffer({0, 0});
+  const int count = 100000;
+  std::thread writer([&]() {
+    for (int i = 1; i <= count; i++) {
+      Snapshot &snapshot = buffer.write_buffer();
+      snapshot.first = i;
+      snapshot.second = i;
+      buffer.publish();
+    }
+  });
+
+  bool consistent = true;
+  bool increasing = true;
+  int last = 0;
+  while (last < count) {
+    if (buffer.update()) {
+      const Snapshot &snapshot = buffer.read_buffer();
+      consistent = consistent && snapshot.first == snapshot.second;
+      increasing = increasing && snapshot.first > last;
+      last = snapshot.first;
+    }
+  }
+  writer.join();
+
+  CHECK(consistent);
+  CHECK(increasing);
+}
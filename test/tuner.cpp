@@ -0,0 +1,86 @@
+#include "catch.hpp"
+
+#include <sstream>
+
+#include "../src/bot.h"
+#include "../src/tuner.h"
+
+TunerOptions small_tuner_options(int threads) {
+  return {8, 3, 4, 2, 100, 0.5, 0.1, DEFAULT_WIDTH, DEFAULT_HEIGHT, 11, threads};
+}
+
+void check_same_tuner_state(const TunerState &lhs, const TunerState &rhs) {
+  CHECK(lhs.generation == rhs.generation);
+  for (int i = 0; i < FEATURE_COUNT; i++) {
+    CHECK(lhs.mean[i] == rhs.mean[i]);
+    CHECK(lhs.deviation[i] == rhs.deviation[i]);
+  }
+  CHECK(lhs.elite_cutoff == rhs.elite_cutoff);
+  CHECK(lhs.best_fitness == rhs.best_fitness);
+  CHECK(score_features({1, 2, 3, 4, 5, 6}, lhs.best_weights) ==
+        score_features({1, 2, 3, 4, 5, 6}, rhs.best_weights));
+}
+
+TEST_CASE("The bot clears lines with the default weights", "[tuner]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  BotGame game = play_bot_game(bot, 1, 200);
+  CHECK(game.pieces == 200);
+  CHECK(game.survived);
+  CHECK(game.lines >= 60); // 200 pieces fill 80 rows
+}
+
+TEST_CASE("The bot plays placements it can reach", "[tuner]") {
+  Bot bot = new_bot(DEFAULT_BOT_WEIGHTS, DEFAULT_WIDTH, DEFAULT_HEIGHT);
+  GameState state = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 3);
+  for (int piece = 0; piece < 20; piece++) {
+    std::vector<Placement> placements = find_placements(state);
+    int best = choose_placement(bot, placements);
+    REQUIRE(best >= 0);
+    for (Action action : placements[best].actions) {
+      state = reduce(state, action);
+    }
+    REQUIRE(state == placements[best].result);
+  }
+}
+
+TEST_CASE("Tuning is the same on any number of threads", "[tuner]") {
+  TunerState one = new_tuner_state(10);
+  TunerState four = new_tuner_state(10);
+  for (int generation = 0; generation < 2; generation++) {
+    run_generation(one, small_tuner_options(1));
+    run_generation(four, small_tuner_options(4));
+  }
+  check_same_tuner_state(one, four);
+  CHECK(one.best_fitness > 0);
+}
+
+TEST_CASE("A resumed tuner continues as if it had not stopped", "[tuner]") {
+  TunerOptions options = small_tuner_options(2);
+  TunerState uninterrupted = new_tuner_state(10);
+  TunerState resumed = new_tuner_state(10);
+  run_generation(uninterrupted, options);
+  run_generation(resumed, options);
+
+  std::stringstream checkpoint;
+  write_tuner_state(checkpoint, resumed);
+  TunerState loaded;
+  REQUIRE(read_tuner_state(checkpoint, loaded));
+  check_same_tuner_state(loaded, resumed);
+
+  run_generation(uninterrupted, options);
+  run_generation(loaded, options);
+  check_same_tuner_state(loaded, uninterrupted);
+}
+
+TEST_CASE("Hopeless candidates stop playing early", "[tuner]") {
+  TunerOptions options = small_tuner_options(2);
+  TunerState state = new_tuner_state(10);
+  GenerationReport first = run_generation(state, options);
+  CHECK(first.pruned == 0); // no cutoff yet
+  CHECK(first.games == 8 * 4);
+
+  state.elite_cutoff = 1e9; // everything is hopeless against this
+  GenerationReport second = run_generation(state, options);
+  CHECK(second.pruned == 8);
+  CHECK(second.games == 8 * 2);
+}
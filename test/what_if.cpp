@@ -0,0 +1,93 @@
+#include "catch.hpp"
+
+#include <random>
+#include <utility>
+
+#include "../src/what_if.h"
+
+static const Action ROLLOUT_ACTIONS[] = {
+  Action::MOVE_LEFT,
+  Action::MOVE_RIGHT,
+  Action::MOVE_DOWN,
+  Action::ROTATE_CLOCKWISE,
+  Action::ROTATE_COUNTERCLOCKWISE,
+  Action::TIME_FALL
+};
+
+// Random rollouts that branch off each other's prefixes.
+static std::vector<std::vector<Action>> branching_sequences(int count, std::mt19937 &random) {
+  std::vector<std::vector<Action>> sequences;
+  for (int i = 0; i < count; i++) {
+    std::vector<Action> sequence;
+    if (!sequences.empty()) {
+      const std::vector<Action> &base = sequences[random() % sequences.size()];
+      sequence.assign(base.begin(), base.begin() + random() % (base.size() + 1));
+    }
+    int extra = random() % 60;
+    for (int j = 0; j < extra; j++) {
+      sequence.push_back(ROLLOUT_ACTIONS[random() % 6]);
+    }
+    sequences.push_back(sequence);
+  }
+  return sequences;
+}
+
+static GameState play(GameState state, const std::vector<Action> &actions) {
+  for (Action action : actions) {
+    state = reduce(std::move(state), action);
+  }
+  return state;
+}
+
+TEST_CASE("What-if results match playing each sequence", "[what_if]") {
+  std::mt19937 random(11);
+  GameState root = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 4);
+  std::vector<std::vector<Action>> sequences = branching_sequences(300, random);
+  sequences.push_back({});
+  sequences.push_back(sequences[5]); // a duplicate
+
+  for (int threads : {1, 4}) {
+    WhatIfOptions options = {true, threads, [](const GameState &state) {
+      return static_cast<double>(hash_game_state(state) % 1000);
+    }};
+    WhatIfResult result = evaluate_sequences(root, sequences, options);
+    REQUIRE(result.states.size() == sequences.size());
+    REQUIRE(result.summaries.size() == sequences.size());
+    bool all_match = true;
+    for (std::size_t i = 0; i < sequences.size(); i++) {
+      GameState expected = play(root, sequences[i]);
+      const WhatIfSummary &summary = result.summaries[i];
+      all_match = all_match &&
+                  result.states[i] == expected &&
+                  result.states[i].progress == expected.progress &&
+                  summary.score == expected.score &&
+                  summary.lines == expected.lines &&
+                  summary.progress == expected.progress &&
+                  summary.value == hash_game_state(expected) % 1000;
+    }
+    CHECK(all_match);
+    CHECK(result.reductions < result.sequence_actions);
+  }
+}
+
+TEST_CASE("What-if shares prefixes", "[what_if]") {
+  GameState root = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  std::vector<Action> prefix(100, Action::TIME_FALL);
+  std::vector<std::vector<Action>> sequences;
+  for (Action last : ROLLOUT_ACTIONS) {
+    sequences.push_back(prefix);
+    sequences.back().push_back(last);
+  }
+  WhatIfResult result = evaluate_sequences(root, sequences, {false, 1, nullptr});
+  CHECK(result.states.empty());
+  CHECK(result.sequence_actions == 6 * 101);
+  CHECK(result.reductions == 100 + 6);
+  CHECK(result.summaries[0].value == 0);
+}
+
+TEST_CASE("What-if handles no sequences", "[what_if]") {
+  GameState root = new_game(DEFAULT_WIDTH, DEFAULT_HEIGHT, 0);
+  WhatIfResult result = evaluate_sequences(root, {}, {true, 4, nullptr});
+  CHECK(result.summaries.empty());
+  CHECK(result.reductions == 0);
+}